@@ -44,6 +44,7 @@
 // #define PIN_LIGHT_SENSOR 34
 // #define PIN_SPEAKER 26
 #define PIN_RPM_INPUT 35 // RPM Input moved to 35
+#define PIN_SHIFT_LIGHT 4 // Shift light output (was PIN_RGB_RED), -1 = none
 
 // GPS / UART
 // Set for Connector P1 (4-pin white) - SWAPPED AGAIN
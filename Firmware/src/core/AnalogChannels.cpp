@@ -0,0 +1,90 @@
+#include "AnalogChannels.h"
+#include <string.h>
+
+void AnalogChannels::clear() { _count = 0; }
+
+int AnalogChannels::add(const Config &c) {
+  if (_count >= MAX_CHANNELS)
+    return -1;
+  Channel &ch = _ch[_count];
+  ch.cfg = c;
+  if (ch.cfg.rateHz == 0)
+    ch.cfg.rateHz = 1;
+  if (ch.cfg.points > MAX_POINTS)
+    ch.cfg.points = MAX_POINTS;
+  ch.sum = 0;
+  ch.n = 0;
+  ch.nextT = 0;
+  ch.last = 0;
+  ch.seq = 0;
+  _count++;
+  setInputRate(_inputHz);
+  return _count - 1;
+}
+
+int AnalogChannels::find(const char *name) const {
+  for (int i = 0; i < _count; i++)
+    if (strcmp(_ch[i].cfg.name, name) == 0)
+      return i;
+  return -1;
+}
+
+void AnalogChannels::setInputRate(uint32_t hz) {
+  _inputHz = hz;
+  for (int i = 0; i < _count; i++) {
+    uint32_t d = hz / _ch[i].cfg.rateHz;
+    _ch[i].decimation = (d > 0) ? d : 1;
+  }
+}
+
+void AnalogChannels::addRaw(int i, uint16_t raw, uint32_t timeMs) {
+  Channel &ch = _ch[i];
+  ch.sum += raw;
+  if (++ch.n < ch.decimation)
+    return;
+
+  // Mean first, then the (non-linear) calibration: one call per output
+  uint32_t mean = (ch.sum + ch.n / 2) / ch.n;
+  ch.sum = 0;
+  ch.n = 0;
+  float mv = _toMv ? (float)_toMv(mean) : mean * 3300.0f / 4095.0f;
+  float v = applyCurve(ch.cfg, mv);
+
+  uint32_t t = timeMs;
+  int32_t off = (int32_t)(timeMs - ch.nextT);
+  if (ch.seq > 0 && off >= -(int32_t)JITTER_MS && off <= (int32_t)JITTER_MS)
+    t = ch.nextT;
+  ch.nextT = t + 1000 / ch.cfg.rateHz;
+
+  ch.last = v;
+  Sample &s = ch.samples[ch.seq % SAMPLES];
+  s.timeMs = t;
+  s.value = v;
+  ch.seq = ch.seq + 1;
+}
+
+bool AnalogChannels::getSample(int i, uint32_t seq, Sample &out) const {
+  const Channel &ch = _ch[i];
+  if (seq >= ch.seq || ch.seq - seq >= SAMPLES)
+    return false;
+  out = ch.samples[seq % SAMPLES];
+  return ch.seq - seq < SAMPLES; // Not overwritten while copying
+}
+
+// Linear between the points, clamped to the ends
+float AnalogChannels::applyCurve(const Config &c, float mv) {
+  if (c.points == 0)
+    return mv / 1000.0f;
+  if (c.points == 1 || mv <= c.mv[0])
+    return c.value[0];
+  for (int k = 1; k < c.points; k++) {
+    if (mv <= c.mv[k]) {
+      float span = c.mv[k] - c.mv[k - 1];
+      if (span <= 0)
+        return c.value[k];
+      return c.value[k - 1] +
+             (c.value[k] - c.value[k - 1]) * (mv - c.mv[k - 1]) / span;
+    }
+  }
+  return c.value[c.points - 1];
+}
@@ -0,0 +1,77 @@
+#ifndef ANALOG_CHANNELS_H
+#define ANALOG_CHANNELS_H
+
+#include <stdint.h>
+
+// Analog sensor channels fed from a continuous ADC stream. Each channel
+// averages DECIMATION = input rate / output rate raw conversions (a
+// boxcar, so mains and ignition noise well above the output rate
+// averages out), converts the mean to mV with the ADC's own calibration
+// and maps mV to the sensor's unit through a piecewise-linear curve.
+// Outputs go into a per-channel ring read by sequence number, so the
+// producer (ADC task) and readers (logger, UI) never wait on each other.
+// Raw conversions arrive a DMA frame at a time, so output times follow
+// a clock of exact 1/rate steps that only resyncs to the frame time when
+// it drifts past JITTER_MS; the log can then keep them in one block.
+class AnalogChannels {
+public:
+  static const int MAX_CHANNELS = 6;
+  static const int MAX_POINTS = 8;
+  static const int SAMPLES = 32; // Per channel
+  static const uint32_t JITTER_MS = 10; // More than one DMA frame
+
+  struct Config {
+    char name[12];
+    char unit[8];
+    int8_t pin;
+    uint16_t rateHz; // Output
+    uint8_t decimals;
+    uint8_t points;  // 0: value = volts at the pin
+    float mv[MAX_POINTS]; // Ascending
+    float value[MAX_POINTS];
+  };
+
+  struct Sample {
+    uint32_t timeMs;
+    float value;
+  };
+
+  void clear();
+  int add(const Config &c); // Index, -1 when full
+  int getCount() const { return _count; }
+  const Config &getConfig(int i) const { return _ch[i].cfg; }
+  int find(const char *name) const;
+
+  // Raw conversions per second per channel, and the ADC's raw -> mV
+  void setInputRate(uint32_t hz);
+  void setCalibration(uint32_t (*rawToMv)(uint32_t raw)) { _toMv = rawToMv; }
+
+  // One conversion of channel i; O(1), publishes every DECIMATION
+  void addRaw(int i, uint16_t raw, uint32_t timeMs);
+
+  float getValue(int i) const { return _ch[i].last; }
+  bool hasValue(int i) const { return _ch[i].seq > 0; }
+  uint32_t getSampleSeq(int i) const { return _ch[i].seq; }
+  bool getSample(int i, uint32_t seq, Sample &out) const;
+
+  static float applyCurve(const Config &c, float mv);
+
+private:
+  struct Channel {
+    Config cfg;
+    uint32_t decimation;
+    uint32_t sum;
+    uint32_t n;
+    uint32_t nextT; // Output clock
+    volatile float last;
+    Sample samples[SAMPLES];
+    volatile uint32_t seq;
+  };
+
+  Channel _ch[MAX_CHANNELS];
+  int _count = 0;
+  uint32_t _inputHz = 1000;
+  uint32_t (*_toMv)(uint32_t) = nullptr;
+};
+
+#endif
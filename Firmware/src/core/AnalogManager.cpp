@@ -0,0 +1,177 @@
+#include "AnalogManager.h"
+#include <ArduinoJson.h>
+#include <SD.h>
+#include <driver/adc.h>
+#include <esp_adc_cal.h>
+
+static esp_adc_cal_characteristics_t adcChars;
+
+static uint32_t rawToMv(uint32_t raw) {
+  return esp_adc_cal_raw_to_voltage(raw, &adcChars);
+}
+
+// ADC1 only: the ESP32 can't stream ADC2, and WiFi owns it anyway.
+// 32/33 are the touch I2C and 35 the RPM input.
+int AnalogManager::adcChannelOf(int pin) {
+  switch (pin) {
+  case 36:
+    return 0;
+  case 37:
+    return 1;
+  case 38:
+    return 2;
+  case 39:
+    return 3;
+  case 34:
+    return 6;
+  default:
+    return -1;
+  }
+}
+
+bool AnalogManager::addChannel(const AnalogChannels::Config &c) {
+  int ch = adcChannelOf(c.pin);
+  if (ch < 0 || _byAdcChannel[ch] >= 0) {
+    Serial.printf("Analog: %s pin %d unusable\n", c.name, c.pin);
+    return false;
+  }
+  int i = _channels.add(c);
+  if (i < 0)
+    return false;
+  _byAdcChannel[ch] = i;
+  return true;
+}
+
+void AnalogManager::loadConfig() {
+  // Battery through the 1:2 divider
+  AnalogChannels::Config bat = {};
+  snprintf(bat.name, sizeof(bat.name), "battery");
+  snprintf(bat.unit, sizeof(bat.unit), "V");
+  bat.pin = PIN_BATTERY;
+  bat.rateHz = 1;
+  bat.decimals = 2;
+  bat.points = 2;
+  bat.mv[0] = 0;
+  bat.value[0] = 0;
+  bat.mv[1] = 3300;
+  bat.value[1] = 6.6f;
+  if (addChannel(bat))
+    _battery = _channels.getCount() - 1;
+
+  File file = SD.open("/analog.json", FILE_READ);
+  if (!file)
+    return;
+  JsonDocument doc;
+  DeserializationError error = deserializeJson(doc, file);
+  file.close();
+  if (error || !doc["channels"].is<JsonArray>()) {
+    Serial.println("Analog: bad /analog.json");
+    return;
+  }
+
+  JsonArray list = doc["channels"];
+  for (JsonVariant v : list) {
+    AnalogChannels::Config c = {};
+    const char *name = v["name"].as<const char *>();
+    if (!name || !*name)
+      continue;
+    snprintf(c.name, sizeof(c.name), "%s", name);
+    const char *unit = v["unit"].as<const char *>();
+    snprintf(c.unit, sizeof(c.unit), "%s", unit ? unit : "");
+    c.pin = (int8_t)v["pin"].as<int>();
+    int hz = v["hz"].isNull() ? 10 : v["hz"].as<int>();
+    c.rateHz = (uint16_t)constrain(hz, 1, MAX_HZ);
+    c.decimals = v["dec"].isNull() ? 2 : (uint8_t)v["dec"].as<int>();
+    if (v["curve"].is<JsonArray>()) {
+      JsonArray curve = v["curve"];
+      for (JsonVariant p : curve) {
+        if (c.points >= AnalogChannels::MAX_POINTS)
+          break;
+        c.mv[c.points] = p[0].as<float>();
+        c.value[c.points] = p[1].as<float>();
+        if (c.points > 0 && c.mv[c.points] <= c.mv[c.points - 1])
+          break; // mV must rise
+        c.points++;
+      }
+    }
+    addChannel(c);
+  }
+}
+
+void AnalogManager::begin() {
+  for (int i = 0; i < 8; i++)
+    _byAdcChannel[i] = -1;
+  loadConfig();
+  if (_channels.getCount() == 0)
+    return;
+
+  esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, 1100,
+                           &adcChars);
+  _channels.setCalibration(rawToMv);
+  _channels.setInputRate(SAMPLE_HZ / _channels.getCount());
+
+  uint32_t mask = 0;
+  adc_digi_pattern_config_t pattern[AnalogChannels::MAX_CHANNELS] = {};
+  for (int i = 0; i < _channels.getCount(); i++) {
+    int ch = adcChannelOf(_channels.getConfig(i).pin);
+    mask |= 1 << ch;
+    pattern[i].atten = ADC_ATTEN_DB_11;
+    pattern[i].channel = ch;
+    pattern[i].unit = 0; // ADC1
+    pattern[i].bit_width = 12;
+  }
+
+  adc_digi_init_config_t init = {};
+  init.max_store_buf_size = 4 * FRAME_BYTES;
+  init.conv_num_each_intr = FRAME_BYTES;
+  init.adc1_chan_mask = mask;
+  if (adc_digi_initialize(&init) != ESP_OK) {
+    Serial.println("Analog: DMA init failed");
+    return;
+  }
+
+  adc_digi_configuration_t cfg = {};
+  cfg.conv_limit_en = true; // Required on the ESP32
+  cfg.conv_limit_num = 250;
+  cfg.pattern_num = _channels.getCount();
+  cfg.adc_pattern = pattern;
+  cfg.sample_freq_hz = SAMPLE_HZ;
+  cfg.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  cfg.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+  adc_digi_controller_configure(&cfg);
+  adc_digi_start();
+  _running = true;
+
+  // Core 0 next to the logger, above it: a late frame is lost data
+  xTaskCreatePinnedToCore(adcTask, "AdcTask", 3072, this, 2, &_taskHandle, 0);
+  Serial.printf("Analog: %d channels at %lu Hz each\n", _channels.getCount(),
+                (unsigned long)(SAMPLE_HZ / _channels.getCount()));
+}
+
+void AnalogManager::adcTask(void *parameter) {
+  AnalogManager *self = (AnalogManager *)parameter;
+  uint8_t buf[FRAME_BYTES];
+
+  while (true) {
+    uint32_t len = 0;
+    esp_err_t err = adc_digi_read_bytes(buf, sizeof(buf), &len, 100);
+    if (err == ESP_ERR_INVALID_STATE)
+      self->_overruns = self->_overruns + 1; // Driver buffer overflowed
+    else if (err != ESP_OK)
+      continue;
+
+    // The frame just ended: its conversions are all within 6.4 ms
+    uint32_t now = millis();
+    for (uint32_t i = 0; i + 1 < len; i += 2) {
+      const adc_digi_output_data_t *d = (const adc_digi_output_data_t *)&buf[i];
+      int ch = d->type1.channel;
+      if (ch >= 8 || self->_byAdcChannel[ch] < 0)
+        continue;
+      self->_channels.addRaw(self->_byAdcChannel[ch], d->type1.data, now);
+    }
+  }
+}
+
+float AnalogManager::getBatteryVolts() const {
+  return _battery >= 0 ? _channels.getValue(_battery) : 0;
+}
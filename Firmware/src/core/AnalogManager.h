@@ -0,0 +1,48 @@
+#ifndef ANALOG_MANAGER_H
+#define ANALOG_MANAGER_H
+
+#include "../config.h"
+#include "AnalogChannels.h"
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Analog sensors on ADC1 in continuous (DMA) mode. The ADC walks the
+// channel pattern at SAMPLE_HZ on its own; a task on core 0 wakes once
+// per DMA frame, decimates and calibrates (AnalogChannels) and leaves
+// the results for SessionManager to log, so the UI loop never waits on
+// a conversion. Channels come from /analog.json on the SD card:
+//   {"channels":[{"name":"water","unit":"C","pin":36,"hz":10,"dec":1,
+//     "curve":[[400,120],[1500,80],[2800,20]]}]}   (mV at the pin, value)
+// plus the battery on PIN_BATTERY, always present.
+class AnalogManager {
+public:
+  void begin(); // After the SD card
+
+  const AnalogChannels &getChannels() const { return _channels; }
+  bool isRunning() const { return _running; }
+  bool hasBattery() const {
+    return _battery >= 0 && _channels.hasValue(_battery);
+  }
+  float getBatteryVolts() const;
+  uint32_t getOverruns() const { return _overruns; }
+
+  static const uint32_t SAMPLE_HZ = 20000; // All channels, the ESP32 minimum
+  static const uint32_t FRAME_BYTES = 256; // 128 conversions, 6.4 ms
+  static const int MAX_HZ = 100;           // Per channel output
+
+private:
+  AnalogChannels _channels;
+  int8_t _byAdcChannel[8]; // ADC1 channel -> index, -1 unused
+  int _battery = -1;
+  bool _running = false;
+  volatile uint32_t _overruns = 0;
+  TaskHandle_t _taskHandle = nullptr;
+
+  void loadConfig();
+  bool addChannel(const AnalogChannels::Config &c);
+  static int adcChannelOf(int pin);
+  static void adcTask(void *parameter);
+};
+
+#endif
@@ -0,0 +1,247 @@
+#include "BrakingEngine.h"
+#include <math.h>
+
+void BrakingEngine::addTarget(float fromKmh, float toKmh) {
+  Target t = {fromKmh, toKmh, false, false, 0, 0, 0, 0, 0, 0};
+  _targets.push_back(t);
+}
+
+void BrakingEngine::reset() {
+  _count = 0;
+  _head = 0;
+  _dist = 0;
+  _braking = false;
+  _candidate = false;
+  _onsetPending = false;
+  _candT = 0;
+  _onsetT = 0;
+  _onsetV = 0;
+  _onsetD = 0;
+  _peak = 0;
+  _stopped = false;
+  _stopDist = 0;
+  _stopTime = 0;
+  _stopPeak = 0;
+  for (size_t i = 0; i < _targets.size(); i++) {
+    Target &t = _targets[i];
+    t.started = false;
+    t.done = false;
+    t.startT = 0;
+    t.startDist = 0;
+    t.time = 0;
+    t.distance = 0;
+    t.avgDecel = 0;
+    t.peakDecel = 0;
+  }
+}
+
+// Deceleration (m/s^2) from the newest epoch back to the newest one at
+// least PEAK_SPAN_MS older: single-epoch differences are mostly noise
+float BrakingEngine::spanDecel() const {
+  int now = idx(0);
+  for (int back = 1; back < _count; back++) {
+    int old = idx(back);
+    uint32_t dt = _t[now] - _t[old];
+    if (dt >= PEAK_SPAN_MS)
+      return (_v[old] - _v[now]) / (dt / 1000.0f);
+  }
+  return 0;
+}
+
+// Least-squares speed line over epochs back kFrom..kTo (newest first),
+// times in s relative to epoch tRef: v = v0 + a t
+bool BrakingEngine::fitLine(int kFrom, int kTo, uint32_t tRef, float &v0,
+                            float &a) const {
+  double st = 0, sv = 0, stt = 0, stv = 0;
+  int n = 0;
+  for (int k = kFrom; k <= kTo && k < _count; k++) {
+    int i = idx(k);
+    double t = ((double)_t[i] - tRef) / 1000.0;
+    st += t;
+    sv += _v[i];
+    stt += t * t;
+    stv += t * _v[i];
+    n++;
+  }
+  double den = n * stt - st * st;
+  if (n < 2 || den <= 0)
+    return false;
+  a = (float)((n * stv - st * sv) / den);
+  v0 = (float)((sv - a * st) / n);
+  return true;
+}
+
+// Once the braking spans ONSET_FIT_MS. The onset can lie in the step
+// before the first one over ONSET_DECEL (its average was diluted), so
+// the pre-braking line is fitted to the epochs up to the start of that
+// step, the braking line to the epochs since, and onset is where they
+// meet.
+void BrakingEngine::findOnset() {
+  // Epoch that started the first braking step
+  int kc = 0;
+  while (kc < _count - 1 && _t[idx(kc)] != _candT)
+    kc++;
+  int k3 = (kc + 1 < _count) ? kc + 1 : kc;
+  int i3 = idx(k3);
+  uint32_t tRef = _t[i3];
+
+  // Pre-braking: up to PEAK_SPAN_MS before epoch i3
+  int kOld = k3;
+  while (kOld + 1 < _count && tRef - _t[idx(kOld + 1)] <= PEAK_SPAN_MS)
+    kOld++;
+  float vA = _v[i3], aA = 0;
+  if (!fitLine(k3, kOld, tRef, vA, aA)) {
+    vA = _v[i3];
+    aA = 0;
+  }
+
+  float vB, aB;
+  float tMax = (_t[idx(0)] - tRef) / 1000.0f;
+  float t = 0;
+  if (kc > 0 && fitLine(0, kc - 1, tRef, vB, aB) && aA - aB > 0.01f) {
+    t = (vB - vA) / (aA - aB);
+    if (t < 0)
+      t = 0;
+    if (t > tMax)
+      t = tMax;
+  }
+
+  _onsetV = vA + aA * t;
+  _onsetT = (double)tRef + t * 1000.0;
+  _onsetD = _d[i3] + (_v[i3] + _onsetV) * 0.5f * t;
+}
+
+// Deceleration to extrapolate a stop with: over the last PEAK_SPAN_MS,
+// or the average since the braking started when that is noise
+float BrakingEngine::stopDecel(float a, float v1, float fromV, double fromT,
+                               uint32_t t1) {
+  if (a < -0.5f)
+    return a;
+  double dt = (t1 - fromT) / 1000.0;
+  return (dt > 0 && v1 < fromV) ? (float)((v1 - fromV) / dt) : -G;
+}
+
+void BrakingEngine::addSample(uint32_t timeMs, float speedKmh) {
+  float v = speedKmh / 3.6f;
+  if (_count > 0 && timeMs == _t[idx(0)])
+    return;
+
+  if (_count == 0) {
+    _t[_head] = timeMs;
+    _v[_head] = v;
+    _d[_head] = 0;
+    _head = (_head + 1) % HISTORY;
+    _count = 1;
+    return;
+  }
+
+  int prev = idx(0);
+  uint32_t t0 = _t[prev];
+  float v0 = _v[prev], d0 = _d[prev];
+  float dt = (timeMs - t0) / 1000.0f;
+  float a = (v - v0) / dt;
+  float d1 = d0 + (v0 + v) * 0.5f * dt;
+
+  _t[_head] = timeMs;
+  _v[_head] = v;
+  _d[_head] = d1;
+  _head = (_head + 1) % HISTORY;
+  if (_count < HISTORY)
+    _count++;
+  _dist = d1;
+
+  // Braking phase (onset to stop)
+  if (!_braking) {
+    if (-a >= ONSET_DECEL && v0 * 3.6f > LOW_KMH) {
+      if (_candidate) {
+        _braking = true;
+        _onsetPending = true;
+        _stopped = false;
+        _peak = 0;
+      } else {
+        _candT = t0;
+      }
+      _candidate = !_braking;
+    } else {
+      _candidate = false;
+    }
+  }
+  if (_braking && _onsetPending &&
+      (timeMs - _candT >= ONSET_FIT_MS || v * 3.6f < LOW_KMH ||
+       _t[idx(_count - 1)] == _candT)) {
+    findOnset();
+    _onsetPending = false;
+  }
+  if (_braking) {
+    float dec = spanDecel();
+    if (dec > _peak)
+      _peak = dec;
+    if (v * 3.6f < LOW_KMH) {
+      float as = stopDecel(-dec, v, _onsetV, _onsetT, timeMs);
+      float tau = -v / as; // s
+      _stopTime = (float)(timeMs + tau * 1000.0f - _onsetT);
+      _stopDist = d1 + v * tau * 0.5f - _onsetD;
+      _stopPeak = _peak / G;
+      _stopped = true;
+      _braking = false;
+    } else if (a > 0) {
+      _braking = false; // Released before a stop
+    }
+  }
+
+  stepTargets(t0, v0, d0, timeMs, v, d1, a);
+}
+
+void BrakingEngine::stepTargets(uint32_t t0, float v0, float d0, uint32_t t1,
+                                float v1, float d1, float a) {
+  for (size_t i = 0; i < _targets.size(); i++) {
+    Target &tg = _targets[i];
+    if (tg.done)
+      continue;
+    float from = tg.fromKmh / 3.6f;
+    float to = tg.toKmh / 3.6f;
+
+    // Start speed crossed going down: interpolated, constant decel
+    if (!tg.started) {
+      if (!(v0 > from && v1 <= from && a < 0))
+        continue;
+      float tau = (from - v0) / a;
+      tg.startT = t0 + tau * 1000.0;
+      tg.startDist = d0 + v0 * tau + 0.5f * a * tau * tau;
+      tg.peakDecel = 0;
+      tg.started = true;
+    } else if (v1 > from) {
+      tg.started = false; // Back above the start speed: try again
+      continue;
+    }
+
+    float dec = spanDecel();
+    if (dec / G > tg.peakDecel)
+      tg.peakDecel = dec / G;
+
+    double endT;
+    float endD;
+    if (tg.toKmh < LOW_KMH) {
+      // To a stop: extrapolated once under LOW_KMH
+      if (v1 * 3.6f >= LOW_KMH)
+        continue;
+      float as = stopDecel(-dec, v1, from, tg.startT, t1);
+      float tau = -v1 / as;
+      endT = t1 + tau * 1000.0;
+      endD = d1 + v1 * tau * 0.5f;
+    } else {
+      if (v1 > to || a >= 0)
+        continue;
+      float tau = (to - v0) / a;
+      endT = t0 + tau * 1000.0;
+      endD = d0 + v0 * tau + 0.5f * a * tau * tau;
+    }
+
+    tg.time = (float)(endT - tg.startT);
+    tg.distance = endD - tg.startDist;
+    tg.avgDecel = (tg.time > 0) ? (from - to) / (tg.time / 1000.0f) / G : 0;
+    if (tg.peakDecel < tg.avgDecel)
+      tg.peakDecel = tg.avgDecel;
+    tg.done = true;
+  }
+}
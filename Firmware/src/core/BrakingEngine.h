@@ -0,0 +1,85 @@
+#ifndef BRAKING_ENGINE_H
+#define BRAKING_ENGINE_H
+
+#include <stdint.h>
+#include <vector>
+
+// Braking measurement, fed once per GNSS epoch like DragEngine.
+// Onset is where the pre-braking speed line meets a fit of the first
+// braking epochs; a speed target (100-0 km/h...) starts at the
+// interpolated crossing of its start speed, and a stop is extrapolated
+// from the last epoch's deceleration. Distances assume constant
+// deceleration inside each epoch.
+class BrakingEngine {
+public:
+  struct Target {
+    float fromKmh;
+    float toKmh;     // 0 = to a stop
+    bool started;
+    bool done;
+    double startT;   // ms (epoch time)
+    float startDist; // m (engine distance)
+    float time;      // ms
+    float distance;  // m
+    float avgDecel;  // g
+    float peakDecel; // g
+  };
+
+  void clearTargets() { _targets.clear(); }
+  void addTarget(float fromKmh, float toKmh);
+  int getTargetCount() const { return _targets.size(); }
+  const Target &getTarget(int i) const { return _targets[i]; }
+
+  void reset();
+  void addSample(uint32_t timeMs, float speedKmh);
+
+  // Last complete stop: onset to standstill
+  bool hasStop() const { return _stopped; }
+  float getOnsetSpeed() const { return _onsetV * 3.6f; } // km/h
+  float getStopDistance() const { return _stopDist; }    // m
+  float getStopTime() const { return _stopTime; }        // ms
+  float getPeakDecel() const { return _stopPeak; }       // g
+
+  static constexpr float ONSET_DECEL = 3.0f; // m/s^2 (~0.3 g) = braking
+  static constexpr float LOW_KMH = 5.0f;     // Below: extrapolate the stop
+  static const uint32_t PEAK_SPAN_MS = 200;  // Peak decel over >= this
+  static const uint32_t ONSET_FIT_MS = 400;  // Braking fitted for onset
+  static constexpr float G = 9.80665f;
+
+private:
+  std::vector<Target> _targets;
+
+  // Recent epochs (speed m/s, engine distance m)
+  static const int HISTORY = 16;
+  uint32_t _t[HISTORY];
+  float _v[HISTORY];
+  float _d[HISTORY];
+  int _count = 0;
+  int _head = 0;
+  float _dist = 0;
+
+  // Braking phase
+  bool _braking = false;
+  bool _candidate = false; // One braking step seen, needs a second
+  uint32_t _candT = 0;     // Epoch starting the first braking step
+  bool _onsetPending = false;
+  double _onsetT = 0;
+  float _onsetV = 0, _onsetD = 0;
+  float _peak = 0; // m/s^2 since onset
+
+  bool _stopped = false;
+  float _stopDist = 0, _stopTime = 0, _stopPeak = 0;
+
+  int idx(int back) const {
+    return (_head + HISTORY - 1 - back) % HISTORY;
+  }
+  float spanDecel() const;
+  bool fitLine(int kFrom, int kTo, uint32_t tRef, float &v0, float &a) const;
+  void findOnset();
+  void stepTargets(uint32_t t0, float v0, float d0, uint32_t t1, float v1,
+                   float d1, float a);
+  static float stopDecel(float a, float v1, float fromV, double fromT,
+                         uint32_t t1);
+};
+
+#endif
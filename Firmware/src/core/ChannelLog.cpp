@@ -0,0 +1,329 @@
+#include "ChannelLog.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Longest D line, well inside the readers' SessionManager::MAX_LINE
+static const int LINE_MAX = 120;
+
+void ChannelLog::define(const char *name, const char *unit, uint32_t periodMs,
+                        int column, uint8_t decimals) {
+  Def &d = _defs[_count];
+  snprintf(d.name, sizeof(d.name), "%s", name);
+  snprintf(d.unit, sizeof(d.unit), "%s", unit);
+  d.periodMs = periodMs;
+  d.column = (int8_t)column;
+  d.decimals = decimals;
+  _pending[_count].count = 0;
+  _count++;
+}
+
+void ChannelLog::clear() {
+  _count = 0;
+  // Fix row: Time,Lat,Lon,Speed,Sats,Alt,Heading,LonG,LatG,Gear
+  define("speed", "km/h", 0, 3, 2);
+  define("alt", "m", 0, 5, 2);
+  define("heading", "deg", 0, 6, 2);
+  define("long", "g", 0, 7, 2);
+  define("latg", "g", 0, 8, 2);
+  define("gear", "", 0, 9, 0);
+  define("rpm", "rpm", 10, -1, 0);
+  define("battery", "V", 1000, -1, 2);
+}
+
+int ChannelLog::add(const char *name, const char *unit, uint32_t periodMs,
+                    uint8_t decimals) {
+  int id = find(name);
+  if (id >= 0)
+    return id;
+  if (_count >= MAX_CHANNELS)
+    return -1;
+  define(name, unit, periodMs, -1, decimals);
+  return _count - 1;
+}
+
+int ChannelLog::find(const char *name) const {
+  for (int i = 0; i < _count; i++)
+    if (strcmp(_defs[i].name, name) == 0)
+      return i;
+  return -1;
+}
+
+int ChannelLog::formatDef(int id, char *buf, size_t size) const {
+  const Def &d = _defs[id];
+  return snprintf(buf, size, "CH,%d,%s,%s,%lu,%d,%u", id, d.name, d.unit,
+                  (unsigned long)d.periodMs, d.column, d.decimals);
+}
+
+bool ChannelLog::parseDef(const char *line, int &id, Def &out) {
+  if (strncmp(line, "CH,", 3) != 0)
+    return false;
+  // Unit may be empty: split by hand rather than with %[^,]
+  const char *f[6];
+  int n = 0;
+  const char *p = line + 3;
+  f[n++] = p;
+  while (*p && n < 6) {
+    if (*p == ',')
+      f[n++] = p + 1;
+    p++;
+  }
+  if (n < 6)
+    return false;
+  id = atoi(f[0]);
+  int nameLen = f[2] - f[1] - 1;
+  int unitLen = f[3] - f[2] - 1;
+  if (id < 0 || nameLen <= 0 || nameLen >= (int)sizeof(out.name) ||
+      unitLen >= (int)sizeof(out.unit))
+    return false;
+  memcpy(out.name, f[1], nameLen);
+  out.name[nameLen] = '\0';
+  memcpy(out.unit, f[2], unitLen);
+  out.unit[unitLen] = '\0';
+  out.periodMs = strtoul(f[3], nullptr, 10);
+  out.column = (int8_t)atoi(f[4]);
+  out.decimals = (uint8_t)atoi(f[5]);
+  return true;
+}
+
+void ChannelLog::addSample(int id, uint32_t timeMs, float value) {
+  if (id < 0 || id >= _count || _defs[id].column >= 0)
+    return;
+  Pending &p = _pending[id];
+  if (p.count > 0) {
+    bool fits;
+    if (p.count >= BLOCK)
+      fits = false;
+    else if (p.count == 1)
+      fits = timeMs > p.t0;
+    else {
+      int32_t off = (int32_t)(timeMs - (p.t0 + p.count * p.dt));
+      fits = off >= -1 && off <= 1;
+    }
+    if (!fits)
+      write(id);
+  }
+  if (p.count == 0) {
+    p.t0 = timeMs;
+    p.dt = 0;
+  } else if (p.count == 1) {
+    p.dt = timeMs - p.t0;
+  }
+  p.v[p.count++] = value;
+}
+
+void ChannelLog::flush() {
+  for (int i = 0; i < _count; i++)
+    if (_pending[i].count > 0)
+      write(i);
+}
+
+// One D line, or several if the values don't fit in LINE_MAX
+void ChannelLog::write(int id) {
+  Pending &p = _pending[id];
+  int dec = _defs[id].decimals;
+  char line[LINE_MAX + 16];
+  int i = 0;
+  while (i < p.count) {
+    int len = snprintf(line, sizeof(line), "D,%d,%lu,%lu", id,
+                       (unsigned long)(p.t0 + i * p.dt), (unsigned long)p.dt);
+    int first = i;
+    while (i < p.count) {
+      char v[24];
+      int n = snprintf(v, sizeof(v), ",%.*f", dec, p.v[i]);
+      if (len + n > LINE_MAX && i > first)
+        break;
+      memcpy(line + len, v, n + 1);
+      len += n;
+      i++;
+    }
+    if (_sink)
+      _sink(line);
+  }
+  p.count = 0;
+}
+
+bool ChannelResampler::begin(const char *names, uint32_t stepMs) {
+  _n = 0;
+  _step = (stepMs > 0) ? stepMs : 1;
+  _started = false;
+  const char *p = names;
+  while (*p) {
+    while (*p == ' ' || *p == ',')
+      p++;
+    const char *s = p;
+    while (*p && *p != ',' && *p != ' ')
+      p++;
+    int len = p - s;
+    if (len == 0)
+      break;
+    if (_n >= MAX_SELECT || len >= (int)sizeof(_names[0]))
+      return false;
+    memcpy(_names[_n], s, len);
+    _names[_n][len] = '\0';
+    Chan &c = _ch[_n++];
+    c.id = -1;
+    c.column = -1;
+    c.holdMs = STALE_MS;
+    c.head = 0;
+    c.count = 0;
+  }
+  return _n > 0;
+}
+
+void ChannelResampler::push(Chan &c, uint32_t t, float v) {
+  if (c.count == WINDOW)
+    emit(false); // Makes room if the grid can move
+  if (c.count == WINDOW) {
+    c.head = (c.head + 1) % WINDOW;
+    c.count--;
+  }
+  int i = (c.head + c.count) % WINDOW;
+  c.t[i] = t;
+  c.v[i] = v;
+  c.count++;
+}
+
+uint32_t ChannelResampler::latest(const Chan &c) const {
+  return c.t[(c.head + c.count - 1) % WINDOW];
+}
+
+void ChannelResampler::addLine(const char *line) {
+  bool pushed = false;
+  if (line[0] == 'C') {
+    int id;
+    ChannelLog::Def d;
+    if (!ChannelLog::parseDef(line, id, d))
+      return;
+    for (int i = 0; i < _n; i++)
+      if (strcmp(_names[i], d.name) == 0) {
+        _ch[i].id = id;
+        _ch[i].column = d.column;
+        uint32_t hold = 2 * d.periodMs;
+        _ch[i].holdMs = (hold > STALE_MS) ? hold : STALE_MS;
+      }
+    return;
+  } else if (line[0] == 'D' && line[1] == ',') {
+    char *end;
+    int id = (int)strtol(line + 2, &end, 10);
+    Chan *c = nullptr;
+    for (int i = 0; i < _n; i++)
+      if (_ch[i].id == id && _ch[i].column < 0)
+        c = &_ch[i];
+    if (!c || *end != ',')
+      return;
+    uint32_t t0 = strtoul(end + 1, &end, 10);
+    if (*end != ',')
+      return;
+    uint32_t dt = strtoul(end + 1, &end, 10);
+    for (int k = 0; *end == ','; k++) {
+      float v = strtof(end + 1, &end);
+      push(*c, t0 + k * dt, v);
+      emit(false);
+    }
+  } else if (line[0] >= '0' && line[0] <= '9') {
+    // Fix row: pick the selected columns
+    char *end;
+    uint32_t t = strtoul(line, &end, 10);
+    const char *p = end;
+    for (int field = 1; *p == ','; field++) {
+      p++;
+      for (int i = 0; i < _n; i++)
+        if (_ch[i].column == field) {
+          push(_ch[i], t, strtof(p, nullptr));
+          pushed = true;
+        }
+      while (*p && *p != ',')
+        p++;
+    }
+  }
+  if (pushed)
+    emit(false);
+}
+
+// Linear between the samples either side of t; NAN in a gap
+float ChannelResampler::valueAt(Chan &c, uint32_t t) const {
+  if (c.count == 0)
+    return NAN;
+  uint32_t last = latest(c);
+  if ((int32_t)(t - last) > 0)
+    return (t - last <= c.holdMs) ? c.v[(c.head + c.count - 1) % WINDOW]
+                                  : NAN;
+  for (int k = 0; k < c.count; k++) {
+    int i = (c.head + k) % WINDOW;
+    if (c.t[i] < t)
+      continue;
+    if (c.t[i] == t)
+      return c.v[i];
+    if (k == 0)
+      return NAN; // Before the first sample held
+    int j = (c.head + k - 1) % WINDOW;
+    uint32_t span = c.t[i] - c.t[j];
+    if (span > c.holdMs)
+      return NAN;
+    return c.v[j] + (c.v[i] - c.v[j]) * (float)(t - c.t[j]) / span;
+  }
+  return NAN;
+}
+
+void ChannelResampler::emit(bool final) {
+  // Lead: the newest sample of any channel
+  bool any = false;
+  uint32_t lead = 0;
+  for (int i = 0; i < _n; i++)
+    if (_ch[i].count > 0) {
+      uint32_t t = latest(_ch[i]);
+      if (!any || (int32_t)(t - lead) > 0)
+        lead = t;
+      any = true;
+    }
+  if (!any)
+    return;
+
+  if (!_started) {
+    // From the first sample of any channel; the others read NAN until
+    // their own first one
+    uint32_t start = lead;
+    for (int i = 0; i < _n; i++)
+      if (_ch[i].count > 0 && (int32_t)(_ch[i].t[_ch[i].head] - start) < 0)
+        start = _ch[i].t[_ch[i].head];
+    _next = (start + _step - 1) / _step * _step;
+    _started = true;
+  }
+
+  float v[MAX_SELECT];
+  while ((int32_t)(lead - _next) >= 0) {
+    bool waiting = false;
+    bool full = final;
+    for (int i = 0; i < _n; i++) {
+      const Chan &c = _ch[i];
+      if (c.id < 0)
+        continue;
+      if (c.count == WINDOW)
+        full = true;
+      // Not there yet: wait, unless it has gone quiet
+      bool reached = c.count > 0 && (int32_t)(latest(c) - _next) >= 0;
+      if (!reached && lead - _next < c.holdMs)
+        waiting = true;
+    }
+    if (waiting && !full)
+      return;
+
+    for (int i = 0; i < _n; i++) {
+      Chan &c = _ch[i];
+      v[i] = valueAt(c, _next);
+      // Keep one sample at or before the grid point, for the next one
+      while (c.count > 1 &&
+             (int32_t)(c.t[(c.head + 1) % WINDOW] - _next) <= 0) {
+        c.head = (c.head + 1) % WINDOW;
+        c.count--;
+      }
+    }
+    if (_out)
+      _out(_next, v);
+    _next += _step;
+  }
+}
+
+void ChannelResampler::finish() { emit(true); }
@@ -0,0 +1,129 @@
+#ifndef CHANNEL_LOG_H
+#define CHANNEL_LOG_H
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+
+// Channel registry and the multi-rate session log. Every channel has a
+// native period and its own timestamps (millis()). GNSS channels are
+// columns of the fix row, written once per fix; the others are written
+// as blocks of evenly spaced samples, interleaved with the rows:
+//   CH,Id,Name,Unit,PeriodMs,Column,Decimals   (declared after the header)
+//   D,Id,T0,Dt,v0,v1,...                       (sample i at T0 + i * Dt)
+// PeriodMs 0 is "per fix"; Column is the fix-row field, -1 for blocks.
+// A block ends when a sample is more than 1 ms off its spacing or
+// BLOCK samples are held, so nothing is padded or repeated. Older
+// readers skip these lines like LAP/SECTOR.
+class ChannelLog {
+public:
+  struct Def {
+    char name[12];
+    char unit[8];
+    uint32_t periodMs; // Native, 0 = per GNSS fix
+    int8_t column;     // Field of the fix row, -1 = D blocks
+    uint8_t decimals;
+  };
+
+  // Always registered, in this order
+  enum Builtin {
+    CH_SPEED,
+    CH_ALT,
+    CH_HEADING,
+    CH_LONG,
+    CH_LATG,
+    CH_GEAR,
+    CH_RPM,
+    CH_BATTERY,
+    BUILTIN_COUNT
+  };
+
+  ChannelLog() { clear(); }
+  void clear(); // Builtins only
+  // A block channel; its id, or -1 when the registry is full
+  int add(const char *name, const char *unit, uint32_t periodMs,
+          uint8_t decimals);
+  int find(const char *name) const;
+  int getCount() const { return _count; }
+  const Def &get(int id) const { return _defs[id]; }
+
+  // "CH,..." line for one channel; parseDef() reads it back
+  int formatDef(int id, char *buf, size_t size) const;
+  static bool parseDef(const char *line, int &id, Def &out);
+
+  // Writer: completed "D,..." lines go to the sink
+  void setSink(std::function<void(const char *)> sink) { _sink = sink; }
+  void addSample(int id, uint32_t timeMs, float value);
+  void flush(); // Everything held, e.g. before a fix row
+
+  static const int MAX_CHANNELS = 16;
+  static const int BLOCK = 16; // Samples per D line at most
+
+private:
+  struct Pending {
+    uint32_t t0;
+    uint32_t dt;
+    uint8_t count;
+    float v[BLOCK];
+  };
+
+  Def _defs[MAX_CHANNELS];
+  Pending _pending[MAX_CHANNELS];
+  int _count = 0;
+  std::function<void(const char *)> _sink;
+
+  void define(const char *name, const char *unit, uint32_t periodMs,
+              int column, uint8_t decimals);
+  void write(int id);
+};
+
+// Reader: resamples a subset of a log's channels onto a common timebase,
+// streaming, whatever their native rates. Feed it every line of the log;
+// each channel keeps a short window of samples, linear interpolation in
+// between. Past its newest sample a channel holds that value for
+// max(STALE_MS, 2 periods), then reads NAN (sensor off, RPM disabled);
+// grid points wait for every channel unless one's window is full.
+class ChannelResampler {
+public:
+  // Comma-separated channel names ("speed,rpm"), matched against the
+  // log's CH lines; false when there are none or too many
+  bool begin(const char *names, uint32_t stepMs);
+  int getChannelCount() const { return _n; }
+  const char *getName(int i) const { return _names[i]; }
+
+  void setOutput(std::function<void(uint32_t, const float *)> fn) {
+    _out = fn;
+  }
+  void addLine(const char *line);
+  void finish(); // Emits what the window still holds
+
+  static const int MAX_SELECT = 8;
+  static const int WINDOW = 40;
+  static const uint32_t STALE_MS = 1000;
+
+private:
+  struct Chan {
+    int id;     // From the CH line, -1 until declared
+    int column; // Fix-row field or -1
+    uint32_t holdMs;
+    uint32_t t[WINDOW];
+    float v[WINDOW];
+    int head;  // Oldest
+    int count;
+  };
+
+  char _names[MAX_SELECT][12];
+  Chan _ch[MAX_SELECT];
+  int _n = 0;
+  uint32_t _step = 100;
+  uint32_t _next = 0;
+  bool _started = false;
+  std::function<void(uint32_t, const float *)> _out;
+
+  void push(Chan &c, uint32_t t, float v);
+  uint32_t latest(const Chan &c) const;
+  float valueAt(Chan &c, uint32_t t) const;
+  void emit(bool final);
+};
+
+#endif
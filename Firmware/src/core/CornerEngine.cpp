@@ -0,0 +1,250 @@
+#include "CornerEngine.h"
+#include <math.h>
+
+static float wrapPi(float a) {
+  while (a > (float)M_PI)
+    a -= 2 * (float)M_PI;
+  while (a < -(float)M_PI)
+    a += 2 * (float)M_PI;
+  return a;
+}
+
+static uint16_t tenths(float kmh) {
+  return (kmh > 0) ? (uint16_t)lroundf(kmh * 10.0f) : 0;
+}
+
+void CornerEngine::clear() {
+  _corners.clear();
+  _length = 0;
+  _closed = false;
+  _laps.clear();
+  reset();
+}
+
+bool CornerEngine::build(const MapMatcher &line) {
+  clear();
+  size_t nv = line.getVertexCount();
+  _length = line.getLength();
+  _closed = line.isClosed();
+  int n = (int)(_length / STEP_M);
+  if (nv < 2 || n < 8)
+    return false;
+
+  // Heading (rad, clockwise from north) of every STEP_M piece
+  std::vector<float> psi(n);
+  size_t seg = 0;
+  auto at = [&](float s, float &x, float &y) {
+    while (seg + 2 < nv && line.getVertexDistance(seg + 1) < s)
+      seg++;
+    float d0 = line.getVertexDistance(seg);
+    float len = line.getVertexDistance(seg + 1) - d0;
+    float f = (len > 0) ? (s - d0) / len : 0;
+    x = line.getVertexX(seg) + f * (line.getVertexX(seg + 1) -
+                                     line.getVertexX(seg));
+    y = line.getVertexY(seg) + f * (line.getVertexY(seg + 1) -
+                                     line.getVertexY(seg));
+  };
+  float x0, y0, x1, y1;
+  at(0, x0, y0);
+  for (int k = 0; k < n; k++) {
+    at((k + 1) * STEP_M, x1, y1);
+    psi[k] = atan2f(x1 - x0, y1 - y0);
+    x0 = x1;
+    y0 = y1;
+  }
+
+  // Curvature (1/m, + = right) at the middle of each piece
+  int h = (int)(SPAN_M / STEP_M);
+  std::vector<float> curv(n);
+  for (int k = 0; k < n; k++) {
+    int a = k - h, b = k + h;
+    if (_closed) {
+      a = (a + n) % n;
+      b = b % n;
+    } else {
+      a = (a < 0) ? 0 : a;
+      b = (b >= n) ? n - 1 : b;
+    }
+    int span = _closed ? 2 * h : b - a;
+    curv[k] = (span > 0) ? wrapPi(psi[b] - psi[a]) / (span * STEP_M) : 0;
+  }
+
+  // Runs of one sign above ENTER_CURV, widened to EXIT_CURV either side.
+  // A corner over the start/finish stays split in two.
+  int k = 0;
+  while (k < n && (int)_corners.size() < MAX_CORNERS) {
+    if (fabsf(curv[k]) < ENTER_CURV) {
+      k++;
+      continue;
+    }
+    float sign = (curv[k] > 0) ? 1.0f : -1.0f;
+    int start = k;
+    while (start > 0 && curv[start - 1] * sign >= EXIT_CURV)
+      start--;
+    int end = k;
+    while (end + 1 < n && curv[end + 1] * sign >= EXIT_CURV)
+      end++;
+
+    float turn = 0;
+    int apex = start;
+    for (int i = start; i <= end; i++) {
+      turn += curv[i] * STEP_M;
+      if (fabsf(curv[i]) > fabsf(curv[apex]))
+        apex = i;
+    }
+
+    Corner c;
+    c.startM = start * STEP_M;
+    c.apexM = (apex + 0.5f) * STEP_M;
+    c.endM = (end + 1) * STEP_M;
+    if (c.endM > _length)
+      c.endM = _length;
+    c.turnDeg = turn * 180.0f / (float)M_PI;
+
+    // Same direction again right after: one corner (double apex)
+    if (!_corners.empty()) {
+      Corner &p = _corners.back();
+      if (p.turnDeg * c.turnDeg > 0 && c.startM - p.endM < MERGE_M) {
+        for (int i = (int)(p.endM / STEP_M); i < start; i++)
+          p.turnDeg += curv[i] * STEP_M * 180.0f / (float)M_PI;
+        p.turnDeg += c.turnDeg;
+        if (fabsf(curv[apex]) >
+            fabsf(curv[(int)(p.apexM / STEP_M)]))
+          p.apexM = c.apexM;
+        p.endM = c.endM;
+        k = end + 1;
+        continue;
+      }
+    }
+    _corners.push_back(c);
+    k = end + 1;
+  }
+
+  // Kinks
+  for (size_t i = 0; i < _corners.size();) {
+    if (fabsf(_corners[i].turnDeg) < MIN_TURN_DEG)
+      _corners.erase(_corners.begin() + i);
+    else
+      i++;
+  }
+  reset();
+  return !_corners.empty();
+}
+
+void CornerEngine::reset() {
+  _laps.clear();
+  _hasPrev = false;
+  _wraps = 0;
+  startLap();
+}
+
+void CornerEngine::startLap() {
+  _cur.assign(_corners.size(), Result{0, 0, 0, 0});
+  _curLap = 0;
+  _next = 0;
+  _in = false;
+  _entryOk = false;
+  _lapOk = true;
+}
+
+void CornerEngine::finishLap() {
+  bool ok = _lapOk && !_in && _next == (int)_corners.size() && _curLap > 0;
+  if (ok) {
+    if (!_laps.empty() && _laps.back().lap == _curLap)
+      _laps.back().corners = _cur;
+    else if ((int)_laps.size() < MAX_LAPS)
+      _laps.push_back({_curLap, _cur});
+  }
+  _wraps++;
+  startLap();
+}
+
+void CornerEngine::addFix(uint32_t timeMs, float distance, float speedKmh,
+                          uint16_t lap) {
+  if (_corners.empty())
+    return;
+  if (!_hasPrev) {
+    _prevT = timeMs;
+    _prevD = distance;
+    _prevV = speedKmh;
+    _hasPrev = true;
+    return;
+  }
+
+  float dd = distance - _prevD;
+  if (dd < -_length / 2) {
+    // Past the end of the line
+    float span = _length - _prevD + distance;
+    if (_closed && span <= MAX_STEP_M) {
+      // Split the step at the finish
+      float f = (span > 0) ? (_length - _prevD) / span : 0;
+      double tl = _prevT + f * (double)(timeMs - _prevT);
+      float vl = _prevV + f * (speedKmh - _prevV);
+      step(_prevT, _prevD, _prevV, tl, _length, vl, lap);
+      finishLap();
+      step(tl, 0, vl, timeMs, distance, speedKmh, lap);
+    } else {
+      finishLap(); // Open line: the next run starts here
+      if (_closed)
+        _lapOk = false; // Lost the line over the finish
+    }
+  } else if (dd < 0) {
+    return; // Matched slightly back: keep the furthest
+  } else {
+    if (dd > MAX_STEP_M)
+      _lapOk = false; // Lost the line: speeds in between unknown
+    step(_prevT, _prevD, _prevV, timeMs, distance, speedKmh, lap);
+  }
+  _prevT = timeMs;
+  _prevD = distance;
+  _prevV = speedKmh;
+}
+
+void CornerEngine::step(double t0, float d0, float v0, double t1, float d1,
+                        float v1, uint16_t lap) {
+  while (_next < (int)_corners.size()) {
+    const Corner &c = _corners[_next];
+    Result &r = _cur[_next];
+
+    if (!_in) {
+      if (d1 < c.startM)
+        return;
+      if (d0 > c.startM) {
+        // Joined inside the corner: no entry
+        _entryOk = false;
+        _entryT = t0;
+        r.entry = tenths(v0);
+        _min = v0;
+      } else {
+        float f = (d1 > d0) ? (c.startM - d0) / (d1 - d0) : 0;
+        float v = v0 + f * (v1 - v0);
+        _entryOk = true;
+        _entryT = t0 + f * (t1 - t0);
+        r.entry = tenths(v);
+        _min = v;
+      }
+      if (_next == 0)
+        _curLap = (_wraps > 0 || !_closed) ? lap : 0;
+      _in = true;
+    }
+
+    if (d1 < c.endM) {
+      if (v1 < _min)
+        _min = v1;
+      return;
+    }
+
+    float f = (d1 > d0) ? (c.endM - d0) / (d1 - d0) : 0;
+    float v = v0 + f * (v1 - v0);
+    double tOut = t0 + f * (t1 - t0);
+    if (v < _min)
+      _min = v;
+    r.apex = tenths(_min);
+    r.exit = tenths(v);
+    r.timeMs = (uint32_t)lround(tOut - _entryT);
+    if (!_entryOk)
+      _lapOk = false;
+    _in = false;
+    _next++;
+  }
+}
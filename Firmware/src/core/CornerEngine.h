@@ -0,0 +1,90 @@
+#ifndef CORNER_ENGINE_H
+#define CORNER_ENGINE_H
+
+#include "MapMatcher.h"
+#include <stdint.h>
+#include <vector>
+
+// Corners of a track and their speeds per lap.
+// build() resamples a centreline every STEP_M and takes the curvature
+// as the heading change over +-SPAN_M; a corner is a run of the same
+// sign above ENTER_CURV (left once under EXIT_CURV), neighbours closer
+// than MERGE_M are one corner and shallow kinks are dropped. Laps are
+// then fed as (time, distance along that centreline, speed) per fix:
+// entry and exit are interpolated where the lap crosses each corner's
+// ends, O(1) per fix, the same code live and over a log.
+class CornerEngine {
+public:
+  struct Corner {
+    float startM; // Along the centreline
+    float apexM;  // Tightest point
+    float endM;
+    float turnDeg; // Signed, + = right
+  };
+
+  struct Result {
+    uint16_t entry; // 0.1 km/h
+    uint16_t apex;  // Minimum, 0.1 km/h
+    uint16_t exit;
+    uint32_t timeMs; // Entry to exit
+  };
+
+  struct LapCorners {
+    uint16_t lap;
+    std::vector<Result> corners; // One per corner, all measured
+  };
+
+  bool build(const MapMatcher &line);
+  void clear();
+  int getCount() const { return _corners.size(); }
+  const Corner &getCorner(int i) const { return _corners[i]; }
+  const std::vector<Corner> &getCorners() const { return _corners; }
+  float getLength() const { return _length; }
+
+  // Fixes matched onto the same centreline. `lap` is the lap being
+  // driven (completed laps + 1). On a closed track the laps before the
+  // first pass over the line are out laps; a lap is kept when every
+  // corner of it was measured, and one with the same number as the last
+  // replaces it.
+  void reset();
+  void addFix(uint32_t timeMs, float distance, float speedKmh, uint16_t lap);
+  const std::vector<LapCorners> &getLaps() const { return _laps; }
+
+  static constexpr float STEP_M = 4.0f;
+  static constexpr float SPAN_M = 12.0f;
+  static constexpr float ENTER_CURV = 1.0f / 120.0f; // 1/m (R 120 m)
+  static constexpr float EXIT_CURV = 1.0f / 200.0f;
+  static constexpr float MERGE_M = 15.0f;
+  static constexpr float MIN_TURN_DEG = 20.0f;
+  static constexpr float MAX_STEP_M = 100.0f; // Bigger jumps: lost the line
+  static const int MAX_CORNERS = 40;
+  static const int MAX_LAPS = 64;
+
+private:
+  std::vector<Corner> _corners;
+  float _length = 0;
+  bool _closed = false;
+  std::vector<LapCorners> _laps;
+
+  // Lap in progress
+  std::vector<Result> _cur;
+  uint16_t _curLap = 0;
+  int _wraps = 0;       // Passes over the end of the line
+  int _next = 0;        // Corner being approached or driven
+  bool _in = false;     // Between its entry and exit
+  bool _entryOk = false;
+  bool _lapOk = true;   // No corner missed so far
+  double _entryT = 0;
+  float _min = 0;
+
+  bool _hasPrev = false;
+  uint32_t _prevT = 0;
+  float _prevD = 0, _prevV = 0;
+
+  void step(double t0, float d0, float v0, double t1, float d1, float v1,
+            uint16_t lap);
+  void finishLap();
+  void startLap();
+};
+
+#endif
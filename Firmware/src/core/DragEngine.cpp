@@ -0,0 +1,213 @@
+#include "DragEngine.h"
+#include <math.h>
+
+void DragEngine::addSpeedTarget(float fromKmh, float toKmh) {
+  Target t = {false, fromKmh, toKmh, false, false, 0, 0, 0};
+  _targets.push_back(t);
+}
+
+void DragEngine::addDistanceTarget(float metres) {
+  Target t = {true, 0, metres, false, false, 0, 0, 0};
+  _targets.push_back(t);
+}
+
+void DragEngine::reset() {
+  _state = WAITING;
+  _hasRest = false;
+  _fitCount = 0;
+  _launchT = 0;
+  _startT = 0;
+  _rolloutDist = 0;
+  _clockRunning = false;
+  _prevT = 0;
+  _prevV = 0;
+  _dist = 0;
+  _peak = 0;
+  for (size_t i = 0; i < _targets.size(); i++) {
+    _targets[i].done = false;
+    _targets[i].started = (_targets[i].startSpeed <= 0);
+    _targets[i].startTime = 0;
+    _targets[i].resultTime = 0;
+    _targets[i].endSpeed = 0;
+  }
+}
+
+bool DragEngine::allDone() const {
+  if (_targets.empty())
+    return false;
+  for (size_t i = 0; i < _targets.size(); i++)
+    if (!_targets[i].done)
+      return false;
+  return true;
+}
+
+float DragEngine::getRunTime(uint32_t timeMs) const {
+  if (!_clockRunning)
+    return 0;
+  return (float)(timeMs - _startT);
+}
+
+uint32_t DragEngine::getStartEpoch() const {
+  return (uint32_t)lround(_startT);
+}
+
+void DragEngine::addSample(uint32_t timeMs, float speedKmh) {
+  if (speedKmh > _peak && _state != FINISHED)
+    _peak = speedKmh;
+
+  if (_state == WAITING) {
+    if (speedKmh < LAUNCH_KMH) {
+      if (speedKmh < STILL_KMH) {
+        _restT = timeMs;
+        _restV = speedKmh;
+        _hasRest = true;
+      }
+      _fitCount = 0;
+      _peak = 0;
+    } else {
+      if (_fitCount == FIT_MAX)
+        _fitCount = 0; // Creeping, not launching: start the fit over
+      _fitT[_fitCount] = timeMs;
+      _fitV[_fitCount] = speedKmh;
+      _fitCount++;
+      if (_fitCount >= FIT_MIN &&
+          (uint32_t)(timeMs - _fitT[0]) >= FIT_SPAN_MS)
+        launch();
+    }
+    return;
+  }
+
+  if (_state != RUNNING || timeMs == _prevT)
+    return;
+
+  float v = speedKmh / 3.6f;
+  step(_prevT, _prevV, timeMs, v);
+  _prevT = timeMs;
+  _prevV = v;
+
+  // Slowed down again after getting going
+  if (speedKmh < STOP_KMH && _peak > 2 * STOP_KMH)
+    _state = FINISHED;
+}
+
+// Least-squares line through the first moving samples; it reaches v = 0
+// at the launch. Not before the car was last seen standing (that
+// sample's creep speed taken off at the same slope).
+void DragEngine::launch() {
+  double mt = 0, mv = 0;
+  for (int i = 0; i < _fitCount; i++) {
+    mt += (double)(uint32_t)(_fitT[i] - _fitT[0]);
+    mv += _fitV[i];
+  }
+  mt /= _fitCount;
+  mv /= _fitCount;
+  double stv = 0, stt = 0;
+  for (int i = 0; i < _fitCount; i++) {
+    double dt = (double)(uint32_t)(_fitT[i] - _fitT[0]) - mt;
+    stv += dt * (_fitV[i] - mv);
+    stt += dt * dt;
+  }
+  if (stv <= 0) {
+    // Not accelerating: keep the latest sample and wait
+    _fitT[0] = _fitT[_fitCount - 1];
+    _fitV[0] = _fitV[_fitCount - 1];
+    _fitCount = 1;
+    return;
+  }
+  double perKmh = stt / stv; // ms per km/h
+  double t0 = _fitT[0] + mt - mv * perKmh;
+  if (_hasRest && t0 < _restT - _restV * perKmh)
+    t0 = _restT - _restV * perKmh;
+  if (t0 > _fitT[0])
+    t0 = _fitT[0];
+
+  _launchT = t0;
+  _dist = 0;
+  _rolloutDist = 0;
+  _clockRunning = !_rollout;
+  _startT = t0;
+  _state = RUNNING;
+
+  // Replay the buffered samples from the launch
+  double prevT = t0;
+  float prevV = 0;
+  for (int i = 0; i < _fitCount; i++) {
+    float v = _fitV[i] / 3.6f;
+    step(prevT, prevV, _fitT[i], v);
+    prevT = _fitT[i];
+    prevV = v;
+  }
+  _prevT = _fitT[_fitCount - 1];
+  _prevV = prevV;
+}
+
+// Time (ms) at which dd metres are covered inside a step starting at t0
+// with speed v0 (m/s) and constant acceleration a (m/s^2)
+double DragEngine::timeAtDistance(double t0, float v0, double dt, float a,
+                                  float dd) {
+  double disc = (double)v0 * v0 + 2.0 * a * dd;
+  double tau; // s
+  if (disc <= 0)
+    tau = dt / 1000.0;
+  else
+    tau = 2.0 * dd / (v0 + sqrt(disc)); // Stable for v0 = 0 and a = 0
+  if (tau * 1000.0 > dt)
+    tau = dt / 1000.0;
+  return t0 + tau * 1000.0;
+}
+
+void DragEngine::step(double t0, float v0, double t1, float v1) {
+  double dt = t1 - t0; // ms
+  if (dt <= 0)
+    return;
+  float a = (float)((v1 - v0) / (dt / 1000.0));
+  float dd = (float)((v0 + v1) * 0.5 * dt / 1000.0);
+
+  // 1 ft rollout crossed in this step: the clock starts there
+  if (!_clockRunning && _dist + dd >= ROLLOUT_M) {
+    _startT = timeAtDistance(t0, v0, dt, a, ROLLOUT_M - _dist);
+    _rolloutDist = ROLLOUT_M;
+    _clockRunning = true;
+  }
+
+  if (_clockRunning) {
+    for (size_t i = 0; i < _targets.size(); i++) {
+      Target &tg = _targets[i];
+      if (tg.done)
+        continue;
+
+      if (tg.isDistance) {
+        float d = tg.target + _rolloutDist;
+        if (_dist + dd < d)
+          continue;
+        double tc = timeAtDistance(t0, v0, dt, a, d - _dist);
+        tg.resultTime = (float)(tc - _startT);
+        tg.endSpeed = (v0 + a * (float)((tc - t0) / 1000.0)) * 3.6f;
+        tg.done = true;
+        continue;
+      }
+
+      // Speed split: interpolate the crossing linearly in speed
+      if (!tg.started) {
+        float s = tg.startSpeed / 3.6f;
+        if (v1 < s || v1 <= v0)
+          continue;
+        double ts = (v0 >= s) ? t0 : t0 + (s - v0) / (v1 - v0) * dt;
+        tg.startTime = (float)(ts - _startT);
+        if (tg.startTime < 0)
+          tg.startTime = 0;
+        tg.started = true;
+      }
+      float s = tg.target / 3.6f;
+      if (v1 < s || v1 <= v0)
+        continue;
+      double tc = (v0 >= s) ? t0 : t0 + (s - v0) / (v1 - v0) * dt;
+      float end = (float)(tc - _startT);
+      tg.resultTime = (end > tg.startTime) ? end - tg.startTime : 0;
+      tg.endSpeed = tg.target;
+      tg.done = true;
+    }
+  }
+
+  _dist += dd;
+}
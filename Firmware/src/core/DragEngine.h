@@ -0,0 +1,86 @@
+#ifndef DRAG_ENGINE_H
+#define DRAG_ENGINE_H
+
+#include <stdint.h>
+#include <vector>
+
+// Drag run timing, fed once per GNSS epoch.
+// Distance is the integral of the Doppler speed (path length, not the
+// straight line from the start). Launch is back-extrapolated from the
+// first moving samples (least squares), and every speed/distance target is interpolated
+// inside the epoch that crossed it, assuming constant acceleration over
+// the epoch. Plain C++ so it is validated on the host with synthetic runs.
+class DragEngine {
+public:
+  enum State { WAITING, RUNNING, FINISHED };
+
+  struct Target {
+    bool isDistance;   // true = metres, false = km/h
+    float startSpeed;  // km/h, split starts here (0 = from the launch)
+    float target;      // metres or km/h
+    bool done;
+    bool started;      // Split start passed (speed splits from > 0)
+    float startTime;   // ms since run start
+    float resultTime;  // ms
+    float endSpeed;    // km/h at the target
+  };
+
+  void clearTargets() { _targets.clear(); }
+  void addSpeedTarget(float fromKmh, float toKmh);
+  void addDistanceTarget(float metres);
+  int getTargetCount() const { return _targets.size(); }
+  const Target &getTarget(int i) const { return _targets[i]; }
+
+  // 1 ft rollout: the clock starts when the car has moved 0.3048 m and
+  // distances are measured from there (drag strip staging beam)
+  void setRollout(bool enabled) { _rollout = enabled; }
+
+  void reset();
+  // One epoch: time (ms, GNSS epoch preferred) and speed over ground
+  void addSample(uint32_t timeMs, float speedKmh);
+
+  State getState() const { return _state; }
+  bool allDone() const;
+  float getDistance() const { return _dist - _rolloutDist; } // m
+  float getRunTime(uint32_t timeMs) const; // ms since the run start
+  float getPeakSpeed() const { return _peak; }
+  uint32_t getStartEpoch() const; // Epoch time of the run start (rounded)
+
+  static constexpr float STILL_KMH = 1.0f;  // Standing below this
+  static constexpr float LAUNCH_KMH = 3.0f; // Moving above this
+  static constexpr float STOP_KMH = 5.0f;   // Run over below this
+  static constexpr float ROLLOUT_M = 0.3048f;
+
+private:
+  std::vector<Target> _targets;
+  bool _rollout = false;
+  State _state = WAITING;
+
+  // Last standing sample and the first moving ones (launch fit)
+  static const int FIT_MIN = 3;
+  static const int FIT_MAX = 8;
+  static const uint32_t FIT_SPAN_MS = 250;
+  uint32_t _restT = 0;
+  float _restV = 0;
+  bool _hasRest = false;
+  uint32_t _fitT[FIT_MAX];
+  float _fitV[FIT_MAX];
+  int _fitCount = 0;
+
+  double _launchT = 0;   // Back-extrapolated v = 0 (epoch ms)
+  double _startT = 0;    // Clock start: launch or rollout point
+  float _rolloutDist = 0;
+  bool _clockRunning = false;
+
+  uint32_t _prevT = 0;
+  float _prevV = 0; // m/s
+  float _dist = 0;  // m since launch
+  float _peak = 0;  // km/h
+
+  void launch();
+  void step(double t0, float v0, double t1, float v1);
+  static double timeAtDistance(double t0, float v0, double dt, float a,
+                               float dd);
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include "DragPredictor.h"
+#include <math.h>
+
+// --- Profile ---
+
+void DragProfile::clear() {
+  step = STEP_M;
+  time.clear();
+  speed.clear();
+  _lastT = 0;
+  _lastD = 0;
+  _lastV = 0;
+}
+
+bool DragProfile::timeAtDistance(float metres, float &timeMs) const {
+  if (!isValid() || metres < 0 || metres > getLength())
+    return false;
+  float f = metres / step;
+  size_t i = (size_t)f;
+  if (i >= time.size() - 1)
+    i = time.size() - 2;
+  f -= i;
+  timeMs = time[i] + f * ((float)time[i + 1] - time[i]);
+  return true;
+}
+
+bool DragProfile::timeAtSpeed(float kmh, float &timeMs) const {
+  uint16_t v = (uint16_t)lroundf(kmh * 10.0f);
+  for (size_t i = 1; i < speed.size(); i++) {
+    if (speed[i] < v)
+      continue;
+    // First crossing, interpolated in speed
+    float dv = (float)speed[i] - speed[i - 1];
+    float f = (dv > 0) ? (v - (float)speed[i - 1]) / dv : 1.0f;
+    if (f < 0)
+      f = 0;
+    timeMs = time[i - 1] + f * ((float)time[i] - time[i - 1]);
+    return true;
+  }
+  return false;
+}
+
+void DragProfile::addSample(float timeMs, float distance, float speedKmh) {
+  if (time.empty()) {
+    time.push_back(0);
+    speed.push_back(0);
+    _lastT = 0;
+    _lastD = 0;
+    _lastV = 0;
+  }
+  if (distance <= _lastD)
+    return;
+
+  // Grid points covered since the last epoch
+  while ((int)time.size() < MAX_POINTS) {
+    float d = time.size() * step;
+    if (d > distance)
+      break;
+    float f = (d - _lastD) / (distance - _lastD);
+    time.push_back((uint32_t)lroundf(_lastT + f * (timeMs - _lastT)));
+    speed.push_back(
+        (uint16_t)lroundf((_lastV + f * (speedKmh - _lastV)) * 10.0f));
+  }
+  _lastT = timeMs;
+  _lastD = distance;
+  _lastV = speedKmh;
+}
+
+// --- Predictor ---
+
+void DragPredictor::begin(const DragProfile *reference, bool isDistance,
+                          float target) {
+  _ref = reference;
+  _isDistance = isDistance;
+  _target = target;
+  _count = 0;
+  _head = 0;
+  _valid = false;
+  _predicted = 0;
+  _band = 0;
+
+  // Reference that never reached the target cannot predict it
+  bool ok = _ref && (isDistance ? _ref->timeAtDistance(target, _refTarget)
+                                : _ref->timeAtSpeed(target, _refTarget));
+  if (!ok)
+    _ref = nullptr;
+}
+
+void DragPredictor::addSample(float timeMs, float distance, float speedKmh) {
+  if (!_ref)
+    return;
+
+  float x = _isDistance ? distance : speedKmh;
+  if (x < (_isDistance ? MIN_X_M : MIN_X_KMH) || x >= _target)
+    return;
+
+  float refTime;
+  bool ok = _isDistance ? _ref->timeAtDistance(x, refTime)
+                        : _ref->timeAtSpeed(x, refTime);
+  if (!ok)
+    return;
+
+  _x[_head] = refTime;
+  _gap[_head] = timeMs - refTime;
+  _head = (_head + 1) % WINDOW;
+  if (_count < WINDOW)
+    _count++;
+  fit();
+}
+
+void DragPredictor::fit() {
+  double mx = 0, my = 0;
+  for (int i = 0; i < _count; i++) {
+    mx += _x[i];
+    my += _gap[i];
+  }
+  mx /= _count;
+  my /= _count;
+
+  double sxx = 0, sxy = 0;
+  for (int i = 0; i < _count; i++) {
+    sxx += (_x[i] - mx) * (_x[i] - mx);
+    sxy += (_x[i] - mx) * (_gap[i] - my);
+  }
+
+  // Too few or too close together for a slope: carry the current gap
+  if (_count < 3 || sxx < 1e-3) {
+    int last = (_head + WINDOW - 1) % WINDOW;
+    _predicted = _refTarget + _gap[last];
+    _band = 0;
+    _valid = false;
+    return;
+  }
+
+  double slope = sxy / sxx;
+  double sse = 0;
+  for (int i = 0; i < _count; i++) {
+    double r = _gap[i] - (my + slope * (_x[i] - mx));
+    sse += r * r;
+  }
+  double s = sqrt(sse / (_count - 2));
+  double dx = _refTarget - mx;
+
+  _predicted = (float)(_refTarget + my + slope * dx);
+
+  // Fit scatter, plus the run not keeping the same shape for the rest
+  int last = (_head + WINDOW - 1) % WINDOW;
+  double fitBand = 2.0 * s * sqrt(1.0 + 1.0 / _count + dx * dx / sxx);
+  double shapeBand = SHAPE_ERR * (_refTarget - _x[last]);
+  _band = (float)sqrt(fitBand * fitBand + shapeBand * shapeBand);
+  _valid = true;
+}
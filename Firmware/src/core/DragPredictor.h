@@ -0,0 +1,75 @@
+#ifndef DRAG_PREDICTOR_H
+#define DRAG_PREDICTOR_H
+
+#include <stdint.h>
+#include <vector>
+
+// Time and speed of a drag run on a fixed distance grid (t = 0 and
+// d = 0 at the run start). Built live from the engine's epochs and kept
+// on SD as the reference run.
+class DragProfile {
+public:
+  float step = STEP_M;
+  std::vector<uint32_t> time;  // ms since the start
+  std::vector<uint16_t> speed; // 0.1 km/h
+
+  void clear();
+  bool isValid() const { return time.size() >= 2; }
+  float getLength() const { return time.empty() ? 0 : (time.size() - 1) * step; }
+
+  // Interpolated; false when the run did not get that far / that fast
+  bool timeAtDistance(float metres, float &timeMs) const;
+  bool timeAtSpeed(float kmh, float &timeMs) const;
+
+  // Builder: one epoch of the run, grid points in between interpolated
+  void addSample(float timeMs, float distance, float speedKmh);
+
+  static constexpr float STEP_M = 1.0f;
+  static const int MAX_POINTS = 1200; // 1.2 km covers 0-200 km/h
+
+private:
+  float _lastT = 0, _lastD = 0, _lastV = 0;
+};
+
+// Final time of one discipline, predicted every epoch from the live run
+// against the reference. The gap to the reference (live - reference
+// time at the same distance, or the same speed for speed targets) is
+// fitted as a line of the reference time over the recent epochs, and
+// extrapolated to the reference's time at the target. A run that pulls
+// a steady fraction harder or softer than the reference is a straight
+// line there. The band is the fit's ~95% prediction interval, widened by
+// the time still to go.
+class DragPredictor {
+public:
+  void begin(const DragProfile *reference, bool isDistance, float target);
+  void addSample(float timeMs, float distance, float speedKmh);
+
+  bool isValid() const { return _valid; }
+  float getPredicted() const { return _predicted; } // ms
+  float getBand() const { return _band; }           // +/- ms
+  float getReferenceTime() const { return _ref ? _refTarget : 0; } // ms
+
+  static const int WINDOW = 24;           // Epochs in the fit
+  static constexpr float MIN_X_M = 5.0f;  // Launch noise: start fitting
+  static constexpr float MIN_X_KMH = 15.0f; // beyond these
+  static constexpr float SHAPE_ERR = 0.02f; // Of the time still to go
+
+private:
+  const DragProfile *_ref = nullptr;
+  bool _isDistance = true;
+  float _target = 0;
+  float _refTarget = 0; // Reference time at the target (ms)
+
+  float _x[WINDOW];     // Reference time at the aligned point (ms)
+  float _gap[WINDOW];   // ms
+  int _count = 0;
+  int _head = 0;
+
+  bool _valid = false;
+  float _predicted = 0;
+  float _band = 0;
+
+  void fit();
+};
+
+#endif
@@ -0,0 +1,224 @@
+#include "DynoEngine.h"
+#include <math.h>
+
+static const float MASS_KG[DynoEngine::MASS_OPTIONS] = {
+    100, 150, 200, 250, 300, 500, 800, 1000, 1200, 1400, 1600, 2000};
+static const float CDA_M2[DynoEngine::CDA_OPTIONS] = {0.3f, 0.4f, 0.5f, 0.6f,
+                                                      0.7f, 0.8f, 0.9f, 1.0f};
+static const float CRR[DynoEngine::CRR_OPTIONS] = {0.010f, 0.015f, 0.020f,
+                                                   0.025f};
+
+static float option(const float *table, int count, int i) {
+  return table[(i < 0) ? 0 : (i >= count) ? count - 1 : i];
+}
+float DynoEngine::massOption(int i) { return option(MASS_KG, MASS_OPTIONS, i); }
+float DynoEngine::cdAOption(int i) { return option(CDA_M2, CDA_OPTIONS, i); }
+float DynoEngine::crrOption(int i) { return option(CRR, CRR_OPTIONS, i); }
+
+void DynoEngine::clearResult() {
+  for (int i = 0; i < BINS; i++)
+    _bins[i] = Bin{0, 0, 0, 0};
+  for (int i = 0; i < 7; i++)
+    _sx[i] = 0;
+  for (int i = 0; i < 4; i++) {
+    _sy[i] = 0;
+    _c[i] = 0;
+  }
+  _accepted = 0;
+  _rejected = 0;
+  _bad = 0;
+  _ratio = 0;
+  _minRpm = 0;
+  _maxRpm = 0;
+  _hasFit = false;
+  _peakPower = _peakPowerRpm = 0;
+  _peakTorque = _peakTorqueRpm = 0;
+}
+
+void DynoEngine::arm() {
+  clearResult();
+  _accel.reset();
+  _histCount = 0;
+  _histHead = 0;
+  _state = STATE_ARMED;
+}
+
+void DynoEngine::cancel() { _state = STATE_IDLE; }
+
+void DynoEngine::addSample(uint32_t timeMs, float speedKmh, float rpm) {
+  if (_state != STATE_ARMED && _state != STATE_RUNNING)
+    return;
+
+  _accel.addSample(timeMs, speedKmh, 0);
+  if (_histCount > 0 && _histT[(_histHead + HISTORY - 1) % HISTORY] == timeMs)
+    _histHead = (_histHead + HISTORY - 1) % HISTORY; // Same epoch again
+  else if (_histCount < HISTORY)
+    _histCount++;
+  _histT[_histHead] = timeMs;
+  _histV[_histHead] = speedKmh;
+  _histRpm[_histHead] = rpm;
+  _histHead = (_histHead + 1) % HISTORY;
+  if (!_accel.isValid())
+    return;
+
+  // The derivative is for an older epoch: take its speed and RPM
+  uint32_t tc = _accel.getTime();
+  for (int k = 1; k <= _histCount; k++) {
+    int i = (_histHead + HISTORY - k) % HISTORY;
+    if (_histT[i] == tc) {
+      process(tc, _histV[i] / 3.6f, _histRpm[i],
+              _accel.getLonG() * GForceEngine::G);
+      return;
+    }
+  }
+}
+
+void DynoEngine::process(uint32_t t, float v, float rpm, float a) {
+  bool moving = v * 3.6f >= MIN_KMH && rpm >= MIN_RPM;
+
+  if (_state == STATE_ARMED) {
+    if (moving && a >= START_ACCEL) {
+      _state = STATE_RUNNING;
+      _startT = t;
+      _ratio = rpm / (v * 3.6f);
+      _minRpm = _maxRpm = rpm;
+    }
+    return;
+  }
+
+  // Running: ends when the pull fades, the RPM falls back or the
+  // RPM/speed ratio leaves this gear, END_SAMPLES in a row
+  float ratio = moving ? rpm / (v * 3.6f) : 0;
+  bool sameGear = moving && fabsf(ratio / _ratio - 1.0f) < RATIO_TOL;
+  bool pulling = a >= END_ACCEL && rpm >= _maxRpm * 0.97f;
+  if (!sameGear || !pulling) {
+    if (!sameGear)
+      _rejected++;
+    if (++_bad < END_SAMPLES)
+      return;
+    if (_accepted == 0) {
+      // A blip of noise or a stab of throttle, not a pull: keep waiting
+      clearResult();
+      _state = STATE_ARMED;
+      return;
+    }
+    finish();
+    return;
+  }
+  _bad = 0;
+  _ratio += (ratio - _ratio) * 0.1f;
+  // Until the derivative's window is past the throttle opening it
+  // still averages in the time before the pull
+  if (t - _startT >= 2 * GForceEngine::LATENCY_MS)
+    accept(v, rpm, a);
+}
+
+void DynoEngine::accept(float v, float rpm, float a) {
+  int b = binOf(rpm);
+  if (b < 0 || b >= BINS) {
+    _rejected++;
+    return;
+  }
+
+  const float g = 9.80665f;
+  float force = _cfg.massKg * a + 0.5f * _cfg.rho * _cfg.cdA * v * v +
+                _cfg.crr * _cfg.massKg * g;
+  float power = force * v; // W
+
+  // Outlier against the bin so far (Welford)
+  Bin &bin = _bins[b];
+  if (bin.n >= 4) {
+    float sigma = sqrtf(bin.m2 / (bin.n - 1));
+    float floor = fmaxf(MIN_SIGMA_W, 0.05f * fabsf(bin.power));
+    if (fabsf(power - bin.power) > OUTLIER_SIGMA * fmaxf(sigma, floor)) {
+      _rejected++;
+      return;
+    }
+  }
+  bin.n++;
+  float d = power - bin.power;
+  bin.power += d / bin.n;
+  bin.m2 += d * (power - bin.power);
+  bin.rpm += (rpm - bin.rpm) / bin.n;
+
+  // Normal equations of the torque cubic
+  double x = rpm / 1000.0;
+  double torque = power / (rpm * 2.0 * M_PI / 60.0);
+  double p = 1;
+  for (int k = 0; k < 7; k++) {
+    _sx[k] += p;
+    if (k < 4)
+      _sy[k] += torque * p;
+    p *= x;
+  }
+
+  if (_accepted++ == 0)
+    _minRpm = rpm;
+  if (rpm < _minRpm)
+    _minRpm = rpm;
+  if (rpm > _maxRpm)
+    _maxRpm = rpm;
+}
+
+float DynoEngine::fitTorque(float rpm) const {
+  double x = rpm / 1000.0;
+  return (float)(_c[0] + x * (_c[1] + x * (_c[2] + x * _c[3])));
+}
+
+float DynoEngine::fitPower(float rpm) const {
+  return fitTorque(rpm) * rpm * 2.0f * (float)M_PI / 60.0f / 1000.0f;
+}
+
+void DynoEngine::finish() {
+  _state = STATE_DONE;
+  _hasFit = false;
+  if (_accepted < MIN_POINTS || _maxRpm - _minRpm < MIN_SPAN_RPM)
+    return;
+
+  // 4x4 normal equations, Gaussian elimination with partial pivoting
+  double m[4][5];
+  for (int r = 0; r < 4; r++) {
+    for (int c = 0; c < 4; c++)
+      m[r][c] = _sx[r + c];
+    m[r][4] = _sy[r];
+  }
+  for (int col = 0; col < 4; col++) {
+    int piv = col;
+    for (int r = col + 1; r < 4; r++)
+      if (fabs(m[r][col]) > fabs(m[piv][col]))
+        piv = r;
+    if (fabs(m[piv][col]) < 1e-12)
+      return;
+    for (int c = 0; c < 5; c++) {
+      double t = m[col][c];
+      m[col][c] = m[piv][c];
+      m[piv][c] = t;
+    }
+    for (int r = col + 1; r < 4; r++) {
+      double f = m[r][col] / m[col][col];
+      for (int c = col; c < 5; c++)
+        m[r][c] -= f * m[col][c];
+    }
+  }
+  for (int r = 3; r >= 0; r--) {
+    double s = m[r][4];
+    for (int c = r + 1; c < 4; c++)
+      s -= m[r][c] * _c[c];
+    _c[r] = s / m[r][r];
+  }
+  _hasFit = true;
+
+  // Peaks on the fitted curve, over the RPM range actually covered
+  for (float rpm = _minRpm; rpm <= _maxRpm; rpm += 25.0f) {
+    float t = fitTorque(rpm);
+    float p = fitPower(rpm);
+    if (t > _peakTorque) {
+      _peakTorque = t;
+      _peakTorqueRpm = rpm;
+    }
+    if (p > _peakPower) {
+      _peakPower = p;
+      _peakPowerRpm = rpm;
+    }
+  }
+}
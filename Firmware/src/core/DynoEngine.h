@@ -0,0 +1,120 @@
+#ifndef DYNO_ENGINE_H
+#define DYNO_ENGINE_H
+
+#include "GForceEngine.h"
+#include <stdint.h>
+
+// Virtual dyno: wheel power and torque over a full-throttle pull in one
+// gear, fed once per GNSS epoch with speed and RPM. Acceleration is the
+// smoothed derivative of the speed (GForceEngine), lined up with the
+// speed and RPM of the same epoch. Wheel force is
+//   F = m a + 1/2 rho CdA v^2 + Crr m g
+// and P = F v. Each sample is binned by RPM (running mean and variance,
+// samples beyond OUTLIER_SIGMA of their bin are dropped) and added to a
+// least-squares cubic of torque against RPM, so the curve is ready as
+// soon as the pull ends. Torque is wheel power over engine speed, i.e.
+// at the crank without drivetrain losses.
+class DynoEngine {
+public:
+  struct Config {
+    float massKg;   // Vehicle + rider
+    float cdA;      // m^2
+    float crr;      // Rolling resistance coefficient
+    float rho;      // Air density, kg/m^3
+  };
+
+  struct Bin {
+    uint16_t n;
+    float rpm;   // Mean
+    float power; // Mean, W
+    float m2;    // Sum of squared deviations of power
+  };
+
+  enum State {
+    STATE_IDLE,
+    STATE_ARMED,   // Waiting for the pull
+    STATE_RUNNING,
+    STATE_DONE     // hasFit() when the pull was long enough
+  };
+
+  void setConfig(const Config &c) { _cfg = c; }
+  const Config &getConfig() const { return _cfg; }
+
+  void arm();    // Clears the last result
+  void cancel(); // Back to idle
+  void addSample(uint32_t timeMs, float speedKmh, float rpm);
+  State getState() const { return _state; }
+
+  // Bins fill while running
+  static int binOf(float rpm) { return (int)(rpm / BIN_RPM); }
+  const Bin &getBin(int i) const { return _bins[i]; }
+  int getAccepted() const { return _accepted; }
+  int getRejected() const { return _rejected; }
+  float getMinRpm() const { return _minRpm; }
+  float getMaxRpm() const { return _maxRpm; }
+
+  bool hasFit() const { return _hasFit; }
+  float fitTorque(float rpm) const; // Nm
+  float fitPower(float rpm) const;  // kW
+  float getPeakPower() const { return _peakPower; } // kW
+  float getPeakPowerRpm() const { return _peakPowerRpm; }
+  float getPeakTorque() const { return _peakTorque; } // Nm
+  float getPeakTorqueRpm() const { return _peakTorqueRpm; }
+
+  // Choices offered in Settings, by index
+  static const int MASS_OPTIONS = 12;
+  static const int CDA_OPTIONS = 8;
+  static const int CRR_OPTIONS = 4;
+  static float massOption(int i);
+  static float cdAOption(int i);
+  static float crrOption(int i);
+
+  static const int BIN_RPM = 250;
+  static const int BINS = 64; // Up to 16000 rpm
+  static const int HISTORY = 16; // Epochs kept to line up the derivative
+  static constexpr float MIN_RPM = 2000.0f;
+  static constexpr float MIN_KMH = 5.0f;
+  static constexpr float START_ACCEL = 1.0f; // m/s^2
+  static constexpr float END_ACCEL = 0.3f;
+  static constexpr float RATIO_TOL = 0.05f;  // RPM/speed off: clutch, shift
+  static const int END_SAMPLES = 3;          // In a row
+  static constexpr float OUTLIER_SIGMA = 3.0f;
+  static constexpr float MIN_SIGMA_W = 500.0f;
+  static const int MIN_POINTS = 10;
+  static constexpr float MIN_SPAN_RPM = 1000.0f;
+
+private:
+  Config _cfg = {200.0f, 0.6f, 0.015f, 1.2f};
+  State _state = STATE_IDLE;
+  GForceEngine _accel;
+
+  uint32_t _histT[HISTORY];
+  float _histV[HISTORY]; // km/h
+  float _histRpm[HISTORY];
+  int _histHead = 0;
+  int _histCount = 0;
+
+  Bin _bins[BINS];
+  int _accepted = 0;
+  int _rejected = 0;
+  int _bad = 0; // Consecutive samples that would end the pull
+  float _ratio = 0; // RPM per km/h of this gear
+  float _minRpm = 0, _maxRpm = 0;
+
+  // Torque = c0 + c1 x + c2 x^2 + c3 x^3, x = rpm / 1000
+  double _sx[7];
+  double _sy[4];
+  double _c[4];
+  bool _hasFit = false;
+  float _peakPower = 0, _peakPowerRpm = 0;
+  float _peakTorque = 0, _peakTorqueRpm = 0;
+
+  void clearResult();
+  uint32_t _startT = 0;
+
+  void process(uint32_t t, float v, float rpm, float a);
+  void accept(float v, float rpm, float a);
+  void finish();
+};
+
+#endif
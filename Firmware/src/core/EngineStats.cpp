@@ -0,0 +1,51 @@
+#include "EngineStats.h"
+#include <string.h>
+
+void EngineStats::add(Histogram &h, int bin, int gear, int rpm) {
+  h.ticks[gear][bin]++;
+  h.runTicks++;
+  h.rpmTicks += rpm;
+  if ((uint32_t)rpm > h.peakRpm)
+    h.peakRpm = rpm;
+}
+
+void EngineStats::addSample(int rpm, int gear) {
+  _running = rpm > 0;
+  if (!_running)
+    return;
+  int bin = rpm / BIN_RPM;
+  if (bin >= BINS)
+    bin = BINS - 1;
+  if (gear < 0)
+    gear = 0;
+  if (gear >= GEAR_SLOTS)
+    gear = GEAR_SLOTS - 1;
+  add(_session, bin, gear, rpm);
+  add(_lifetime, bin, gear, rpm);
+}
+
+void EngineStats::resetSession() { memset(&_session, 0, sizeof(_session)); }
+
+void EngineStats::clearLifetime() { memset(&_lifetime, 0, sizeof(_lifetime)); }
+
+uint32_t EngineStats::binTicks(const Histogram &h, int bin) {
+  uint32_t t = 0;
+  for (int g = 0; g < GEAR_SLOTS; g++)
+    t += h.ticks[g][bin];
+  return t;
+}
+
+uint32_t EngineStats::meanRpm(const Histogram &h) {
+  return h.runTicks ? (uint32_t)(h.rpmTicks / h.runTicks) : 0;
+}
+
+uint32_t EngineStats::percentileRpm(const Histogram &h, int pct) {
+  uint64_t target = (uint64_t)h.runTicks * pct / 100;
+  uint64_t sum = 0;
+  for (int b = 0; b < BINS; b++) {
+    sum += binTicks(h, b);
+    if (sum >= target && sum > 0)
+      return (b + 1) * BIN_RPM;
+  }
+  return 0;
+}
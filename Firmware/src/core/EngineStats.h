@@ -0,0 +1,50 @@
+#ifndef ENGINE_STATS_H
+#define ENGINE_STATS_H
+
+#include <stdint.h>
+
+// Engine usage from the RPM samples (one per TICK_MS): time in fixed
+// BIN_RPM bands, split by gear, for the session and the engine's life.
+// Each sample is one counter increment per histogram, whatever its
+// length; the RPM-only histogram is the sum over gears. Counts are
+// ticks, so a bin (and the run time) is good for 11,900 hours.
+class EngineStats {
+public:
+  static const int BIN_RPM = 500;
+  static const int BINS = 32; // Up to 16000 rpm, above goes in the last
+  static const int GEAR_SLOTS = 8; // 0 = unknown/neutral, 7 = 7th and up
+  static const uint32_t TICK_MS = 10;
+
+  // Also the NVS blob: its size is the layout version
+  struct Histogram {
+    uint32_t ticks[GEAR_SLOTS][BINS];
+    uint32_t runTicks;  // Engine turning
+    uint32_t peakRpm;
+    uint64_t rpmTicks;  // Sum of RPM per tick: revolutions * 6000
+  };
+
+  void addSample(int rpm, int gear); // Every TICK_MS while capturing
+  void resetSession();
+  void setLifetime(const Histogram &h) { _lifetime = h; }
+  void clearLifetime();
+
+  const Histogram &getSession() const { return _session; }
+  const Histogram &getLifetime() const { return _lifetime; }
+  bool isRunning() const { return _running; }
+
+  static uint32_t binTicks(const Histogram &h, int bin); // All gears
+  static float hours(uint32_t ticks) { return ticks / 360000.0f; }
+  static uint32_t meanRpm(const Histogram &h);
+  static uint64_t revolutions(const Histogram &h) { return h.rpmTicks / 6000; }
+  // RPM below which `pct` % of the running time was spent (bin top)
+  static uint32_t percentileRpm(const Histogram &h, int pct);
+
+private:
+  Histogram _session = {};
+  Histogram _lifetime = {};
+  bool _running = false;
+
+  static void add(Histogram &h, int bin, int gear, int rpm);
+};
+
+#endif
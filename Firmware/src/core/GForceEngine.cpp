@@ -0,0 +1,116 @@
+#include "GForceEngine.h"
+#include <math.h>
+
+// Value (c0) and slope (c1) at x = 0 of the least-squares quadratic
+// y = c0 + c1 x + c2 x^2, from the sums S[k] = sum x^k and
+// Y[k] = sum y x^k (Cramer's rule on the normal equations)
+static bool solveQuadratic(const double S[5], const double Y[3], double &c0,
+                           double &c1) {
+  double det = S[0] * (S[2] * S[4] - S[3] * S[3]) -
+               S[1] * (S[1] * S[4] - S[3] * S[2]) +
+               S[2] * (S[1] * S[3] - S[2] * S[2]);
+  if (fabs(det) < 1e-12)
+    return false;
+  c0 = (Y[0] * (S[2] * S[4] - S[3] * S[3]) -
+        S[1] * (Y[1] * S[4] - S[3] * Y[2]) +
+        S[2] * (Y[1] * S[3] - S[2] * Y[2])) /
+       det;
+  c1 = (S[0] * (Y[1] * S[4] - S[3] * Y[2]) -
+        Y[0] * (S[1] * S[4] - S[3] * S[2]) +
+        S[2] * (S[1] * Y[2] - Y[1] * S[2])) /
+       det;
+  return true;
+}
+
+void GForceEngine::reset() {
+  _count = 0;
+  _head = 0;
+  _valid = false;
+  _lonG = 0;
+  _latG = 0;
+  _outT = 0;
+}
+
+void GForceEngine::addSample(uint32_t timeMs, float speedKmh,
+                             float courseDeg) {
+  float v = speedKmh / 3.6f;
+  float c = courseDeg * (float)M_PI / 180.0f;
+
+  if (_count > 0) {
+    uint32_t last = _t[idx(0)];
+    if (timeMs == last) {
+      // Same epoch, newer sentence: overwrite
+      int i = idx(0);
+      _v[i] = v;
+      _vn[i] = v * cosf(c);
+      _ve[i] = v * sinf(c);
+      update();
+      return;
+    }
+    if ((int32_t)(timeMs - last) < 0 || timeMs - last > GAP_MS)
+      reset(); // Lost fixes or time jumped
+  }
+
+  _t[_head] = timeMs;
+  _v[_head] = v;
+  _vn[_head] = v * cosf(c);
+  _ve[_head] = v * sinf(c);
+  _head = (_head + 1) % HISTORY;
+  if (_count < HISTORY)
+    _count++;
+  update();
+}
+
+void GForceEngine::update() {
+  if (_count < 3) {
+    _valid = false;
+    return;
+  }
+
+  // Half window from the mean epoch spacing
+  float dt = (float)(_t[idx(0)] - _t[idx(_count - 1)]) / (_count - 1);
+  int m = (dt > 0) ? (int)lroundf(LATENCY_MS / dt) : 1;
+  if (m < 1)
+    m = 1;
+  if (m > MAX_HALF)
+    m = MAX_HALF;
+  if (2 * m + 1 > _count)
+    m = (_count - 1) / 2; // Filling up after a reset
+
+  uint32_t tc = _t[idx(m)];
+  double S[5] = {0, 0, 0, 0, 0};
+  double Yv[3] = {0, 0, 0}, Yn[3] = {0, 0, 0}, Ye[3] = {0, 0, 0};
+  for (int k = 0; k <= 2 * m; k++) {
+    int i = idx(k);
+    double x = (int32_t)(_t[i] - tc) / 1000.0; // s
+    double p = 1;
+    for (int e = 0; e < 5; e++) {
+      S[e] += p;
+      if (e < 3) {
+        Yv[e] += _v[i] * p;
+        Yn[e] += _vn[i] * p;
+        Ye[e] += _ve[i] * p;
+      }
+      p *= x;
+    }
+  }
+
+  double v0, av, n0, an, e0, ae;
+  if (!solveQuadratic(S, Yv, v0, av) || !solveQuadratic(S, Yn, n0, an) ||
+      !solveQuadratic(S, Ye, e0, ae)) {
+    _valid = false;
+    return;
+  }
+
+  _lonG = (float)(av / G);
+
+  // Acceleration across the smoothed velocity
+  double speed = sqrt(n0 * n0 + e0 * e0);
+  if (speed * 3.6 < MIN_TURN_KMH)
+    _latG = 0;
+  else
+    _latG = (float)((n0 * ae - e0 * an) / speed / G);
+
+  _outT = tc;
+  _valid = true;
+}
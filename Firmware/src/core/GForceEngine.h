@@ -0,0 +1,47 @@
+#ifndef G_FORCE_ENGINE_H
+#define G_FORCE_ENGINE_H
+
+#include <stdint.h>
+
+// Longitudinal and lateral acceleration from GNSS speed and course, fed
+// once per epoch. Each channel is a Savitzky-Golay derivative: a
+// least-squares quadratic over the epochs within LATENCY_MS either side
+// of a centre epoch (real epoch times, so missed epochs are fine), so
+// the output lags by LATENCY_MS whatever the rate. Longitudinal is the
+// derivative of the Doppler speed; lateral is the velocity vector's
+// derivative across the direction of travel (positive = to the right).
+class GForceEngine {
+public:
+  void reset();
+  // Same epoch again (GGA then RMC) replaces the newest sample
+  void addSample(uint32_t timeMs, float speedKmh, float courseDeg);
+
+  bool isValid() const { return _valid; }
+  float getLonG() const { return _lonG; } // + = accelerating
+  float getLatG() const { return _latG; } // + = to the right
+  uint32_t getTime() const { return _outT; } // Epoch the values are for
+
+  static const uint32_t LATENCY_MS = 200; // Half window
+  static const int MAX_HALF = 6;          // 25 Hz: +-5 epochs
+  static const uint32_t GAP_MS = 1000;    // Longer: start over
+  static constexpr float MIN_TURN_KMH = 5.0f; // Course is noise below
+  static constexpr float G = 9.80665f;
+
+private:
+  static const int HISTORY = 2 * MAX_HALF + 1;
+  uint32_t _t[HISTORY];
+  float _v[HISTORY];      // m/s
+  float _vn[HISTORY];     // North, m/s
+  float _ve[HISTORY];     // East, m/s
+  int _count = 0;
+  int _head = 0;
+
+  bool _valid = false;
+  float _lonG = 0, _latG = 0;
+  uint32_t _outT = 0;
+
+  int idx(int back) const { return (_head + HISTORY - 1 - back) % HISTORY; }
+  void update();
+};
+
+#endif
@@ -3,6 +3,8 @@
 #include <Arduino.h>
 #include <HardwareSerial.h>
 #include <Preferences.h>
+#include <algorithm>
+#include <soc/gpio_struct.h>
 
 void GPSManager::begin() {
   Preferences prefs;
@@ -17,6 +19,9 @@ void GPSManager::begin() {
   _currentGnssMode = prefs.getInt("gnss_mode", 1);
   _currentDynModel = prefs.getInt("gnss_model", 3);
   _currentSBAS = prefs.getInt("gnss_sbas", 0);
+  int freqIdx = prefs.getInt("gnss_freq_limit", 5);
+  static const int freqHz[] = {1, 2, 5, 10, 18, 25};
+  _targetFreq = (freqIdx >= 0 && freqIdx < 6) ? freqHz[freqIdx] : 25;
   _projectionEnabled = prefs.getBool("gnss_proj", true);
   _utcOffset = prefs.getInt("utc_offset", 0);
   _rpmEnabled = prefs.getBool("rpm_enabled", true); // Default: Enabled
@@ -25,7 +30,21 @@ void GPSManager::begin() {
   int pprIdx = prefs.getInt("rpm_ppr", 0);
   setPPRIndex(pprIdx); // Initialize _currentPPR
 
+  // Learned gear ratios
+  GearEngine::Cluster gears[GearEngine::MAX_CLUSTERS];
+  size_t gearBytes = prefs.getBytes("gear_model", gears, sizeof(gears));
+  _gears.setClusters(gears, gearBytes / sizeof(GearEngine::Cluster));
+  _savedGearCount = _gears.getGearCount();
+
+  // Engine usage; another size is another layout, start over
+  EngineStats::Histogram life;
+  if (prefs.getBytes("engine_hist", &life, sizeof(life)) == sizeof(life)) {
+    _engine.setLifetime(life);
+    _savedRunTicks = life.runTicks;
+  }
+
   prefs.end();
+  loadShiftConfig();
 
   // Gunakan Serial2 untuk GPS
   _gpsSerial = &Serial2;
@@ -41,25 +60,25 @@ void GPSManager::begin() {
     delay(250);                            // Give GPS time to switch
     _gpsSerial->updateBaudRate(_baudRate); // Switch ESP32 UART speed
   }
+  _linkBaud = _baudRate;
 
   // Apply Config (if GPS active)
   if (_gpsSerial) {
     delay(100); // Wait for GPS boot
 
-    // Optimize: Set 5Hz update rate (More stable signal)
-    setFrequencyLimit(5);
-
     // Optimize: Disable unnecessary NMEA sentences
     disableUnnecessarySentences();
 
-    setGnssMode(_currentGnssMode);
-
     // Force NMEA RMC enable just in case
     const uint8_t enableRmc[] = {0xB5, 0x62, 0x06, 0x01, 0x03, 0x00,
                                  0xF0, 0x04, 0x01, 0xFF, 0x18};
     sendUBX(enableRmc, sizeof(enableRmc));
     setDynamicModel(_currentDynModel);
     setSBASConfig(_currentSBAS);
+
+    // Menus until a session starts: low rate, configured constellations
+    _profile = PROFILE_IDLE;
+    applyProfile();
   }
 
   // Initialize SD Card for Redundancy
@@ -80,27 +99,190 @@ void GPSManager::begin() {
   }
 
   // Initialize RPM Sensor
-  // Initialize RPM Sensor
-  if (PIN_RPM_INPUT >= 0 && _rpmEnabled) {
-    pinMode(PIN_RPM_INPUT, INPUT);
-    attachInterrupt(digitalPinToInterrupt(PIN_RPM_INPUT), onPulse, FALLING);
+  if (PIN_RPM_INPUT >= 0 && _rpmEnabled)
+    startRpmCapture();
+}
+
+// Falling edge, timestamped by the capture unit. Edges closer than the
+// debounce are dropped without becoming the reference, so a spark
+// ringing burst doesn't shorten the next period.
+bool IRAM_ATTR GPSManager::onRpmCapture(mcpwm_unit_t unit,
+                                        mcpwm_capture_channel_id_t channel,
+                                        const cap_event_data_t *edata,
+                                        void *arg) {
+  GPSManager *self = (GPSManager *)arg;
+  uint32_t cap = edata->cap_value;
+  uint32_t ticks = cap - self->_rpmLastCap;
+  if (self->_rpmHaveEdge && ticks < self->_rpmMinTicks)
+    return false;
+  uint32_t now = (uint32_t)esp_timer_get_time();
+  uint32_t head = self->_rpmEdgeHead;
+  if (head - self->_rpmEdgeTail < RPM_EDGES) {
+    RpmEdge &e = self->_rpmEdges[head % RPM_EDGES];
+    e.us = now;
+    e.ticks = self->_rpmHaveEdge ? ticks : 0;
+    self->_rpmEdgeHead = head + 1;
+  }
+  // Shift light straight from this period, not the 100 Hz filter
+  bool changed = false;
+  if (self->_rpmHaveEdge) {
+    portENTER_CRITICAL_ISR(&self->_shiftMux);
+    changed = self->_shift.onPeriod(ticks, now);
+    portEXIT_CRITICAL_ISR(&self->_shiftMux);
   }
+  if (changed) {
+    setShiftPin(self->_shift.getLevel() != ShiftAlert::LEVEL_NONE);
+    self->_shiftBlink = true;
+    self->_shiftBlinkTicks = 0;
+    ShiftAlert::addLatency(self->_shiftOutLat,
+                           (uint32_t)esp_timer_get_time() -
+                               self->_shift.getCrossUs());
+  }
+  self->_rpmLastCap = cap;
+  self->_rpmHaveEdge = true;
+  return false;
+}
+
+// 100 Hz from the esp_timer task, whatever the UI loop is doing
+void GPSManager::onRpmSample(void *arg) {
+  GPSManager *self = (GPSManager *)arg;
+  uint32_t head = self->_rpmEdgeHead;
+  while (self->_rpmEdgeTail != head) {
+    const RpmEdge &e = self->_rpmEdges[self->_rpmEdgeTail % RPM_EDGES];
+    self->_rpmFilter.addPeriod(e.us, (float)e.ticks / RPM_TICKS_PER_US);
+    self->_rpmEdgeTail = self->_rpmEdgeTail + 1;
+  }
+  uint32_t now = (uint32_t)esp_timer_get_time();
+  self->_rpmFilter.sample(now, millis());
+  int rpm = self->_rpmFilter.getRpm();
+  int gear = self->_gears.getGear();
+  portENTER_CRITICAL(&self->_engineMux);
+  self->_engine.addSample(rpm, gear);
+  portEXIT_CRITICAL(&self->_engineMux);
+
+  // Thresholds follow the gear; the alert ends with the engine
+  portENTER_CRITICAL(&self->_shiftMux);
+  self->_shift.setGear(gear);
+  bool stopped = rpm == 0 && self->_shift.onStopped(now);
+  portEXIT_CRITICAL(&self->_shiftMux);
+  if (stopped)
+    setShiftPin(false);
+  if (self->_shift.getLevel() == ShiftAlert::LEVEL_OVERREV &&
+      ++self->_shiftBlinkTicks >= SHIFT_BLINK_SAMPLES) {
+    self->_shiftBlinkTicks = 0;
+    self->_shiftBlink = !self->_shiftBlink;
+    setShiftPin(self->_shiftBlink);
+  }
+  // The capture counter wraps every 53 s: after a long stop the next
+  // edge starts over instead of measuring against a stale one
+  if (self->_rpmFilter.getRpm() == 0 && self->_rpmEdgeTail == head)
+    self->_rpmHaveEdge = false;
 }
 
-// Static Member Initialization
-volatile unsigned long GPSManager::_rpmPulses = 0;
-volatile unsigned long GPSManager::_lastPulseMicros = 0;
-volatile unsigned long GPSManager::_pulseInterval = 0;
+// Register write: safe in the capture interrupt
+void IRAM_ATTR GPSManager::setShiftPin(bool on) {
+  if (PIN_SHIFT_LIGHT < 0)
+    return;
+  if (on)
+    GPIO.out_w1ts = 1UL << PIN_SHIFT_LIGHT;
+  else
+    GPIO.out_w1tc = 1UL << PIN_SHIFT_LIGHT;
+}
 
-void IRAM_ATTR GPSManager::onPulse() {
-  unsigned long now = micros();
-  // Debounce: 2ms (2000us) -> Max 30.000 RPM (Reduces noise significantly)
-  unsigned long interval = now - _lastPulseMicros;
-  if (interval > 2000) {
-    _lastPulseMicros = now;
-    _pulseInterval = interval;
-    _rpmPulses++; // Still keep track of total pulses if needed
+bool GPSManager::isShiftLampOn() {
+  ShiftAlert::Level level = _shift.getLevel();
+  return level == ShiftAlert::LEVEL_SHIFT ||
+         (level == ShiftAlert::LEVEL_OVERREV && _shiftBlink);
+}
+
+// Settings store option indices: 0 is off (over-rev, default shift
+// point) or "same as default" (per gear)
+void GPSManager::loadShiftConfig() {
+  uint16_t rpm[ShiftAlert::MAX_GEARS + 1];
+  Preferences prefs;
+  prefs.begin("laptimer", true);
+  int idx = prefs.getInt("shift_rpm", 0);
+  rpm[0] = idx > 0 ? ShiftAlert::rpmOption(idx - 1) : 0;
+  for (int g = 1; g <= ShiftAlert::MAX_GEARS; g++) {
+    char key[12];
+    snprintf(key, sizeof(key), "shift_g%d", g);
+    idx = prefs.getInt(key, 0);
+    rpm[g] = idx > 0 ? ShiftAlert::rpmOption(idx - 1) : 0;
   }
+  idx = prefs.getInt("overrev_rpm", 0);
+  uint16_t overRev = idx > 0 ? ShiftAlert::rpmOption(idx - 1) : 0;
+  prefs.end();
+
+  // NVS is read first: no flash access inside the critical section
+  portENTER_CRITICAL(&_shiftMux);
+  for (int g = 0; g <= ShiftAlert::MAX_GEARS; g++)
+    _shift.setShiftRpm(g, rpm[g]);
+  _shift.setOverRevRpm(overRev);
+  portEXIT_CRITICAL(&_shiftMux);
+}
+
+// From the UI loop once the lamp for `seq` is on the screen
+void GPSManager::noteShiftShown(uint32_t seq) {
+  if (seq != _shift.getSeq())
+    return; // Changed again meanwhile
+  ShiftAlert::addLatency(_shiftScrLat,
+                         (uint32_t)esp_timer_get_time() - _shift.getCrossUs());
+}
+
+void GPSManager::resetShiftLatency() {
+  _shiftOutLat = {};
+  _shiftScrLat = {};
+}
+
+void GPSManager::startRpmCapture() {
+  if (_rpmCapturing)
+    return;
+  _rpmCapturing = true;
+  _rpmFilter.reset();
+  _rpmFilter.setPulsesPerRev(_currentPPR);
+  _rpmMinTicks = _rpmFilter.getMinPeriodUs() * RPM_TICKS_PER_US;
+  _rpmHaveEdge = false;
+  _rpmEdgeTail = _rpmEdgeHead;
+
+  if (PIN_SHIFT_LIGHT >= 0) {
+    pinMode(PIN_SHIFT_LIGHT, OUTPUT);
+    digitalWrite(PIN_SHIFT_LIGHT, LOW);
+  }
+  pinMode(PIN_RPM_INPUT, INPUT);
+  mcpwm_gpio_init(MCPWM_UNIT_0, MCPWM_CAP_0, PIN_RPM_INPUT);
+  mcpwm_capture_config_t cap = {};
+  cap.cap_edge = MCPWM_NEG_EDGE;
+  cap.cap_prescale = 1;
+  cap.capture_cb = onRpmCapture;
+  cap.user_data = this;
+  mcpwm_capture_enable_channel(MCPWM_UNIT_0, MCPWM_SELECT_CAP0, &cap);
+
+  if (!_rpmTimer) {
+    esp_timer_create_args_t args = {};
+    args.callback = onRpmSample;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "rpm";
+    esp_timer_create(&args, &_rpmTimer);
+  }
+  esp_timer_start_periodic(_rpmTimer, RPM_SAMPLE_US);
+}
+
+void GPSManager::stopRpmCapture() {
+  if (!_rpmCapturing)
+    return;
+  _rpmCapturing = false;
+  mcpwm_capture_disable_channel(MCPWM_UNIT_0, MCPWM_SELECT_CAP0);
+  if (_rpmTimer)
+    esp_timer_stop(_rpmTimer);
+  _rpmFilter.reset();
+  portENTER_CRITICAL(&_engineMux);
+  _engine.addSample(0, 0); // Stopped, as far as the stats know
+  portEXIT_CRITICAL(&_engineMux);
+  portENTER_CRITICAL(&_shiftMux);
+  _shift.onStopped((uint32_t)esp_timer_get_time());
+  portEXIT_CRITICAL(&_shiftMux);
+  setShiftPin(false);
 }
 
 void GPSManager::update() {
@@ -167,8 +349,43 @@ void GPSManager::update() {
     _lastLat = lat;
     _lastLng = lng;
     _hasLastPos = true;
-    _updatesCount++;
+
+    // Epoch time: exact fix spacing, unlike the arrival time over UART
+    uint32_t fixTime;
+    if (_gps.time.isValid()) {
+      uint32_t ms = ((_gps.time.hour() * 60UL + _gps.time.minute()) * 60UL +
+                     _gps.time.second()) * 1000UL +
+                    _gps.time.centisecond() * 10UL;
+      if (ms + _dayOffsetMs + 43200000UL < _fixTimeMs)
+        _dayOffsetMs += 86400000UL; // Past midnight
+      fixTime = ms + _dayOffsetMs;
+    } else {
+      fixTime = millis();
+    }
+
+    // GGA and RMC of one epoch both update the location: count it once
+    if (fixTime != _fixTimeMs || _fixCount == 0) {
+      _fixTimeMs = fixTime;
+      _updatesCount++;
+      _fixCount++;
+      updateClockOffset(fixTime);
+
+      // Derived G channels; the filter's cost is tracked per epoch
+      unsigned long g0 = micros();
+      _gForce.addSample(_fixTimeMs, getSpeedKmph(), getHeading());
+      unsigned long gUs = micros() - g0;
+      _gForceTotalUs += gUs;
+      _gForceEpochs++;
+      if (gUs > _gForceMaxUs)
+        _gForceMaxUs = gUs;
+
+      if (_rpmEnabled) {
+        _gears.addSample(_fixTimeMs, getSpeedKmph(), getRPM());
+        saveGearModel();
+      }
+    }
   }
+  saveEngineStats();
 
   // Calculate Hz every 1 second
   if (millis() - _lastRateCheck >= 1000) {
@@ -178,37 +395,6 @@ void GPSManager::update() {
     _lastRateCheck = millis();
   }
 
-  // --- RPM CALCULATION (PERIOD METHOD) ---
-  if (_rpmEnabled) {
-    if (millis() - _lastRpmCalcTime > 50) { // 20Hz Update for smoothness
-      _lastRpmCalcTime = millis();
-
-      unsigned long lastP = _lastPulseMicros;
-      unsigned long interval = _pulseInterval;
-      unsigned long nowMicros = micros();
-
-      // Timeout: 0.5s without pulse -> Engine Off/Stall (<120 RPM 4T)
-      if (nowMicros - lastP > 500000) {
-        _currentRPM = 0;
-      } else if (interval > 0) {
-        // Calculate RPM: (60 sec * 1000 ms * 1000 us) / (interval * PPR)
-        // 60,000,000 / (interval * PPR)
-        float ppr = (_currentPPR > 0.1) ? _currentPPR : 1.0;
-        float instRPM = 60000000.0 / (float)(interval * ppr);
-
-        if (instRPM > 20000)
-          instRPM = 0; // Sanity check (Noise)
-
-        // Smoothing (EMA)
-        // _currentRPM = 0.7 * _currentRPM + 0.3 * instRPM;
-        // Or simpler integer smoothing
-        _currentRPM = (_currentRPM * 7 + (int)instRPM * 3) / 10;
-      }
-    }
-  } else {
-    _currentRPM = 0;
-  }
-
   // Periodic Save (Every 1 minute)
   if (millis() - _lastSaveTime > 60000) {
     Preferences prefs;
@@ -264,6 +450,15 @@ double GPSManager::getLatitude() { return _gps.location.lat(); }
 
 double GPSManager::getLongitude() { return _gps.location.lng(); }
 
+static int32_t rawToE7(const RawDegrees &r) {
+  int32_t v = (int32_t)r.deg * 10000000 + (r.billionths + 50) / 100;
+  return r.negative ? -v : v;
+}
+
+int32_t GPSManager::getLatE7() { return rawToE7(_gps.location.rawLat()); }
+
+int32_t GPSManager::getLonE7() { return rawToE7(_gps.location.rawLng()); }
+
 float GPSManager::getSpeedKmph() {
   // Priority 1: Use GPS speed if valid (no minimum threshold for sensitivity)
   if (_gps.speed.isValid()) {
@@ -431,62 +626,130 @@ void GPSManager::sendUBX(const uint8_t *cmd, int len) {
   }
 }
 
-void GPSManager::setGnssMode(uint8_t mode) {
-  if (!_gpsSerial)
+// Arrival is late by the UART transfer and the loop's polling, so the
+// fastest arrival of each second gives the offset. Small changes are
+// ignored to keep logged sample spacing exact (clock drift is ~1 ms/min).
+void GPSManager::updateClockOffset(uint32_t fixTime) {
+  uint32_t now = millis();
+  int32_t off = (int32_t)(fixTime - now);
+  int32_t jump = off - _clockOffset;
+  if (!_offsetValid || jump > 1000 || jump < -1000) {
+    // First fix, or the timebase changed (receiver time became valid)
+    _clockOffset = off;
+    _offsetMax = off;
+    _offsetStart = now;
+    _offsetValid = true;
+    return;
+  }
+  if (off > _offsetMax)
+    _offsetMax = off;
+  if (now - _offsetStart < 1000)
     return;
+  int32_t change = _offsetMax - _clockOffset;
+  if (change > CLOCK_HYST_MS || change < -CLOCK_HYST_MS)
+    _clockOffset = _offsetMax;
+  _offsetStart = now;
+  _offsetMax = off;
+}
 
-  // UBX-CFG-GNSS commands for different constellations
-  // We construct these based on U-blox M8 protocol
-  // Simplify: Trigger Cold Start or just minimal configuration?
-  // Real implementation requires constructing complex payload.
-  // For this prototype, we will handle RATE mostly as it's the primary "User
-  // Visible" change Hz.
-
-  // Mapping Mode to Hz Limit
-  int targetRate = 1; // Default safer 1Hz for 9600 baud
-
-  // Only allow higher rates if Baud Rate is sufficient (>38400)
-  // 9600 baud can barely handle 10Hz if sentences are short, but with full
-  // NMEA it chokes. Safe limit: 1Hz for 9600.
-  if (_baudRate > 38400) {
-    switch (mode) {
-    case 0:
-      targetRate = 5;
-      break; // All
-    case 1:
-      targetRate = 5;
-      break; // GPS+GLO+SBAS (Was 16)
-    case 2:
-      targetRate = 5;
-      break; // GPS+GAL+GLO+SBAS
-    case 3:
-      targetRate = 5;
-      break; // GPS+GAL+SBAS (Was 20)
-    case 4:
-      targetRate = 5;
-      break; // GPS+SBAS (Was 25)
-    case 5:
-      targetRate = 5;
-      break; // GPS Only (Was 25)
-    case 6:
-      targetRate = 5;
-      break; // GPS+BEI+SBAS (Was 12)
-    case 7:
-      targetRate = 5;
-      break; // GPS+GLO (Was 16)
+// Send a CFG frame and wait for its UBX-ACK, retrying on silence.
+// A NAK is final (the receiver does not support the setting). Inside
+// applyProfile() the waits share its budget; once that is spent frames
+// still go out, just unconfirmed.
+bool GPSManager::sendUBXConfirmed(const uint8_t *cmd, int len) {
+  if (!_gpsSerial)
+    return false;
+  for (int attempt = 0; attempt < 3; attempt++) {
+    unsigned long wait = 300;
+    if (_ubxDeadline) {
+      long left = (long)(_ubxDeadline - millis());
+      if (left <= 0) {
+        if (attempt == 0)
+          _gpsSerial->write(cmd, len);
+        break;
+      }
+      if (left < (long)wait)
+        wait = left;
     }
-  } else {
-    // For 9600 baud, force 1Hz to be safe.
-    targetRate = 1;
+    _gpsSerial->write(cmd, len);
+    int res = waitAck(cmd[2], cmd[3], wait);
+    if (res == 1)
+      return true;
+    if (res == 0) {
+      Serial.printf("UBX %02X-%02X: NAK\n", cmd[2], cmd[3]);
+      return false;
+    }
+    if (_gps.charsProcessed() == 0)
+      break; // Nothing on the line at all: no receiver to wait for
   }
-  Serial.printf("Setting GPS Frequency Limit to %d Hz...\n", targetRate);
-  setFrequencyLimit(targetRate);
-  _currentGnssMode = mode;
+  Serial.printf("UBX %02X-%02X: no ACK\n", cmd[2], cmd[3]);
+  return false;
+}
 
-  // In a real scenario, we would send UBX-CFG-GNSS here to enable/disable
-  // specific constellations. Due to complexity and lack of verification
-  // hardware, we mock the constellation switch but APPLY the Update Rate
-  // which is universally supported on M8/M10.
+// 1 = ACK, 0 = NAK, -1 = timeout. NMEA arriving meanwhile still goes to
+// the parser, so fixes are not lost while waiting.
+int GPSManager::waitAck(uint8_t cls, uint8_t id, unsigned long timeoutMs) {
+  // B5 62 05 (00 NAK | 01 ACK) 02 00 cls id ck_a ck_b
+  uint8_t buf[10];
+  int n = 0;
+  unsigned long start = millis();
+  while (millis() - start < timeoutMs) {
+    if (!_gpsSerial->available()) {
+      delay(1);
+      continue;
+    }
+    uint8_t c = _gpsSerial->read();
+    if (_dataCallback)
+      _dataCallback(c);
+
+    bool fits = (n == 0 && c == 0xB5) || (n == 1 && c == 0x62) ||
+                (n == 2 && c == 0x05) || (n == 3 && c <= 0x01) ||
+                (n == 4 && c == 0x02) || (n == 5 && c == 0x00) || n >= 6;
+    if (!fits) {
+      for (int i = 0; i < n; i++)
+        _gps.encode(buf[i]);
+      n = 0;
+      if (c != 0xB5) {
+        _gps.encode(c);
+        continue;
+      }
+    }
+    buf[n++] = c;
+    if (n < 10)
+      continue;
+
+    uint8_t ck_a = 0, ck_b = 0;
+    for (int i = 2; i < 8; i++) {
+      ck_a += buf[i];
+      ck_b += ck_a;
+    }
+    n = 0;
+    if (ck_a == buf[8] && ck_b == buf[9] && buf[6] == cls && buf[7] == id)
+      return buf[3];
+  }
+  return -1;
+}
+
+// Fastest rate whose NMEA output fits the UART, with headroom for
+// the UBX traffic. Only GGA and RMC are left on once trimming is
+// confirmed; otherwise count the default sentence set too.
+int GPSManager::maxRateForBaud(int baud) {
+  int sentences = _nmeaTrimmed ? 2 : 8; // GGA, RMC (+GSA, GSV x4, GLL, VTG)
+  int bytesPerEpoch = sentences * NMEA_MAX_LEN;
+  int usable = baud / 10 * 3 / 4; // 10 bits per byte, 75% load
+  int hz = usable / bytesPerEpoch;
+  return hz < 1 ? 1 : hz;
+}
+
+void GPSManager::setGnssMode(uint8_t mode) {
+  if (!_gpsSerial)
+    return;
+
+  // The mode is the idle constellation set; sessions use the
+  // high-rate profile (see applyProfile)
+  _currentGnssMode = mode;
+  _appliedGnss = -1; // Resend even if unchanged
+  applyProfile();
 
   Preferences prefs;
   prefs.begin("laptimer", false);
@@ -494,6 +757,151 @@ void GPSManager::setGnssMode(uint8_t mode) {
   prefs.end();
 }
 
+void GPSManager::setActivityProfile(ActivityProfile profile) {
+  if (_profile == profile)
+    return;
+  _profile = profile;
+  applyProfile();
+}
+
+void GPSManager::applyProfile() {
+  if (!_gpsSerial)
+    return;
+
+  // Highest navigation rate of each constellation set (M10 figures)
+  static const uint8_t modeMaxHz[] = {10, 16, 10, 20, 25, 25, 12, 16};
+
+  bool session = (_profile == PROFILE_SESSION);
+  uint8_t mode = session ? (uint8_t)MODE_GPS_SBAS_25HZ : _currentGnssMode;
+  if (mode > 7)
+    mode = MODE_GPS_GL_SBAS_16HZ;
+  int hz = IDLE_HZ;
+  if (session)
+    hz = std::min((int)modeMaxHz[mode], _targetFreq);
+  _ubxDeadline = millis() + PROFILE_BUDGET_MS;
+  if (_ubxDeadline == 0)
+    _ubxDeadline = 1; // 0 means no budget
+
+  if (session && maxRateForBaud(_linkBaud) < hz) {
+    // Raise the link to the slowest standard baud that carries the rate
+    static const int bauds[] = {38400, 57600, 115200};
+    for (int i = 0; i < 3; i++) {
+      if (bauds[i] <= _linkBaud)
+        continue;
+      if (maxRateForBaud(bauds[i]) >= hz || i == 2) {
+        switchLinkBaud(bauds[i], std::min(hz, maxRateForBaud(bauds[i])));
+        break;
+      }
+    }
+  }
+  // Never more than the link carries
+  hz = std::min(hz, maxRateForBaud(_linkBaud));
+
+  bool ok = true;
+  if (!session)
+    ok &= sendRate(hz); // Slow down before the baud comes down
+  if (mode != _appliedGnss) {
+    // Note: a constellation change restarts the receiver's tracking
+    // (fix back within a second or two on a hot start)
+    if (sendGnssConfig(mode))
+      _appliedGnss = mode;
+    else
+      ok = false;
+  }
+  if (!session && _linkBaud != _baudRate)
+    ok &= switchLinkBaud(_baudRate, hz);
+  if (session)
+    ok &= sendRate(hz);
+
+  _ubxDeadline = 0;
+  _profileHz = hz;
+  Serial.printf("GNSS profile %s: mode %d, %d Hz @ %d baud%s\n",
+                session ? "SESSION" : "IDLE", mode, hz, _linkBaud,
+                ok ? "" : " (not confirmed)");
+}
+
+// UBX-CFG-PRT at the current speed, then follow with the UART and
+// confirm with an ACK'd CFG-RATE of `hz` at the new speed: the rate the
+// link is about to carry, not the one before the switch
+bool GPSManager::switchLinkBaud(int baud, int hz) {
+  int oldBaud = _linkBaud;
+  configureGpsBaud(baud);
+  _gpsSerial->flush();
+  delay(100);
+  _gpsSerial->updateBaudRate(baud);
+  _linkBaud = baud;
+
+  if (sendRate(hz))
+    return true;
+
+  // Receiver did not follow: back to the old speed
+  Serial.printf("GNSS baud %d not confirmed, staying at %d\n", baud, oldBaud);
+  _gpsSerial->updateBaudRate(oldBaud);
+  _linkBaud = oldBaud;
+  return false;
+}
+
+// UBX-CFG-GNSS: enable the constellations of a mode, disable the rest
+bool GPSManager::sendGnssConfig(uint8_t mode) {
+  enum {
+    GPS = 1 << 0,
+    SBAS = 1 << 1,
+    GAL = 1 << 2,
+    BDS = 1 << 3,
+    QZSS = 1 << 5,
+    GLO = 1 << 6
+  };
+  static const uint8_t modeSets[] = {
+      GPS | SBAS | GAL | BDS | QZSS | GLO, // 0 All
+      GPS | GLO | SBAS | QZSS,             // 1
+      GPS | GAL | GLO | SBAS | QZSS,       // 2
+      GPS | GAL | SBAS | QZSS,             // 3
+      GPS | SBAS | QZSS,                   // 4
+      GPS | QZSS,                          // 5
+      GPS | BDS | SBAS | QZSS,             // 6
+      GPS | GLO | QZSS                     // 7
+  };
+  // gnssId, resTrkCh, maxTrkCh
+  static const uint8_t blocks[][3] = {{0, 8, 16}, {1, 1, 3}, {2, 4, 8},
+                                      {3, 8, 16}, {5, 0, 3}, {6, 8, 14}};
+  const int count = 6;
+
+  uint8_t packet[6 + 4 + count * 8 + 2];
+  int len = 4 + count * 8;
+  packet[0] = 0xB5;
+  packet[1] = 0x62;
+  packet[2] = 0x06;
+  packet[3] = 0x3E;
+  packet[4] = len & 0xFF;
+  packet[5] = len >> 8;
+  packet[6] = 0x00; // msgVer
+  packet[7] = 0x00; // numTrkChHw (read only)
+  packet[8] = 0xFF; // numTrkChUse: all
+  packet[9] = count;
+  for (int i = 0; i < count; i++) {
+    uint8_t *b = &packet[10 + i * 8];
+    bool on = modeSets[mode] & (1 << blocks[i][0]);
+    b[0] = blocks[i][0];
+    b[1] = blocks[i][1];
+    b[2] = blocks[i][2];
+    b[3] = 0x00;
+    b[4] = on ? 0x01 : 0x00; // enable
+    b[5] = 0x00;
+    b[6] = 0x01; // sigCfgMask: L1 / E1 / B1
+    b[7] = 0x00;
+  }
+
+  uint8_t ck_a = 0, ck_b = 0;
+  for (int i = 2; i < 6 + len; i++) {
+    ck_a += packet[i];
+    ck_b += ck_a;
+  }
+  packet[6 + len] = ck_a;
+  packet[7 + len] = ck_b;
+
+  return sendUBXConfirmed(packet, sizeof(packet));
+}
+
 uint8_t GPSManager::getGnssMode() { return _currentGnssMode; }
 
 void GPSManager::setDynamicModel(uint8_t modelIdx) {
@@ -645,18 +1053,102 @@ void GPSManager::setSBASConfig(uint8_t regionIndex) {
   prefs.end();
 }
 
+// A new gear is saved right away, refinements every GEAR_SAVE_MS
+void GPSManager::saveGearModel() {
+  if (!_gears.isModelChanged())
+    return;
+  int count = _gears.getGearCount();
+  if (count == _savedGearCount && millis() - _lastGearSave < GEAR_SAVE_MS)
+    return;
+
+  GearEngine::Cluster gears[GearEngine::MAX_CLUSTERS];
+  int n = _gears.getClusterCount();
+  for (int i = 0; i < n; i++)
+    gears[i] = _gears.getCluster(i);
+  Preferences prefs;
+  prefs.begin("laptimer", false);
+  prefs.putBytes("gear_model", gears, n * sizeof(GearEngine::Cluster));
+  prefs.end();
+
+  _gears.clearModelChanged();
+  _savedGearCount = count;
+  _lastGearSave = millis();
+  Serial.printf("Gear model saved: %d gears\n", count);
+}
+
+// Lifetime histogram (1 KB) every ENGINE_SAVE_MS of running, or once the
+// engine stops; the run time since the last save goes onto engine_hours
+// (which a cloud sync may overwrite with the server's count)
+void GPSManager::saveEngineStats(bool force) {
+  portENTER_CRITICAL(&_engineMux);
+  uint32_t runTicks = _engine.getLifetime().runTicks;
+  bool running = _engine.isRunning();
+  portEXIT_CRITICAL(&_engineMux);
+  uint32_t unsaved = (runTicks - _savedRunTicks) * EngineStats::TICK_MS;
+  if (!force) {
+    if (unsaved < ENGINE_MIN_SAVE_MS)
+      return;
+    if (running && unsaved < ENGINE_SAVE_MS)
+      return;
+  }
+
+  // Never torn by a sample; static, 1 KB is a lot of loop stack
+  static EngineStats::Histogram copy;
+  getEngineHistogram(true, copy);
+  Preferences prefs;
+  prefs.begin("laptimer", false);
+  prefs.putBytes("engine_hist", &copy, sizeof(copy));
+  float hours = prefs.getFloat("engine_hours", 0.0);
+  hours += EngineStats::hours(copy.runTicks - _savedRunTicks);
+  prefs.putFloat("engine_hours", hours);
+  prefs.end();
+  _savedRunTicks = copy.runTicks;
+  Serial.printf("Engine stats saved: %.2f h\n", hours);
+}
+
+void GPSManager::getEngineHistogram(bool lifetime,
+                                    EngineStats::Histogram &out) {
+  portENTER_CRITICAL(&_engineMux);
+  out = lifetime ? _engine.getLifetime() : _engine.getSession();
+  portEXIT_CRITICAL(&_engineMux);
+}
+
+void GPSManager::resetEngineSession() {
+  portENTER_CRITICAL(&_engineMux);
+  _engine.resetSession();
+  portEXIT_CRITICAL(&_engineMux);
+}
+
+void GPSManager::resetEngineStats() {
+  portENTER_CRITICAL(&_engineMux);
+  _engine.resetSession();
+  _engine.clearLifetime();
+  portEXIT_CRITICAL(&_engineMux);
+  _savedRunTicks = 0;
+  Preferences prefs;
+  prefs.begin("laptimer", false);
+  prefs.remove("engine_hist");
+  prefs.end();
+}
+
+void GPSManager::resetGearModel() {
+  _gears.reset();
+  _gears.clearModelChanged();
+  _savedGearCount = 0;
+  Preferences prefs;
+  prefs.begin("laptimer", false);
+  prefs.remove("gear_model");
+  prefs.end();
+}
+
 void GPSManager::setRpmEnabled(bool enabled) {
   _rpmEnabled = enabled;
 
   if (PIN_RPM_INPUT >= 0) {
-    if (_rpmEnabled) {
-      pinMode(PIN_RPM_INPUT, INPUT);
-      attachInterrupt(digitalPinToInterrupt(PIN_RPM_INPUT), onPulse, FALLING);
-    } else {
-      detachInterrupt(digitalPinToInterrupt(PIN_RPM_INPUT));
-      _currentRPM = 0;
-      _rpmPulses = 0;
-    }
+    if (_rpmEnabled)
+      startRpmCapture();
+    else
+      stopRpmCapture();
   }
 
   // Save Preference
@@ -685,11 +1177,22 @@ void GPSManager::setPPRIndex(int idx) {
     _currentPPR = 4.0;
     break;
   }
+  _rpmFilter.setPulsesPerRev(_currentPPR);
+  _rpmMinTicks = _rpmFilter.getMinPeriodUs() * RPM_TICKS_PER_US;
+  portENTER_CRITICAL(&_shiftMux);
+  _shift.setScale(60e6f * RPM_TICKS_PER_US / _currentPPR);
+  portEXIT_CRITICAL(&_shiftMux);
 }
 
 void GPSManager::setFrequencyLimit(int freq) {
-  if (!_gpsSerial)
-    return;
+  _targetFreq = freq;
+  if (_profile == PROFILE_SESSION)
+    applyProfile();
+}
+
+bool GPSManager::sendRate(int freq) {
+  if (!_gpsSerial || freq < 1)
+    return false;
 
   // UBX-CFG-RATE
   // rate = 1000 / freq
@@ -720,8 +1223,7 @@ void GPSManager::setFrequencyLimit(int freq) {
   packet[12] = ck_a;
   packet[13] = ck_b;
 
-  sendUBX(packet, sizeof(packet));
-  _targetFreq = freq;
+  return sendUBXConfirmed(packet, sizeof(packet));
 }
 
 void GPSManager::setProjection(bool enabled) {
@@ -750,7 +1252,7 @@ void GPSManager::setPins(int rx, int tx) {
   if (_gpsSerial) {
     _gpsSerial->end();
     delay(100);
-    _gpsSerial->begin(_baudRate, SERIAL_8N1, _rxPin, _txPin);
+    _gpsSerial->begin(_linkBaud, SERIAL_8N1, _rxPin, _txPin);
 
     // Re-apply config as module might have power cycled?
     // Actually ESP32 UART reset doesn't reset the GPS module itself,
@@ -781,10 +1283,11 @@ void GPSManager::setBaud(int baud) {
     delay(200); // Wait for module
     _gpsSerial->updateBaudRate(_baudRate);
     delay(100);
+    _linkBaud = _baudRate;
     // Re-apply config
-    setGnssMode(_currentGnssMode);
     setDynamicModel(_currentDynModel);
     setSBASConfig(_currentSBAS);
+    applyProfile();
   }
 }
 
@@ -839,6 +1342,7 @@ void GPSManager::configureGpsBaud(int targetBaud) {
 void GPSManager::disableUnnecessarySentences() {
   if (!_gpsSerial)
     return;
+  bool ok = true;
 
   // Disable GSA (DOP and active satellites) - Not critical for racing
   uint8_t disableGSA[] = {
@@ -846,25 +1350,30 @@ void GPSManager::disableUnnecessarySentences() {
       0x00, 0x00, 0x00, 0x00, 0x00, 0x00,             // Disable on all ports
       0x01, 0x31                                      // Checksum
   };
-  sendUBX(disableGSA, sizeof(disableGSA));
-  delay(50);
+  ok &= sendUBXConfirmed(disableGSA, sizeof(disableGSA));
 
   // Disable GSV (Satellites in view) - Not critical, uses lots of bandwidth
   uint8_t disableGSV[] = {
       0xB5, 0x62, 0x06, 0x01, 0x08, 0x00, 0xF0, 0x03, // NMEA-GxGSV
       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x38  // Checksum
   };
-  sendUBX(disableGSV, sizeof(disableGSV));
-  delay(50);
+  ok &= sendUBXConfirmed(disableGSV, sizeof(disableGSV));
 
   // Disable GLL (Geographic position) - Redundant with RMC
   uint8_t disableGLL[] = {
       0xB5, 0x62, 0x06, 0x01, 0x08, 0x00, 0xF0, 0x01, // NMEA-GxGLL
       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2A  // Checksum
   };
-  sendUBX(disableGLL, sizeof(disableGLL));
-  delay(50);
+  ok &= sendUBXConfirmed(disableGLL, sizeof(disableGLL));
+
+  // Disable VTG (Track/Speed) - RMC carries the same, TinyGPS++ skips it
+  uint8_t disableVTG[] = {
+      0xB5, 0x62, 0x06, 0x01, 0x08, 0x00, 0xF0, 0x05, // NMEA-GxVTG
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x46  // Checksum
+  };
+  ok &= sendUBXConfirmed(disableVTG, sizeof(disableVTG));
 
-  // Keep enabled: GGA (Position), RMC (Recommended minimum), VTG (Track/Speed)
-  // These are essential for racing/tracking
+  // Keep enabled: GGA (Position, altitude, sats) and RMC (speed, course,
+  // date). The rate budget counts only these once trimming is confirmed.
+  _nmeaTrimmed = ok;
 }
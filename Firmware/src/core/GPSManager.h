@@ -2,10 +2,18 @@
 #define GPS_MANAGER_H
 
 #include "../config.h"
+#include "EngineStats.h"
+#include "GForceEngine.h"
+#include "GearEngine.h"
+#include "GeoTypes.h"
+#include "RpmFilter.h"
+#include "ShiftAlert.h"
 #include <FS.h>
 #include <SD.h>
 #include <SPI.h> // Ensure SPI is included
 #include <TinyGPS++.h>
+#include <driver/mcpwm.h>
+#include <esp_timer.h>
 #include <functional>
 
 class GPSManager {
@@ -18,6 +26,10 @@ public:
     MODE_GPS_SBAS_25HZ = 4
   };
 
+  // Receiver profile by activity: low rate in menus, the fastest
+  // constellation set the link can carry while a session is running
+  enum ActivityProfile { PROFILE_IDLE, PROFILE_SESSION };
+
   void begin();
   void update();
 
@@ -25,12 +37,17 @@ public:
   bool isFixed();
   double getLatitude();
   double getLongitude();
+  int32_t getLatE7(); // 1e-7 deg, from the raw NMEA digits (no double)
+  int32_t getLonE7();
+  GeoPoint getPosition() { return {getLatE7(), getLonE7()}; }
   float getSpeedKmph();
   float getTotalTrip();
   void resetTrip();
   int getSatellites();
-  void setRPM(int rpm) { _currentRPM = rpm; }
-  int getRPM() { return _currentRPM; }
+  // Filtered engine speed, RPM_SAMPLE_US old at most
+  int getRPM() { return _rpmEnabled ? _rpmFilter.getRpm() : 0; }
+  // Every RPM sample (100 Hz), by sequence number; see RpmFilter
+  const RpmFilter &getRpmFilter() { return _rpmFilter; }
   String getTimeString();
   String getDateString();
   int getRawHour();
@@ -39,6 +56,53 @@ public:
   double getAltitude();
   double getHeading();
   int getUpdateRate();
+  // Increments once per position epoch, i.e. when the receiver time of
+  // the fix changes (compare to detect fresh fixes)
+  uint32_t getFixCount() { return _fixCount; }
+  // Receiver time of the last fix in ms (UTC time of day, keeps counting
+  // past midnight); millis() at arrival while the receiver has no time
+  uint32_t getFixTimeMs() { return _fixTimeMs; }
+  // A millis() reading on the fix timebase, for channels logged next to
+  // the fixes. The offset is the largest fixTime - arrival of each second
+  // (least UART delay), taken when it moves more than CLOCK_HYST_MS.
+  uint32_t toFixTime(uint32_t ms) { return ms + _clockOffset; }
+
+  // Derived channels: smoothed G from speed and course, LATENCY_MS old
+  bool isGForceValid() { return _gForce.isValid(); }
+  float getLonG() { return _gForce.getLonG(); } // + = accelerating
+  float getLatG() { return _gForce.getLatG(); } // + = to the right
+  // Filter cost per epoch (micros), for the serial report
+  unsigned long getGForceAvgUs() {
+    return _gForceEpochs ? _gForceTotalUs / _gForceEpochs : 0;
+  }
+  unsigned long getGForceMaxUs() { return _gForceMaxUs; }
+
+  // Gear from the RPM/speed ratio (0 = stopped, clutch or not learned).
+  // Ratios are learned while driving and kept in NVS.
+  int getGear() { return _gears.getGear(); }
+  const GearEngine &getGears() { return _gears; }
+  void resetGearStats() { _gears.resetStats(); } // Time in gear
+  void resetGearModel();
+
+  // Time in RPM band and gear, per session and lifetime, from every RPM
+  // sample. The lifetime part is kept in NVS and advances engine_hours.
+  // Updated from the RPM timer task: read through a copy.
+  void getEngineHistogram(bool lifetime, EngineStats::Histogram &out);
+  void resetEngineSession();
+  void resetEngineStats();
+
+  // Shift light: decided per ignition edge in the capture interrupt,
+  // which also drives PIN_SHIFT_LIGHT (over-rev blinks at 10 Hz). Screens
+  // poll the sequence and report when the change is on the display.
+  ShiftAlert::Level getShiftLevel() { return _shift.getLevel(); }
+  uint32_t getShiftSeq() { return _shift.getSeq(); }
+  bool isShiftLampOn();
+  void loadShiftConfig(); // Thresholds from NVS
+  void noteShiftShown(uint32_t seq);
+  // Latency from the first edge past the threshold to the GPIO / screen
+  const ShiftAlert::Latency &getShiftOutputLatency() { return _shiftOutLat; }
+  const ShiftAlert::Latency &getShiftScreenLatency() { return _shiftScrLat; }
+  void resetShiftLatency();
 
   // Configuration
   void setGnssMode(uint8_t mode);
@@ -47,7 +111,12 @@ public:
   void setSBASConfig(uint8_t region);  // 0=EGNOS, 1=WAAS...
   void setProjection(bool enabled);    // Coordinate Projection
   bool isProjectionEnabled() { return _projectionEnabled; }
-  void setFrequencyLimit(int freq); // 10 or 25 (max)
+  void setFrequencyLimit(int freq); // Session rate cap (Hz)
+
+  // Switches rate, constellations and baud; each change is ACK-confirmed
+  void setActivityProfile(ActivityProfile profile);
+  ActivityProfile getActivityProfile() { return _profile; }
+  int getProfileRate() { return _profileHz; } // Hz actually applied
 
   // RPM Configuration
   void setRpmEnabled(bool enabled);
@@ -82,7 +151,15 @@ private:
   TinyGPSPlus _gps;
   HardwareSerial *_gpsSerial;
   void sendUBX(const uint8_t *cmd, int len);
+  bool sendUBXConfirmed(const uint8_t *cmd, int len); // Waits for ACK
+  int waitAck(uint8_t cls, uint8_t id, unsigned long timeoutMs);
   void configureGpsBaud(int targetBaud);
+  bool switchLinkBaud(int baud, int hz); // hz: rate to confirm with
+  bool sendRate(int hz);
+  bool sendGnssConfig(uint8_t mode);
+  void applyProfile();
+  void updateClockOffset(uint32_t fixTime);
+  int maxRateForBaud(int baud);
   void disableUnnecessarySentences(); // Optimize GPS bandwidth
 
   RawDataCallback _dataCallback = nullptr;
@@ -97,7 +174,6 @@ private:
   double _lastLng = 0.0;
   bool _hasLastPos = false;
   unsigned long _lastSaveTime = 0;
-  int _currentRPM = 0;
 
   // Speed Calculation
   float _calculatedSpeed = 0.0;
@@ -108,15 +184,57 @@ private:
 
   // Hz Calculation
   int _updatesCount = 0;
+  uint32_t _fixCount = 0;
+  uint32_t _fixTimeMs = 0;
+  int32_t _clockOffset = 0;  // Fix time - millis()
+  int32_t _offsetMax = 0;    // Best of this second so far
+  uint32_t _offsetStart = 0; // millis() this second began
+  bool _offsetValid = false;
+  static const int32_t CLOCK_HYST_MS = 2;
+  uint32_t _dayOffsetMs = 0;
   unsigned long _lastRateCheck = 0;
   int _currentHz = 0;
 
+  // Derived G channels, fed per fix
+  GForceEngine _gForce;
+  unsigned long _gForceTotalUs = 0;
+  unsigned long _gForceMaxUs = 0;
+  unsigned long _gForceEpochs = 0;
+
+  // Gear model, fed per fix while the RPM sensor is on
+  GearEngine _gears;
+  int _savedGearCount = 0;
+  unsigned long _lastGearSave = 0;
+  static const unsigned long GEAR_SAVE_MS = 300000; // NVS wear
+  void saveGearModel();
+
+  // Engine usage, fed by the RPM sampler; saved every ENGINE_SAVE_MS of
+  // running and when the engine stops, not per sample
+  EngineStats _engine;
+  portMUX_TYPE _engineMux = portMUX_INITIALIZER_UNLOCKED;
+  uint32_t _savedRunTicks = 0;
+  static const uint32_t ENGINE_SAVE_MS = 300000;
+  static const uint32_t ENGINE_MIN_SAVE_MS = 10000; // Run time worth a write
+  void saveEngineStats(bool force = false);
+
   // Settings Cache
   uint8_t _currentGnssMode = 0;
   uint8_t _currentDynModel = 3;   // Default Automotive (User Index 3 -> UBX 4)
   uint8_t _currentSBAS = 0;       // Default EGNOS
   bool _projectionEnabled = true; // Default Enabled
-  int _targetFreq = 10;
+  int _targetFreq = 25; // Session rate cap
+
+  // Activity profile
+  ActivityProfile _profile = PROFILE_IDLE;
+  int _linkBaud = 9600;        // UART speed right now (may be raised)
+  int _profileHz = 1;
+  int _appliedGnss = -1;       // Constellation mode on the receiver
+  bool _nmeaTrimmed = false;   // GSA/GSV/GLL/VTG off (confirmed)
+  static const int IDLE_HZ = 1;
+  // All ACK waits of one applyProfile(), which runs on the UI loop
+  static const unsigned long PROFILE_BUDGET_MS = 600;
+  unsigned long _ubxDeadline = 0; // 0: no budget
+  static const int NMEA_MAX_LEN = 82; // Bytes per sentence (NMEA 0183)
 
   bool _rpmEnabled = true; // Default Enabled
   float _currentPPR = 1.0; // Default 1.0 (1 pulse per rev)
@@ -131,14 +249,43 @@ private:
   int _utcOffset = 0;
   unsigned long _lastTick = 0;
 
-  // RPM Logic
-  static volatile unsigned long _rpmPulses;
-  static volatile unsigned long _lastPulseMicros;
-  static volatile unsigned long _pulseInterval;
-  unsigned long _lastRpmCalcTime = 0;
+  // RPM: MCPWM capture timestamps each falling edge (APB ticks) in
+  // hardware; the ISR only debounces and queues the period, a 100 Hz
+  // esp_timer drains the queue into the filter and takes a sample
+  struct RpmEdge {
+    uint32_t us;    // esp_timer time of the edge
+    uint32_t ticks; // Since the previous edge, 0 = first edge
+  };
+  static const int RPM_EDGES = 64;           // 200 ms at 20k rpm, 1 PPR
+  static const uint32_t RPM_SAMPLE_US = 10000;
+  static const uint32_t RPM_TICKS_PER_US = 80; // APB clock
+  RpmEdge _rpmEdges[RPM_EDGES];
+  volatile uint32_t _rpmEdgeHead = 0; // Written by the ISR
+  volatile uint32_t _rpmEdgeTail = 0; // Written by the sampler
+  volatile uint32_t _rpmMinTicks = 0; // Debounce for this PPR
+  volatile bool _rpmHaveEdge = false;
+  uint32_t _rpmLastCap = 0;
+  RpmFilter _rpmFilter;
+  esp_timer_handle_t _rpmTimer = nullptr;
+  bool _rpmCapturing = false;
+  void startRpmCapture();
+  void stopRpmCapture();
 
-public:
-  static void IRAM_ATTR onPulse();
+  ShiftAlert _shift;
+  // Capture ISR (onPeriod) against the RPM timer and settings changes
+  portMUX_TYPE _shiftMux = portMUX_INITIALIZER_UNLOCKED;
+  ShiftAlert::Latency _shiftOutLat = {};
+  ShiftAlert::Latency _shiftScrLat = {};
+  volatile bool _shiftBlink = true; // Over-rev phase
+  uint8_t _shiftBlinkTicks = 0;
+  static const uint8_t SHIFT_BLINK_SAMPLES = 5; // 50 ms on, 50 off
+  static void IRAM_ATTR setShiftPin(bool on);
+
+  static bool IRAM_ATTR onRpmCapture(mcpwm_unit_t unit,
+                                     mcpwm_capture_channel_id_t channel,
+                                     const cap_event_data_t *edata,
+                                     void *arg);
+  static void onRpmSample(void *arg);
 };
 
 #endif
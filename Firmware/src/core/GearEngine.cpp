@@ -0,0 +1,184 @@
+#include "GearEngine.h"
+
+void GearEngine::reset() {
+  _count = 0;
+  _changed = true;
+  _prevRatio = 0;
+  _steady = 0;
+  _gear = 0;
+  _slot = -1;
+  resetStats();
+}
+
+void GearEngine::resetStats() {
+  for (int i = 0; i < MAX_CLUSTERS; i++)
+    _timeMs[i] = 0;
+  _neutralMs = 0;
+  _hasTime = false;
+}
+
+void GearEngine::setClusters(const Cluster *c, int n) {
+  _count = 0;
+  for (int i = 0; i < n && _count < MAX_CLUSTERS; i++) {
+    if (!(c[i].ratio > 0) || c[i].weight == 0)
+      continue;
+    // Insertion sort, ratio descending
+    int k = _count++;
+    while (k > 0 && _clusters[k - 1].ratio < c[i].ratio) {
+      _clusters[k] = _clusters[k - 1];
+      k--;
+    }
+    _clusters[k] = c[i];
+  }
+  _changed = false;
+  _gear = 0;
+  _slot = -1;
+  resetStats();
+}
+
+int GearEngine::getGearCount() const {
+  int n = 0;
+  for (int i = 0; i < _count; i++)
+    if (_clusters[i].weight >= CONFIRM)
+      n++;
+  return n;
+}
+
+int GearEngine::gearOf(int slot) const {
+  int g = 0;
+  for (int i = 0; i <= slot; i++)
+    if (_clusters[i].weight >= CONFIRM)
+      g++;
+  return g;
+}
+
+float GearEngine::getGearRatio(int gear) const {
+  for (int i = 0; i < _count; i++)
+    if (_clusters[i].weight >= CONFIRM && --gear == 0)
+      return _clusters[i].ratio;
+  return 0;
+}
+
+uint32_t GearEngine::getTimeInGear(int gear) const {
+  if (gear == 0)
+    return _neutralMs;
+  for (int i = 0; i < _count; i++)
+    if (_clusters[i].weight >= CONFIRM && --gear == 0)
+      return _timeMs[i];
+  return 0;
+}
+
+int GearEngine::classify(float ratio) const {
+  int best = -1;
+  float bestD = CLASSIFY_TOL;
+  for (int i = 0; i < _count; i++) {
+    if (_clusters[i].weight < CONFIRM)
+      continue;
+    float d = relDiff(ratio, _clusters[i].ratio);
+    if (d < bestD) {
+      bestD = d;
+      best = i;
+    }
+  }
+  return best;
+}
+
+int GearEngine::addSample(uint32_t timeMs, float speedKmh, float rpm) {
+  // Time since the last sample goes to the gear it was in
+  if (_hasTime && timeMs - _lastT <= GAP_MS) {
+    if (_slot >= 0)
+      _timeMs[_slot] += timeMs - _lastT;
+    else
+      _neutralMs += timeMs - _lastT;
+  }
+  _lastT = timeMs;
+  _hasTime = true;
+
+  if (speedKmh < MIN_KMH || rpm < MIN_RPM) {
+    _steady = 0;
+    _prevRatio = 0;
+    _gear = 0;
+    _slot = -1;
+    return 0;
+  }
+
+  float ratio = rpm / speedKmh;
+  if (_prevRatio > 0 && relDiff(ratio, _prevRatio) < STEADY_TOL)
+    _steady++;
+  else
+    _steady = 0;
+  _prevRatio = ratio;
+  if (_steady >= STEADY_SAMPLES)
+    learn(ratio);
+
+  _slot = classify(ratio);
+  _gear = (_slot >= 0) ? gearOf(_slot) : 0;
+  return _gear;
+}
+
+void GearEngine::remove(int i) {
+  for (int k = i; k + 1 < _count; k++) {
+    _clusters[k] = _clusters[k + 1];
+    _timeMs[k] = _timeMs[k + 1];
+  }
+  _count--;
+  _timeMs[_count] = 0;
+}
+
+void GearEngine::learn(float ratio) {
+  int near = -1;
+  float nearD = JOIN_TOL;
+  for (int i = 0; i < _count; i++) {
+    float d = relDiff(ratio, _clusters[i].ratio);
+    if (d < nearD) {
+      nearD = d;
+      near = i;
+    }
+  }
+
+  if (near >= 0) {
+    Cluster &c = _clusters[near];
+    if (c.weight < WEIGHT_CAP)
+      c.weight++;
+    c.ratio += (ratio - c.ratio) / c.weight;
+    _changed = true;
+
+    // Grown into a neighbour (two seeds of one gear): one cluster
+    for (int j = near - 1; j <= near + 1; j += 2) {
+      if (j < 0 || j >= _count ||
+          relDiff(_clusters[j].ratio, c.ratio) >= MERGE_TOL)
+        continue;
+      int keep = (j < near) ? j : near;
+      int drop = (j < near) ? near : j;
+      Cluster &a = _clusters[keep];
+      const Cluster &b = _clusters[drop];
+      uint32_t w = (uint32_t)a.weight + b.weight;
+      a.ratio = (a.ratio * a.weight + b.ratio * b.weight) / w;
+      a.weight = (w < WEIGHT_CAP) ? w : WEIGHT_CAP;
+      _timeMs[keep] += _timeMs[drop];
+      remove(drop);
+      break;
+    }
+    return;
+  }
+
+  // New cluster; when full it replaces the weakest unconfirmed one
+  if (_count == MAX_CLUSTERS) {
+    int weakest = -1;
+    for (int i = 0; i < _count; i++)
+      if (_clusters[i].weight < CONFIRM &&
+          (weakest < 0 || _clusters[i].weight < _clusters[weakest].weight))
+        weakest = i;
+    if (weakest < 0)
+      return;
+    remove(weakest);
+  }
+  int k = _count++;
+  while (k > 0 && _clusters[k - 1].ratio < ratio) {
+    _clusters[k] = _clusters[k - 1];
+    _timeMs[k] = _timeMs[k - 1];
+    k--;
+  }
+  _clusters[k] = {ratio, 1};
+  _timeMs[k] = 0;
+}
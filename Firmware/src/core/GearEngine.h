@@ -0,0 +1,77 @@
+#ifndef GEAR_ENGINE_H
+#define GEAR_ENGINE_H
+
+#include <stdint.h>
+
+// Gear from the RPM/speed ratio, learned while driving. Steady samples
+// (ratio within STEADY_TOL of the previous one for STEADY_SAMPLES, not
+// idling, moving) are clustered online: the nearest cluster within
+// JOIN_TOL moves towards the sample (running mean, weight capped so it
+// keeps adapting), otherwise a new cluster starts. Clusters with
+// CONFIRM samples are gears, numbered from the highest ratio (1st).
+// Clutch slip and shifts are never steady, so they only ever seed small
+// clusters that get evicted. Classification is O(gears) per sample.
+class GearEngine {
+public:
+  struct Cluster {
+    float ratio;     // RPM per km/h
+    uint16_t weight; // Samples, capped at WEIGHT_CAP
+  };
+
+  void reset();      // Forget the learned ratios
+  void resetStats(); // Time in gear only
+
+  // Returns the gear (1..), 0 when stopped, idling, between gears or not
+  // learned yet
+  int addSample(uint32_t timeMs, float speedKmh, float rpm);
+  int getGear() const { return _gear; }
+
+  int getGearCount() const; // Confirmed clusters
+  float getGearRatio(int gear) const;
+  // ms since resetStats(); gear 0 is neutral/clutch/unknown
+  uint32_t getTimeInGear(int gear) const;
+
+  // Persistence: raw clusters, ratio descending
+  int getClusterCount() const { return _count; }
+  const Cluster &getCluster(int i) const { return _clusters[i]; }
+  void setClusters(const Cluster *c, int n);
+  bool isModelChanged() const { return _changed; }
+  void clearModelChanged() { _changed = false; }
+
+  static const int MAX_CLUSTERS = 10; // Also the most gears
+  static const uint16_t CONFIRM = 30;     // Samples before it is a gear
+  static const uint16_t WEIGHT_CAP = 500; // Learning rate floor 1/500
+  static const int STEADY_SAMPLES = 3;
+  static constexpr float STEADY_TOL = 0.02f;
+  static constexpr float JOIN_TOL = 0.05f;     // Relative to the centre
+  static constexpr float MERGE_TOL = 0.03f;    // Neighbours this close
+  static constexpr float CLASSIFY_TOL = 0.06f;
+  static constexpr float MIN_KMH = 8.0f;
+  static constexpr float MIN_RPM = 1500.0f; // Above idle
+  static const uint32_t GAP_MS = 1000;      // Longer: not counted
+
+private:
+  Cluster _clusters[MAX_CLUSTERS];
+  uint32_t _timeMs[MAX_CLUSTERS]; // Time in each cluster's gear
+  int _count = 0;
+  uint32_t _neutralMs = 0;
+  bool _changed = false;
+
+  float _prevRatio = 0;
+  int _steady = 0;
+  int _gear = 0;
+  int _slot = -1; // Cluster of _gear
+  bool _hasTime = false;
+  uint32_t _lastT = 0;
+
+  static float relDiff(float x, float c) {
+    float d = x / c - 1.0f;
+    return (d < 0) ? -d : d;
+  }
+  void learn(float ratio);
+  void remove(int i);
+  int classify(float ratio) const; // Slot or -1
+  int gearOf(int slot) const;
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef GEO_TYPES_H
+#define GEO_TYPES_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// No Arduino.h here so the geometry can be built and tested on a host
+#ifndef DEG_TO_RAD
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#endif
+
+// Compact fixed-point coordinates.
+// Lat/lon are int32 in 1e-7 degrees (~1.1 cm, same as the u-blox output).
+// Geometry works on int32 deltas scaled by a float, so there is no double
+// maths (software emulated on the ESP32) in the hot paths.
+
+#define MM_PER_E7_LAT 11.054f    // 110540 m per degree latitude
+#define MM_PER_E7_LON_EQ 11.132f // 111320 m per degree longitude at equator
+
+struct GeoPoint { // 8 bytes
+  int32_t latE7;
+  int32_t lonE7;
+};
+
+struct LocalPoint { // 8 bytes, millimetres east/north of a LocalFrame origin
+  int32_t x;
+  int32_t y;
+};
+
+inline int32_t degToE7(double deg) {
+  return (int32_t)(deg * 10000000.0 + (deg >= 0 ? 0.5 : -0.5));
+}
+
+inline double e7ToDeg(int32_t e7) { return e7 / 10000000.0; }
+
+// Parse "-12.3456789" straight into 1e-7 degrees (extra digits truncated).
+// Returns the position after the number, or nullptr if there is none.
+inline const char *parseE7(const char *s, int32_t &out) {
+  bool neg = false;
+  if (*s == '-') {
+    neg = true;
+    s++;
+  } else if (*s == '+') {
+    s++;
+  }
+  if (*s < '0' || *s > '9')
+    return nullptr;
+
+  int32_t deg = 0;
+  while (*s >= '0' && *s <= '9') {
+    deg = deg * 10 + (*s - '0');
+    s++;
+  }
+
+  int32_t frac = 0;
+  int digits = 0;
+  if (*s == '.') {
+    s++;
+    while (*s >= '0' && *s <= '9') {
+      if (digits < 7) {
+        frac = frac * 10 + (*s - '0');
+        digits++;
+      }
+      s++;
+    }
+  }
+  while (digits < 7) {
+    frac *= 10;
+    digits++;
+  }
+
+  int32_t v = deg * 10000000 + frac;
+  out = neg ? -v : v;
+  return s;
+}
+
+// Format 1e-7 degrees as "-12.3456789" (buf >= 13 chars)
+inline void formatE7(char *buf, int32_t e7) {
+  uint32_t a = (e7 < 0) ? (uint32_t)(-(int64_t)e7) : (uint32_t)e7;
+  sprintf(buf, "%s%lu.%07lu", (e7 < 0) ? "-" : "", (unsigned long)(a / 10000000),
+          (unsigned long)(a % 10000000));
+}
+
+// Flat-earth frame around an origin. Good to well under 0.1% over the size
+// of a circuit or drag strip.
+struct LocalFrame {
+  GeoPoint origin = {0, 0};
+  float mmPerE7Lon = MM_PER_E7_LON_EQ;
+
+  void setOrigin(const GeoPoint &o) {
+    origin = o;
+    mmPerE7Lon = MM_PER_E7_LON_EQ * cosf(o.latE7 * (1e-7f * DEG_TO_RAD));
+  }
+
+  // Metres (float) east/north of the origin
+  float xM(int32_t lonE7) const {
+    return (lonE7 - origin.lonE7) * mmPerE7Lon * 0.001f;
+  }
+  float yM(int32_t latE7) const {
+    return (latE7 - origin.latE7) * MM_PER_E7_LAT * 0.001f;
+  }
+
+  LocalPoint toLocal(const GeoPoint &p) const {
+    LocalPoint l;
+    l.x = (int32_t)((p.lonE7 - origin.lonE7) * mmPerE7Lon);
+    l.y = (int32_t)((p.latE7 - origin.latE7) * MM_PER_E7_LAT);
+    return l;
+  }
+
+  GeoPoint toGeo(float xM, float yM) const {
+    GeoPoint g;
+    g.latE7 = origin.latE7 + (int32_t)lroundf(yM * 1000.0f / MM_PER_E7_LAT);
+    g.lonE7 = origin.lonE7 + (int32_t)lroundf(xM * 1000.0f / mmPerE7Lon);
+    return g;
+  }
+
+  float distanceM(const GeoPoint &a, const GeoPoint &b) const {
+    float dx = (b.lonE7 - a.lonE7) * mmPerE7Lon;
+    float dy = (b.latE7 - a.latE7) * MM_PER_E7_LAT;
+    return sqrtf(dx * dx + dy * dy) * 0.001f;
+  }
+};
+
+// One-off distance (metres) between two nearby points
+inline float geoDistanceM(const GeoPoint &a, const GeoPoint &b) {
+  LocalFrame f;
+  f.setOrigin(a);
+  return f.distanceM(a, b);
+}
+
+#endif
@@ -0,0 +1,167 @@
+#include "LapTimingEngine.h"
+
+void LapTimingEngine::begin(const TrackLayout &layout) {
+  _frame.setOrigin(layout.centre);
+  _gates.clear();
+  for (const auto &s : layout.sectors)
+    _gates.push_back(makeGate(s));
+
+  _finishReady = layout.hasFinishLine;
+  if (_finishReady)
+    _gates.push_back(makeGate(layout.finish));
+
+  reset();
+}
+
+void LapTimingEngine::reset() {
+  _hasPrev = false;
+  _lapRunning = false;
+  _lapStart = 0;
+  _lastSplit = 0;
+  _nextGate = 0;
+  _lapTimes.clear();
+  _sectorTimes.clear();
+  _currentSectors.clear();
+  _bestLap = 0;
+  _bestLapIdx = -1;
+  _bestLapStart = 0;
+  _eventCount = 0;
+  for (auto &g : _gates)
+    g.dir = 0;
+}
+
+LapTimingEngine::Gate LapTimingEngine::makeGate(const GateLine &line) {
+  Gate g;
+  g.ax = _frame.xM(line.a.lonE7);
+  g.ay = _frame.yM(line.a.latE7);
+  g.bx = _frame.xM(line.b.lonE7);
+  g.by = _frame.yM(line.b.latE7);
+  g.dir = 0;
+  return g;
+}
+
+void LapTimingEngine::buildAutoFinish(float x, float y, float dx, float dy) {
+  float len = sqrtf(dx * dx + dy * dy);
+  if (len < 0.5f)
+    return;
+
+  // Only while approaching the centre point (origin of the frame)
+  if (x * x + y * y > AUTO_GATE_RADIUS * AUTO_GATE_RADIUS)
+    return;
+  if (x * dx + y * dy > 0)
+    return; // Moving away
+
+  float nx = -dy / len * AUTO_GATE_HALF_W;
+  float ny = dx / len * AUTO_GATE_HALF_W;
+  Gate g = {nx, ny, -nx, -ny, -1}; // Direction of travel is known here
+  _gates.push_back(g);
+  _finishReady = true;
+}
+
+// Segment P->C against gate A->B. t = fraction along P->C.
+bool LapTimingEngine::crosses(Gate &g, float px, float py, float cx, float cy,
+                              float &t) {
+  float rx = cx - px, ry = cy - py;
+  float sx = g.bx - g.ax, sy = g.by - g.ay;
+  float denom = rx * sy - ry * sx;
+  if (fabsf(denom) < 1e-6f)
+    return false; // Parallel
+
+  float qx = g.ax - px, qy = g.ay - py;
+  t = (qx * sy - qy * sx) / denom;
+  float u = (qx * ry - qy * rx) / denom;
+  if (t < 0 || t >= 1 || u < 0 || u > 1)
+    return false;
+
+  int8_t side = (denom > 0) ? 1 : -1;
+  if (g.dir == 0)
+    g.dir = side; // First crossing defines the driving direction
+  return side == g.dir;
+}
+
+int LapTimingEngine::addFix(uint32_t timeMs, const GeoPoint &pos) {
+  _eventCount = 0;
+  float x = _frame.xM(pos.lonE7);
+  float y = _frame.yM(pos.latE7);
+
+  if (_hasPrev) {
+    if (!_finishReady)
+      buildAutoFinish(_prevX, _prevY, x - _prevX, y - _prevY);
+
+    // Sectors only forward within a lap (a missed line is skipped), the
+    // finish line always
+    size_t finishIdx = _gates.size() - 1;
+    for (size_t i = 0; _finishReady && i < _gates.size(); i++) {
+      if (_lapRunning && i < _nextGate)
+        continue;
+      if (!_lapRunning && i != finishIdx)
+        continue;
+
+      float t;
+      if (crosses(_gates[i], _prevX, _prevY, x, y, t)) {
+        uint32_t at = _prevT + (uint32_t)(t * (timeMs - _prevT) + 0.5f);
+        onGate(i, at);
+      }
+    }
+  }
+
+  _prevX = x;
+  _prevY = y;
+  _prevT = timeMs;
+  _hasPrev = true;
+  return _eventCount;
+}
+
+void LapTimingEngine::onGate(size_t idx, uint32_t at) {
+  size_t nSectors = _gates.size();
+  bool isFinish = (idx == nSectors - 1);
+
+  if (!isFinish) {
+    _currentSectors[idx] = at - _lastSplit;
+    pushEvent(EV_SECTOR, _lapTimes.size() + 1, idx + 1, at - _lastSplit, at);
+    _lastSplit = at;
+    _nextGate = idx + 1;
+    return;
+  }
+
+  if (_lapRunning) {
+    uint32_t lap = at - _lapStart;
+    if (lap < MIN_LAP_MS)
+      return; // Wobble on the line
+
+    uint16_t lapNum = _lapTimes.size() + 1;
+    if (nSectors > 1) {
+      _currentSectors[nSectors - 1] = at - _lastSplit;
+      pushEvent(EV_SECTOR, lapNum, nSectors, at - _lastSplit, at);
+    }
+
+    _lapTimes.push_back(lap);
+    _sectorTimes.insert(_sectorTimes.end(), _currentSectors.begin(),
+                        _currentSectors.end());
+    if (_bestLap == 0 || lap < _bestLap) {
+      _bestLap = lap;
+      _bestLapIdx = lapNum - 1;
+      _bestLapStart = _lapStart;
+    }
+    pushEvent(EV_LAP, lapNum, 0, lap, at);
+  }
+
+  // Start next lap
+  _lapRunning = true;
+  _lapStart = at;
+  _lastSplit = at;
+  _nextGate = 0;
+  _currentSectors.assign(nSectors, 0);
+}
+
+void LapTimingEngine::pushEvent(uint8_t type, uint16_t lap, uint8_t sector,
+                                uint32_t time, uint32_t at) {
+  if (_eventCount >= 4)
+    return;
+  Event &e = _events[_eventCount++];
+  e.type = type;
+  e.lap = lap;
+  e.sector = sector;
+  e.time = time;
+  e.crossAt = at;
+}
@@ -0,0 +1,100 @@
+#ifndef LAP_TIMING_ENGINE_H
+#define LAP_TIMING_ENGINE_H
+
+#include "GeoTypes.h"
+#include <stdint.h>
+#include <vector>
+
+// Timing line between two points
+struct GateLine {
+  GeoPoint a;
+  GeoPoint b;
+};
+
+// Start/finish plus optional sector lines, in driving order.
+// Without an explicit finish line, one is built through `centre`
+// perpendicular to the direction of travel on the first approach.
+struct TrackLayout {
+  GeoPoint centre = {0, 0};
+  bool hasFinishLine = false;
+  GateLine finish;
+  std::vector<GateLine> sectors;
+};
+
+// Streaming lap/sector timer.
+// Fed one fix at a time (live or from a log), detects line crossings as
+// segment intersections and interpolates the crossing time between fixes.
+// Plain C++ (no Arduino/SD) so it runs the same on the host.
+class LapTimingEngine {
+public:
+  enum EventType { EV_LAP, EV_SECTOR };
+
+  struct Event {
+    uint8_t type;
+    uint16_t lap;    // 1-based lap number
+    uint8_t sector;  // 1-based, last sector ends at the finish line
+    uint32_t time;   // Lap or sector duration (ms)
+    uint32_t crossAt; // Interpolated crossing timestamp (ms)
+  };
+
+  void begin(const TrackLayout &layout);
+  void reset();
+
+  // Returns the number of events produced by this fix (see getEvent)
+  int addFix(uint32_t timeMs, const GeoPoint &pos);
+  const Event &getEvent(int i) const { return _events[i]; }
+
+  // Results so far
+  int getLapCount() const { return _lapTimes.size(); }
+  const std::vector<uint32_t> &getLapTimes() const { return _lapTimes; }
+  uint32_t getBestLap() const { return _bestLap; }
+  int getBestLapIdx() const { return _bestLapIdx; }
+  uint32_t getBestLapStart() const { return _bestLapStart; }
+  int getSectorsPerLap() const { return _gates.size(); }
+  // Sector times, lap-major (getSectorsPerLap() per lap, 0 = missed)
+  const std::vector<uint32_t> &getSectorTimes() const { return _sectorTimes; }
+  bool isLapRunning() const { return _lapRunning; }
+  uint32_t getLapStart() const { return _lapStart; }
+
+  static const uint32_t MIN_LAP_MS = 10000; // Ignore double crossings
+  static const int AUTO_GATE_RADIUS = 50;   // m, build auto finish line
+  static const int AUTO_GATE_HALF_W = 15;   // m
+
+private:
+  struct Gate {
+    float ax, ay, bx, by; // Local metres
+    int8_t dir;           // Required crossing side, 0 = learn on first
+  };
+
+  LocalFrame _frame;
+  std::vector<Gate> _gates; // Sector lines, then finish line last
+  bool _finishReady = false;
+
+  bool _hasPrev = false;
+  float _prevX = 0, _prevY = 0;
+  uint32_t _prevT = 0;
+
+  bool _lapRunning = false;
+  uint32_t _lapStart = 0;
+  uint32_t _lastSplit = 0;
+  size_t _nextGate = 0;
+
+  std::vector<uint32_t> _lapTimes;
+  std::vector<uint32_t> _sectorTimes;
+  std::vector<uint32_t> _currentSectors;
+  uint32_t _bestLap = 0;
+  int _bestLapIdx = -1;
+  uint32_t _bestLapStart = 0;
+
+  Event _events[4];
+  int _eventCount = 0;
+
+  Gate makeGate(const GateLine &line);
+  bool crosses(Gate &g, float px, float py, float cx, float cy, float &t);
+  void buildAutoFinish(float x, float y, float dx, float dy);
+  void onGate(size_t idx, uint32_t at);
+  void pushEvent(uint8_t type, uint16_t lap, uint8_t sector, uint32_t time,
+                 uint32_t at);
+};
+
+#endif
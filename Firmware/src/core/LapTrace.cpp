@@ -0,0 +1,70 @@
+#include "LapTrace.h"
+#include <algorithm>
+#include <math.h>
+
+void LapTraceBuilder::begin(float lengthM) {
+  _length = lengthM;
+  _bins = (int)(lengthM / BIN_M);
+  if (_bins > MAX_BINS)
+    _bins = MAX_BINS;
+  if (_bins < 1)
+    _bins = 1;
+  _binLen = lengthM / _bins;
+  _lastDist = -1;
+
+  _sumOffset.assign(_bins, 0);
+  _sumSpeed.assign(_bins, 0);
+  _count.assign(_bins, 0);
+  _done.offset.assign(_bins, (int8_t)LapTrace::NO_OFFSET);
+  _done.speed.assign(_bins, 0);
+}
+
+bool LapTraceBuilder::addFix(float distance, float offset, float speedKmh) {
+  // Wrapped from the end of the lap to its start
+  bool wrapped = _lastDist > _length * 0.75f && distance < _length * 0.25f;
+  _lastDist = distance;
+  if (wrapped)
+    finishLap();
+
+  int b = (int)(distance / _binLen);
+  if (b < 0 || b >= _bins)
+    return wrapped;
+  if (_count[b] < 255) {
+    _sumOffset[b] += offset;
+    _sumSpeed[b] += speedKmh;
+    _count[b]++;
+  }
+  return wrapped;
+}
+
+void LapTraceBuilder::finishLap() {
+  _done.lap = 0;
+  _done.lapTime = 0;
+  std::fill(_done.offset.begin(), _done.offset.end(),
+            (int8_t)LapTrace::NO_OFFSET);
+  std::fill(_done.speed.begin(), _done.speed.end(), 0);
+
+  int lastFilled = -1;
+  for (int b = 0; b < _bins; b++) {
+    if (_count[b] == 0)
+      continue;
+    float off = _sumOffset[b] / _count[b] * 10.0f;
+    off = fmaxf(-127.0f, fminf(127.0f, off));
+    _done.offset[b] = (int8_t)lroundf(off);
+    _done.speed[b] = (uint16_t)lroundf(_sumSpeed[b] / _count[b] * 10.0f);
+
+    // Fixes further apart than a bin leave gaps: interpolate them
+    for (int g = lastFilled + 1; lastFilled >= 0 && g < b; g++) {
+      float f = (float)(g - lastFilled) / (b - lastFilled);
+      _done.offset[g] = (int8_t)lroundf(
+          _done.offset[lastFilled] + f * (_done.offset[b] - _done.offset[lastFilled]));
+      _done.speed[g] = (uint16_t)lroundf(
+          _done.speed[lastFilled] + f * (_done.speed[b] - _done.speed[lastFilled]));
+    }
+    lastFilled = b;
+  }
+
+  std::fill(_sumOffset.begin(), _sumOffset.end(), 0.0f);
+  std::fill(_sumSpeed.begin(), _sumSpeed.end(), 0.0f);
+  std::fill(_count.begin(), _count.end(), 0);
+}
@@ -0,0 +1,60 @@
+#ifndef LAP_TRACE_H
+#define LAP_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Per-lap racing line and speed, binned by distance along the reference
+// centreline (see MapMatcher). Stored per session as a .cmp sidecar:
+//   LapTraceHeader, then one record per lap:
+//   uint16 lap, uint32 lapTime, int8 offset[bins], uint16 speed[bins]
+struct LapTraceHeader {
+  uint32_t magic;
+  uint16_t bins;
+  uint16_t reserved;
+  float binLen; // m
+};
+
+struct LapTrace {
+  uint16_t lap = 0;
+  uint32_t lapTime = 0;
+  std::vector<int8_t> offset;   // 0.1 m, left +, NO_OFFSET = no data
+  std::vector<uint16_t> speed;  // 0.1 km/h
+
+  static const int8_t NO_OFFSET = -128;
+  static size_t recordSize(int bins) { return 6 + 3 * bins; }
+};
+
+// Bins the matched fixes of a session lap by lap. A lap is complete when
+// the matched distance wraps at the start line; the caller assigns it the
+// lap number of the LAP line that follows.
+class LapTraceBuilder {
+public:
+  void begin(float lengthM);
+  int getBins() const { return _bins; }
+  float getBinLen() const { return _binLen; }
+
+  // Returns true when this fix started a new lap (getCompleted() is set)
+  bool addFix(float distance, float offset, float speedKmh);
+  const LapTrace &getCompleted() const { return _done; }
+
+  static const uint32_t MAGIC = 0x314D434C; // "LCM1"
+  static const int MAX_BINS = 256;
+  static constexpr float BIN_M = 5.0f;
+
+private:
+  int _bins = 0;
+  float _binLen = BIN_M;
+  float _length = 0;
+  float _lastDist = -1;
+
+  std::vector<float> _sumOffset;
+  std::vector<float> _sumSpeed;
+  std::vector<uint8_t> _count;
+  LapTrace _done;
+
+  void finishLap();
+};
+
+#endif
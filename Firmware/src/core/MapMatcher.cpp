@@ -0,0 +1,283 @@
+#include "MapMatcher.h"
+#include <algorithm>
+
+void MapMatcher::begin(const GeoPoint &origin) {
+  clear();
+  _frame.setOrigin(origin);
+}
+
+void MapMatcher::clear() {
+  _vx.clear();
+  _vy.clear();
+  _vd.clear();
+  _segCount = 0;
+  _length = 0;
+  _closed = false;
+  _hasLast = false;
+  _pendX.clear();
+  _pendY.clear();
+  _cellStart.clear();
+  _cellSegs.clear();
+  _gridW = 0;
+  _gridH = 0;
+  _locked = false;
+  _lastSeg = 0;
+}
+
+// --- Build ---
+
+void MapMatcher::addPoint(const GeoPoint &p) {
+  float x = _frame.xM(p.lonE7);
+  float y = _frame.yM(p.latE7);
+
+  if (_vx.empty()) {
+    pushVertex(x, y);
+    _anchorX = x;
+    _anchorY = y;
+    return;
+  }
+
+  if (_hasLast) {
+    float lx = x - _lastX, ly = y - _lastY;
+    if (lx * lx + ly * ly < 0.04f)
+      return; // Standing still
+
+    // Keep the last point as a vertex once the chord anchor -> p no longer
+    // covers everything since the anchor
+    float cx = x - _anchorX, cy = y - _anchorY;
+    float len = sqrtf(cx * cx + cy * cy);
+    bool cut = len > MAX_CHORD || _pendX.size() >= 64;
+    for (size_t i = 0; !cut && i <= _pendX.size(); i++) {
+      float px = (i < _pendX.size()) ? _pendX[i] : _lastX;
+      float py = (i < _pendY.size()) ? _pendY[i] : _lastY;
+      float ex = px - _anchorX, ey = py - _anchorY;
+      float d = (len < 0.01f) ? sqrtf(ex * ex + ey * ey)
+                              : fabsf(ex * cy - ey * cx) / len;
+      cut = d > SIMPLIFY_TOL;
+    }
+
+    if (cut) {
+      pushVertex(_lastX, _lastY);
+      _anchorX = _lastX;
+      _anchorY = _lastY;
+      _pendX.clear();
+      _pendY.clear();
+    } else {
+      _pendX.push_back(_lastX);
+      _pendY.push_back(_lastY);
+    }
+  }
+
+  _lastX = x;
+  _lastY = y;
+  _hasLast = true;
+}
+
+void MapMatcher::addVertex(const GeoPoint &p) {
+  pushVertex(_frame.xM(p.lonE7), _frame.yM(p.latE7));
+}
+
+void MapMatcher::pushVertex(float x, float y) {
+  float d = 0;
+  if (!_vx.empty()) {
+    float dx = x - _vx.back(), dy = y - _vy.back();
+    d = _vd.back() + sqrtf(dx * dx + dy * dy);
+  }
+  _vx.push_back(x);
+  _vy.push_back(y);
+  _vd.push_back(d);
+}
+
+bool MapMatcher::finish() {
+  if (_hasLast)
+    pushVertex(_lastX, _lastY);
+  _hasLast = false;
+  _pendX.clear();
+  _pendX.shrink_to_fit();
+  _pendY.clear();
+  _pendY.shrink_to_fit();
+
+  if (_vx.size() < 2 || _vx.size() >= 65535) {
+    clear();
+    return false;
+  }
+
+  // A lap: join the ends so distance wraps cleanly at the line
+  float gx = _vx.front() - _vx.back(), gy = _vy.front() - _vy.back();
+  if (_vd.back() > 4 * CLOSE_DIST && gx * gx + gy * gy < CLOSE_DIST * CLOSE_DIST) {
+    pushVertex(_vx.front(), _vy.front());
+    _closed = true;
+  }
+
+  _segCount = _vx.size() - 1;
+  _length = _vd.back();
+  _vx.shrink_to_fit();
+  _vy.shrink_to_fit();
+  _vd.shrink_to_fit();
+  buildGrid();
+  return true;
+}
+
+void MapMatcher::buildGrid() {
+  float maxX = _vx[0], maxY = _vy[0];
+  _minX = _vx[0];
+  _minY = _vy[0];
+  for (size_t i = 1; i < _vx.size(); i++) {
+    _minX = std::min(_minX, _vx[i]);
+    _minY = std::min(_minY, _vy[i]);
+    maxX = std::max(maxX, _vx[i]);
+    maxY = std::max(maxY, _vy[i]);
+  }
+  _minX -= LOCK_LOSS;
+  _minY -= LOCK_LOSS;
+  maxX += LOCK_LOSS;
+  maxY += LOCK_LOSS;
+
+  // Cells at least as big as the lock radius, so the 3x3 block around a
+  // fix holds every segment that can match it
+  float span = std::max(maxX - _minX, maxY - _minY);
+  _cellSize = std::max((float)LOCK_LOSS, span / MAX_GRID);
+  _gridW = (int)((maxX - _minX) / _cellSize) + 1;
+  _gridH = (int)((maxY - _minY) / _cellSize) + 1;
+  int cells = _gridW * _gridH;
+
+  // Count, prefix sum, fill
+  std::vector<uint16_t> fill(cells, 0);
+  for (int s = 0; s < _segCount; s++) {
+    int c0, r0, c1, r1;
+    segmentBox(s, c0, r0, c1, r1);
+    for (int r = r0; r <= r1; r++)
+      for (int c = c0; c <= c1; c++)
+        fill[r * _gridW + c]++;
+  }
+
+  _cellStart.assign(cells + 1, 0);
+  for (int i = 0; i < cells; i++)
+    _cellStart[i + 1] = _cellStart[i] + fill[i];
+  _cellSegs.assign(_cellStart[cells], 0);
+
+  std::fill(fill.begin(), fill.end(), 0);
+  for (int s = 0; s < _segCount; s++) {
+    int c0, r0, c1, r1;
+    segmentBox(s, c0, r0, c1, r1);
+    for (int r = r0; r <= r1; r++) {
+      for (int c = c0; c <= c1; c++) {
+        int cell = r * _gridW + c;
+        _cellSegs[_cellStart[cell] + fill[cell]++] = s;
+      }
+    }
+  }
+}
+
+int MapMatcher::cellOf(float x, float y) const {
+  int c = (int)((x - _minX) / _cellSize);
+  int r = (int)((y - _minY) / _cellSize);
+  if (x < _minX || y < _minY || c >= _gridW || r >= _gridH)
+    return -1;
+  return r * _gridW + c;
+}
+
+void MapMatcher::segmentBox(int s, int &c0, int &r0, int &c1, int &r1) const {
+  c0 = (int)((std::min(_vx[s], _vx[s + 1]) - _minX) / _cellSize);
+  c1 = (int)((std::max(_vx[s], _vx[s + 1]) - _minX) / _cellSize);
+  r0 = (int)((std::min(_vy[s], _vy[s + 1]) - _minY) / _cellSize);
+  r1 = (int)((std::max(_vy[s], _vy[s + 1]) - _minY) / _cellSize);
+}
+
+// --- Matching ---
+
+// Squared distance from (x, y) to segment s, t = position along it
+float MapMatcher::project(int s, float x, float y, float &t,
+                         float &side) const {
+  float ax = _vx[s], ay = _vy[s];
+  float dx = _vx[s + 1] - ax, dy = _vy[s + 1] - ay;
+  float ex = x - ax, ey = y - ay;
+  float len2 = dx * dx + dy * dy;
+  t = (len2 > 0) ? (ex * dx + ey * dy) / len2 : 0;
+  t = std::max(0.0f, std::min(1.0f, t));
+  side = dx * ey - dy * ex;
+  float px = ex - t * dx, py = ey - t * dy;
+  return px * px + py * py;
+}
+
+MapMatcher::Match MapMatcher::resultFor(int s, float x, float y) const {
+  float t, side;
+  float d2 = project(s, x, y, t, side);
+  Match m;
+  m.valid = true;
+  m.segment = s;
+  m.distance = _vd[s] + t * (_vd[s + 1] - _vd[s]);
+  m.offset = (side >= 0) ? sqrtf(d2) : -sqrtf(d2);
+  return m;
+}
+
+MapMatcher::Match MapMatcher::match(const GeoPoint &pos) {
+  Match none = {false, 0, 0, 0};
+  if (_segCount == 0)
+    return none;
+
+  float x = _frame.xM(pos.lonE7);
+  float y = _frame.yM(pos.latE7);
+  float t, side;
+  int best = -1;
+  float bestD2 = LOCK_LOSS * LOCK_LOSS;
+
+  if (_locked) {
+    // Window around the last match. Slide on while the best fit is the
+    // far end of the window (long step on short segments).
+    int from = _lastSeg - WINDOW_BACK;
+    int to = _lastSeg + WINDOW_AHEAD;
+    for (int pass = 0; pass < 4; pass++) {
+      bool atEnd = false;
+      for (int k = from; k <= to; k++) {
+        int s = k;
+        if (_closed)
+          s = ((k % _segCount) + _segCount) % _segCount;
+        else if (s < 0 || s >= _segCount)
+          continue;
+        float d2 = project(s, x, y, t, side);
+        if (d2 < bestD2) {
+          bestD2 = d2;
+          best = s;
+          atEnd = (k == to && t >= 1.0f);
+        }
+      }
+      if (!atEnd)
+        break;
+      from = to + 1;
+      to += WINDOW_AHEAD;
+    }
+    if (best >= 0) {
+      _lastSeg = best;
+      return resultFor(best, x, y);
+    }
+  }
+
+  // Not locked or lost: all segments near the fix
+  int cell = cellOf(x, y);
+  if (cell < 0) {
+    _locked = false;
+    return none;
+  }
+  int cr = cell / _gridW, cc = cell % _gridW;
+  for (int r = std::max(0, cr - 1); r <= std::min(_gridH - 1, cr + 1); r++) {
+    for (int c = std::max(0, cc - 1); c <= std::min(_gridW - 1, cc + 1); c++) {
+      int i = r * _gridW + c;
+      for (uint32_t j = _cellStart[i]; j < _cellStart[i + 1]; j++) {
+        float d2 = project(_cellSegs[j], x, y, t, side);
+        if (d2 < bestD2) {
+          bestD2 = d2;
+          best = _cellSegs[j];
+        }
+      }
+    }
+  }
+
+  if (best < 0) {
+    _locked = false;
+    return none;
+  }
+  _locked = true;
+  _lastSeg = best;
+  return resultFor(best, x, y);
+}
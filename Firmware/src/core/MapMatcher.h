@@ -0,0 +1,86 @@
+#ifndef MAP_MATCHER_H
+#define MAP_MATCHER_H
+
+#include "GeoTypes.h"
+#include <stdint.h>
+#include <vector>
+
+// Snaps fixes onto a track centreline.
+// The centreline is simplified while it is built, its segments are put in
+// a uniform grid, and a locked fix only searches a small window of
+// segments around the previous match, so each fix costs about the same
+// whatever the track length. Gives a stable distance along the lap (the
+// same spot always maps to the same metre) and a lateral offset.
+class MapMatcher {
+public:
+  struct Match {
+    bool valid;
+    float distance; // m from the first vertex along the centreline
+    float offset;   // m, positive = left of the driving direction
+    uint16_t segment;
+  };
+
+  // Build: begin, addPoint in driving order, finish
+  void begin(const GeoPoint &origin);
+  void addPoint(const GeoPoint &p);
+  void addVertex(const GeoPoint &p); // As is, for a saved centreline
+  bool finish();
+  void clear();
+
+  bool isValid() const { return _segCount > 0; }
+  bool isClosed() const { return _closed; }
+  float getLength() const { return _length; }
+  size_t getVertexCount() const { return _vx.size(); }
+  GeoPoint getVertex(size_t i) const { return _frame.toGeo(_vx[i], _vy[i]); }
+  // Local metres and distance along the line of a vertex
+  float getVertexX(size_t i) const { return _vx[i]; }
+  float getVertexY(size_t i) const { return _vy[i]; }
+  float getVertexDistance(size_t i) const { return _vd[i]; }
+
+  Match match(const GeoPoint &pos);
+  void resetTracking() { _locked = false; }
+
+  static constexpr float SIMPLIFY_TOL = 0.25f; // m off the chord
+  static constexpr float MAX_CHORD = 50.0f;    // m between vertices
+  static constexpr float CLOSE_DIST = 30.0f;   // m, ends joined into a loop
+  static constexpr float LOCK_LOSS = 25.0f;    // m off track: search again
+  static const int WINDOW_BACK = 2;            // Segments searched behind
+  static const int WINDOW_AHEAD = 6;           // and ahead of the last match
+  static const int MAX_GRID = 64;              // Cells per axis
+
+private:
+  LocalFrame _frame;
+
+  // Vertices (metres) and distance along the line at each one
+  std::vector<float> _vx, _vy, _vd;
+  int _segCount = 0;
+  float _length = 0;
+  bool _closed = false;
+
+  // Streaming simplification
+  float _anchorX = 0, _anchorY = 0;
+  float _lastX = 0, _lastY = 0;
+  bool _hasLast = false;
+  std::vector<float> _pendX, _pendY;
+
+  // Segment grid (compressed rows: cell -> range in _cellSegs). A segment
+  // is entered in every cell its box covers, so the entry total can pass
+  // the segment count many times over: 32-bit offsets.
+  float _minX = 0, _minY = 0, _cellSize = 20.0f;
+  int _gridW = 0, _gridH = 0;
+  std::vector<uint32_t> _cellStart;
+  std::vector<uint16_t> _cellSegs; // Segment numbers (< 65535)
+
+  // Tracking
+  bool _locked = false;
+  int _lastSeg = 0;
+
+  void pushVertex(float x, float y);
+  void buildGrid();
+  int cellOf(float x, float y) const;
+  void segmentBox(int s, int &c0, int &r0, int &c1, int &r1) const;
+  float project(int s, float x, float y, float &t, float &side) const;
+  Match resultFor(int s, float x, float y) const;
+};
+
+#endif
@@ -0,0 +1,390 @@
+#include "MathChannels.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *INPUT_NAMES[MathChannels::IN_COUNT] = {
+    "speed", "alt", "heading", "long", "latg", "rpm", "gear"};
+
+void MathChannels::clear() {
+  _count = 0;
+  _constCount = 0;
+  _winCount = 0;
+  _error[0] = '\0';
+  reset();
+}
+
+void MathChannels::reset() {
+  for (int i = 0; i < _winCount; i++) {
+    _win[i].sum = 0;
+    _win[i].head = 0;
+    _win[i].count = 0;
+  }
+  for (int i = 0; i < MAX_CHANNELS; i++)
+    _value[i] = 0;
+  _started = false;
+}
+
+bool MathChannels::isIdentChar(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+bool MathChannels::fail(const char *msg) {
+  snprintf(_error, sizeof(_error), "%s", msg);
+  return false;
+}
+
+bool MathChannels::addLine(const char *line) {
+  const char *p = line;
+  while (*p == ' ' || *p == '\t')
+    p++;
+  if (*p == '\0' || *p == '#' || *p == '\r' || *p == '\n')
+    return true;
+
+  const char *eq = strchr(p, '=');
+  if (!eq)
+    return fail("expected name = expression");
+  const char *e = eq;
+  while (e > p && (e[-1] == ' ' || e[-1] == '\t'))
+    e--;
+  if (e - p >= NAME_LEN)
+    return fail("name too long");
+  char name[NAME_LEN];
+  memcpy(name, p, e - p);
+  name[e - p] = '\0';
+  return add(name, eq + 1);
+}
+
+bool MathChannels::add(const char *name, const char *expr) {
+  _error[0] = '\0';
+  if (_count >= MAX_CHANNELS)
+    return fail("too many channels");
+  size_t len = strlen(name);
+  if (len == 0 || len >= NAME_LEN || (name[0] >= '0' && name[0] <= '9'))
+    return fail("bad name");
+  for (size_t i = 0; i < len; i++)
+    if (!isIdentChar(name[i]))
+      return fail("bad name");
+  if (strcmp(name, "time") == 0)
+    return fail("name taken");
+  for (int i = 0; i < IN_COUNT; i++)
+    if (strcmp(name, INPUT_NAMES[i]) == 0)
+      return fail("name taken");
+  for (int i = 0; i < _count; i++)
+    if (strcmp(name, _ch[i].name) == 0)
+      return fail("name taken");
+
+  // Compile into the next slot; constants and windows roll back on error
+  Channel &c = _ch[_count];
+  memcpy(c.name, name, len + 1);
+  c.len = 0;
+  int consts = _constCount, wins = _winCount;
+  _out = &c;
+  _p = expr;
+  _depth = 0;
+
+  bool ok = parseExpr();
+  if (ok) {
+    skipSpace();
+    if (*_p != '\0' && *_p != '#' && *_p != '\r' && *_p != '\n')
+      ok = fail("unexpected text");
+  }
+  if (!ok) {
+    _constCount = consts;
+    _winCount = wins;
+    return false;
+  }
+  _value[_count] = 0;
+  _count++;
+  return true;
+}
+
+void MathChannels::skipSpace() {
+  while (*_p == ' ' || *_p == '\t')
+    _p++;
+}
+
+bool MathChannels::emit(uint8_t op, int depthChange) {
+  if (_out->len >= MAX_CODE)
+    return fail("expression too long");
+  _out->code[_out->len++] = op;
+  _depth += depthChange;
+  if (_depth > MAX_STACK)
+    return fail("expression too deep");
+  return true;
+}
+
+bool MathChannels::emitArg(uint8_t op, int arg, int depthChange) {
+  return emit(op, depthChange) && emit((uint8_t)arg, 0);
+}
+
+// expr := term (('+' | '-') term)*
+bool MathChannels::parseExpr() {
+  if (!parseTerm())
+    return false;
+  for (;;) {
+    skipSpace();
+    char c = *_p;
+    if (c != '+' && c != '-')
+      return true;
+    _p++;
+    if (!parseTerm() || !emit(c == '+' ? OP_ADD : OP_SUB, -1))
+      return false;
+  }
+}
+
+// term := unary (('*' | '/') unary)*
+bool MathChannels::parseTerm() {
+  if (!parseUnary())
+    return false;
+  for (;;) {
+    skipSpace();
+    char c = *_p;
+    if (c != '*' && c != '/')
+      return true;
+    _p++;
+    if (!parseUnary() || !emit(c == '*' ? OP_MUL : OP_DIV, -1))
+      return false;
+  }
+}
+
+bool MathChannels::parseUnary() {
+  skipSpace();
+  if (*_p == '-') {
+    _p++;
+    return parseUnary() && emit(OP_NEG, 0);
+  }
+  if (*_p == '+') {
+    _p++;
+    return parseUnary();
+  }
+  return parsePrimary();
+}
+
+bool MathChannels::parsePrimary() {
+  skipSpace();
+  if (*_p == '(') {
+    _p++;
+    if (!parseExpr())
+      return false;
+    skipSpace();
+    if (*_p != ')')
+      return fail("missing )");
+    _p++;
+    return true;
+  }
+
+  if ((*_p >= '0' && *_p <= '9') || *_p == '.') {
+    char *end;
+    float v = strtof(_p, &end);
+    if (end == _p)
+      return fail("bad number");
+    _p = end;
+    int k = 0;
+    while (k < _constCount && _const[k] != v)
+      k++;
+    if (k == _constCount) {
+      if (_constCount >= MAX_CONSTS)
+        return fail("too many constants");
+      _const[_constCount++] = v;
+    }
+    return emitArg(OP_CONST, k, 1);
+  }
+
+  const char *name = _p;
+  while (isIdentChar(*_p))
+    _p++;
+  int len = _p - name;
+  if (len == 0)
+    return fail("expected a value");
+
+  skipSpace();
+  if (*_p == '(') {
+    _p++;
+    return parseCall(name, len);
+  }
+  if (len == 4 && strncmp(name, "time", 4) == 0)
+    return emit(OP_TIME, 1);
+  for (int i = 0; i < IN_COUNT; i++)
+    if ((int)strlen(INPUT_NAMES[i]) == len &&
+        strncmp(name, INPUT_NAMES[i], len) == 0)
+      return emitArg(OP_INPUT, i, 1);
+  for (int i = 0; i < _count; i++)
+    if ((int)strlen(_ch[i].name) == len &&
+        strncmp(name, _ch[i].name, len) == 0)
+      return emitArg(OP_CHAN, i, 1);
+  return fail("unknown name");
+}
+
+// Window length: a whole number of samples, 1..max
+bool MathChannels::parseWindowCount(int &n, int max) {
+  skipSpace();
+  char *end;
+  long v = strtol(_p, &end, 10);
+  if (end == _p || v < 1 || v > max)
+    return fail("bad window length");
+  _p = end;
+  n = (int)v;
+  return true;
+}
+
+bool MathChannels::parseCall(const char *name, int len) {
+  struct Func {
+    const char *name;
+    uint8_t op;
+    int args;
+  };
+  static const Func FUNCS[] = {{"abs", OP_ABS, 1},   {"sqrt", OP_SQRT, 1},
+                               {"min", OP_MIN, 2},   {"max", OP_MAX, 2},
+                               {"avg", OP_AVG, 2},   {"deriv", OP_DERIV, 2}};
+  const Func *f = nullptr;
+  for (const Func &k : FUNCS)
+    if ((int)strlen(k.name) == len && strncmp(name, k.name, len) == 0)
+      f = &k;
+  if (!f)
+    return fail("unknown function");
+
+  if (!parseExpr())
+    return false;
+  bool windowed = (f->op == OP_AVG || f->op == OP_DERIV);
+  int n = 0;
+  if (f->args == 2) {
+    skipSpace();
+    if (*_p != ',')
+      return fail("expected ,");
+    _p++;
+    int max = (f->op == OP_DERIV) ? WINDOW - 1 : WINDOW;
+    if (windowed ? !parseWindowCount(n, max) : !parseExpr())
+      return false;
+  }
+  skipSpace();
+  if (*_p != ')')
+    return fail("missing )");
+  _p++;
+
+  if (!windowed)
+    return emit(f->op, 1 - f->args);
+
+  if (_winCount >= MAX_WINDOWS)
+    return fail("too many avg/deriv");
+  Window &w = _win[_winCount];
+  // deriv(x, n) compares with the sample n back, so it keeps n + 1
+  w.n = (f->op == OP_DERIV) ? n + 1 : n;
+  w.sum = 0;
+  w.head = 0;
+  w.count = 0;
+  return emitArg(f->op, _winCount++, 0);
+}
+
+void MathChannels::evaluate(uint32_t timeMs, const float *in) {
+  if (!_started) {
+    _t0 = timeMs;
+    _started = true;
+  }
+  _now = timeMs;
+  for (int i = 0; i < _count; i++) {
+    float v = run(_ch[i], in);
+    _value[i] = isfinite(v) ? v : 0.0f;
+  }
+}
+
+float MathChannels::run(const Channel &c, const float *in) {
+  float st[MAX_STACK];
+  int sp = 0;
+  const uint8_t *pc = c.code;
+  const uint8_t *end = c.code + c.len;
+  while (pc < end) {
+    switch (*pc++) {
+    case OP_CONST:
+      st[sp++] = _const[*pc++];
+      break;
+    case OP_INPUT:
+      st[sp++] = in[*pc++];
+      break;
+    case OP_CHAN:
+      st[sp++] = _value[*pc++];
+      break;
+    case OP_TIME:
+      st[sp++] = (_now - _t0) / 1000.0f;
+      break;
+    case OP_ADD:
+      sp--;
+      st[sp - 1] += st[sp];
+      break;
+    case OP_SUB:
+      sp--;
+      st[sp - 1] -= st[sp];
+      break;
+    case OP_MUL:
+      sp--;
+      st[sp - 1] *= st[sp];
+      break;
+    case OP_DIV:
+      sp--;
+      st[sp - 1] = (st[sp] != 0) ? st[sp - 1] / st[sp] : 0.0f;
+      break;
+    case OP_NEG:
+      st[sp - 1] = -st[sp - 1];
+      break;
+    case OP_ABS:
+      st[sp - 1] = fabsf(st[sp - 1]);
+      break;
+    case OP_SQRT:
+      st[sp - 1] = (st[sp - 1] > 0) ? sqrtf(st[sp - 1]) : 0.0f;
+      break;
+    case OP_MIN:
+      sp--;
+      if (st[sp] < st[sp - 1])
+        st[sp - 1] = st[sp];
+      break;
+    case OP_MAX:
+      sp--;
+      if (st[sp] > st[sp - 1])
+        st[sp - 1] = st[sp];
+      break;
+    case OP_AVG:
+      st[sp - 1] = windowAvg(_win[*pc++], st[sp - 1]);
+      break;
+    case OP_DERIV:
+      st[sp - 1] = windowDeriv(_win[*pc++], st[sp - 1]);
+      break;
+    }
+  }
+  return (sp > 0) ? st[sp - 1] : 0.0f;
+}
+
+// Running sum, rebuilt once per pass over the ring so float rounding
+// can't accumulate over an hour-long log
+float MathChannels::windowAvg(Window &w, float x) {
+  if (!isfinite(x))
+    x = 0;
+  if (w.count == w.n)
+    w.sum -= w.v[w.head];
+  else
+    w.count++;
+  w.v[w.head] = x;
+  w.sum += x;
+  w.head = (w.head + 1 == w.n) ? 0 : w.head + 1;
+  if (w.head == 0) {
+    w.sum = 0;
+    for (int i = 0; i < w.count; i++)
+      w.sum += w.v[i];
+  }
+  return w.sum / w.count;
+}
+
+// Slope between this sample and the oldest one kept (n back once full)
+float MathChannels::windowDeriv(Window &w, float x) {
+  if (!isfinite(x))
+    x = 0;
+  w.v[w.head] = x;
+  w.t[w.head] = _now;
+  w.head = (w.head + 1 == w.n) ? 0 : w.head + 1;
+  if (w.count < w.n)
+    w.count++;
+  int oldest = (w.count == w.n) ? w.head : 0;
+  uint32_t dt = _now - w.t[oldest];
+  return (dt > 0) ? (x - w.v[oldest]) * 1000.0f / dt : 0.0f;
+}
@@ -0,0 +1,122 @@
+#ifndef MATH_CHANNELS_H
+#define MATH_CHANNELS_H
+
+#include <stdint.h>
+
+// User-defined channels, one "name = expression" per line:
+//   ratio = rpm / speed
+//   accel = deriv(speed, 3) / 3.6     # m/s^2 over 3 samples
+//   vavg  = avg(speed, 10)
+// Each expression is compiled once to bytecode for a small stack VM and
+// evaluated per sample. Operands are numbers, the inputs below, `time`
+// (s since reset) and channels defined on earlier lines; operators
+// + - * / and unary -, functions abs sqrt min max, and the windowed
+// avg(x, n) and deriv(x, n) (per second, n samples back) over fixed ring
+// buffers of up to WINDOW samples. Everything is sized at compile time:
+// evaluate() never allocates.
+class MathChannels {
+public:
+  enum Input {
+    IN_SPEED,   // km/h
+    IN_ALT,     // m
+    IN_HEADING, // deg
+    IN_LONG,    // g, + = accelerating
+    IN_LATG,    // g, + = to the right
+    IN_RPM,
+    IN_GEAR,    // 0 = neutral/unknown
+    IN_COUNT
+  };
+
+  void clear();
+  // "name = expression"; blank lines and # comments are accepted and
+  // ignored. False with getError() set when the line is rejected.
+  bool addLine(const char *line);
+  bool add(const char *name, const char *expr);
+  const char *getError() const { return _error; }
+
+  int getCount() const { return _count; }
+  const char *getName(int i) const { return _ch[i].name; }
+
+  // Empties the windows; `time` counts from the next sample
+  void reset();
+  // One sample: inputs indexed by Input. Non-finite results read 0.
+  void evaluate(uint32_t timeMs, const float *in);
+  float getValue(int i) const { return _value[i]; }
+
+  static const int MAX_CHANNELS = 8;
+  static const int NAME_LEN = 12;
+  static const int MAX_CODE = 48;   // Bytes per channel
+  static const int MAX_CONSTS = 32; // Shared by all channels
+  static const int MAX_STACK = 12;
+  static const int MAX_WINDOWS = 8; // avg/deriv calls, all channels
+  static const int WINDOW = 32;     // Longest n
+
+private:
+  enum Op : uint8_t {
+    OP_CONST, // + constant index
+    OP_INPUT, // + Input
+    OP_CHAN,  // + channel index
+    OP_TIME,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_NEG,
+    OP_ABS,
+    OP_SQRT,
+    OP_MIN,
+    OP_MAX,
+    OP_AVG,   // + window index
+    OP_DERIV  // + window index
+  };
+
+  struct Channel {
+    char name[NAME_LEN];
+    uint8_t code[MAX_CODE];
+    uint8_t len;
+  };
+
+  struct Window {
+    float v[WINDOW];
+    uint32_t t[WINDOW];
+    float sum;     // Of the last n values (avg)
+    uint8_t n;
+    uint8_t head;  // Next slot
+    uint8_t count; // Filled, up to n
+  };
+
+  Channel _ch[MAX_CHANNELS];
+  float _value[MAX_CHANNELS];
+  int _count = 0;
+  float _const[MAX_CONSTS];
+  int _constCount = 0;
+  Window _win[MAX_WINDOWS];
+  int _winCount = 0;
+  uint32_t _t0 = 0;
+  uint32_t _now = 0;
+  bool _started = false;
+  char _error[48] = "";
+
+  // Compiler state for the channel being added
+  const char *_p = nullptr;
+  Channel *_out = nullptr;
+  int _depth = 0;
+
+  bool fail(const char *msg);
+  void skipSpace();
+  bool emit(uint8_t op, int depthChange);
+  bool emitArg(uint8_t op, int arg, int depthChange);
+  bool parseExpr();
+  bool parseTerm();
+  bool parseUnary();
+  bool parsePrimary();
+  bool parseCall(const char *name, int len);
+  bool parseWindowCount(int &n, int max);
+  static bool isIdentChar(char c);
+
+  float run(const Channel &c, const float *in);
+  float windowAvg(Window &w, float x);
+  float windowDeriv(Window &w, float x);
+};
+
+#endif
@@ -0,0 +1,228 @@
+#include "MiniSectorEngine.h"
+#include <algorithm>
+#include <math.h>
+
+void MiniSectorEngine::begin(int count, float lapLengthM) {
+  _count = std::max(1, std::min(count, (int)MAX_COUNT));
+  _givenLength = lapLengthM;
+  reset();
+}
+
+void MiniSectorEngine::reset() {
+  _lapLength = _givenLength;
+  _sliceLen = (_lapLength > 0) ? _lapLength / _count : 0;
+
+  _hasPrev = false;
+  _prevTrackD = NAN;
+  _lapRunning = false;
+  _lapDist = 0;
+  _nextSlice = 0;
+  _trace.clear();
+  _traceStep = 1.0f;
+
+  _cur.assign(_count, 0);
+  _best.assign(_count, 0);
+  _last.assign(_count, 0);
+  _bestLapSlices.assign(_count, 0);
+  _bestLapTime = 0;
+  _optimal = 0;
+  _bestComplete = false;
+}
+
+void MiniSectorEngine::addFix(uint32_t timeMs, const GeoPoint &pos,
+                              uint32_t lapCrossAt) {
+  addTrackFix(timeMs, pos, NAN, lapCrossAt);
+}
+
+void MiniSectorEngine::addTrackFix(uint32_t timeMs, const GeoPoint &pos,
+                                   float trackDistM, uint32_t lapCrossAt) {
+  if (!_hasPrev) {
+    _frame.setOrigin(pos);
+    _prevPos = pos;
+    _prevT = timeMs;
+    _prevTrackD = trackDistM;
+    _hasPrev = true;
+    return;
+  }
+
+  float ds = _frame.distanceM(_prevPos, pos);
+  if (!isnan(trackDistM) && !isnan(_prevTrackD) && _givenLength > 0) {
+    // Along the centreline, which wraps at its start on a closed track
+    float dd = trackDistM - _prevTrackD;
+    if (dd < -_givenLength / 2)
+      dd += _givenLength;
+    else if (dd > _givenLength / 2)
+      dd -= _givenLength;
+    ds = (dd > 0) ? dd : 0;
+  }
+  _prevTrackD = trackDistM;
+
+  if (lapCrossAt > 0 && lapCrossAt >= _prevT && timeMs > _prevT) {
+    // Split the step at the finish line
+    float dc = ds * (lapCrossAt - _prevT) / (float)(timeMs - _prevT);
+    if (_lapRunning) {
+      advance(_lapDist, _prevT, _lapDist + dc, lapCrossAt);
+      _lapDist += dc;
+      finishLap(lapCrossAt);
+    }
+    startLap(lapCrossAt);
+    advance(0, lapCrossAt, ds - dc, timeMs);
+    _lapDist = ds - dc;
+  } else if (_lapRunning) {
+    advance(_lapDist, _prevT, _lapDist + ds, timeMs);
+    _lapDist += ds;
+  }
+
+  _prevPos = pos;
+  _prevT = timeMs;
+}
+
+// Close every slice boundary passed between d0 and d1
+void MiniSectorEngine::advance(float d0, uint32_t t0, float d1, uint32_t t1) {
+  if (!hasReference()) {
+    // Lap one: keep a thinned-out trace, slices are cut at the finish
+    if (d1 - _trace.back().d < _traceStep)
+      return;
+    _trace.push_back({d1, t1});
+    if ((int)_trace.size() >= MAX_TRACE) {
+      size_t out = 0;
+      for (size_t i = 0; i < _trace.size(); i += 2)
+        _trace[out++] = _trace[i];
+      _trace.resize(out);
+      _traceStep *= 2;
+    }
+    return;
+  }
+
+  // The last slice always ends at the finish line
+  while (_nextSlice < _count - 1 && d1 > d0) {
+    float b = (_nextSlice + 1) * _sliceLen;
+    if (d1 < b)
+      break;
+    uint32_t tb = t0 + (uint32_t)((b - d0) / (d1 - d0) * (t1 - t0) + 0.5f);
+    _cur[_nextSlice++] = tb - _sliceStart;
+    _sliceStart = tb;
+  }
+}
+
+void MiniSectorEngine::startLap(uint32_t at) {
+  _lapRunning = true;
+  _lapStart = at;
+  _lapDist = 0;
+  _nextSlice = 0;
+  _sliceStart = at;
+  std::fill(_cur.begin(), _cur.end(), 0);
+
+  if (!hasReference()) {
+    _trace.clear();
+    _traceStep = 1.0f;
+    _trace.push_back({0, at});
+  }
+}
+
+void MiniSectorEngine::finishLap(uint32_t at) {
+  uint32_t lapTime = at - _lapStart;
+
+  if (!hasReference()) {
+    if (_lapDist < 1.0f)
+      return;
+    _lapLength = _lapDist;
+    _sliceLen = _lapLength / _count;
+    _trace.push_back({_lapDist, at});
+    slicesFromTrace(at);
+    _trace.clear();
+    _trace.shrink_to_fit();
+    storeLap(lapTime, _count);
+    return;
+  }
+
+  // Laps differ slightly in length: slices not reached share the rest
+  // (an estimate, shown but never a best), a longer lap ends up in the
+  // last slice
+  int measured = (_nextSlice == _count - 1) ? _count : _nextSlice;
+  int remaining = _count - _nextSlice;
+  uint32_t rest = at - _sliceStart;
+  for (int i = _nextSlice; i < _count; i++)
+    _cur[i] = rest / remaining;
+  _cur[_count - 1] += rest % remaining;
+
+  if (fabsf(_lapDist - _lapLength) > _lapLength * MAX_LENGTH_DEV) {
+    std::fill(_last.begin(), _last.end(), 0); // Cut or pit lap
+    return;
+  }
+  storeLap(lapTime, measured);
+}
+
+void MiniSectorEngine::slicesFromTrace(uint32_t at) {
+  size_t j = 1;
+  uint32_t sliceStart = _trace[0].t;
+  for (int i = 0; i < _count - 1; i++) {
+    float b = (i + 1) * _sliceLen;
+    while (j < _trace.size() - 1 && _trace[j].d < b)
+      j++;
+    const TracePoint &p0 = _trace[j - 1];
+    const TracePoint &p1 = _trace[j];
+    float span = p1.d - p0.d;
+    float f = (span > 0) ? (b - p0.d) / span : 0;
+    uint32_t tb = p0.t + (uint32_t)(f * (p1.t - p0.t) + 0.5f);
+    _cur[i] = tb - sliceStart;
+    sliceStart = tb;
+  }
+  _cur[_count - 1] = at - sliceStart;
+}
+
+// Slices from `measured` on are estimates: kept for the lap, not as bests
+void MiniSectorEngine::storeLap(uint32_t lapTime, int measured) {
+  _last = _cur;
+  for (int i = 0; i < measured; i++) {
+    if (_best[i] == 0 || _cur[i] < _best[i]) {
+      _optimal += _cur[i] - _best[i];
+      _best[i] = _cur[i];
+    }
+  }
+  _bestComplete = std::find(_best.begin(), _best.end(), 0u) == _best.end();
+
+  if (_bestLapTime == 0 || lapTime < _bestLapTime) {
+    _bestLapTime = lapTime;
+    _bestLapSlices = _cur;
+  }
+}
+
+int32_t MiniSectorEngine::getLastLoss(int i) const {
+  if (_last[i] == 0 || _best[i] == 0)
+    return 0;
+  return (int32_t)(_last[i] - _best[i]);
+}
+
+std::vector<MiniSectorEngine::LossZone>
+MiniSectorEngine::getBestLapLosses(int maxZones) const {
+  std::vector<LossZone> zones;
+  if (_bestLapTime == 0)
+    return zones;
+
+  bool open = false;
+  for (int i = 0; i < _count; i++) {
+    // An estimated slice can undercut the best: no loss there
+    uint32_t loss = (_best[i] > 0 && _bestLapSlices[i] > _best[i])
+                        ? _bestLapSlices[i] - _best[i]
+                        : 0;
+    if (loss >= (uint32_t)LOSS_MIN_MS) {
+      if (!open) {
+        zones.push_back({i * _sliceLen, 0, 0});
+        open = true;
+      }
+      zones.back().endM = (i + 1) * _sliceLen;
+      zones.back().lossMs += loss;
+    } else {
+      open = false;
+    }
+  }
+
+  std::sort(zones.begin(), zones.end(),
+            [](const LossZone &a, const LossZone &b) {
+              return a.lossMs > b.lossMs;
+            });
+  if ((int)zones.size() > maxZones)
+    zones.resize(maxZones);
+  return zones;
+}
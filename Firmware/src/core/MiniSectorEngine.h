@@ -0,0 +1,97 @@
+#ifndef MINI_SECTOR_ENGINE_H
+#define MINI_SECTOR_ENGINE_H
+
+#include "GeoTypes.h"
+#include <stdint.h>
+#include <vector>
+
+// Equal-distance mini-sectors and optimal lap.
+// The lap is cut into N slices of the reference lap length (first full lap
+// unless given). Slice times are taken as the driven distance passes each
+// boundary, best slices are kept across laps and their sum is the optimal
+// lap. O(1) per fix, so the same code runs live and over a log.
+class MiniSectorEngine {
+public:
+  struct LossZone {
+    float startM; // Distance into the lap
+    float endM;
+    uint32_t lossMs; // vs. the best slices
+  };
+
+  void begin(int count = DEFAULT_COUNT, float lapLengthM = 0);
+  void reset();
+
+  // One GPS fix. `lapCrossAt` is the interpolated finish crossing when this
+  // fix completed a lap (from LapTimingEngine), 0 otherwise.
+  void addFix(uint32_t timeMs, const GeoPoint &pos, uint32_t lapCrossAt = 0);
+  // The same, stepping along a centreline of the track (MapMatcher
+  // distance of the fix) instead of the driven path, so weaving and GPS
+  // wander don't move the slices: begin() with the centreline's length.
+  // NAN (no match) steps by the driven distance.
+  void addTrackFix(uint32_t timeMs, const GeoPoint &pos, float trackDistM,
+                   uint32_t lapCrossAt = 0);
+
+  int getCount() const { return _count; }
+  float getLapLength() const { return _lapLength; }
+  bool hasReference() const { return _lapLength > 0; }
+
+  uint32_t getOptimalLap() const { return _bestComplete ? _optimal : 0; }
+  uint32_t getBestSlice(int i) const { return _best[i]; }
+  // Slices of the last completed lap (0 = not valid)
+  uint32_t getLastSlice(int i) const { return _last[i]; }
+  // Loss of the last lap against the best slices so far
+  int32_t getLastLoss(int i) const;
+
+  // Biggest loss zones (merged neighbouring slices) of the fastest lap
+  std::vector<LossZone> getBestLapLosses(int maxZones = 3) const;
+
+  static const int DEFAULT_COUNT = 100;
+  static const int MAX_COUNT = 200;
+  static const int MAX_TRACE = 512;   // (distance, time) pairs of lap one
+  static const int LOSS_MIN_MS = 20;  // Slices below this join no zone
+  static constexpr float MAX_LENGTH_DEV = 0.1f; // Cut/pit laps are skipped
+
+private:
+  struct TracePoint {
+    float d;
+    uint32_t t;
+  };
+
+  int _count = DEFAULT_COUNT;
+  float _givenLength = 0;
+  float _lapLength = 0;
+  float _sliceLen = 0;
+
+  LocalFrame _frame;
+  bool _hasPrev = false;
+  GeoPoint _prevPos = {0, 0};
+  uint32_t _prevT = 0;
+  float _prevTrackD = 0; // NAN when the last fix had no match
+
+  // Current lap
+  bool _lapRunning = false;
+  float _lapDist = 0;
+  uint32_t _lapStart = 0;
+  int _nextSlice = 0;     // Next boundary to pass
+  uint32_t _sliceStart = 0;
+  std::vector<uint32_t> _cur;
+
+  // First lap, before the length is known (decimated when full)
+  std::vector<TracePoint> _trace;
+  float _traceStep = 1.0f;
+
+  std::vector<uint32_t> _best;
+  std::vector<uint32_t> _last;
+  std::vector<uint32_t> _bestLapSlices;
+  uint32_t _bestLapTime = 0;
+  uint32_t _optimal = 0;
+  bool _bestComplete = false;
+
+  void advance(float d0, uint32_t t0, float d1, uint32_t t1);
+  void startLap(uint32_t at);
+  void finishLap(uint32_t at);
+  void slicesFromTrace(uint32_t at);
+  void storeLap(uint32_t lapTime, int measured);
+};
+
+#endif
@@ -0,0 +1,212 @@
+#include "QuotaManager.h"
+#include "SessionManager.h"
+#include <Preferences.h>
+#include <SD.h>
+#include <vector>
+
+extern SessionManager sessionManager;
+
+void QuotaManager::begin() {
+  Preferences prefs;
+  prefs.begin("laptimer", true);
+  int idx = prefs.getInt("quota_hours", 2); // Default 2 hours
+  _logRateBps = prefs.getUInt("log_bps", _logRateBps);
+  prefs.end();
+  setHeadroomIndex(idx);
+
+  _lock = xSemaphoreCreateMutex();
+
+  // Low priority, Core 0 (next to the logging task). The first free-space
+  // scan can take seconds on a large FAT32 card, keep it off the UI core.
+  xTaskCreatePinnedToCore(quotaTask, "QuotaTask", 4096, this, 0, &_taskHandle,
+                          0);
+}
+
+void QuotaManager::quotaTask(void *parameter) {
+  QuotaManager *self = (QuotaManager *)parameter;
+
+  xSemaphoreTake(self->_lock, portMAX_DELAY);
+  self->rescan();
+  xSemaphoreGive(self->_lock);
+
+  while (true) {
+    // Every 10 s, or right away when a session start asks for room
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10000));
+
+    xSemaphoreTake(self->_lock, portMAX_DELAY);
+    self->foldPending();
+
+    uint32_t wantKb = self->_rotateKb.exchange(0);
+    if (self->_ready && wantKb > 0)
+      self->rotateSynced((uint64_t)wantKb << 10);
+
+    // Re-measure every 10 minutes while idle to correct drift (cluster slack)
+    if (!sessionManager.isLogging() && millis() - self->_lastRescan > 600000) {
+      self->rescan();
+    }
+
+    if (self->_ready && self->_totalBytes > 0) {
+      uint64_t used = self->_totalBytes - self->_freeBytes;
+      if (used * 100 > self->_totalBytes * HIGH_WATERMARK) {
+        uint64_t target = self->_totalBytes * (100 - LOW_WATERMARK) / 100;
+        self->rotateSynced(target);
+      }
+
+      // Keep headroom while a long session is running
+      if (sessionManager.isLogging()) {
+        uint64_t need = self->requiredBytes(self->_headroomHours);
+        if (self->_freeBytes < need)
+          self->rotateSynced(need);
+      }
+    }
+    xSemaphoreGive(self->_lock);
+  }
+}
+
+void QuotaManager::rescan() {
+  _totalBytes = SD.totalBytes();
+  if (_totalBytes == 0) {
+    _ready = false; // No card
+    return;
+  }
+  _freeBytes = _totalBytes - SD.usedBytes();
+  _pendingWrite = 0;
+  _pendingFreed = 0;
+  _lastRescan = millis();
+  _ready = true;
+  Serial.printf("Quota: %llu MB free of %llu MB\n", _freeBytes >> 20,
+                _totalBytes >> 20);
+}
+
+void QuotaManager::foldPending() {
+  uint32_t written = _pendingWrite.exchange(0);
+  uint32_t freed = _pendingFreed.exchange(0);
+
+  _freeBytes += freed;
+  _freeBytes = (_freeBytes > written) ? _freeBytes - written : 0;
+  if (_freeBytes > _totalBytes)
+    _freeBytes = _totalBytes;
+}
+
+uint64_t QuotaManager::getFreeBytes() {
+  uint64_t free = _freeBytes;
+  uint32_t written = _pendingWrite;
+  uint32_t freed = _pendingFreed;
+  free += freed;
+  return (free > written) ? free - written : 0;
+}
+
+uint64_t QuotaManager::requiredBytes(float hours) {
+  // Plus a fixed reserve for the history index, tracks and FAT growth
+  return (uint64_t)(_logRateBps * hours * 3600.0) + (4ULL << 20);
+}
+
+// Runs on the UI thread as a session starts: no scan and no deletions
+// here, just the tracked free space. Rotation is left to the quota task.
+bool QuotaManager::ensureHeadroom(float hours) {
+  if (!_ready) {
+    Serial.println("Quota: card not measured yet");
+    return false;
+  }
+  uint64_t free = getFreeBytes();
+  uint64_t need = requiredBytes(hours);
+  if (free >= need)
+    return true;
+
+  _rotateKb = (uint32_t)(need >> 10);
+  xTaskNotifyGive(_taskHandle);
+  // Rotation frees the rest while the session runs, if it can
+  uint64_t least = requiredBytes(MIN_START_HOURS);
+  Serial.printf("Quota: need %llu KB, %llu KB free, rotating\n", need >> 10,
+                free >> 10);
+  return free >= least;
+}
+
+bool QuotaManager::rotateSynced(uint64_t targetFree) {
+  if (_freeBytes >= targetFree)
+    return true;
+
+  // A copy: the catalog is rewritten below, and by the UI meanwhile
+  String index = sessionManager.loadHistoryIndex();
+  if (index.length() == 0)
+    return false;
+
+  // Catalog is append-only, so the first synced entries are the oldest
+  std::vector<String> victims;
+  uint64_t reclaim = 0;
+  String current = sessionManager.isLogging()
+                       ? sessionManager.getCurrentFilename()
+                       : String("");
+
+  int start = 0;
+  while (start < (int)index.length() && _freeBytes + reclaim < targetFree) {
+    int end = index.indexOf('\n', start);
+    if (end < 0)
+      end = index.length();
+    String line = index.substring(start, end);
+    start = end + 1;
+    line.trim();
+    // Format: filename,date,laps,best,type,synced
+    int c1 = line.indexOf(',');
+    int c5 = line.lastIndexOf(',');
+    if (c1 <= 0 || c5 <= c1)
+      continue;
+    if (line.substring(c5 + 1) != "1")
+      continue;
+
+    String fName = line.substring(0, c1);
+    if (fName == current || !SD.exists(fName))
+      continue;
+
+    File f = SD.open(fName, FILE_READ);
+    if (f) {
+      reclaim += f.size();
+      f.close();
+    }
+    victims.push_back(fName);
+  }
+
+  for (const String &fName : victims) {
+    Serial.println("Quota: rotating " + fName);
+    sessionManager.deleteSession(fName); // Reports freed bytes back to us
+    _rotatedCount++;
+  }
+  foldPending();
+
+  return _freeBytes >= targetFree;
+}
+
+void QuotaManager::onSessionEnd(uint32_t bytes, unsigned long durationMs) {
+  // Ignore very short sessions, the rate is dominated by the header
+  if (durationMs < 10000)
+    return;
+
+  uint32_t bps = (uint32_t)((uint64_t)bytes * 1000 / durationMs);
+  // Smooth towards the latest session (channel set rarely changes)
+  _logRateBps = (_logRateBps + bps * 3) / 4;
+
+  Preferences prefs;
+  prefs.begin("laptimer", false);
+  prefs.putUInt("log_bps", _logRateBps);
+  prefs.end();
+}
+
+void QuotaManager::setHeadroomIndex(int idx) {
+  switch (idx) {
+  case 0:
+    _headroomHours = 0.5;
+    break;
+  case 1:
+    _headroomHours = 1.0;
+    break;
+  case 3:
+    _headroomHours = 4.0;
+    break;
+  case 4:
+    _headroomHours = 8.0;
+    break;
+  default:
+    _headroomHours = 2.0;
+    break;
+  }
+}
@@ -0,0 +1,71 @@
+#ifndef QUOTA_MANAGER_H
+#define QUOTA_MANAGER_H
+
+#include "../config.h"
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+// Keeps the SD card from filling up.
+// Free space is measured once (FAT free-cluster scan is slow) and then tracked
+// through the session catalog: bytes written by the logger are subtracted,
+// deleted sessions are added back. When usage crosses the high watermark the
+// oldest sessions that are already synced to the cloud are rotated out.
+class QuotaManager {
+public:
+  void begin();
+
+  // Room for the next `hours` of logging at the measured log rate, from
+  // the tracked free space (fast, no card access). When short, the quota
+  // task rotates synced sessions; true while MIN_START_HOURS still fit.
+  // False until the first scan is done.
+  bool ensureHeadroom(float hours);
+  bool ensureHeadroom() { return ensureHeadroom(_headroomHours); }
+
+  // Accounting hooks (called by SessionManager)
+  void onBytesWritten(size_t bytes) { _pendingWrite += bytes; }
+  void onBytesFreed(size_t bytes) { _pendingFreed += bytes; }
+  void onSessionEnd(uint32_t bytes, unsigned long durationMs);
+
+  // Configuration
+  void setHeadroomIndex(int idx); // 0=30min, 1=1h, 2=2h, 3=4h, 4=8h
+  float getHeadroomHours() { return _headroomHours; }
+
+  // Status
+  bool isReady() { return _ready; }
+  uint64_t getFreeBytes();
+  uint64_t getTotalBytes() { return _totalBytes; }
+  uint32_t getLogRateBps() { return _logRateBps; }
+  int getRotatedCount() { return _rotatedCount; }
+
+private:
+  // Usage thresholds (percent of card)
+  static const int HIGH_WATERMARK = 90; // Start rotating above this
+  static const int LOW_WATERMARK = 80;  // Rotate down to this
+  static constexpr float MIN_START_HOURS = 0.25f; // Enough to start on
+
+  float _headroomHours = 2.0;
+  uint32_t _logRateBps = 700; // ~10 rows/s x 70 B until measured
+  uint64_t _totalBytes = 0;
+  uint64_t _freeBytes = 0;
+  // Added to from the logging, UI and quota tasks
+  std::atomic<uint32_t> _pendingWrite{0};
+  std::atomic<uint32_t> _pendingFreed{0};
+  std::atomic<uint32_t> _rotateKb{0}; // Free space asked for by a start
+  bool _ready = false;
+  int _rotatedCount = 0;
+  unsigned long _lastRescan = 0;
+
+  SemaphoreHandle_t _lock;
+  TaskHandle_t _taskHandle;
+  static void quotaTask(void *parameter);
+
+  void rescan();
+  void foldPending();
+  uint64_t requiredBytes(float hours);
+  bool rotateSynced(uint64_t targetFree);
+};
+
+#endif
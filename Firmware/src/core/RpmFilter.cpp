@@ -0,0 +1,87 @@
+#include "RpmFilter.h"
+
+void RpmFilter::reset() {
+  _periodCount = 0;
+  _periodHead = 0;
+  _pendingUs = 0;
+  _medianUs = 0;
+  _lastEdgeUs = 0;
+  _rpm = 0;
+  _seq = 0;
+}
+
+void RpmFilter::setPulsesPerRev(float ppr) {
+  _ppr = (ppr > 0.1f) ? ppr : 1.0f;
+  _minPeriodUs = (uint32_t)(60000000.0f / (MAX_RPM * _ppr));
+}
+
+void RpmFilter::addPeriod(uint32_t edgeUs, float periodUs) {
+  _lastEdgeUs = edgeUs;
+  if (periodUs < _minPeriodUs || periodUs > TIMEOUT_US) {
+    // First edge after a stop, or one the capture let through
+    _periodCount = 0;
+    _periodHead = 0;
+    _pendingUs = 0;
+    _medianUs = 0;
+    return;
+  }
+
+  // A stray edge splits one period in two: hold the short part and add
+  // it to the next, the engine can't speed up that much in one pulse
+  periodUs += _pendingUs;
+  _pendingUs = 0;
+  if (_medianUs > 0 && periodUs < SPLIT_FRACTION * _medianUs) {
+    _pendingUs = periodUs;
+    return;
+  }
+
+  _periods[_periodHead] = periodUs;
+  _periodHead = (_periodHead + 1) % MEDIAN;
+  if (_periodCount < MEDIAN)
+    _periodCount++;
+  if (_periodCount < MEDIAN)
+    return;
+
+  // Median by insertion sort: MEDIAN is tiny
+  float p[MEDIAN];
+  for (int i = 0; i < MEDIAN; i++) {
+    float v = _periods[i];
+    int j = i;
+    for (; j > 0 && p[j - 1] > v; j--)
+      p[j] = p[j - 1];
+    p[j] = v;
+  }
+  // Random edges (engine off, noise) have no steady period
+  bool steady = p[MEDIAN - 2] < MAX_SPREAD * p[1];
+  _medianUs = steady ? p[MEDIAN / 2] : 0;
+}
+
+int RpmFilter::sample(uint32_t nowUs, uint32_t nowMs) {
+  float rpm = 0;
+  uint32_t since = nowUs - _lastEdgeUs;
+  // A full, steady window first: stray edges with the engine off read
+  // nothing
+  if (_medianUs > 0 && since < TIMEOUT_US) {
+    float period = _medianUs;
+    // Edges stopped (more than one missed pulse): it can't be turning
+    // faster than one period per `since`
+    if (since > STALL_PERIODS * period)
+      period = (float)since;
+    rpm = 60000000.0f / (period * _ppr);
+  }
+  _rpm = (int)(rpm + 0.5f);
+
+  Sample &s = _samples[_seq % SAMPLES];
+  s.timeMs = nowMs;
+  s.rpm = (uint16_t)_rpm;
+  _seq = _seq + 1;
+  return _rpm;
+}
+
+bool RpmFilter::getSample(uint32_t seq, Sample &out) const {
+  if (seq >= _seq || _seq - seq >= SAMPLES)
+    return false;
+  out = _samples[seq % SAMPLES];
+  // Overwritten while copying
+  return _seq - seq < SAMPLES;
+}
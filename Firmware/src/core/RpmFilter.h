@@ -0,0 +1,64 @@
+#ifndef RPM_FILTER_H
+#define RPM_FILTER_H
+
+#include <stdint.h>
+
+// Engine speed from timestamped ignition pulse periods (hardware capture
+// upstream). RPM is the median of the last MEDIAN periods, so a missed
+// pulse never shows; a stray edge that splits a period is merged back.
+// Once edges stop the RPM is capped by the time since the last one, so
+// a dying engine reads falling instead of holding its last value. sample() is called at a fixed
+// rate and keeps a ring of timestamped samples that readers walk by
+// sequence number, independent of the UI loop. addPeriod() is O(MEDIAN),
+// sample() O(1).
+class RpmFilter {
+public:
+  struct Sample {
+    uint32_t timeMs; // millis() when taken
+    uint16_t rpm;
+  };
+
+  void reset();
+  void setPulsesPerRev(float ppr);
+  float getPulsesPerRev() const { return _ppr; }
+  // Debounce: the period of MAX_RPM at this PPR. Shorter edges must be
+  // dropped by the capture without moving its reference edge.
+  uint32_t getMinPeriodUs() const { return _minPeriodUs; }
+
+  // One edge-to-edge period, ending at edgeUs (both us)
+  void addPeriod(uint32_t edgeUs, float periodUs);
+
+  // RPM now; appended to the sample ring
+  int sample(uint32_t nowUs, uint32_t nowMs);
+  int getRpm() const { return _rpm; }
+
+  // Samples written since reset(); getSample() is false for one not
+  // written yet or already overwritten
+  uint32_t getSampleSeq() const { return _seq; }
+  bool getSample(uint32_t seq, Sample &out) const;
+
+  static const int MEDIAN = 5;
+  static const int SAMPLES = 256; // 2.5 s at 100 Hz
+  static constexpr float MAX_RPM = 20000.0f;
+  static const uint32_t TIMEOUT_US = 500000; // No pulse: engine off
+  static constexpr float SPLIT_FRACTION = 0.6f; // Of the median
+  static constexpr float STALL_PERIODS = 2.5f;
+  static constexpr float MAX_SPREAD = 1.5f; // 2nd longest / 2nd shortest
+
+private:
+  float _ppr = 1.0f;
+  uint32_t _minPeriodUs = 3000;
+
+  float _periods[MEDIAN];
+  int _periodCount = 0;
+  int _periodHead = 0;
+  float _pendingUs = 0; // Short part of a split period
+  float _medianUs = 0;  // 0 until the window is full
+  uint32_t _lastEdgeUs = 0;
+
+  volatile int _rpm = 0;
+  Sample _samples[SAMPLES];
+  volatile uint32_t _seq = 0;
+};
+
+#endif
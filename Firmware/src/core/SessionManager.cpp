@@ -1,10 +1,21 @@
 #include "SessionManager.h"
+#include "AnalogManager.h"
+#include "GPSManager.h"
+#include "QuotaManager.h"
 #include <SPI.h>
 
+extern QuotaManager quotaManager;
+extern GPSManager gpsManager;
+extern AnalogManager analogManager;
+
 // Queue item structure (implicitly just char* for now)
 
 void SessionManager::begin() {
   _logging = false;
+  _sessionBytes = 0;
+  _sessionStart = 0;
+  _catalogLock = xSemaphoreCreateMutex();
+  channels.setSink([this](const char *line) { logData(line); });
 
   Serial.printf("SD Init: SCK=%d, MISO=%d, MOSI=%d, CS=%d\n", PIN_SD_SCLK,
                 PIN_SD_MISO, PIN_SD_MOSI, PIN_SD_CS);
@@ -24,6 +35,7 @@ void SessionManager::begin() {
     if (!SD.exists("/sessions")) {
       SD.mkdir("/sessions");
     }
+    loadMathChannels();
   }
 
   // Initialize Logging Queue (Holds 50 pointers)
@@ -38,15 +50,52 @@ bool SessionManager::startSession() {
   if (_logging)
     return true;
 
+  // Refuse to start if the card can't hold the configured headroom
+  if (!quotaManager.ensureHeadroom()) {
+    Serial.println("Not enough SD space for a new session");
+    return false;
+  }
+
   String filename = createFilename();
   _logFile = SD.open(filename, FILE_WRITE);
 
   if (_logFile) {
     _logging = true;
     _currentFilename = filename;
+    _sessionBytes = 0;
+    _sessionStart = millis();
     // _logFile.println("Time,Lat,Lon,Speed,Sats,Alt,Heading"); // Header - Send
     // via Queue instead
-    logData("Time,Lat,Lon,Speed,Sats,Alt,Heading");
+    logData("Time,Lat,Lon,Speed,Sats,Alt,Heading,LonG,LatG,Gear");
+    // Analog sensors as block channels ("battery" is a builtin)
+    channels.clear();
+    const AnalogChannels &analog = analogManager.getChannels();
+    for (int i = 0; i < analog.getCount(); i++) {
+      const AnalogChannels::Config &c = analog.getConfig(i);
+      _analogIds[i] = channels.add(c.name, c.unit, 1000 / c.rateHz, c.decimals);
+      _analogSeq[i] = analog.getSampleSeq(i);
+    }
+    // Math channels after the sensors; a name already taken (or no room
+    // left) leaves that channel out of the log
+    for (int i = 0; i < mathChannels.getCount(); i++) {
+      const char *name = mathChannels.getName(i);
+      _mathIds[i] = -1;
+      if (channels.find(name) < 0)
+        _mathIds[i] = channels.add(name, "", 0, 3);
+      if (_mathIds[i] < 0)
+        Serial.printf("Math channel %s not logged\n", name);
+    }
+    for (int i = 0; i < channels.getCount(); i++) {
+      char def[64];
+      channels.formatDef(i, def, sizeof(def));
+      logData(def);
+    }
+    _rpmSeq = gpsManager.getRpmFilter().getSampleSeq();
+    gpsManager.resetEngineSession();
+    mathChannels.reset();
+    _mathTotalUs = 0;
+    _mathMaxUs = 0;
+    _mathRows = 0;
 
     Serial.println("Started logging to: " + filename);
     return true;
@@ -56,6 +105,8 @@ bool SessionManager::startSession() {
 
 void SessionManager::stopSession() {
   if (_logging) {
+    logChannels(true);
+
     // Wait a bit for queue to flush?
     // We can't strictly wait essentially, but let's give it a moment
     unsigned long startWait = millis();
@@ -73,9 +124,127 @@ void SessionManager::stopSession() {
       _logFile.close();
       Serial.println("Session Stopped");
     }
+
+    // Feed the measured log rate back into the headroom estimate
+    quotaManager.onSessionEnd(_sessionBytes, millis() - _sessionStart);
+
+    if (_mathRows > 0)
+      Serial.printf("Math channels: %lu rows, avg %lu us, max %lu us\n",
+                    _mathRows, _mathTotalUs / _mathRows, _mathMaxUs);
+
+    static EngineStats::Histogram eng; // 1 KB, off the loop stack
+    gpsManager.getEngineHistogram(false, eng);
+    if (eng.runTicks > 0)
+      Serial.printf("Engine: %.2f h, mean %lu rpm, p90 %lu, peak %lu\n",
+                    EngineStats::hours(eng.runTicks),
+                    (unsigned long)EngineStats::meanRpm(eng),
+                    (unsigned long)EngineStats::percentileRpm(eng, 90),
+                    (unsigned long)eng.peakRpm);
   }
 }
 
+// One "name = expression" per line, bad lines reported and skipped.
+// Ends with a quick benchmark of the compiled set.
+bool SessionManager::loadMathChannels() {
+  mathChannels.clear();
+  File f = SD.open("/channels.txt", FILE_READ);
+  if (!f)
+    return false;
+
+  int lineNo = 0;
+  while (f.available()) {
+    String line = f.readStringUntil('\n');
+    lineNo++;
+    if (!mathChannels.addLine(line.c_str()))
+      Serial.printf("channels.txt:%d: %s\n", lineNo,
+                    mathChannels.getError());
+  }
+  f.close();
+  if (mathChannels.getCount() == 0)
+    return false;
+
+  const int RUNS = 1000;
+  float in[MathChannels::IN_COUNT] = {0};
+  unsigned long start = micros();
+  for (int i = 0; i < RUNS; i++) {
+    in[MathChannels::IN_SPEED] = 50.0f + (i % 100);
+    in[MathChannels::IN_RPM] = 3000.0f + 20.0f * (i % 100);
+    mathChannels.evaluate(i * 40, in);
+  }
+  unsigned long us = micros() - start;
+  mathChannels.reset();
+  Serial.printf("Math channels: %d loaded, %.2f us/sample\n",
+                mathChannels.getCount(), (float)us / RUNS);
+  return true;
+}
+
+void SessionManager::logMathChannels(uint32_t timeMs, const float *in) {
+  if (!_logging || mathChannels.getCount() == 0)
+    return;
+  unsigned long start = micros();
+  mathChannels.evaluate(timeMs, in);
+  unsigned long us = micros() - start;
+  _mathTotalUs += us;
+  if (us > _mathMaxUs)
+    _mathMaxUs = us;
+  _mathRows++;
+
+  for (int i = 0; i < mathChannels.getCount(); i++)
+    channels.addSample(_mathIds[i], timeMs, mathChannels.getValue(i));
+}
+
+void SessionManager::logChannels(bool flush) {
+  if (!_logging)
+    return;
+  const RpmFilter &rpm = gpsManager.getRpmFilter();
+  uint32_t seq = rpm.getSampleSeq();
+  if (seq - _rpmSeq > RpmFilter::SAMPLES)
+    _rpmSeq = seq - RpmFilter::SAMPLES; // Fell behind: oldest still held
+  RpmFilter::Sample s;
+  for (; _rpmSeq != seq; _rpmSeq++)
+    if (rpm.getSample(_rpmSeq, s))
+      channels.addSample(ChannelLog::CH_RPM, gpsManager.toFixTime(s.timeMs),
+                         s.rpm);
+
+  const AnalogChannels &analog = analogManager.getChannels();
+  for (int i = 0; i < analog.getCount(); i++) {
+    uint32_t aseq = analog.getSampleSeq(i);
+    if (aseq - _analogSeq[i] > AnalogChannels::SAMPLES)
+      _analogSeq[i] = aseq - AnalogChannels::SAMPLES;
+    AnalogChannels::Sample a;
+    for (; _analogSeq[i] != aseq; _analogSeq[i]++)
+      if (analog.getSample(i, _analogSeq[i], a))
+        channels.addSample(_analogIds[i], gpsManager.toFixTime(a.timeMs),
+                           a.value);
+  }
+  if (flush)
+    channels.flush();
+}
+
+void SessionManager::logSample(int channel, uint32_t timeMs, float value) {
+  if (_logging)
+    channels.addSample(channel, timeMs, value);
+}
+
+bool SessionManager::resampleSession(
+    String filename, const char *names, uint32_t stepMs,
+    std::function<void(uint32_t, const float *)> fn) {
+  ChannelResampler r;
+  if (!r.begin(names, stepMs))
+    return false;
+  File f = SD.open(filename, FILE_READ);
+  if (!f)
+    return false;
+  r.setOutput(fn);
+  bool ok = forEachLine(f, [&](const char *line, size_t) {
+    r.addLine(line);
+    return true;
+  });
+  r.finish();
+  f.close();
+  return ok;
+}
+
 void SessionManager::logData(String dataLine) {
   if (_logging) {
     // Alloc string on heap
@@ -98,7 +267,9 @@ void SessionManager::loggingTask(void *parameter) {
   while (true) {
     if (xQueueReceive(self->_logQueue, &msg, portMAX_DELAY) == pdTRUE) {
       if (self->_logging && self->_logFile) {
-        self->_logFile.println(msg);
+        size_t n = self->_logFile.println(msg);
+        self->_sessionBytes += n;
+        quotaManager.onBytesWritten(n);
         // Optional: Flush every N lines or rely on close()
       }
       free(msg); // Important: Free the memory allocated in logData
@@ -119,62 +290,89 @@ String SessionManager::createFilename() {
 void SessionManager::appendToHistoryIndex(String filename, String date,
                                           int laps, unsigned long bestLap,
                                           String type) {
+  xSemaphoreTake(_catalogLock, portMAX_DELAY);
   File indexFile = SD.open("/history.csv", FILE_APPEND);
   if (!indexFile) {
     indexFile = SD.open("/history.csv", FILE_WRITE);
   }
 
   if (indexFile) {
-    // Format: NamaFile,Tanggal,Lap,LapTerbaik,Tipe
+    // Format: NamaFile,Tanggal,Lap,LapTerbaik,Tipe,Synced
     String line = filename + "," + date + "," + String(laps) + "," +
-                  String(bestLap) + "," + type;
+                  String(bestLap) + "," + type + ",0";
     indexFile.println(line);
     indexFile.close();
     Serial.println("Added to history index: " + line);
   } else {
     Serial.println("Failed to open history index");
   }
+  xSemaphoreGive(_catalogLock);
 }
 
 String SessionManager::loadHistoryIndex() {
-  if (!SD.exists("/history.csv"))
-    return "";
-
-  File indexFile = SD.open("/history.csv", FILE_READ);
-  if (!indexFile)
-    return "";
-
   String content = "";
-  content.reserve(indexFile.size());
-  while (indexFile.available()) {
-    content += (char)indexFile.read();
+  xSemaphoreTake(_catalogLock, portMAX_DELAY);
+  File indexFile;
+  if (SD.exists("/history.csv"))
+    indexFile = SD.open("/history.csv", FILE_READ);
+  if (indexFile) {
+    content.reserve(indexFile.size());
+    while (indexFile.available()) {
+      content += (char)indexFile.read();
+    }
+    indexFile.close();
   }
-  indexFile.close();
+  xSemaphoreGive(_catalogLock);
   return content;
 }
 
 bool SessionManager::deleteSession(String filename) {
   // 1. Remove the actual log file
   if (SD.exists(filename)) {
-    SD.remove(filename);
+    File f = SD.open(filename, FILE_READ);
+    size_t size = f ? f.size() : 0;
+    if (f)
+      f.close();
+    if (SD.remove(filename))
+      quotaManager.onBytesFreed(size);
     Serial.println("Deleted log file: " + filename);
   } else {
     Serial.println("Log file not found: " + filename);
     // Proceed to clean index anyway
   }
 
-  // 2. Rewrite History Index
-  if (!SD.exists("/history.csv"))
-    return false;
+  // Derived sidecars
+  String sidecars[] = {summaryPath(filename), comparePath(filename)};
+  for (const String &path : sidecars) {
+    if (!SD.exists(path))
+      continue;
+    File f = SD.open(path, FILE_READ);
+    size_t size = f ? f.size() : 0;
+    if (f)
+      f.close();
+    if (SD.remove(path))
+      quotaManager.onBytesFreed(size);
+  }
 
+  // 2. Drop it from the history index
+  return editHistoryEntry(filename, [](const String &) { return String(); });
+}
+
+// Rewrite the catalog line of one session through a temp file
+bool SessionManager::editHistoryEntry(
+    const String &filename, std::function<String(const String &)> edit) {
+  xSemaphoreTake(_catalogLock, portMAX_DELAY);
   File inFile = SD.open("/history.csv", FILE_READ);
-  if (!inFile)
+  if (!inFile) {
+    xSemaphoreGive(_catalogLock);
     return false;
+  }
 
   String tempPath = "/history.tmp";
   File outFile = SD.open(tempPath, FILE_WRITE);
   if (!outFile) {
     inFile.close();
+    xSemaphoreGive(_catalogLock);
     return false;
   }
 
@@ -185,16 +383,12 @@ bool SessionManager::deleteSession(String filename) {
     if (line.length() == 0)
       continue;
 
-    // Check if this line contains the filename
-    // Format: /sessions/run_X.csv,Date,...
     int c1 = line.indexOf(',');
-    if (c1 > 0) {
-      String fName = line.substring(0, c1);
-      if (fName == filename) {
-        found = true;
-        Serial.println("Skipping deleted entry in index: " + fName);
-        continue; // Skip this line
-      }
+    if (c1 > 0 && line.substring(0, c1) == filename) {
+      found = true;
+      line = edit(line);
+      if (line.length() == 0)
+        continue;
     }
     outFile.println(line);
   }
@@ -204,8 +398,41 @@ bool SessionManager::deleteSession(String filename) {
 
   SD.remove("/history.csv");
   SD.rename(tempPath, "/history.csv");
+  xSemaphoreGive(_catalogLock);
 
-  return true;
+  return found;
+}
+
+bool SessionManager::markSessionSynced(String filename) {
+  return editHistoryEntry(filename, [](const String &line) {
+    // Old entries have no synced column (5 fields), newer ones end in ,0
+    int commas = 0;
+    for (unsigned int i = 0; i < line.length(); i++)
+      if (line[i] == ',')
+        commas++;
+    String out = (commas >= 5) ? line.substring(0, line.lastIndexOf(','))
+                               : line;
+    return out + ",1";
+  });
+}
+
+bool SessionManager::updateHistoryStats(String filename, int laps,
+                                        unsigned long bestLap) {
+  return editHistoryEntry(filename, [&](const String &line) {
+    // Format: NamaFile,Tanggal,Lap,LapTerbaik,Tipe[,Synced]
+    int c1 = line.indexOf(',');
+    int c2 = line.indexOf(',', c1 + 1);
+    int c3 = line.indexOf(',', c2 + 1);
+    int c4 = line.indexOf(',', c3 + 1);
+    if (c2 < 0 || c3 < 0)
+      return line;
+    int c5 = (c4 > 0) ? line.indexOf(',', c4 + 1) : -1;
+    String type = (c4 > 0) ? line.substring(c4 + 1, (c5 > 0) ? c5 : line.length())
+                           : String("TRACK");
+    // Content changed, the uploaded copy is stale
+    return line.substring(0, c2) + "," + String(laps) + "," +
+           String(bestLap) + "," + type + ",0";
+  });
 }
 
 bool SessionManager::getSDStatus(uint64_t &total, uint64_t &used) {
@@ -316,6 +543,20 @@ SessionManager::runFullTest(void (*progressCallback)(int, String)) {
   return res;
 }
 
+void SessionManager::addGG(SessionAnalysis &a, float lonG, float latG) {
+  const int half = SessionAnalysis::GG_BINS / 2;
+  int i = constrain((int)lroundf(lonG / SessionAnalysis::GG_STEP), -half, half) + half;
+  int j = constrain((int)lroundf(latG / SessionAnalysis::GG_STEP), -half, half) + half;
+  if (a.gg[i][j] < 0xFFFF)
+    a.gg[i][j]++;
+  if (lonG > a.maxAccelG)
+    a.maxAccelG = lonG;
+  if (-lonG > a.maxBrakeG)
+    a.maxBrakeG = -lonG;
+  if (fabsf(latG) > a.maxLatG)
+    a.maxLatG = fabsf(latG);
+}
+
 SessionManager::SessionAnalysis
 SessionManager::analyzeSession(String filename) {
   SessionAnalysis result;
@@ -325,6 +566,29 @@ SessionManager::analyzeSession(String filename) {
   result.avgSpeed = 0;
   result.validLaps = 0;
   result.bestLap = 0;
+  result.optimalLap = 0;
+  memset(result.gg, 0, sizeof(result.gg));
+  result.maxAccelG = 0;
+  result.maxBrakeG = 0;
+  result.maxLatG = 0;
+  result.mathCount = mathChannels.getCount();
+  for (int i = 0; i < result.mathCount; i++) {
+    result.mathMin[i] = 0;
+    result.mathMax[i] = 0;
+    result.mathAvg[i] = 0;
+  }
+  mathChannels.reset();
+  unsigned long mathRows = 0;
+  unsigned long mathUs = 0;
+  memset(result.gearMs, 0, sizeof(result.gearMs));
+  result.gearCount = 0;
+  int prevGear = -1;
+  unsigned long prevGearT = 0;
+  int rpmId = -1; // From the CH lines; D blocks precede their fix row
+  float lastRpm = 0;
+
+  // Lap/sector results from the .sum sidecar when there is one
+  bool haveSummary = loadSessionSummary(filename, result);
 
   File f = SD.open(filename, FILE_READ);
   if (!f)
@@ -332,8 +596,8 @@ SessionManager::analyzeSession(String filename) {
 
   unsigned long firstTime = 0;
   unsigned long lastTime = 0;
-  double prevLat = 0;
-  double prevLon = 0;
+  GeoPoint prev = {0, 0};
+  LocalFrame frame;
   bool firstPoint = true;
 
   while (f.available()) {
@@ -342,7 +606,18 @@ SessionManager::analyzeSession(String filename) {
     if (line.length() == 0)
       continue;
 
-    if (line.startsWith("LAP,")) {
+    if (line.startsWith("CH,")) {
+      int id;
+      ChannelLog::Def def;
+      if (ChannelLog::parseDef(line.c_str(), id, def) &&
+          strcmp(def.name, "rpm") == 0)
+        rpmId = id;
+    } else if (line.startsWith("D,")) {
+      if (rpmId >= 0 && atoi(line.c_str() + 2) == rpmId)
+        lastRpm = line.substring(line.lastIndexOf(',') + 1).toFloat();
+    } else if (line.startsWith("LAP,")) {
+      if (haveSummary)
+        continue;
       // LAP,Count,Time
       int lastComma = line.lastIndexOf(',');
       if (lastComma > 0) {
@@ -353,6 +628,8 @@ SessionManager::analyzeSession(String filename) {
           result.bestLap = t;
       }
     } else if (line.startsWith("SECTOR,")) {
+      if (haveSummary)
+        continue;
       // SECTOR,Lap,Num,Time
       int c1 = line.indexOf(',');
       int c2 = line.indexOf(',', c1 + 1);
@@ -380,38 +657,76 @@ SessionManager::analyzeSession(String filename) {
 
       if (p1 > 0 && p2 > 0 && p3 > 0 && p4 > 0) {
         unsigned long t = line.substring(0, p1).toInt();
-        double lat = line.substring(p1 + 1, p2).toDouble();
-        double lon = line.substring(p2 + 1, p3).toDouble();
+        GeoPoint pos = {0, 0};
+        parseE7(line.c_str() + p1 + 1, pos.latE7);
+        parseE7(line.c_str() + p2 + 1, pos.lonE7);
         float speed = line.substring(p3 + 1, p4).toFloat();
 
         if (firstPoint) {
           firstTime = t;
-          prevLat = lat;
-          prevLon = lon;
+          prev = pos;
+          frame.setOrigin(pos);
           firstPoint = false;
         } else {
-          // Haversine
-          float dLat = (lat - prevLat) * DEG_TO_RAD;
-          float dLon = (lon - prevLon) * DEG_TO_RAD;
-          float a = sin(dLat / 2) * sin(dLat / 2) +
-                    cos(prevLat * DEG_TO_RAD) * cos(lat * DEG_TO_RAD) *
-                        sin(dLon / 2) * sin(dLon / 2);
-          float c = 2 * atan2(sqrt(a), sqrt(1 - a));
-          float dist = 6371000 * c; // meters
+          float dist = frame.distanceM(prev, pos); // meters
           if (dist > 0.5) {
             result.totalDistance += (dist / 1000.0); // Add to km
           }
-          prevLat = lat;
-          prevLon = lon;
+          prev = pos;
         }
         lastTime = t;
         if (speed > result.maxSpeed)
           result.maxSpeed = speed;
+
+        // ...,Sats,Alt,Heading,LonG,LatG,Gear (older logs stop earlier)
+        float v[6] = {0, 0, 0, 0, 0, 0};
+        int nv = 0;
+        const char *s = line.c_str() + p4;
+        while (nv < 6 && *s == ',') {
+          char *end;
+          v[nv++] = strtof(s + 1, &end);
+          s = end;
+        }
+        if (nv >= 5)
+          addGG(result, v[3], v[4]);
+
+        // Time in gear: a row's gear holds until the next row
+        if (prevGear >= 0 && t - prevGearT <= 1000)
+          result.gearMs[prevGear] += t - prevGearT;
+        int gear = (nv == 6) ? (int)v[5] : -1;
+        prevGear = (gear <= GearEngine::MAX_CLUSTERS) ? gear : -1;
+        prevGearT = t;
+        if (gear > result.gearCount && gear <= GearEngine::MAX_CLUSTERS)
+          result.gearCount = gear;
+
+        if (result.mathCount > 0) {
+          // Input order: speed, alt, heading, long, latg, rpm, gear
+          float in[MathChannels::IN_COUNT] = {speed, v[1], v[2], v[3],
+                                              v[4], lastRpm, v[5]};
+          unsigned long start = micros();
+          mathChannels.evaluate(t, in);
+          mathUs += micros() - start;
+          for (int i = 0; i < result.mathCount; i++) {
+            float x = mathChannels.getValue(i);
+            if (mathRows == 0 || x < result.mathMin[i])
+              result.mathMin[i] = x;
+            if (mathRows == 0 || x > result.mathMax[i])
+              result.mathMax[i] = x;
+            result.mathAvg[i] += x; // Sum until the end
+          }
+          mathRows++;
+        }
       }
     }
   }
   f.close();
 
+  if (mathRows > 0) {
+    for (int i = 0; i < result.mathCount; i++)
+      result.mathAvg[i] /= mathRows;
+    Serial.printf("Math channels: %lu rows in %lu us\n", mathRows, mathUs);
+  }
+
   if (lastTime > firstTime) {
     result.totalTime = lastTime - firstTime;
     float hours = result.totalTime / 3600000.0;
@@ -438,7 +753,7 @@ SessionManager::analyzeSession(String filename) {
 
   unsigned long startTime = 0;
   bool started = false;
-  double startLat = 0, startLon = 0;
+  GeoPoint start = {0, 0};
   unsigned long time100 = 0;
 
   while (f.available()) {
@@ -454,15 +769,16 @@ SessionManager::analyzeSession(String filename) {
 
     if (p1 > 0 && p2 > 0 && p3 > 0 && p4 > 0) {
       unsigned long t = line.substring(0, p1).toInt();
-      double lat = line.substring(p1 + 1, p2).toDouble();
-      double lon = line.substring(p2 + 1, p3).toDouble();
+      GeoPoint pos = {0, 0};
+      parseE7(line.c_str() + p1 + 1, pos.latE7);
+      parseE7(line.c_str() + p2 + 1, pos.lonE7);
       float speed = line.substring(p3 + 1, p4).toFloat();
 
       if (!started && speed > 1.0) {
         started = true;
         startTime = t;
-        startLat = lat;
-        startLon = lon;
+        start = pos;
+        frame.setOrigin(pos);
       }
 
       if (started) {
@@ -485,14 +801,8 @@ SessionManager::analyzeSession(String filename) {
         // Distance (Cheap Calc) - Real implementation should accumulate
         // strictly For simplicity, we assume straight line from start if drag?
         // No, accumulate. We'll trust totalDistance Logic or re-calc distance
-        // from start. Let's use Haversine from START point for Drag Distance
-        float dLat = (lat - startLat) * DEG_TO_RAD;
-        float dLon = (lon - startLon) * DEG_TO_RAD;
-        float a = sin(dLat / 2) * sin(dLat / 2) +
-                  cos(startLat * DEG_TO_RAD) * cos(lat * DEG_TO_RAD) *
-                      sin(dLon / 2) * sin(dLon / 2);
-        float c = 2 * atan2(sqrt(a), sqrt(1 - a));
-        float distFromStart = 6371000 * c; // meters
+        // from start. Straight line from START point for Drag Distance
+        float distFromStart = frame.distanceM(start, pos); // meters
 
         if (result.time400m == 0 && distFromStart >= 402.336) { // 1/4 mile
           result.time400m = runTime;
@@ -504,131 +814,960 @@ SessionManager::analyzeSession(String filename) {
   return result;
 }
 
-// --- Predictive Timing ---
-bool SessionManager::loadBestLapAsReference(String filename) {
-  referenceLap.clear();
-  File f = SD.open(filename, FILE_READ);
+// --- Lap Re-timing ---
+
+String SessionManager::summaryPath(const String &filename) {
+  int dot = filename.lastIndexOf('.');
+  return ((dot > 0) ? filename.substring(0, dot) : filename) + ".sum";
+}
+
+String SessionManager::comparePath(const String &filename) {
+  int dot = filename.lastIndexOf('.');
+  return ((dot > 0) ? filename.substring(0, dot) : filename) + ".cmp";
+}
+
+// Sidecar with the computed results, so History does not re-scan the log:
+//   SUMMARY,Laps,BestLap,SectorsPerLap
+//   LAP,Num,Time,S1,S2,...
+//   OPT,OptimalLap,MiniSectors,LapLengthM
+//   LOSS,StartM,EndM,LossMs          (best lap vs. best mini-sectors)
+//   TURN,Num,StartM,ApexM,EndM,Deg   (corners, + = right)
+//   CORNER,Lap,Num,Entry,Apex,Exit,TimeMs  (km/h)
+bool SessionManager::writeSessionSummary(String filename,
+                                         const LapTimingEngine &timer,
+                                         const MiniSectorEngine *mini,
+                                         const CornerEngine *corners) {
+  String path = summaryPath(filename);
+  if (SD.exists(path))
+    SD.remove(path);
+  File f = SD.open(path, FILE_WRITE);
   if (!f)
     return false;
 
-  // Pass 1: Find Best Lap Index
-  int bestLapIdx = -1;
-  unsigned long bestTime = 0;
-  int currentLap = 0; // 0-indexed count
+  int spl = timer.getSectorsPerLap();
+  const std::vector<uint32_t> &laps = timer.getLapTimes();
+  const std::vector<uint32_t> &sectors = timer.getSectorTimes();
+  f.printf("SUMMARY,%d,%lu,%d\n", (int)laps.size(),
+           (unsigned long)timer.getBestLap(), spl);
+  for (size_t i = 0; i < laps.size(); i++) {
+    f.printf("LAP,%d,%lu", (int)i + 1, (unsigned long)laps[i]);
+    for (int s = 0; s < spl && spl > 1; s++)
+      f.printf(",%lu", (unsigned long)sectors[i * spl + s]);
+    f.print('\n');
+  }
+
+  if (mini && mini->getOptimalLap() > 0) {
+    f.printf("OPT,%lu,%d,%.1f\n", (unsigned long)mini->getOptimalLap(),
+             mini->getCount(), mini->getLapLength());
+    for (const auto &z : mini->getBestLapLosses())
+      f.printf("LOSS,%.0f,%.0f,%lu\n", z.startM, z.endM,
+               (unsigned long)z.lossMs);
+  }
+
+  if (corners && !corners->getLaps().empty()) {
+    for (int i = 0; i < corners->getCount(); i++) {
+      const CornerEngine::Corner &c = corners->getCorner(i);
+      f.printf("TURN,%d,%.0f,%.0f,%.0f,%.0f\n", i + 1, c.startM, c.apexM,
+               c.endM, c.turnDeg);
+    }
+    for (const auto &l : corners->getLaps()) {
+      for (size_t i = 0; i < l.corners.size(); i++) {
+        const CornerEngine::Result &r = l.corners[i];
+        f.printf("CORNER,%u,%d,%.1f,%.1f,%.1f,%lu\n", l.lap, (int)i + 1,
+                 r.entry / 10.0f, r.apex / 10.0f, r.exit / 10.0f,
+                 (unsigned long)r.timeMs);
+      }
+    }
+  }
+  f.close();
+  return true;
+}
+
+bool SessionManager::loadSessionSummary(String filename,
+                                        SessionAnalysis &result) {
+  File f = SD.open(summaryPath(filename), FILE_READ);
+  if (!f)
+    return false;
 
   while (f.available()) {
     String line = f.readStringUntil('\n');
-    line.trim();
-    if (line.startsWith("LAP,")) {
-      // LAP,Count,Time
-      int lastComma = line.lastIndexOf(',');
-      if (lastComma > 0) {
-        unsigned long t = line.substring(lastComma + 1).toInt();
-        if (bestLapIdx == -1 || t < bestTime) {
-          bestTime = t;
-          bestLapIdx = currentLap;
-        }
-      }
-      currentLap++;
+    if (line.startsWith("OPT,")) {
+      result.optimalLap = strtoul(line.c_str() + 4, nullptr, 10);
+      continue;
+    }
+    if (line.startsWith("LOSS,")) {
+      // LOSS,StartM,EndM,LossMs
+      MiniSectorEngine::LossZone z;
+      char *end;
+      z.startM = strtof(line.c_str() + 5, &end);
+      z.endM = strtof(end + 1, &end);
+      z.lossMs = strtoul(end + 1, nullptr, 10);
+      result.lossZones.push_back(z);
+      continue;
+    }
+    if (line.startsWith("TURN,")) {
+      // TURN,Num,StartM,ApexM,EndM,Deg
+      CornerEngine::Corner c;
+      char *end;
+      strtoul(line.c_str() + 5, &end, 10);
+      c.startM = strtof(end + 1, &end);
+      c.apexM = strtof(end + 1, &end);
+      c.endM = strtof(end + 1, &end);
+      c.turnDeg = strtof(end + 1, nullptr);
+      result.corners.push_back(c);
+      continue;
+    }
+    if (line.startsWith("CORNER,")) {
+      // CORNER,Lap,Num,Entry,Apex,Exit,TimeMs
+      char *end;
+      uint16_t lap = strtoul(line.c_str() + 7, &end, 10);
+      strtoul(end + 1, &end, 10);
+      CornerEngine::Result r;
+      r.entry = (uint16_t)lroundf(strtof(end + 1, &end) * 10);
+      r.apex = (uint16_t)lroundf(strtof(end + 1, &end) * 10);
+      r.exit = (uint16_t)lroundf(strtof(end + 1, &end) * 10);
+      r.timeMs = strtoul(end + 1, nullptr, 10);
+      if (result.cornerLaps.empty() || result.cornerLaps.back().lap != lap)
+        result.cornerLaps.push_back({lap, {}});
+      result.cornerLaps.back().corners.push_back(r);
+      continue;
+    }
+    if (!line.startsWith("LAP,"))
+      continue;
+
+    // LAP,Num,Time,S1,S2,...
+    const char *s = line.c_str() + 4;
+    char *end;
+    strtoul(s, &end, 10);
+    if (*end != ',')
+      continue;
+    unsigned long t = strtoul(end + 1, &end, 10);
+    result.lapTimes.push_back(t);
+    result.validLaps++;
+    if (result.bestLap == 0 || t < result.bestLap)
+      result.bestLap = t;
+
+    for (int num = 1; *end == ',' && num <= 3; num++) {
+      unsigned long st = strtoul(end + 1, &end, 10);
+      if (num == 1)
+        result.sector1.push_back(st);
+      else if (num == 2)
+        result.sector2.push_back(st);
+      else
+        result.sector3.push_back(st);
     }
   }
+  f.close();
+  return true;
+}
 
-  if (bestLapIdx == -1) {
-    f.close();
-    return false; // No laps found
+void SessionManager::layoutFromJson(JsonVariant t, TrackLayout &layout) {
+  layout = TrackLayout();
+  layout.centre = {degToE7(t["lat"].as<double>()),
+                   degToE7(t["lon"].as<double>())};
+
+  // Lines are [lat1, lon1, lat2, lon2]
+  auto toGate = [](JsonArray a, GateLine &g) {
+    if (a.size() != 4)
+      return false;
+    g.a = {degToE7(a[0].as<double>()), degToE7(a[1].as<double>())};
+    g.b = {degToE7(a[2].as<double>()), degToE7(a[3].as<double>())};
+    return true;
+  };
+
+  if (t["finish"].is<JsonArray>())
+    layout.hasFinishLine = toGate(t["finish"], layout.finish);
+
+  if (t["sectors"].is<JsonArray>()) {
+    JsonArray sectors = t["sectors"];
+    for (JsonVariant s : sectors) {
+      GateLine g;
+      if (s.is<JsonArray>() && toGate(s, g))
+        layout.sectors.push_back(g);
+    }
   }
+}
 
-  // Pass 2: Extract Points for Best Lap
-  f.seek(0);
-  currentLap = 0;
-  bool collecting = (currentLap == bestLapIdx);
+bool SessionManager::findTrackLayout(const GeoPoint &near,
+                                     TrackLayout &layout) {
+  File file = SD.open("/tracks.json", FILE_READ);
+  if (!file)
+    return false;
 
-  double prevLat = 0, prevLon = 0;
-  float totalDist = 0;
-  unsigned long lapStartTime = 0;
-  bool firstPoint = true;
+  JsonDocument doc;
+  DeserializationError error = deserializeJson(doc, file);
+  file.close();
+  if (error || !doc["tracks"].is<JsonArray>())
+    return false;
 
+  float bestDist = 5000; // m, session must start near the track
+  bool found = false;
+  JsonArray trackArray = doc["tracks"];
+  for (JsonVariant t : trackArray) {
+    GeoPoint loc = {degToE7(t["lat"].as<double>()),
+                    degToE7(t["lon"].as<double>())};
+    float d = geoDistanceM(near, loc);
+    if (d < bestDist) {
+      bestDist = d;
+      layoutFromJson(t, layout);
+      found = true;
+    }
+  }
+  return found;
+}
+
+bool SessionManager::retimeSession(String filename) {
+  File f = SD.open(filename, FILE_READ);
+  if (!f)
+    return false;
+
+  // First fix of the log picks the track
+  GeoPoint first = {0, 0};
   while (f.available()) {
     String line = f.readStringUntil('\n');
-    line.trim();
-    if (line.length() == 0)
+    if (line.length() == 0 || !isdigit(line.charAt(0)))
       continue;
+    const char *c1 = strchr(line.c_str(), ',');
+    const char *c2 = c1 ? strchr(c1 + 1, ',') : nullptr;
+    if (c2 && parseE7(c1 + 1, first.latE7) && parseE7(c2 + 1, first.lonE7) &&
+        !(first.latE7 == 0 && first.lonE7 == 0))
+      break;
+    first = {0, 0};
+  }
+  f.close();
 
-    if (line.startsWith("LAP,")) {
-      if (currentLap == bestLapIdx) {
-        break;
-      }
-      currentLap++;
-      collecting = (currentLap == bestLapIdx);
-      if (collecting) {
-        totalDist = 0;
-        firstPoint = true;
-        lapStartTime = 0;
-      }
-      continue;
+  if (first.latE7 == 0 && first.lonE7 == 0)
+    return false;
+
+  TrackLayout layout;
+  if (!findTrackLayout(first, layout)) {
+    // Unknown track: auto finish line through the starting point
+    layout.centre = first;
+  }
+  return retimeSession(filename, layout);
+}
+
+// Single streaming pass: fixes go through the timer, old LAP/SECTOR lines
+// are dropped and the new ones written in place.
+bool SessionManager::retimeSession(String filename,
+                                   const TrackLayout &layout) {
+  if (_logging && filename == _currentFilename)
+    return false;
+
+  File in = SD.open(filename, FILE_READ);
+  if (!in)
+    return false;
+
+  String tempPath = summaryPath(filename) + ".tmp";
+  if (SD.exists(tempPath))
+    SD.remove(tempPath);
+  File out = SD.open(tempPath, FILE_WRITE);
+  if (!out) {
+    in.close();
+    return false;
+  }
+
+  unsigned long start = millis();
+  LapTimingEngine timer;
+  timer.begin(layout);
+  uint32_t lapStart = 0;
+  std::vector<uint32_t> crossings; // Finish line, for the mini-sectors
+
+  static const size_t BUF_SIZE = 1024;
+  char *outBuf = (char *)malloc(BUF_SIZE);
+  if (!outBuf) {
+    in.close();
+    out.close();
+    SD.remove(tempPath);
+    return false;
+  }
+
+  size_t outLen = 0;
+  uint32_t fixes = 0;
+  bool ok = true;
+
+  auto emit = [&](const char *s, size_t n) {
+    if (outLen + n > BUF_SIZE) {
+      if (out.write((uint8_t *)outBuf, outLen) != outLen)
+        ok = false;
+      outLen = 0;
+    }
+    memcpy(outBuf + outLen, s, n);
+    outLen += n;
+  };
+
+  bool read = forEachLine(in, [&](const char *line, size_t lineLen) {
+    if (strncmp(line, "LAP,", 4) == 0 || strncmp(line, "SECTOR,", 7) == 0)
+      return true; // Replaced below
+
+    emit(line, lineLen);
+    emit("\n", 1);
+
+    uint32_t t;
+    GeoPoint pos;
+    if (!parseFix(line, t, pos))
+      return true; // Header, no fix yet
+    fixes++;
+
+    int n = timer.addFix(t, pos);
+    for (int i = 0; i < n; i++) {
+      const LapTimingEngine::Event &e = timer.getEvent(i);
+      char ev[40];
+      int len;
+      if (e.type == LapTimingEngine::EV_LAP)
+        len = snprintf(ev, sizeof(ev), "LAP,%u,%lu\n", e.lap,
+                       (unsigned long)e.time);
+      else
+        len = snprintf(ev, sizeof(ev), "SECTOR,%u,%u,%lu\n", e.lap, e.sector,
+                       (unsigned long)e.time);
+      emit(ev, len);
     }
 
-    if (collecting && isdigit(line.charAt(0))) {
-      int p1 = line.indexOf(',');
-      int p2 = line.indexOf(',', p1 + 1);
-      int p3 = line.indexOf(',', p2 + 1);
-      if (p1 > 0 && p2 > 0 && p3 > 0) {
-        unsigned long t = line.substring(0, p1).toInt();
-        double lat = line.substring(p1 + 1, p2).toDouble();
-        double lon = line.substring(p2 + 1, p3).toDouble();
+    if (timer.isLapRunning() && timer.getLapStart() != lapStart) {
+      lapStart = timer.getLapStart();
+      crossings.push_back(lapStart);
+    }
+    return true;
+  });
 
-        if (firstPoint) {
-          lapStartTime = t;
-          prevLat = lat;
-          prevLon = lon;
-          totalDist = 0;
-          firstPoint = false;
-          referenceLap.push_back({0, 0});
-        } else {
-          float dLat = (lat - prevLat) * DEG_TO_RAD;
-          float dLon = (lon - prevLon) * DEG_TO_RAD;
-          float a = sin(dLat / 2) * sin(dLat / 2) +
-                    cos(prevLat * DEG_TO_RAD) * cos(lat * DEG_TO_RAD) *
-                        sin(dLon / 2) * sin(dLon / 2);
-          float c = 2 * atan2(sqrt(a), sqrt(1 - a));
-          float dist = 6371000 * c;
+  if (outLen > 0 && out.write((uint8_t *)outBuf, outLen) != outLen)
+    ok = false;
+  ok = ok && read;
+  free(outBuf);
 
-          if (dist > 0.5) {
-            totalDist += dist;
-            unsigned long relTime = t - lapStartTime;
-            referenceLap.push_back({totalDist, (uint32_t)relTime});
-            prevLat = lat;
-            prevLon = lon;
-          }
-        }
+  size_t oldSize = in.size();
+  size_t newSize = out.size();
+  in.close();
+  out.close();
+
+  if (!ok) {
+    SD.remove(tempPath);
+    return false;
+  }
+
+  SD.remove(filename);
+  SD.rename(tempPath, filename);
+  if (newSize > oldSize)
+    quotaManager.onBytesWritten(newSize - oldSize);
+  else
+    quotaManager.onBytesFreed(oldSize - newSize);
+
+  // buildCorners() leaves the best lap's centreline in referenceMatcher
+  CornerEngine corners;
+  bool haveCorners = buildCorners(filename, corners);
+  MiniSectorEngine mini;
+  buildMiniSectors(filename, crossings, mini);
+  writeSessionSummary(filename, timer, &mini, haveCorners ? &corners : nullptr);
+  SD.remove(comparePath(filename)); // Laps changed, rebuilt on demand
+  updateHistoryStats(filename, timer.getLapCount(), timer.getBestLap());
+
+  Serial.printf("Retime: %s, %lu fixes, %d laps, best %lu ms in %lu ms\n",
+                filename.c_str(), (unsigned long)fixes, timer.getLapCount(),
+                (unsigned long)timer.getBestLap(), millis() - start);
+  return true;
+}
+
+bool SessionManager::startJob(JobType type, const String &filename) {
+  if (_jobState == JOB_RUNNING)
+    return false;
+  _jobType = type;
+  _jobFile = filename;
+  _jobState = JOB_RUNNING;
+  // Same stack as the Arduino loop these used to run on
+  if (xTaskCreatePinnedToCore(jobTask, "HistoryJob", 8192, this, 1, NULL,
+                              0) != pdPASS) {
+    _jobState = JOB_IDLE;
+    return false;
+  }
+  return true;
+}
+
+void SessionManager::jobTask(void *parameter) {
+  SessionManager *self = (SessionManager *)parameter;
+  bool ok = (self->_jobType == JOB_RETIME)
+                ? self->retimeSession(self->_jobFile)
+                : self->buildLapComparison(self->_jobFile);
+  self->_jobState = ok ? JOB_DONE : JOB_FAILED;
+  vTaskDelete(NULL);
+}
+
+// --- Lap Comparison ---
+
+// One pass over the log: every fix is matched onto the best lap's
+// centreline and binned; a lap is written when its LAP line comes by.
+bool SessionManager::buildLapComparison(String filename) {
+  if (_logging && filename == _currentFilename)
+    return false;
+  if (!loadBestLapAsReference(filename))
+    return false;
+
+  File in = SD.open(filename, FILE_READ);
+  if (!in)
+    return false;
+  String path = comparePath(filename);
+  if (SD.exists(path))
+    SD.remove(path);
+  File out = SD.open(path, FILE_WRITE);
+  if (!out) {
+    in.close();
+    return false;
+  }
+
+  unsigned long start = millis();
+  LapTraceBuilder builder;
+  builder.begin(referenceMatcher.getLength());
+  int bins = builder.getBins();
+
+  LapTraceHeader hdr = {LapTraceBuilder::MAGIC, (uint16_t)bins, 0,
+                        builder.getBinLen()};
+  bool ok = out.write((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr);
+
+  // The LAP line and the wrap of the matched distance come within a fix
+  // or two of each other, in either order
+  bool wrapped = false;  // Lap binned, waiting for its LAP line
+  bool lapSeen = false;  // LAP line read, waiting for the wrap
+  uint16_t lap = 0;
+  uint32_t lapTime = 0;
+  uint32_t lastFix = 0, lapSeenAt = 0, wrappedAt = 0;
+  int records = 0;
+
+  auto writeLap = [&]() {
+    const LapTrace &tr = builder.getCompleted();
+    ok = ok && out.write((uint8_t *)&lap, 2) == 2 &&
+         out.write((uint8_t *)&lapTime, 4) == 4 &&
+         out.write((uint8_t *)tr.offset.data(), bins) == (size_t)bins &&
+         out.write((uint8_t *)tr.speed.data(), bins * 2) == (size_t)bins * 2;
+    records++;
+    wrapped = false;
+    lapSeen = false;
+  };
+
+  forEachLine(in, [&](const char *line, size_t len) {
+    if (strncmp(line, "LAP,", 4) == 0) {
+      // LAP,Count,Time
+      char *end;
+      lap = strtoul(line + 4, &end, 10);
+      lapTime = (*end == ',') ? strtoul(end + 1, nullptr, 10) : 0;
+      lapSeen = true;
+      lapSeenAt = lastFix;
+      if (wrapped && lastFix - wrappedAt <= 2000)
+        writeLap();
+      return ok;
+    }
+
+    uint32_t t;
+    GeoPoint pos;
+    const char *rest;
+    if (!parseFix(line, t, pos, &rest))
+      return true;
+    lastFix = t;
+    if (lapSeen && t - lapSeenAt > 2000)
+      lapSeen = false; // No wrap near this line (matched off track)
+
+    MapMatcher::Match m = referenceMatcher.match(pos);
+    if (!m.valid)
+      return true; // Pit lane, off track
+    if (builder.addFix(m.distance, m.offset, strtof(rest, nullptr))) {
+      wrapped = true;
+      wrappedAt = t;
+      if (lapSeen)
+        writeLap();
+    }
+    return ok;
+  });
+  referenceMatcher.resetTracking();
+
+  size_t size = out.size();
+  in.close();
+  out.close();
+  if (!ok || records == 0) {
+    SD.remove(path);
+    return false;
+  }
+  quotaManager.onBytesWritten(size);
+
+  Serial.printf("Compare: %s, %d laps x %d bins in %lu ms\n",
+                filename.c_str(), records, bins, millis() - start);
+  return true;
+}
+
+bool SessionManager::buildCorners(String filename, CornerEngine &corners) {
+  if (_logging && filename == _currentFilename)
+    return false;
+  if (!loadBestLapAsReference(filename) ||
+      !corners.build(referenceMatcher))
+    return false;
+
+  File in = SD.open(filename, FILE_READ);
+  if (!in)
+    return false;
+
+  uint16_t laps = 0; // LAP lines so far
+  forEachLine(in, [&](const char *line, size_t len) {
+    if (strncmp(line, "LAP,", 4) == 0) {
+      laps++;
+      return true;
+    }
+    uint32_t t;
+    GeoPoint pos;
+    const char *rest;
+    if (!parseFix(line, t, pos, &rest))
+      return true;
+    MapMatcher::Match m = referenceMatcher.match(pos);
+    if (m.valid)
+      corners.addFix(t, m.distance, strtof(rest, nullptr), laps + 1);
+    return true;
+  });
+  referenceMatcher.resetTracking();
+  in.close();
+
+  Serial.printf("Corners: %s, %d corners, %d laps\n", filename.c_str(),
+                corners.getCount(), (int)corners.getLaps().size());
+  return !corners.getLaps().empty();
+}
+
+// Mini-sectors along referenceMatcher's centreline (by driven distance
+// without one), given the finish crossings of the timer
+bool SessionManager::buildMiniSectors(const String &filename,
+                                      const std::vector<uint32_t> &crossings,
+                                      MiniSectorEngine &mini) {
+  bool matched = referenceMatcher.isValid();
+  mini.begin(MiniSectorEngine::DEFAULT_COUNT,
+             matched ? referenceMatcher.getLength() : 0);
+  File in = SD.open(filename, FILE_READ);
+  if (!in)
+    return false;
+
+  size_t next = 0;
+  bool ok = forEachLine(in, [&](const char *line, size_t len) {
+    uint32_t t;
+    GeoPoint pos;
+    if (!parseFix(line, t, pos))
+      return true;
+    uint32_t lapCross = 0;
+    if (next < crossings.size() && crossings[next] <= t)
+      lapCross = crossings[next++];
+    float d = NAN;
+    if (matched) {
+      MapMatcher::Match m = referenceMatcher.match(pos);
+      if (m.valid)
+        d = m.distance;
+    }
+    mini.addTrackFix(t, pos, d, lapCross);
+    return true;
+  });
+  referenceMatcher.resetTracking();
+  in.close();
+  return ok;
+}
+
+int SessionManager::getLapTraceCount(String filename, LapTraceHeader &hdr) {
+  File f = SD.open(comparePath(filename), FILE_READ);
+  if (!f)
+    return 0;
+  int count = 0;
+  if (f.read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+      hdr.magic == LapTraceBuilder::MAGIC && hdr.bins > 0) {
+    count = (f.size() - sizeof(hdr)) / LapTrace::recordSize(hdr.bins);
+  }
+  f.close();
+  return count;
+}
+
+bool SessionManager::loadLapTrace(String filename, int idx, LapTrace &out,
+                                  bool timeOnly) {
+  LapTraceHeader hdr;
+  File f = SD.open(comparePath(filename), FILE_READ);
+  if (!f)
+    return false;
+  bool ok = f.read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+            hdr.magic == LapTraceBuilder::MAGIC &&
+            f.seek(sizeof(hdr) + idx * LapTrace::recordSize(hdr.bins)) &&
+            f.read((uint8_t *)&out.lap, 2) == 2 &&
+            f.read((uint8_t *)&out.lapTime, 4) == 4;
+  if (ok && !timeOnly) {
+    out.offset.resize(hdr.bins);
+    out.speed.resize(hdr.bins);
+    ok = f.read((uint8_t *)out.offset.data(), hdr.bins) == hdr.bins &&
+         f.read((uint8_t *)out.speed.data(), hdr.bins * 2) ==
+             (size_t)hdr.bins * 2;
+  }
+  f.close();
+  return ok;
+}
+
+// --- Predictive Timing ---
+bool SessionManager::loadBestLapAsReference(String filename) {
+  referenceTimes.clear();
+  referenceMatcher.clear();
+  _referenceLapTime = 0;
+  File f = SD.open(filename, FILE_READ);
+  if (!f)
+    return false;
+
+  // Best lap and its time window. A LAP line follows the fix that crossed
+  // the line, so the lap ends at the last fix before it.
+  uint32_t bestTime = 0;
+  uint32_t bestEnd = 0;
+  uint32_t lastFixTime = 0;
+
+  forEachLine(f, [&](const char *line, size_t len) {
+    if (strncmp(line, "LAP,", 4) == 0) {
+      // LAP,Count,Time
+      const char *c = strrchr(line, ',');
+      uint32_t t = strtoul(c + 1, nullptr, 10);
+      if (t > 0 && (bestTime == 0 || t < bestTime)) {
+        bestTime = t;
+        bestEnd = lastFixTime;
       }
+    } else if (*line >= '0' && *line <= '9') {
+      lastFixTime = strtoul(line, nullptr, 10);
+    }
+    return true;
+  });
+  f.close();
+
+  if (bestTime == 0 || bestEnd < bestTime)
+    return false; // No laps found
+  return buildReference(filename, bestEnd - bestTime, bestTime);
+}
+
+// Centreline from the lap's fixes, then the lap time at every
+// REF_STEP_M along it, resampled as the fixes stream by
+bool SessionManager::buildReference(const String &filename, uint32_t lapStart,
+                                    uint32_t lapTime) {
+  referenceTimes.clear();
+  referenceMatcher.clear();
+  _referenceLapTime = 0;
+  uint32_t lapEnd = lapStart + lapTime;
+
+  bool first = true;
+  readFixes(filename, lapStart, lapEnd, [&](uint32_t t, const GeoPoint &pos) {
+    if (first) {
+      referenceMatcher.begin(pos);
+      first = false;
     }
+    referenceMatcher.addPoint(pos);
+  });
+  if (first || !referenceMatcher.finish())
+    return false;
+
+  float prevD = 0;
+  uint32_t prevT = 0;
+  referenceTimes.reserve((size_t)(referenceMatcher.getLength() / REF_STEP_M) + 2);
+  referenceTimes.push_back(0);
+
+  readFixes(filename, lapStart, lapEnd, [&](uint32_t t, const GeoPoint &pos) {
+    MapMatcher::Match m = referenceMatcher.match(pos);
+    if (!m.valid)
+      return;
+    // Closed loop: the first metres can match just before the line
+    if (prevT == 0 && m.distance > referenceMatcher.getLength() / 2)
+      return;
+    if (m.distance <= prevD)
+      return; // Keep it monotonic
+    uint32_t rel = t - lapStart;
+    float g = referenceTimes.size() * REF_STEP_M;
+    while (g <= m.distance) {
+      float f = (g - prevD) / (m.distance - prevD);
+      referenceTimes.push_back(prevT + (uint32_t)(f * (rel - prevT) + 0.5f));
+      g += REF_STEP_M;
+    }
+    prevD = m.distance;
+    prevT = rel;
+  });
+  referenceMatcher.resetTracking();
+
+  if (referenceTimes.size() < 2) {
+    referenceTimes.clear();
+    return false;
   }
+  referenceTimes.push_back(lapTime); // Finish line
+  _referenceLapTime = lapTime;
+
+  Serial.printf("Reference: %d pts, centreline %d vertices, %.0f m\n",
+                (int)referenceTimes.size(),
+                (int)referenceMatcher.getVertexCount(),
+                referenceMatcher.getLength());
+  return true;
+}
+
+String SessionManager::referencePath(const String &trackName) {
+  String key = trackName;
+  for (unsigned int i = 0; i < key.length(); i++) {
+    if (!isalnum(key.charAt(i)))
+      key.setCharAt(i, '_');
+  }
+  return "/refs/" + key + ".ref";
+}
 
+// Resampled reference of a track's best lap: header, centreline vertices,
+// lap time (ms) at every metre
+bool SessionManager::saveTrackReference(const String &trackName,
+                                        String filename, uint32_t lapStart,
+                                        uint32_t lapTime) {
+  if (!buildReference(filename, lapStart, lapTime))
+    return false;
+
+  if (!SD.exists("/refs"))
+    SD.mkdir("/refs");
+  String path = referencePath(trackName);
+  if (SD.exists(path))
+    SD.remove(path);
+  File f = SD.open(path, FILE_WRITE);
+  if (!f)
+    return false;
+
+  // The closing vertex is added again when the line is rebuilt
+  uint16_t verts = referenceMatcher.getVertexCount();
+  if (referenceMatcher.isClosed())
+    verts--;
+
+  RefHeader hdr;
+  hdr.magic = REF_MAGIC;
+  hdr.lapTime = lapTime;
+  hdr.step = REF_STEP_M;
+  hdr.vertexCount = verts;
+  hdr.reserved = 0;
+  hdr.count = referenceTimes.size();
+
+  bool ok = f.write((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr);
+  for (uint16_t i = 0; ok && i < verts; i++) {
+    GeoPoint v = referenceMatcher.getVertex(i);
+    ok = f.write((uint8_t *)&v, sizeof(v)) == sizeof(v);
+  }
+  size_t bytes = referenceTimes.size() * sizeof(uint32_t);
+  ok = ok && f.write((uint8_t *)referenceTimes.data(), bytes) == bytes;
+  size_t size = f.size();
   f.close();
-  return !referenceLap.empty();
+
+  if (!ok) {
+    SD.remove(path);
+    return false;
+  }
+  quotaManager.onBytesWritten(size);
+  Serial.printf("Reference: saved %s (%lu ms, %u bytes)\n", path.c_str(),
+                (unsigned long)lapTime, (unsigned)size);
+  return true;
 }
 
-float SessionManager::getReferenceTime(float distance) {
-  if (referenceLap.empty())
-    return -1.0;
+bool SessionManager::loadTrackReference(const String &trackName) {
+  referenceTimes.clear();
+  referenceMatcher.clear();
+  _referenceLapTime = 0;
+
+  File f = SD.open(referencePath(trackName), FILE_READ);
+  if (!f)
+    return false;
 
-  auto it = std::lower_bound(
-      referenceLap.begin(), referenceLap.end(), distance,
-      [](const ReferencePoint &a, float val) { return a.distance < val; });
+  RefHeader hdr;
+  bool ok = f.read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+            hdr.magic == REF_MAGIC && hdr.step == REF_STEP_M &&
+            hdr.vertexCount >= 2 && hdr.count >= 2;
+
+  for (uint16_t i = 0; ok && i < hdr.vertexCount; i++) {
+    GeoPoint v;
+    ok = f.read((uint8_t *)&v, sizeof(v)) == sizeof(v);
+    if (!ok)
+      break;
+    if (i == 0)
+      referenceMatcher.begin(v);
+    referenceMatcher.addVertex(v);
+  }
 
-  if (it == referenceLap.begin())
-    return referenceLap[0].time;
-  if (it == referenceLap.end())
-    return referenceLap.back().time;
+  if (ok) {
+    referenceTimes.resize(hdr.count);
+    size_t bytes = hdr.count * sizeof(uint32_t);
+    ok = f.read((uint8_t *)referenceTimes.data(), bytes) == bytes &&
+         referenceMatcher.finish();
+  }
+  f.close();
+
+  if (!ok) {
+    referenceTimes.clear();
+    referenceMatcher.clear();
+    return false;
+  }
+  _referenceLapTime = hdr.lapTime;
+  return true;
+}
 
-  const ReferencePoint &p2 = *it;
-  const ReferencePoint &p1 = *(it - 1);
+// Header, then time (uint32 ms) and speed (uint16 0.1 km/h) per step
+bool SessionManager::saveDragReference(const DragProfile &profile) {
+  if (!profile.isValid())
+    return false;
+  if (!SD.exists("/refs"))
+    SD.mkdir("/refs");
+  const char *path = "/refs/drag.ref";
+  if (SD.exists(path))
+    SD.remove(path);
+  File f = SD.open(path, FILE_WRITE);
+  if (!f)
+    return false;
 
-  float distDelta = p2.distance - p1.distance;
-  if (distDelta < 0.1)
-    return p1.time;
+  DragRefHeader hdr;
+  hdr.magic = DRAG_MAGIC;
+  hdr.step = profile.step;
+  hdr.count = profile.time.size();
+  size_t timeBytes = hdr.count * sizeof(uint32_t);
+  size_t speedBytes = hdr.count * sizeof(uint16_t);
+  bool ok = f.write((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+            f.write((uint8_t *)profile.time.data(), timeBytes) == timeBytes &&
+            f.write((uint8_t *)profile.speed.data(), speedBytes) == speedBytes;
+  size_t size = f.size();
+  f.close();
 
-  float ratio = (distance - p1.distance) / distDelta;
-  return p1.time + (p2.time - p1.time) * ratio;
+  if (!ok) {
+    SD.remove(path);
+    return false;
+  }
+  quotaManager.onBytesWritten(size);
+  Serial.printf("Drag reference: saved %u points\n", (unsigned)hdr.count);
+  return true;
+}
+
+bool SessionManager::loadDragReference(DragProfile &profile) {
+  profile.clear();
+  File f = SD.open("/refs/drag.ref", FILE_READ);
+  if (!f)
+    return false;
+
+  DragRefHeader hdr;
+  bool ok = f.read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+            hdr.magic == DRAG_MAGIC && hdr.step > 0 && hdr.count >= 2 &&
+            hdr.count <= DragProfile::MAX_POINTS;
+  if (ok) {
+    profile.step = hdr.step;
+    profile.time.resize(hdr.count);
+    profile.speed.resize(hdr.count);
+    size_t timeBytes = hdr.count * sizeof(uint32_t);
+    size_t speedBytes = hdr.count * sizeof(uint16_t);
+    ok = f.read((uint8_t *)profile.time.data(), timeBytes) == timeBytes &&
+         f.read((uint8_t *)profile.speed.data(), speedBytes) == speedBytes;
+  }
+  f.close();
+
+  if (!ok)
+    profile.clear();
+  return ok;
+}
+
+// Data lines with from <= Time <= to
+bool SessionManager::readFixes(
+    const String &filename, uint32_t from, uint32_t to,
+    std::function<void(uint32_t, const GeoPoint &)> fn) {
+  File f = SD.open(filename, FILE_READ);
+  if (!f)
+    return false;
+
+  bool ok = forEachLine(f, [&](const char *line, size_t len) {
+    uint32_t t;
+    GeoPoint pos;
+    if (!parseFix(line, t, pos) || t < from)
+      return true;
+    if (t > to)
+      return false; // Past the window
+    fn(t, pos);
+    return true;
+  });
+  f.close();
+  return ok;
+}
+
+// "Time,Lat,Lon,..." -> false for headers, events and rows without a fix.
+// `rest` points at the field after Lon.
+bool SessionManager::parseFix(const char *line, uint32_t &t, GeoPoint &pos,
+                              const char **rest) {
+  if (*line < '0' || *line > '9')
+    return false;
+  char *end;
+  t = strtoul(line, &end, 10);
+  if (*end != ',')
+    return false;
+  const char *p = parseE7(end + 1, pos.latE7);
+  if (!p || *p != ',')
+    return false;
+  p = parseE7(p + 1, pos.lonE7);
+  if (!p || (pos.latE7 == 0 && pos.lonE7 == 0))
+    return false;
+  if (rest)
+    *rest = (*p == ',') ? p + 1 : p;
+  return true;
+}
+
+// Streams a file line by line from 1 KB reads (readStringUntil goes byte
+// by byte, far too slow for hour-long logs). Lines are NUL-terminated
+// and without CR/LF; `fn` returns false to stop. A line is never cut:
+// past MAX_LINE the walk stops and returns false, so a caller that
+// writes lines back (retimeSession) leaves the file alone.
+bool SessionManager::forEachLine(
+    File &f, std::function<bool(const char *, size_t)> fn) {
+  static const size_t BUF_SIZE = 1024;
+  char *buf = (char *)malloc(BUF_SIZE);
+  size_t cap = 128; // Grows up to MAX_LINE + 1
+  char *line = (char *)malloc(cap);
+  if (!buf || !line) {
+    free(buf);
+    free(line);
+    return false;
+  }
+
+  bool ok = true;
+  bool stop = false;
+  size_t len = 0;
+  while (!stop && f.available()) {
+    int n = f.read((uint8_t *)buf, BUF_SIZE);
+    if (n <= 0)
+      break;
+    for (int i = 0; i < n && !stop; i++) {
+      char c = buf[i];
+      if (c == '\n') {
+        line[len] = '\0';
+        if (len > 0 && !fn(line, len))
+          stop = true;
+        len = 0;
+      } else if (c != '\r') {
+        if (len >= MAX_LINE) {
+          Serial.printf("Line over %u chars, stopped\n", (unsigned)MAX_LINE);
+          ok = false;
+          stop = true;
+          break;
+        }
+        if (len + 1 >= cap) {
+          size_t want = (cap * 2 > MAX_LINE + 1) ? MAX_LINE + 1 : cap * 2;
+          char *grown = (char *)realloc(line, want);
+          if (!grown) {
+            ok = false;
+            stop = true;
+            break;
+          }
+          line = grown;
+          cap = want;
+        }
+        line[len++] = c;
+      }
+    }
+  }
+  if (!stop && len > 0) {
+    line[len] = '\0';
+    fn(line, len);
+  }
+
+  free(line);
+  free(buf);
+  return ok;
+}
+
+float SessionManager::getReferenceTime(float distance) {
+  if (referenceTimes.empty())
+    return -1.0;
+  if (distance <= 0)
+    return referenceTimes[0];
+
+  float f = distance / REF_STEP_M;
+  size_t i = (size_t)f;
+  if (i >= referenceTimes.size() - 1)
+    return referenceTimes.back();
+  return referenceTimes[i] + (f - i) * (float)(referenceTimes[i + 1] -
+                                               referenceTimes[i]);
 }
@@ -2,12 +2,26 @@
 #define SESSION_MANAGER_H
 
 #include "../config.h"
+#include "AnalogChannels.h"
+#include "ChannelLog.h"
+#include "CornerEngine.h"
+#include "DragPredictor.h"
+#include "GearEngine.h"
+#include "GeoTypes.h"
+#include "LapTimingEngine.h"
+#include "LapTrace.h"
+#include "MapMatcher.h"
+#include "MathChannels.h"
+#include "MiniSectorEngine.h"
 #include <Arduino.h>
+#include <ArduinoJson.h>
 #include <FS.h>
 #include <SD.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
+#include <freertos/semphr.h>
 #include <freertos/task.h>
+#include <functional>
 #include <vector>
 
 class SessionManager {
@@ -20,11 +34,41 @@ public:
 
   bool isLogging() { return _logging; }
 
+  // User math channels (/channels.txt), loaded at begin(). Logged as
+  // per-fix block channels, so they never widen the fix row.
+  MathChannels mathChannels;
+  bool loadMathChannels();
+  // Once per fix row, before logChannels(true); inputs indexed by
+  // MathChannels::Input
+  void logMathChannels(uint32_t timeMs, const float *in);
+
+  // Channels at their own rate (see ChannelLog), declared in the header.
+  // logChannels() moves new RPM and analog samples in, on the fix rows'
+  // timebase (GPSManager::toFixTime); call it every loop, and with flush
+  // before each fix row so the file stays in time order.
+  ChannelLog channels;
+  void logChannels(bool flush = false);
+  void logSample(int channel, uint32_t timeMs, float value);
+  // Every line of a file, whole, read in blocks (String reads go byte by
+  // byte, far too slow for hour-long logs); false if one is over MAX_LINE
+  static bool forEachLine(File &f,
+                          std::function<bool(const char *, size_t)> fn);
+  static const size_t MAX_LINE = 512;
+
+  // Any channels of a log on a common timebase (names comma-separated,
+  // values in that order, NAN where a channel has no data)
+  bool resampleSession(String filename, const char *names, uint32_t stepMs,
+                       std::function<void(uint32_t, const float *)> fn);
+
+  // The catalog (/history.csv) is read and rewritten from the UI and from
+  // the quota task; these calls take turns on it.
   void appendToHistoryIndex(String filename, String date, int laps,
                             unsigned long bestLap, String type = "TRACK");
   String loadHistoryIndex(); // Returns full content for processing
 
   bool deleteSession(String filename); // Delete file and update index
+  bool markSessionSynced(String filename); // Set synced flag in index
+  bool updateHistoryStats(String filename, int laps, unsigned long bestLap);
 
   bool getSDStatus(uint64_t &total, uint64_t &used);
 
@@ -55,23 +99,140 @@ public:
     std::vector<unsigned long> sector1;
     std::vector<unsigned long> sector2;
     std::vector<unsigned long> sector3;
+    // Mini-sectors (from the .sum sidecar)
+    unsigned long optimalLap;
+    std::vector<MiniSectorEngine::LossZone> lossZones; // Of the best lap
+    std::vector<CornerEngine::Corner> corners;       // Of the reference
+    std::vector<CornerEngine::LapCorners> cornerLaps; // Fully measured laps
+    // G-G diagram: logged LonG/LatG rows per GG_STEP cell, 0 g centred
+    static const int GG_BINS = 25; // +-1.2 g, outer cells clamp
+    static constexpr float GG_STEP = 0.1f;
+    uint16_t gg[GG_BINS][GG_BINS]; // [lon][lat]
+    float maxAccelG, maxBrakeG, maxLatG;
+    // Logged gear: ms per gear (0 = neutral/unknown), highest gear seen
+    uint32_t gearMs[GearEngine::MAX_CLUSTERS + 1];
+    int gearCount;
+    // Math channels re-evaluated over the logged rows (RPM: the latest
+    // logged sample at each row)
+    int mathCount;
+    float mathMin[MathChannels::MAX_CHANNELS];
+    float mathMax[MathChannels::MAX_CHANNELS];
+    float mathAvg[MathChannels::MAX_CHANNELS];
   };
 
   SessionAnalysis analyzeSession(String filename);
 
-  struct ReferencePoint {
-    float distance; // Meters from start of LAP
-    uint32_t time;  // ms from start of LAP
-  };
-  std::vector<ReferencePoint> referenceLap;
+  // Lap Re-timing
+  // Recomputes LAP/SECTOR lines from the raw trace with interpolated line
+  // crossings, rewrites the log, the .sum sidecar and the history entry.
+  bool retimeSession(String filename); // Layout from /tracks.json
+  bool retimeSession(String filename, const TrackLayout &layout);
+  bool writeSessionSummary(String filename, const LapTimingEngine &timer,
+                           const MiniSectorEngine *mini = nullptr,
+                           const CornerEngine *corners = nullptr);
+  // Corners of the session's best lap, then every lap's speeds through
+  // them (one pass over the log; replaces the loaded reference)
+  bool buildCorners(String filename, CornerEngine &corners);
+  static String summaryPath(const String &filename); // run_X.csv -> .sum
+
+  // Racing line / speed per lap vs. the best lap (.cmp sidecar)
+  bool buildLapComparison(String filename);
+  int getLapTraceCount(String filename, LapTraceHeader &hdr);
+  bool loadLapTrace(String filename, int idx, LapTrace &out,
+                    bool timeOnly = false);
+  static String comparePath(const String &filename); // run_X.csv -> .cmp
+
+  // Re-time and comparison builds read the whole log, so the history
+  // screen runs them as a job on core 0 (one at a time) and polls
+  enum JobType { JOB_RETIME, JOB_COMPARE };
+  enum JobState { JOB_IDLE, JOB_RUNNING, JOB_DONE, JOB_FAILED };
+  bool startJob(JobType type, const String &filename); // False if busy
+  JobState getJobState() { return _jobState; }
+  JobType getJobType() { return _jobType; }
+  const String &getJobFile() { return _jobFile; }
+  void clearJob() { _jobState = JOB_IDLE; } // Outcome seen
+
+  // Track layouts (/tracks.json: lat, lon, optional finish/sectors lines)
+  static void layoutFromJson(JsonVariant t, TrackLayout &layout);
+  bool findTrackLayout(const GeoPoint &near, TrackLayout &layout);
+
+  // Reference lap: ms from the start of the lap at every REF_STEP_M along
+  // its centreline. match() live fixes against referenceMatcher so the
+  // distances line up.
+  std::vector<uint32_t> referenceTimes;
+  MapMatcher referenceMatcher;
   bool loadBestLapAsReference(String filename); // Loads best lap from session
-  float getReferenceTime(float distance);       // Interp logic
+  float getReferenceTime(float distance);       // O(1) lookup
+  uint32_t getReferenceLapTime() { return _referenceLapTime; }
+
+  // Per-track reference (/refs/<track>.ref), one read at race start
+  bool loadTrackReference(const String &trackName);
+  bool saveTrackReference(const String &trackName, String filename,
+                          uint32_t lapStart, uint32_t lapTime);
+  static String referencePath(const String &trackName);
+
+  static constexpr float REF_STEP_M = 1.0f;
+
+  // Drag reference run (/refs/drag.ref): the whole time/speed profile
+  bool loadDragReference(DragProfile &profile);
+  bool saveDragReference(const DragProfile &profile);
 
 private:
+  static const uint32_t REF_MAGIC = 0x31464552; // "REF1"
+  struct RefHeader {
+    uint32_t magic;
+    uint32_t lapTime;
+    float step;
+    uint16_t vertexCount;
+    uint16_t reserved;
+    uint32_t count;
+  };
+  uint32_t _referenceLapTime = 0;
+  static const uint32_t DRAG_MAGIC = 0x31475244; // "DRG1"
+  struct DragRefHeader {
+    uint32_t magic;
+    float step;
+    uint32_t count;
+  };
+  bool buildReference(const String &filename, uint32_t lapStart,
+                      uint32_t lapTime);
+
+  bool loadSessionSummary(String filename, SessionAnalysis &result);
+  static void addGG(SessionAnalysis &a, float lonG, float latG);
+  bool readFixes(const String &filename, uint32_t from, uint32_t to,
+                 std::function<void(uint32_t, const GeoPoint &)> fn);
+  static bool parseFix(const char *line, uint32_t &t, GeoPoint &pos,
+                       const char **rest = nullptr);
+  bool buildMiniSectors(const String &filename,
+                        const std::vector<uint32_t> &crossings,
+                        MiniSectorEngine &mini);
+  // edit() returning "" drops the entry
+  bool editHistoryEntry(const String &filename,
+                        std::function<String(const String &)> edit);
+  SemaphoreHandle_t _catalogLock;
+
+  volatile JobState _jobState = JOB_IDLE;
+  JobType _jobType = JOB_RETIME;
+  String _jobFile; // Only changed while no job runs
+  static void jobTask(void *parameter);
+
   bool _logging;
   File _logFile;
   String createFilename();
   String _currentFilename;
+  volatile uint32_t _sessionBytes; // Bytes written by the logging task
+  unsigned long _sessionStart;
+
+  // Math channel cost while logging (micros per row)
+  unsigned long _mathTotalUs = 0;
+  unsigned long _mathMaxUs = 0;
+  unsigned long _mathRows = 0;
+
+  uint32_t _rpmSeq = 0; // Next RPM sample to log
+  // Analog channel -> log id, and the next sample of each to log
+  int _analogIds[AnalogChannels::MAX_CHANNELS];
+  int _mathIds[MathChannels::MAX_CHANNELS]; // -1: registry full
+  uint32_t _analogSeq[AnalogChannels::MAX_CHANNELS];
 
 public:
   String getCurrentFilename() { return _currentFilename; }
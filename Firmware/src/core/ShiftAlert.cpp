@@ -0,0 +1,50 @@
+#include "ShiftAlert.h"
+
+void ShiftAlert::setShiftRpm(int gear, uint16_t rpm) {
+  if (gear < 0 || gear > MAX_GEARS)
+    return;
+  _shiftRpm[gear] = rpm;
+  update();
+}
+
+void ShiftAlert::setScale(float ticksPerMinute) {
+  _scale = ticksPerMinute;
+  update();
+}
+
+void ShiftAlert::setGear(int gear) {
+  if (gear < 0 || gear > MAX_GEARS)
+    gear = 0;
+  if (gear == _gear)
+    return;
+  _gear = gear;
+  update();
+}
+
+uint32_t ShiftAlert::periodOf(uint16_t rpm) const {
+  if (rpm == 0 || _scale <= 0)
+    return 0;
+  return (uint32_t)(_scale / rpm);
+}
+
+void ShiftAlert::update() {
+  int g = (_gear > 0 && _shiftRpm[_gear] > 0) ? _gear : 0;
+  uint16_t shift = _shiftRpm[g];
+  // Off thresholds first: the ISR may read in between
+  _shiftOff = shift > HYST_RPM ? periodOf(shift - HYST_RPM) : 0;
+  _shiftOn = periodOf(shift);
+  _overOff = _overRevRpm > HYST_RPM ? periodOf(_overRevRpm - HYST_RPM) : 0;
+  _overOn = periodOf(_overRevRpm);
+}
+
+bool ShiftAlert::onStopped(uint32_t nowUs) {
+  _prev = 0;
+  _count = 0;
+  if (_level == LEVEL_NONE)
+    return false;
+  _level = LEVEL_NONE;
+  _crossUs = nowUs;
+  _changeUs = nowUs;
+  _seq = _seq + 1;
+  return true;
+}
@@ -0,0 +1,118 @@
+#ifndef SHIFT_ALERT_H
+#define SHIFT_ALERT_H
+
+#include <stdint.h>
+
+// Shift light and over-rev alert, decided per ignition edge in the
+// capture interrupt instead of from the filtered RPM. The RPM
+// thresholds of the current gear are turned into periods between edges
+// up front, so each edge is a few integer compares. A level changes
+// after CONFIRM edges agree, each within -25%/+50% of the period before
+// it: a stray edge (two short periods) or a missed one (a double
+// period) breaks the run instead of raising or clearing the alert.
+// Dropping also needs HYST_RPM of margin.
+class ShiftAlert {
+public:
+  enum Level : uint8_t { LEVEL_NONE, LEVEL_SHIFT, LEVEL_OVERREV };
+
+  struct Latency {
+    uint32_t count;
+    uint32_t totalUs;
+    uint32_t maxUs;
+  };
+
+  static const int MAX_GEARS = 6;
+  static const int CONFIRM = 2;
+  static const uint16_t HYST_RPM = 200;
+
+  // Thresholds; 0 rpm is off. Gear 0 is the default for gears without
+  // their own (and for gear 0 itself: clutch, not learned)
+  void setShiftRpm(int gear, uint16_t rpm);
+  void setOverRevRpm(uint16_t rpm) { _overRevRpm = rpm; update(); }
+  // Capture ticks per minute per pulse: 60e6 * ticks/us / pulses-per-rev
+  void setScale(float ticksPerMinute);
+  void setGear(int gear); // Cheap when unchanged
+
+  // From the capture ISR: true when the level changed
+  inline bool onPeriod(uint32_t ticks, uint32_t nowUs);
+  bool onStopped(uint32_t nowUs); // No RPM any more
+  Level getLevel() const { return (Level)_level; }
+  uint32_t getSeq() const { return _seq; }
+  // First edge of the run that changed the level, and the change itself
+  uint32_t getCrossUs() const { return _crossUs; }
+  uint32_t getChangeUs() const { return _changeUs; }
+
+  static void addLatency(Latency &l, uint32_t us) {
+    l.count++;
+    l.totalUs += us;
+    if (us > l.maxUs)
+      l.maxUs = us;
+  }
+
+  // Choices offered in Settings, by index
+  static const int RPM_OPTIONS = 27;
+  static uint16_t rpmOption(int i) { return 3000 + 500 * i; }
+
+private:
+  uint16_t _shiftRpm[MAX_GEARS + 1] = {};
+  uint16_t _overRevRpm = 0;
+  float _scale = 0;
+  int _gear = -1;
+
+  // Periods, ticks: shorter is faster. 0 is off.
+  volatile uint32_t _shiftOn = 0, _shiftOff = 0;
+  volatile uint32_t _overOn = 0, _overOff = 0;
+
+  uint32_t _prev = 0;
+  volatile uint8_t _level = LEVEL_NONE;
+  uint8_t _pending = LEVEL_NONE;
+  uint8_t _count = 0;
+  uint32_t _pendingUs = 0;
+  volatile uint32_t _seq = 0;
+  volatile uint32_t _crossUs = 0;
+  volatile uint32_t _changeUs = 0;
+
+  void update();
+  uint32_t periodOf(uint16_t rpm) const;
+  uint8_t classify(uint32_t ticks) const;
+};
+
+// Inline: runs in the IRAM capture handler
+inline uint8_t ShiftAlert::classify(uint32_t ticks) const {
+  uint32_t overOn = _overOn, shiftOn = _shiftOn;
+  if (overOn && ticks <= (_level == LEVEL_OVERREV ? _overOff : overOn))
+    return LEVEL_OVERREV;
+  if (shiftOn && ticks <= (_level >= LEVEL_SHIFT ? _shiftOff : shiftOn))
+    return LEVEL_SHIFT;
+  return LEVEL_NONE;
+}
+
+inline bool ShiftAlert::onPeriod(uint32_t ticks, uint32_t nowUs) {
+  bool steady =
+      ticks >= _prev - (_prev >> 2) && ticks <= _prev + (_prev >> 1);
+  _prev = ticks;
+  if (!steady || ticks == 0) {
+    _count = 0;
+    return false;
+  }
+  uint8_t want = classify(ticks);
+  if (want == _level) {
+    _count = 0;
+    return false;
+  }
+  if (_count == 0 || want != _pending) {
+    _pending = want;
+    _pendingUs = nowUs;
+    _count = 0;
+  }
+  if (++_count < CONFIRM)
+    return false;
+  _count = 0;
+  _level = want;
+  _crossUs = _pendingUs;
+  _changeUs = nowUs;
+  _seq = _seq + 1;
+  return true;
+}
+
+#endif
@@ -0,0 +1,84 @@
+#include "SlopeEstimator.h"
+#include <math.h>
+
+void SlopeEstimator::reset() {
+  _n = 0;
+  _rejected = 0;
+  _streak = 0;
+  _mx = 0;
+  _my = 0;
+  _cxx = 0;
+  _cxy = 0;
+  _cyy = 0;
+  _minX = 0;
+  _maxX = 0;
+}
+
+double SlopeEstimator::residualSigma() const {
+  if (_n < 3 || _cxx <= 0)
+    return 0;
+  double sse = _cyy - _cxy * _cxy / _cxx;
+  return sse > 0 ? sqrt(sse / (_n - 2)) : 0;
+}
+
+bool SlopeEstimator::add(float distance, float altitude) {
+  // Settled fit: drop fixes too far off the line. After a run of
+  // rejections the line is what's wrong, so fixes are taken again until
+  // one fits it once more.
+  bool outlier = false;
+  if (isValid()) {
+    double predicted = _my + _cxy / _cxx * (distance - _mx);
+    double sigma = residualSigma();
+    if (sigma < MIN_SIGMA_M)
+      sigma = MIN_SIGMA_M;
+    outlier = fabs(altitude - predicted) > OUTLIER_SIGMA * sigma;
+  }
+  if (!outlier) {
+    _streak = 0;
+  } else if (_streak < MAX_STREAK) {
+    _rejected++;
+    _streak++;
+    return false;
+  }
+
+  _n++;
+  double dx = distance - _mx;
+  double dy = altitude - _my;
+  _mx += dx / _n;
+  _my += dy / _n;
+  _cxx += dx * (distance - _mx);
+  _cxy += dx * (altitude - _my);
+  _cyy += dy * (altitude - _my);
+
+  if (_n == 1 || distance < _minX)
+    _minX = distance;
+  if (_n == 1 || distance > _maxX)
+    _maxX = distance;
+  return true;
+}
+
+bool SlopeEstimator::isValid() const {
+  return _n >= MIN_FIXES && _cxx > 0 && _maxX - _minX >= MIN_SPAN_M;
+}
+
+float SlopeEstimator::getSlope() const {
+  if (!isValid())
+    return 0;
+  return (float)(_cxy / _cxx * 100.0);
+}
+
+float SlopeEstimator::getConfidence() const {
+  if (!isValid())
+    return 0;
+  // Standard error of the slope, ~2 sigma
+  double sigma = residualSigma();
+  if (sigma < MIN_SIGMA_M / 2)
+    sigma = MIN_SIGMA_M / 2;
+  return (float)(2.0 * sigma / sqrt(_cxx) * 100.0);
+}
+
+bool SlopeEstimator::isTooSteepDownhill(float maxDownhill) const {
+  if (!isValid())
+    return false;
+  return getSlope() + getConfidence() < -maxDownhill;
+}
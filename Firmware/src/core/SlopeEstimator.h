@@ -0,0 +1,42 @@
+#ifndef SLOPE_ESTIMATOR_H
+#define SLOPE_ESTIMATOR_H
+
+#include <stdint.h>
+
+// Road gradient of a run: least-squares line of GNSS altitude against
+// distance along the path, updated per fix in O(1) (running means and
+// co-moments). Fixes far off the line (altitude spikes) are rejected
+// once the fit spans enough distance.
+class SlopeEstimator {
+public:
+  void reset();
+  // Returns false when the fix was rejected as an outlier
+  bool add(float distance, float altitude);
+
+  bool isValid() const; // Enough fixes over enough distance
+  float getSlope() const;      // %, positive = uphill
+  float getConfidence() const; // +/- %, ~95%
+  int getCount() const { return _n; }
+  int getRejected() const { return _rejected; }
+
+  // Confidently steeper downhill than maxDownhill (%, e.g. 1.0)
+  bool isTooSteepDownhill(float maxDownhill) const;
+
+  static const int MIN_FIXES = 5;
+  static constexpr float MIN_SPAN_M = 50.0f;
+  static constexpr float OUTLIER_SIGMA = 3.0f;
+  static constexpr float MIN_SIGMA_M = 0.5f; // Altitude noise floor
+  static const int MAX_STREAK = 5;
+
+private:
+  int _n = 0;
+  int _rejected = 0;
+  int _streak = 0; // Rejections in a row, held until a fix fits again
+  double _mx = 0, _my = 0;            // Means
+  double _cxx = 0, _cxy = 0, _cyy = 0; // Co-moments
+  float _minX = 0, _maxX = 0;
+
+  double residualSigma() const;
+};
+
+#endif
@@ -322,6 +322,8 @@ bool SyncManager::uploadSessions(const char *apiUrl, const char *username,
         Serial.println("Failed to upload: " + filename);
       } else {
         Serial.println("Uploaded: " + filename);
+        // Synced sessions may be rotated out when the card fills up
+        sessionManager.markSessionSynced(filename);
       }
     }
   }
@@ -1,8 +1,11 @@
 #include "WiFiManager.h"
+#include "SessionManager.h"
 #include "web_static.h"
 #include <ArduinoJson.h>
 #include <Update.h>
 
+extern SessionManager sessionManager;
+
 WiFiManager::WiFiManager() : _server(80) {
   _ssid = "";
   _pass = "";
@@ -38,6 +41,8 @@ void WiFiManager::begin() {
              std::bind(&WiFiManager::handleApiSessions, this));
   _server.on("/download", HTTP_GET,
              std::bind(&WiFiManager::handleDownload, this));
+  _server.on("/api/resample", HTTP_GET,
+             std::bind(&WiFiManager::handleResample, this));
 
   _server.on(
 
@@ -217,6 +222,57 @@ void WiFiManager::handleDownload() {
   }
 }
 
+// /api/resample?file=/sessions/run_3.csv&ch=speed,rpm&step=100
+// CSV of the channels on one timebase, streamed as it is computed
+void WiFiManager::handleResample() {
+  if (!_server.hasArg("file") || !_server.hasArg("ch")) {
+    _server.send(400, "text/plain", "Bad Request");
+    return;
+  }
+  String path = _server.arg("file");
+  if (path.indexOf("..") != -1) {
+    _server.send(403, "text/plain", "Forbidden");
+    return;
+  }
+  if (!SD.exists(path)) {
+    _server.send(404, "text/plain", "File Not Found");
+    return;
+  }
+  String names = _server.arg("ch");
+  uint32_t step = _server.hasArg("step") ? _server.arg("step").toInt() : 100;
+  if (step < 10)
+    step = 10;
+
+  _server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  _server.send(200, "text/csv", "");
+  _server.sendContent("Time," + names + "\n");
+  int count = 1;
+  for (unsigned int i = 0; i < names.length(); i++)
+    if (names[i] == ',')
+      count++;
+  if (count > ChannelResampler::MAX_SELECT)
+    count = ChannelResampler::MAX_SELECT;
+
+  String chunk;
+  sessionManager.resampleSession(
+      path, names.c_str(), step, [&](uint32_t t, const float *v) {
+        chunk += String(t);
+        for (int i = 0; i < count; i++) {
+          chunk += ',';
+          if (!isnan(v[i]))
+            chunk += String(v[i], 3);
+        }
+        chunk += '\n';
+        if (chunk.length() > 1024) {
+          _server.sendContent(chunk);
+          chunk = "";
+        }
+      });
+  if (chunk.length() > 0)
+    _server.sendContent(chunk);
+  _server.sendContent("");
+}
+
 bool WiFiManager::connect(const char *ssid, const char *pass) {
 
   _ssid = ssid;
@@ -60,6 +60,7 @@ private:
   void handleSessionsPage();
   void handleApiSessions();
   void handleDownload();
+  void handleResample();
 };
 
 #endif
@@ -1,5 +1,7 @@
 #include "config.h"
+#include "core/AnalogManager.h"
 #include "core/GPSManager.h"
+#include "core/QuotaManager.h"
 #include <TAMC_GT911.h>
 
 #include "core/SessionManager.h"
@@ -18,8 +20,10 @@ TAMC_GT911 touch(TOUCH_SDA, TOUCH_SCL, TOUCH_INT, TOUCH_RST, TOUCH_WIDTH,
 UIManager uiManager(&tft);
 GPSManager gpsManager;
 SessionManager sessionManager;
+QuotaManager quotaManager;
 WiFiManager wifiManager;
 SyncManager syncManager;
+AnalogManager analogManager;
 
 // SPIClass touchSpi = SPIClass(HSPI); // Tidak diperlukan untuk I2C
 
@@ -57,6 +61,8 @@ void setup() {
   // Inisialisasi Inti
   gpsManager.begin();
   sessionManager.begin();
+  quotaManager.begin(); // Setelah SD siap
+  analogManager.begin(); // /analog.json dari SD
 
   // Link GPS to WiFi for Web API
   wifiManager.setGPS(&gpsManager);
@@ -1,5 +1,6 @@
 #include "UIManager.h"
 #include "../../config.h"
+#include "../core/AnalogManager.h"
 #include "../core/GPSManager.h"
 #include "../core/WiFiManager.h"
 #include "fonts/Org_01.h"
@@ -7,6 +8,7 @@
 #include <WiFi.h>
 
 extern WiFiManager wifiManager;
+extern AnalogManager analogManager;
 
 // Sertakan layar (dibuat di langkah berikutnya)
 #include "screens/DragMeterScreen.h"
@@ -493,16 +495,21 @@ void UIManager::drawStatusBar(bool force) {
   }
 
   // --- Bagian Baterai ---
-  // Read Battery Voltage every 5 seconds to prevent slowing down loop
+  // Sampled by the ADC task (AnalogManager); refresh every 5 seconds
   static unsigned long lastBatRead = 0;
   static int lastPct = -1;
   static float lastVolts = 0;
 
-  if (millis() - lastBatRead > 5000 || lastPct == -1) {
+  bool batReady = !analogManager.isRunning() || analogManager.hasBattery();
+  if (batReady && (millis() - lastBatRead > 5000 || lastPct == -1)) {
     lastBatRead = millis();
-    int rawADC = analogRead(PIN_BATTERY);
-    // 3.3V ~ 4095
-    lastVolts = (rawADC / 4095.0) * 3.3 * 2.0; // *2 for divider
+    if (analogManager.isRunning()) {
+      lastVolts = analogManager.getBatteryVolts();
+    } else {
+      int rawADC = analogRead(PIN_BATTERY);
+      // 3.3V ~ 4095
+      lastVolts = (rawADC / 4095.0) * 3.3 * 2.0; // *2 for divider
+    }
 
     // Percentage Calculation (Linear 3.0V - 4.2V)
     if (lastVolts >= 4.2)
@@ -82,9 +82,12 @@ public:
   uint16_t getSecondaryColor();
 
   // Session Data Sharing
-  void setLastSession(ActiveSessionData data) { _lastSession = data; }
+  void setLastSession(const ActiveSessionData &data) { _lastSession = data; }
+  void setLastSession(ActiveSessionData &&data) {
+    _lastSession = std::move(data);
+  }
   ActiveSessionData &getLastSession() { return _lastSession; }
-  void setSelectedTrack(Track t) { _selectedTrack = t; }
+  void setSelectedTrack(const Track &t) { _selectedTrack = t; }
   Track &getSelectedTrack() { return _selectedTrack; }
 
 private:
@@ -0,0 +1,64 @@
+#include "GForceWidget.h"
+
+bool GForceWidget::begin(TFT_eSPI *tft, int size, uint16_t bg) {
+  end();
+  _size = size;
+  _bg = bg;
+  _count = 0;
+  _head = 0;
+  _spr = new TFT_eSprite(tft);
+  _spr->setColorDepth(8);
+  if (!_spr->createSprite(size, size)) {
+    delete _spr;
+    _spr = nullptr;
+    return false;
+  }
+  return true;
+}
+
+void GForceWidget::end() {
+  if (_spr != nullptr) {
+    _spr->deleteSprite();
+    delete _spr;
+    _spr = nullptr;
+  }
+}
+
+void GForceWidget::addPoint(float lonG, float latG) {
+  int r = _size / 2 - 2;
+  float k = r / RANGE_G;
+  float x = constrain(latG * k, -r, r);
+  float y = constrain(-lonG * k, -r, r);
+  _trailX[_head] = (int16_t)(_size / 2 + x);
+  _trailY[_head] = (int16_t)(_size / 2 + y);
+  _head = (_head + 1) % TRAIL_LEN;
+  if (_count < TRAIL_LEN)
+    _count++;
+}
+
+void GForceWidget::render(int x, int y) {
+  if (_spr == nullptr)
+    return;
+
+  int c = _size / 2;
+  int r = c - 2;
+  _spr->fillSprite(_bg);
+
+  // 0.5 g rings and axes
+  for (float g = 0.5f; g <= RANGE_G + 0.01f; g += 0.5f)
+    _spr->drawCircle(c, c, (int)(g / RANGE_G * r), TFT_DARKGREY);
+  _spr->drawFastHLine(c - r, c, 2 * r + 1, 0x3186);
+  _spr->drawFastVLine(c, c - r, 2 * r + 1, 0x3186);
+
+  // Trail oldest first, newest point on top
+  for (int i = 0; i < _count; i++) {
+    int k = (_head + TRAIL_LEN - _count + i) % TRAIL_LEN;
+    bool newest = (i == _count - 1);
+    if (newest)
+      _spr->fillCircle(_trailX[k], _trailY[k], 4, TFT_RED);
+    else
+      _spr->fillRect(_trailX[k] - 1, _trailY[k] - 1, 2, 2, TFT_ORANGE);
+  }
+
+  _spr->pushSprite(x, y);
+}
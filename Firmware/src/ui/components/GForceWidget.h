@@ -0,0 +1,34 @@
+#ifndef G_FORCE_WIDGET_H
+#define G_FORCE_WIDGET_H
+
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+
+// Live G-G (friction circle): accelerating up, braking down, lateral G
+// to the side it pulls. Drawn into a small 8-bit sprite each frame with
+// a short fading trail, so nothing has to be erased on the panel.
+class GForceWidget {
+public:
+  bool begin(TFT_eSPI *tft, int size, uint16_t bg);
+  void end();
+  bool isValid() { return _spr != nullptr; }
+
+  void addPoint(float lonG, float latG);
+  void clearTrail() { _count = 0; }
+  void render(int x, int y);
+
+  static constexpr float RANGE_G = 1.5f; // Edge of the circle
+  static const int TRAIL_LEN = 12;
+
+private:
+  TFT_eSprite *_spr = nullptr;
+  int _size = 0;
+  uint16_t _bg = TFT_BLACK;
+
+  int16_t _trailX[TRAIL_LEN];
+  int16_t _trailY[TRAIL_LEN];
+  int _head = 0;
+  int _count = 0;
+};
+
+#endif
@@ -0,0 +1,371 @@
+#include "TrackMapRenderer.h"
+#include "../../core/SessionManager.h"
+#include <SD.h>
+
+void TrackMapRenderer::clear() {
+  _path.clear();
+  _w = 0;
+  _h = 0;
+}
+
+bool TrackMapRenderer::load(const String &source, int w, int h) {
+  clear();
+  _w = w;
+  _h = h;
+
+  File f = SD.open(source, FILE_READ);
+  if (!f)
+    return false;
+  uint32_t size = f.size();
+  f.close();
+
+  String cache = cachePath(source);
+  if (loadCache(cache, size))
+    return true;
+
+  unsigned long start = millis();
+  if (!buildFromFile(source))
+    return false;
+  Serial.printf("Map: built %s (%d pts) in %lu ms\n", source.c_str(),
+                (int)_path.size(), millis() - start);
+
+  saveCache(cache, size);
+  return true;
+}
+
+bool TrackMapRenderer::setPoints(const std::vector<GPSPoint> &points, int w,
+                                 int h) {
+  clear();
+  _w = w;
+  _h = h;
+  if (points.size() < 2)
+    return false;
+
+  GeoPoint minP = {INT32_MAX, INT32_MAX};
+  GeoPoint maxP = {INT32_MIN, INT32_MIN};
+  for (const auto &p : points) {
+    minP.latE7 = min(minP.latE7, p.latE7);
+    maxP.latE7 = max(maxP.latE7, p.latE7);
+    minP.lonE7 = min(minP.lonE7, p.lonE7);
+    maxP.lonE7 = max(maxP.lonE7, p.lonE7);
+  }
+  fitProjection(minP, maxP);
+
+  std::vector<FPoint> pts;
+  pts.reserve(points.size());
+  for (const auto &p : points)
+    pts.push_back(toPixel(p.latE7, p.lonE7));
+
+  simplify(pts, 0.75);
+  store(pts);
+  return isValid();
+}
+
+bool TrackMapRenderer::project(const GeoPoint &pos, int16_t &px,
+                               int16_t &py) {
+  if (!isValid())
+    return false;
+  FPoint p = toPixel(pos.latE7, pos.lonE7);
+  if (p.x < 0 || p.y < 0 || p.x >= _w || p.y >= _h)
+    return false;
+  px = (int16_t)(p.x + 0.5);
+  py = (int16_t)(p.y + 0.5);
+  return true;
+}
+
+void TrackMapRenderer::drawInto(TFT_eSprite &spr, uint16_t color) {
+  for (size_t i = 1; i < _path.size(); i++) {
+    spr.drawLine(_path[i - 1].x, _path[i - 1].y, _path[i].x, _path[i].y,
+                 color);
+  }
+}
+
+void TrackMapRenderer::render(TFT_eSPI *tft, int x, int y, uint16_t bg,
+                              uint16_t color) {
+  TFT_eSprite spr(tft);
+  spr.setColorDepth(8); // w*h bytes, fine without PSRAM
+  if (!spr.createSprite(_w, _h)) {
+    // Low heap: draw straight to the panel instead
+    for (size_t i = 1; i < _path.size(); i++) {
+      tft->drawLine(x + _path[i - 1].x, y + _path[i - 1].y, x + _path[i].x,
+                    y + _path[i].y, color);
+    }
+    return;
+  }
+
+  spr.fillSprite(bg);
+  drawInto(spr, color);
+  spr.pushSprite(x, y);
+  spr.deleteSprite();
+}
+
+// --- Projection ---
+
+void TrackMapRenderer::fitProjection(const GeoPoint &minP,
+                                     const GeoPoint &maxP) {
+  GeoPoint centre = {minP.latE7 + (maxP.latE7 - minP.latE7) / 2,
+                     minP.lonE7 + (maxP.lonE7 - minP.lonE7) / 2};
+  _frame.setOrigin(centre);
+
+  float spanX = _frame.xM(maxP.lonE7) - _frame.xM(minP.lonE7);
+  float spanY = _frame.yM(maxP.latE7) - _frame.yM(minP.latE7);
+  if (spanX < 1.0)
+    spanX = 1.0;
+  if (spanY < 1.0)
+    spanY = 1.0;
+
+  // Uniform scale so the track keeps its shape
+  _scale = min((_w - 2 * PADDING) / spanX, (_h - 2 * PADDING) / spanY);
+}
+
+TrackMapRenderer::FPoint TrackMapRenderer::toPixel(int32_t latE7,
+                                                   int32_t lonE7) {
+  FPoint p;
+  p.x = _w * 0.5f + _frame.xM(lonE7) * _scale;
+  p.y = _h * 0.5f - _frame.yM(latE7) * _scale;
+  return p;
+}
+
+// --- Simplification ---
+
+// Iterative Douglas-Peucker (no recursion, loop task stack is small)
+void TrackMapRenderer::simplify(std::vector<FPoint> &pts, float epsilon) {
+  size_t n = pts.size();
+  if (n < 3)
+    return;
+
+  std::vector<bool> keep(n, false);
+  keep[0] = true;
+  keep[n - 1] = true;
+
+  std::vector<std::pair<size_t, size_t>> stack;
+  stack.push_back({0, n - 1});
+  float eps2 = epsilon * epsilon;
+
+  while (!stack.empty()) {
+    size_t a = stack.back().first;
+    size_t b = stack.back().second;
+    stack.pop_back();
+    if (b <= a + 1)
+      continue;
+
+    float dx = pts[b].x - pts[a].x;
+    float dy = pts[b].y - pts[a].y;
+    float len2 = dx * dx + dy * dy;
+
+    float maxD2 = 0;
+    size_t idx = a;
+    for (size_t i = a + 1; i < b; i++) {
+      float ex = pts[i].x - pts[a].x;
+      float ey = pts[i].y - pts[a].y;
+      float d2;
+      if (len2 < 0.0001) {
+        d2 = ex * ex + ey * ey; // Closed loop: segment is a point
+      } else {
+        float cross = ex * dy - ey * dx;
+        d2 = cross * cross / len2;
+      }
+      if (d2 > maxD2) {
+        maxD2 = d2;
+        idx = i;
+      }
+    }
+
+    if (maxD2 > eps2) {
+      keep[idx] = true;
+      stack.push_back({a, idx});
+      stack.push_back({idx, b});
+    }
+  }
+
+  size_t out = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (keep[i])
+      pts[out++] = pts[i];
+  }
+  pts.resize(out);
+}
+
+void TrackMapRenderer::store(const std::vector<FPoint> &pts) {
+  _path.clear();
+  _path.reserve(pts.size());
+  for (const auto &p : pts) {
+    MapPoint m = {(int16_t)(p.x + 0.5), (int16_t)(p.y + 0.5)};
+    // Rounding can collapse neighbours onto the same pixel
+    if (!_path.empty() && _path.back().x == m.x && _path.back().y == m.y)
+      continue;
+    _path.push_back(m);
+  }
+}
+
+// --- Source files ---
+
+bool TrackMapRenderer::parsePoint(const char *s, int32_t &latE7,
+                                  int32_t &lonE7) {
+
+  // GPX: <trkpt lat="..." lon="...">
+  const char *la = strstr(s, "lat=\"");
+  if (la) {
+    const char *lo = strstr(s, "lon=\"");
+    if (!lo || !parseE7(la + 5, latE7) || !parseE7(lo + 5, lonE7))
+      return false;
+    return !(latE7 == 0 && lonE7 == 0);
+  }
+
+  if ((*s < '0' || *s > '9') && *s != '-')
+    return false; // Header, LAP/SECTOR lines
+
+  const char *c1 = strchr(s, ',');
+  if (!c1)
+    return false;
+  const char *c2 = strchr(c1 + 1, ',');
+
+  const char *dot = strchr(s, '.');
+  if (c2 && (!dot || dot > c1)) {
+    // Session log: Time,Lat,Lon,...
+    if (!parseE7(c1 + 1, latE7) || !parseE7(c2 + 1, lonE7))
+      return false;
+  } else {
+    // Track path: Lat,Lon[,...]
+    if (!parseE7(s, latE7) || !parseE7(c1 + 1, lonE7))
+      return false;
+  }
+  return !(latE7 == 0 && lonE7 == 0); // Rows logged without a fix
+}
+
+bool TrackMapRenderer::buildFromFile(const String &source) {
+  File f = SD.open(source, FILE_READ);
+  if (!f)
+    return false;
+
+  // Pass 1: bounding box
+  GeoPoint minP = {INT32_MAX, INT32_MAX};
+  GeoPoint maxP = {INT32_MIN, INT32_MIN};
+  int32_t lat, lon;
+  int count = 0;
+  bool read = SessionManager::forEachLine(f, [&](const char *line, size_t) {
+    if (!parsePoint(line, lat, lon))
+      return true;
+    minP.latE7 = min(minP.latE7, lat);
+    maxP.latE7 = max(maxP.latE7, lat);
+    minP.lonE7 = min(minP.lonE7, lon);
+    maxP.lonE7 = max(maxP.lonE7, lon);
+    count++;
+    return true;
+  });
+  if (!read || count < 2) {
+    f.close();
+    return false;
+  }
+  fitProjection(minP, maxP);
+
+  // Pass 2: project, drop sub-pixel steps, simplify a chunk whenever the
+  // buffer fills. A simplified chunk is final (each point goes through
+  // Douglas-Peucker once, so the error stays within epsilon); only its
+  // last point stays behind to anchor the next chunk.
+  f.seek(0);
+  std::vector<FPoint> pts;
+  std::vector<FPoint> chunk;
+  chunk.reserve(MAX_BUFFER);
+  auto push = [&](const FPoint &p) {
+    if (chunk.size() >= MAX_BUFFER) {
+      simplify(chunk, 0.75);
+      pts.insert(pts.end(), chunk.begin(), chunk.end() - 1);
+      chunk.erase(chunk.begin(), chunk.end() - 1);
+    }
+    chunk.push_back(p);
+  };
+  FPoint pending;
+  bool hasPending = false;
+
+  read = SessionManager::forEachLine(f, [&](const char *line, size_t) {
+    if (!parsePoint(line, lat, lon))
+      return true;
+
+    FPoint p = toPixel(lat, lon);
+    if (!chunk.empty() && fabs(p.x - chunk.back().x) < 1.0 &&
+        fabs(p.y - chunk.back().y) < 1.0) {
+      pending = p; // A sub-pixel run: only its last point is kept
+      hasPending = true;
+      return true;
+    }
+    if (hasPending)
+      push(pending); // Where the run ended, e.g. a slow hairpin
+    hasPending = false;
+    push(p);
+    return true;
+  });
+  f.close();
+  if (!read)
+    return false;
+
+  if (hasPending)
+    push(pending);
+
+  simplify(chunk, 0.75);
+  pts.insert(pts.end(), chunk.begin(), chunk.end());
+  store(pts);
+  return isValid();
+}
+
+// --- Cache ---
+
+String TrackMapRenderer::cachePath(const String &source) {
+  String key = source;
+  if (key.startsWith("/"))
+    key = key.substring(1);
+  key.replace("/", "_");
+  key.replace(".", "_");
+  return "/maps/" + key + "_" + String(_w) + "x" + String(_h) + ".bin";
+}
+
+bool TrackMapRenderer::loadCache(const String &path, uint32_t sourceSize) {
+  File f = SD.open(path, FILE_READ);
+  if (!f)
+    return false;
+
+  CacheHeader hdr;
+  bool ok = f.read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+            hdr.magic == CACHE_MAGIC && hdr.sourceSize == sourceSize &&
+            hdr.w == _w && hdr.h == _h && hdr.count >= 2;
+
+  if (ok) {
+    _path.resize(hdr.count);
+    size_t bytes = hdr.count * sizeof(MapPoint);
+    ok = f.read((uint8_t *)_path.data(), bytes) == bytes;
+  }
+  f.close();
+
+  if (!ok) {
+    _path.clear();
+    return false; // Stale or damaged, rebuild
+  }
+
+  _frame.setOrigin(hdr.origin);
+  _frame.mmPerE7Lon = hdr.mmPerE7Lon;
+  _scale = hdr.scale;
+  return true;
+}
+
+void TrackMapRenderer::saveCache(const String &path, uint32_t sourceSize) {
+  if (!SD.exists("/maps"))
+    SD.mkdir("/maps");
+
+  File f = SD.open(path, FILE_WRITE);
+  if (!f)
+    return;
+
+  CacheHeader hdr;
+  hdr.magic = CACHE_MAGIC;
+  hdr.sourceSize = sourceSize;
+  hdr.w = _w;
+  hdr.h = _h;
+  hdr.origin = _frame.origin;
+  hdr.mmPerE7Lon = _frame.mmPerE7Lon;
+  hdr.scale = _scale;
+  hdr.count = _path.size();
+
+  f.write((uint8_t *)&hdr, sizeof(hdr));
+  f.write((uint8_t *)_path.data(), _path.size() * sizeof(MapPoint));
+  f.close();
+}
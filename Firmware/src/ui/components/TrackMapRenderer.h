@@ -0,0 +1,83 @@
+#ifndef TRACK_MAP_RENDERER_H
+#define TRACK_MAP_RENDERER_H
+
+#include "../../config.h"
+#include "../screens/TrackData.h"
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+#include <vector>
+
+// Track outline fitted to a pixel box.
+// The path is projected once, simplified with Douglas-Peucker to ~1 px and
+// cached on SD (/maps) as an int16 polyline, so showing a map afterwards is
+// one small file read plus one sprite push.
+class TrackMapRenderer {
+public:
+  struct MapPoint {
+    int16_t x;
+    int16_t y;
+  };
+
+  // Load outline for a track (.gpx / lat,lon .csv) or a session log.
+  // Uses the SD cache when it is still valid for the source file.
+  bool load(const String &source, int w, int h);
+
+  // Build from points already in RAM (not cached)
+  bool setPoints(const std::vector<GPSPoint> &points, int w, int h);
+
+  void clear();
+  bool isValid() { return _path.size() >= 2; }
+  const std::vector<MapPoint> &getPath() { return _path; }
+
+  // Box-relative pixel position of a coordinate. False if outside the box.
+  bool project(const GeoPoint &pos, int16_t &px, int16_t &py);
+
+  // Draw the outline into a sprite of the box size
+  void drawInto(TFT_eSprite &spr, uint16_t color);
+
+  // Draw the outline at (x, y) through a temporary 8-bit sprite
+  void render(TFT_eSPI *tft, int x, int y, uint16_t bg, uint16_t color);
+
+private:
+  static const uint32_t CACHE_MAGIC = 0x32504D54; // "TMP2"
+  static const int MAX_BUFFER = 1024; // Points per simplified chunk
+  static const int PADDING = 4;       // px kept free around the outline
+
+  struct CacheHeader {
+    uint32_t magic;
+    uint32_t sourceSize;
+    int16_t w;
+    int16_t h;
+    GeoPoint origin;
+    float mmPerE7Lon;
+    float scale; // px per metre
+    uint16_t count;
+  };
+
+  struct FPoint {
+    float x;
+    float y;
+  };
+
+  std::vector<MapPoint> _path;
+  int _w = 0;
+  int _h = 0;
+
+  // Projection (flat frame around the box centre)
+  LocalFrame _frame;
+  float _scale = 1.0;
+
+  void fitProjection(const GeoPoint &minP, const GeoPoint &maxP);
+  FPoint toPixel(int32_t latE7, int32_t lonE7);
+  void simplify(std::vector<FPoint> &pts, float epsilon);
+  void store(const std::vector<FPoint> &pts);
+
+  bool buildFromFile(const String &source);
+  static bool parsePoint(const char *line, int32_t &latE7, int32_t &lonE7);
+
+  String cachePath(const String &source);
+  bool loadCache(const String &path, uint32_t sourceSize);
+  void saveCache(const String &path, uint32_t sourceSize);
+};
+
+#endif
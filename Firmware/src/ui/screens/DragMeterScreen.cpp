@@ -26,7 +26,7 @@ void DragMeterScreen::onShow() {
   _lastTapIdx = -1;
   _lastTapTime = 0;
   _menuItems = {"DRAG MODE", "DRAG SCREEN", "PREDICTIVE", "SUMMARY"};
-  _dragModeItems = {"SPEED", "DISTANCE", "CUSTOM"};
+  _dragModeItems = {"SPEED", "DISTANCE", "BRAKING", "CUSTOM"};
   _predictiveItems = {"NORMAL MODE", "PREDICTIVE MODE"};
 
   _predictiveItems = {"NORMAL MODE", "PREDICTIVE MODE"};
@@ -37,6 +37,7 @@ void DragMeterScreen::onShow() {
 
   _currentSpeed = 0.0;
   _slope = 0.0;
+  _slopeConf = 0.0;
   _highlightTitle = "400 m";
   _highlightValue = "--.--";
 
@@ -49,8 +50,6 @@ void DragMeterScreen::onShow() {
 
   // Reset Run State
   _runState = RUN_WAITING;
-  _oneFootReached = false;
-  _startPosition = 0;
 
   // Load Settings
   Preferences p;
@@ -64,8 +63,6 @@ void DragMeterScreen::onShow() {
     _targetTime = targets[targetIdx];
   else
     _targetTime = 10.0;
-
-  _referenceTime = p.getFloat("drag_ref", 0.0);
   p.end();
 
   if (treeIdx <= 5)
@@ -77,11 +74,17 @@ void DragMeterScreen::onShow() {
 
   _displayMode = DISPLAY_NORMAL;
   _predictedFinalTime = 0;
+  loadReferenceRun();
+  armEngine();
 
   _summaryShowBest = false;
   _sessionBest.clear();
 }
 
+void DragMeterScreen::onHide() {
+  gpsManager.setActivityProfile(GPSManager::PROFILE_IDLE);
+}
+
 void DragMeterScreen::update() {
   static unsigned long lastDragTouch = 0;
   UIManager::TouchPoint p = _ui->getTouchPoint();
@@ -117,6 +120,7 @@ void DragMeterScreen::update() {
           } else {
             // If in running mode, go back to menu
             _state = STATE_MENU;
+            gpsManager.setActivityProfile(GPSManager::PROFILE_IDLE);
             _ui->setTitle("DRAG METER");
             _ui->getTft()->fillScreen(_ui->getBackgroundColor());
             drawDashboardStatic();
@@ -266,7 +270,12 @@ void DragMeterScreen::update() {
       // Christmas Tree Logic
       unsigned long elapsed = millis() - _startTime;
       if (elapsed >= _treeInterval) {
-        // GO!
+        // GO! Still on the line: the slope is measured from here
+        _startLat = gpsManager.getLatitude();
+        _startLon = gpsManager.getLongitude();
+        _startAlt = gpsManager.getAltitude();
+        _totalRunDistance = 0;
+        _slopeFit.add(0, _startAlt);
         _runState = RUN_RUNNING;
         _runStartTime = millis();                             // Start timer
         _ui->getTft()->fillScreen(_ui->getBackgroundColor()); // Clear tree
@@ -276,67 +285,86 @@ void DragMeterScreen::update() {
       }
     } else if (_runState == RUN_RUNNING) {
       checkStopCondition();
+      sessionManager.logChannels();
       updateDisciplines();
     }
     drawDashboardDynamic();
   }
 }
 
-void DragMeterScreen::checkStartCondition() {
+// Fresh run: engine targets follow the current disciplines
+void DragMeterScreen::armEngine() {
+  _runState = RUN_WAITING;
+  _brakingMeasurable = false;
+  _brakingStartSpeed = 0;
+  _engine.clearTargets();
+  _braking.clearTargets();
+  for (auto &d : _disciplines) {
+    if (d.isBraking)
+      _braking.addTarget(d.startSpeed, d.target);
+    else if (d.isDistance)
+      _engine.addDistanceTarget(d.target);
+    else
+      _engine.addSpeedTarget(d.startSpeed, d.target);
+    d.completed = false;
+    d.resultTime = 0;
+    d.endSpeed = 0;
+    d.peakSpeed = 0;
+    d.brakingDistance = 0;
+    d.avgDecel = 0;
+    d.peakDecel = 0;
+  }
+  _engine.setRollout(_rolloutEnabled);
+  _engine.reset();
+  _braking.reset();
+  _slopeFit.reset(); // Seeded with the launch point by either start
+  _lastFixCount = gpsManager.getFixCount();
+
+  // Prediction of the final discipline against the reference run
+  _runProfile.clear();
+  _predictedFinalTime = 0;
+  _predictionBand = 0;
+  _referenceTime = 0;
+  int idx = predictedDiscipline();
+  if (idx >= 0) {
+    const Discipline &d = _disciplines[idx];
+    _predictor.begin(&_refProfile, d.isDistance, d.target);
+    _referenceTime = _predictor.getReferenceTime() / 1000.0;
+  }
+}
+
+bool DragMeterScreen::feedEngine() {
+  uint32_t fixCount = gpsManager.getFixCount();
+  if (fixCount == _lastFixCount)
+    return false;
+  _lastFixCount = fixCount;
+  uint32_t t = gpsManager.getFixTimeMs();
   float speed = gpsManager.getSpeedKmph();
-  if (speed > 1.0) { // Moving (> 1 km/h)
-    unsigned long now = millis();
+  _engine.addSample(t, speed);
+  _braking.addSample(t, speed);
+  return true;
+}
 
-    if (_runState == RUN_WAITING) {
-      // First motion detection
+void DragMeterScreen::checkStartCondition() {
+  if (!feedEngine())
+    return;
+
+  if (_engine.getState() == DragEngine::WAITING) {
+    // Still standing: slope is measured from here
+    if (gpsManager.getSpeedKmph() < DragEngine::LAUNCH_KMH) {
       _startLat = gpsManager.getLatitude();
       _startLon = gpsManager.getLongitude();
       _startAlt = gpsManager.getAltitude();
-      _startPosition = 0;
       _totalRunDistance = 0;
     }
-
-    if (_rolloutEnabled) {
-      // For rollout, we track distance from initial movement
-      double dist = gpsManager.distanceBetween(_startLat, _startLon,
-                                               gpsManager.getLatitude(),
-                                               gpsManager.getLongitude());
-      _startPosition = dist; // approximate rollout distance
-      _lastUpdate = now;
-
-      if (_startPosition >= 0.3048) { // 1 ft
-        _runState = RUN_RUNNING;
-        _runStartTime = now;
-        // Start "official" run from here
-        _startLat = gpsManager.getLatitude();
-        _startLon = gpsManager.getLongitude();
-        _startAlt = gpsManager.getAltitude();
-
-        // Reset disciplines
-        for (auto &d : _disciplines) {
-          d.completed = false;
-          d.resultTime = 0;
-        }
-      }
-
-    } else {
-      // Immediate Start
-      _runState = RUN_RUNNING;
-      _runStartTime = millis();
-      // Reset disciplines
-      for (auto &d : _disciplines) {
-        d.completed = false;
-        d.resultTime = 0;
-      }
-    }
-
-    if (_runState == RUN_RUNNING) {
-      sessionManager.startSession();
-    }
-  } else {
-    _lastUpdate = millis(); // Keep updating time while stationary
-    _startPosition = 0;     // Reset rollout if stopped
+    return;
   }
+
+  // Launched (back-dated by the engine, rollout included)
+  _slopeFit.add(0, _startAlt);
+  _runState = RUN_RUNNING;
+  _runStartTime = millis();
+  sessionManager.startSession();
 }
 
 // ... functions ...
@@ -350,8 +378,6 @@ void DragMeterScreen::drawPredictiveMode() {
   tft->setFreeFont(&Org_01);
   tft->setTextSize(6); // Very big
 
-  calculatePrediction();
-
   String timeStr;
   if (_predictedFinalTime > 0) {
     timeStr = String(_predictedFinalTime, 2);
@@ -360,8 +386,17 @@ void DragMeterScreen::drawPredictiveMode() {
   }
   tft->drawString(timeStr, SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2);
 
-  // Delta to Target
+  // Confidence band
   tft->setTextSize(2);
+  tft->setTextColor(_ui->getTextColor(), _ui->getBackgroundColor());
+  String bandStr = "";
+  if (_predictedFinalTime > 0 && _predictionBand > 0)
+    bandStr = "+/- " + String(_predictionBand, 2) + "s";
+  tft->fillRect(SCREEN_WIDTH / 2 - 80, SCREEN_HEIGHT / 2 + 20, 160, 20,
+                _ui->getBackgroundColor());
+  tft->drawString(bandStr, SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 + 30);
+
+  // Delta to Target
   if (_targetTime > 0 && _predictedFinalTime > 0) {
     float delta = _predictedFinalTime - _targetTime;
     uint16_t color = _ui->getTextColor();
@@ -376,45 +411,53 @@ void DragMeterScreen::drawPredictiveMode() {
   }
 }
 
-void DragMeterScreen::calculatePrediction() {
-  // Basic prediction: Use reference time
-  _predictedFinalTime = _referenceTime;
+// Last discipline timed from the launch: the run's final time
+int DragMeterScreen::predictedDiscipline() {
+  for (int i = (int)_disciplines.size() - 1; i >= 0; i--) {
+    if (_disciplines[i].startSpeed <= 0)
+      return i;
+  }
+  return -1;
 }
 
-void DragMeterScreen::saveReferenceRun() {
-  if (_disciplines.empty())
-    return;
+// Per epoch: this run's profile grows, the prediction follows it
+void DragMeterScreen::calculatePrediction(float runTimeMs) {
+  _runProfile.addSample(runTimeMs, _totalRunDistance, _currentSpeed);
+  _predictor.addSample(runTimeMs, _totalRunDistance, _currentSpeed);
 
-  // Calculate final time of the longest discipline?
-  // We iterate to find the longest target discipline.
-  // Simplifying: The last one is usually the longest or the "Result".
-  Discipline *best = nullptr;
-  for (auto &d : _disciplines) {
-    if (d.completed)
-      best = &d;
+  if (_predictor.isValid()) {
+    _predictedFinalTime = _predictor.getPredicted() / 1000.0;
+    _predictionBand = _predictor.getBand() / 1000.0;
+  } else {
+    _predictedFinalTime = 0;
+    _predictionBand = 0;
   }
+}
 
-  if (best && best->completed) {
-    float runTime = best->resultTime / 1000.0;
+void DragMeterScreen::loadReferenceRun() {
+  if (!sessionManager.loadDragReference(_refProfile))
+    Serial.println("Drag: no reference run yet");
+}
 
-    // Save if faster (runTime < _referenceTime) or if no reference exists
-    // Note: Faster means LOWER time.
-    if (_referenceTime <= 0.0 || runTime < _referenceTime) {
-      _referenceTime = runTime;
+void DragMeterScreen::saveReferenceRun() {
+  int idx = predictedDiscipline();
+  if (idx < 0 || !_disciplines[idx].completed)
+    return;
 
-      Preferences p;
-      p.begin("laptimer", false);
-      p.putFloat("drag_ref", _referenceTime);
-      p.end();
+  // Faster (lower) than the reference for this discipline, or none yet:
+  // the whole profile becomes the new reference
+  float runTime = _disciplines[idx].resultTime / 1000.0;
+  if (_referenceTime <= 0.0 || runTime < _referenceTime) {
+    if (sessionManager.saveDragReference(_runProfile)) {
+      _refProfile = _runProfile;
+      _referenceTime = runTime;
     }
   }
 }
 
 void DragMeterScreen::checkStopCondition() {
-  // If speed drops to 0 and we have been running for a bit?
-  // Or simply if speed < 1.0
-  if (gpsManager.getSpeedKmph() < 5.0) {
-    // Only stop if we actually started (which we did if we are here)
+  // Slowed down below 5 km/h after the launch
+  if (_engine.getState() == DragEngine::FINISHED) {
 
     saveReferenceRun(); // Save if good run
 
@@ -442,6 +485,7 @@ void DragMeterScreen::checkStopCondition() {
                                         "DRAG");
 
     _runState = RUN_FINISHED;
+    gpsManager.setActivityProfile(GPSManager::PROFILE_IDLE);
 
     // Go to Summary
     _state = STATE_SUMMARY_VIEW;
@@ -451,84 +495,113 @@ void DragMeterScreen::checkStopCondition() {
 }
 
 void DragMeterScreen::updateDisciplines() {
+  if (!feedEngine())
+    return;
+
   float speed = gpsManager.getSpeedKmph();
-  unsigned long now = millis();
-  unsigned long runTime = now - _runStartTime;
+  float runTime = _engine.getRunTime(gpsManager.getFixTimeMs());
 
-  // Geometric Distance
   double currentLat = gpsManager.getLatitude();
   double currentLon = gpsManager.getLongitude();
   double currentAlt = gpsManager.getAltitude();
 
-  // Calculate total run distance from start point
-  _totalRunDistance =
-      gpsManager.distanceBetween(_startLat, _startLon, currentLat, currentLon);
+  // Distance along the driven path since the start (rollout excluded)
+  _totalRunDistance = _engine.getDistance();
 
   _currentSpeed = speed;
 
-  // Calculate Slope: (Rise / Run) * 100
-  // Only valid if we have moved enough to reduce GPS altitude noise impact
-  if (_totalRunDistance > 50.0) {
-    float rise = currentAlt - _startAlt;
-    _slope = (rise / _totalRunDistance) * 100.0;
-  } else {
-    _slope = 0.0;
-  }
+  // Slope: altitude against path distance, every fix of the run (0 until
+  // the fit spans 50 m)
+  _slopeFit.add(_totalRunDistance, currentAlt);
+  _slope = _slopeFit.getSlope();
+  _slopeConf = _slopeFit.getConfidence();
+
+  if (runTime > 0)
+    calculatePrediction(runTime);
 
   // LOG DATA
   if (_runState == RUN_RUNNING && sessionManager.isLogging()) {
-    // Time,Lat,Lon,Speed,Sats,Alt,Heading
-    String data = String(millis()) + "," + String(currentLat, 7) + "," +
+    // Time,Lat,Lon,Speed,Sats,Alt,Heading,LonG,LatG,Gear
+    uint32_t now = gpsManager.getFixTimeMs();
+    String data = String(now) + "," + String(currentLat, 7) + "," +
                   String(currentLon, 7) + "," + String(speed, 2) + "," +
                   String(gpsManager.getSatellites()) + "," +
                   String(currentAlt, 2) + "," +
-                  String(gpsManager.getHeading(), 2);
+                  String(gpsManager.getHeading(), 2) + "," +
+                  String(gpsManager.getLonG(), 2) + "," +
+                  String(gpsManager.getLatG(), 2) + "," +
+                  String(gpsManager.getGear());
+    // Input order: speed, alt, heading, long, latg, rpm, gear
+    float in[MathChannels::IN_COUNT] = {
+        speed, (float)currentAlt, (float)gpsManager.getHeading(),
+        gpsManager.getLonG(), gpsManager.getLatG(),
+        (float)gpsManager.getRPM(), (float)gpsManager.getGear()};
+    sessionManager.logMathChannels(now, in);
+    sessionManager.logChannels(true);
     sessionManager.logData(data);
   }
 
-  // Check disciplines
-  bool allComplete = true;
-  for (auto &d : _disciplines) {
-    if (!d.completed) {
-      allComplete = false;
-
-      d.slope = _slope; // Capture current slope
-
-      // Peak Speed
-      if (speed > d.peakSpeed)
-        d.peakSpeed = speed;
-
-      if (d.isDistance) {
-        if (_totalRunDistance >= d.target) {
-          d.completed = true;
-          d.resultTime = runTime;
-          d.endSpeed = speed;
-          // Validate slope: < -1.0% invalid (NHRA rule approx)
-          d.valid = (d.slope >= -1.0);
-        }
-      } else {
-        if (speed >= d.target) {
-          d.completed = true;
-          d.resultTime = runTime;
-          d.valid = (d.slope >= -1.0);
-        }
-      }
+  // Results come from the engines, interpolated between epochs. Targets
+  // were added in discipline order, braking ones to the braking engine.
+  int engineIdx = 0;
+  int brakingIdx = 0;
+  for (size_t i = 0; i < _disciplines.size(); i++) {
+    Discipline &d = _disciplines[i];
+    int ei = d.isBraking ? brakingIdx++ : engineIdx++;
+    if (d.completed)
+      continue;
+
+    d.slope = _slope; // Capture current slope
+
+    // Peak Speed
+    if (speed > d.peakSpeed)
+      d.peakSpeed = speed;
+
+    if (d.isBraking) {
+      const BrakingEngine::Target &b = _braking.getTarget(ei);
+      if (!b.done)
+        continue;
+      d.resultTime = lroundf(b.time);
+      d.endSpeed = d.target;
+      d.brakingDistance = b.distance;
+      d.avgDecel = b.avgDecel;
+      d.peakDecel = b.peakDecel;
+      logBraking(d.startSpeed, d.target, b.time, b.distance, b.avgDecel,
+                 b.peakDecel);
+    } else {
+      const DragEngine::Target &t = _engine.getTarget(ei);
+      if (!t.done)
+        continue;
+      d.resultTime = lroundf(t.resultTime);
+      d.endSpeed = t.endSpeed;
     }
+    d.completed = true;
+    // Validate slope: steeper than -1.0% invalid (NHRA rule approx),
+    // only when the fit is sure of it
+    d.valid = !_slopeFit.isTooSteepDownhill(1.0);
   }
 
-  // Run Finishing Logic
-  if (allComplete) {
-    if (!_brakingMeasurable) {
-      _brakingMeasurable = true; // Mark as finished phase
-    }
+  // Run Finishing Logic (the stop itself is checkStopCondition)
+  if (_engine.allDone() && !_brakingMeasurable) {
+    _brakingMeasurable = true; // Mark as finished phase
+  }
 
-    // Auto-Stop Condition: Speed drops low OR timeout
-    if (speed < 5.0) {
-      _oneFootReached = false; // reset flag reuse
-      // Call stop/save
-      checkStopCondition(); // This function will see speed < 5.0 logic if
-                            // updated
+  // The stop that ends the run: onset to standstill
+  if (_braking.hasStop() && _brakingStartSpeed == 0) {
+    _brakingStartSpeed = _braking.getOnsetSpeed();
+    float stopTime = _braking.getStopTime();
+    float avg = (stopTime > 0) ? _brakingStartSpeed / 3.6f /
+                                     (stopTime / 1000.0f) / BrakingEngine::G
+                               : 0;
+    for (auto &d : _disciplines) {
+      if (d.isBraking)
+        continue;
+      d.brakingDistance = _braking.getStopDistance();
+      d.avgDecel = avg;
+      d.peakDecel = _braking.getPeakDecel();
     }
+    logBraking(_brakingStartSpeed, 0, stopTime, _braking.getStopDistance(),
+               avg, _braking.getPeakDecel());
   }
 
   // Update highlight
@@ -542,6 +615,18 @@ void DragMeterScreen::updateDisciplines() {
   }
 }
 
+// Session log event, next to the fixes:
+// BRAKE,fromKmh,toKmh,timeMs,distanceM,avgG,peakG
+void DragMeterScreen::logBraking(float fromKmh, float toKmh, float timeMs,
+                                 float distance, float avgG, float peakG) {
+  if (!sessionManager.isLogging())
+    return;
+  char ev[64];
+  snprintf(ev, sizeof(ev), "BRAKE,%.1f,%.1f,%lu,%.2f,%.3f,%.3f", fromKmh,
+           toKmh, (unsigned long)lroundf(timeMs), distance, avgG, peakG);
+  sessionManager.logData(String(ev));
+}
+
 void DragMeterScreen::startChristmasTree() {
   _runState = RUN_COUNTDOWN;
   _startTime = millis();
@@ -583,6 +668,8 @@ void DragMeterScreen::handleMenuTouch(int idx) {
   String &item = _menuItems[idx];
   if (item == "DRAG SCREEN") {
     _state = STATE_RUNNING;
+    armEngine();
+    gpsManager.setActivityProfile(GPSManager::PROFILE_SESSION);
     _ui->setTitle("DRAG METER");
     _ui->getTft()->fillScreen(_ui->getBackgroundColor());
     drawDashboardStatic();
@@ -612,6 +699,8 @@ void DragMeterScreen::handleDragModeTouch(int idx) {
 
     // Go to Running View
     _state = STATE_RUNNING;
+    armEngine();
+    gpsManager.setActivityProfile(GPSManager::PROFILE_SESSION);
     _ui->setTitle("DRAG METER");
     _ui->getTft()->fillScreen(_ui->getBackgroundColor());
     drawDashboardStatic();
@@ -625,7 +714,7 @@ void DragMeterScreen::loadDisciplines(int modeIdx) {
     // SPEED MODE
     // 0-60 kph, 0-100 kph, 100-200 kph, 0-200 kph
     // Fields: name, isDist, start, target, resTime, compl, endSpd, slope,
-    // peakSpd, brakeDist, valid
+    // peakSpd, brakeDist, valid[, isBraking]
     _disciplines.push_back({"0-60", false, 0, 60, 0, false, 0, 0, 0, 0, true});
     _disciplines.push_back(
         {"0-100", false, 0, 100, 0, false, 0, 0, 0, 0, true});
@@ -649,6 +738,19 @@ void DragMeterScreen::loadDisciplines(int modeIdx) {
     _highlightTitle = "400 m";
     _highlightValue = "--.--";
 
+  } else if (modeIdx == 2) {
+    // BRAKING MODE
+    // Accelerate past 100 km/h, then brake to a stop
+    _disciplines.push_back(
+        {"0-100", false, 0, 100, 0, false, 0, 0, 0, 0, true, false});
+    _disciplines.push_back(
+        {"100-0", false, 100, 0, 0, false, 0, 0, 0, 0, true, true});
+    _disciplines.push_back(
+        {"60-0", false, 60, 0, 0, false, 0, 0, 0, 0, true, true});
+
+    _highlightTitle = "0-100";
+    _highlightValue = "--.--";
+
   } else {
     // CUSTOM (Placeholder)
     _disciplines.push_back(
@@ -800,7 +902,8 @@ void DragMeterScreen::drawDashboardDynamic() {
   tft->setFreeFont(&Org_01); // Back to Org_01
   tft->setTextSize(1);
   tft->setTextDatum(TL_DATUM);
-  tft->drawString(String(_slope, 1) + "%", 40, SCREEN_HEIGHT - 15);
+  tft->drawString(String(_slope, 1) + "% +/-" + String(_slopeConf, 1) + "  ",
+                  40, SCREEN_HEIGHT - 15);
 }
 
 void DragMeterScreen::drawSummary() {
@@ -905,9 +1008,12 @@ void DragMeterScreen::drawSummary() {
       tft->drawString("-", 110, rowY);
     }
 
-    // End Speed
+    // End Speed (braking: distance, same interpolation as the time)
     tft->setTextDatum(TR_DATUM);
-    if (d.completed) {
+    if (d.completed && d.isBraking) {
+      tft->drawString(String(d.brakingDistance, 1) + "m", SCREEN_WIDTH - 45,
+                      rowY);
+    } else if (d.completed) {
       tft->drawString(String(d.endSpeed, 1), SCREEN_WIDTH - 45, rowY);
     } else {
       tft->drawString("-", SCREEN_WIDTH - 45, rowY);
@@ -926,13 +1032,19 @@ void DragMeterScreen::drawSummary() {
   tft->setTextDatum(TL_DATUM);
   tft->drawString("Brk Dist:", 10, SCREEN_HEIGHT - 20);
 
+  // Onset to standstill of the stop that ended the run, peak over 200 ms
   float brakeDist = 0;
-  if (!data->empty())
-    brakeDist = data->back().brakingDistance;
+  float peakG = 0;
+  for (const auto &d : *data) {
+    if (!d.isBraking) {
+      brakeDist = d.brakingDistance;
+      peakG = d.peakDecel;
+    }
+  }
 
   tft->setTextDatum(TR_DATUM);
-  tft->drawString(String(brakeDist, 1) + " m", SCREEN_WIDTH - 10,
-                  SCREEN_HEIGHT - 20);
+  tft->drawString(String(brakeDist, 1) + " m  " + String(peakG, 2) + " g",
+                  SCREEN_WIDTH - 10, SCREEN_HEIGHT - 20);
 
   _ui->drawStatusBar(true);
 }
@@ -1046,6 +1158,8 @@ void DragMeterScreen::handlePredictiveTouch(int idx) {
   } else {
     // Normal Mode - maybe back to drag screen?
     _state = STATE_RUNNING;
+    armEngine();
+    gpsManager.setActivityProfile(GPSManager::PROFILE_SESSION);
     _ui->getTft()->fillScreen(COLOR_BG);
     drawDashboardStatic();
   }
@@ -1,6 +1,10 @@
 #ifndef DRAG_METER_SCREEN_H
 #define DRAG_METER_SCREEN_H
 
+#include "../../core/BrakingEngine.h"
+#include "../../core/DragEngine.h"
+#include "../../core/DragPredictor.h"
+#include "../../core/SlopeEstimator.h"
 #include "../UIManager.h"
 #include <Arduino.h>
 #include <vector>
@@ -9,6 +13,7 @@ class DragMeterScreen : public UserScreen {
 public:
   void begin(UIManager *ui) override { _ui = ui; }
   void onShow() override;
+  void onHide() override;
   void update() override;
 
 private:
@@ -34,23 +39,27 @@ private:
     float peakSpeed;       // kph
     float brakingDistance; // meters
     bool valid;            // slope check
+    bool isBraking;        // startSpeed down to target (km/h)
+    float avgDecel;        // g
+    float peakDecel;       // g
   };
 
   std::vector<Discipline> _disciplines;
   std::vector<Discipline> _sessionBest;
   bool _summaryShowBest;
 
-  float _brakingStartDistance;
-  bool _brakingMeasurable;
+  float _brakingStartSpeed; // km/h, onset of the last stop
+  bool _brakingMeasurable;   // All acceleration targets done
   float _totalRunDistance;
 
   unsigned long _startTime;
-  unsigned long _lastUpdate;
   int _selectedBtn; // -1:None, 0:Back, 1:Reset
 
   // Display Data
   float _currentSpeed;
-  float _slope;
+  float _slope;     // %, least-squares fit of the run so far
+  float _slopeConf; // +/- %
+  SlopeEstimator _slopeFit;
   String _highlightTitle;
   String _highlightValue;
 
@@ -78,17 +87,24 @@ private:
   void checkStopCondition();
   void updateDisciplines();
   void loadDisciplines(int modeIdx);
+  void armEngine();
+  bool feedEngine(); // True when a new fix went in
+  void logBraking(float fromKmh, float toKmh, float timeMs, float distance,
+                  float avgG, float peakG);
 
   // Advanced Run Logic
   enum RunState { RUN_WAITING, RUN_COUNTDOWN, RUN_RUNNING, RUN_FINISHED };
   RunState _runState;
 
   bool _rolloutEnabled;
-  bool _oneFootReached;
   unsigned long _treeInterval;
   unsigned long _reactionTime;
   unsigned long _runStartTime;
-  float _startPosition; // To track distance for rollout
+
+  // Timing per GNSS epoch (launch, rollout, interpolated targets)
+  DragEngine _engine;
+  BrakingEngine _braking; // Same epochs: onset, stop, braking targets
+  uint32_t _lastFixCount = 0;
 
   // Geometric Tracking
   double _startLat = 0.0;
@@ -103,10 +119,17 @@ private:
   DisplayMode _displayMode;
 
   float _targetTime;
-  float _referenceTime; // Best run time
+  float _referenceTime; // Reference run, predicted discipline (s)
   float _predictedFinalTime;
+  float _predictionBand; // +/- s
+
+  // Whole run profiles: this run and the reference (SD)
+  DragProfile _runProfile;
+  DragProfile _refProfile;
+  DragPredictor _predictor;
 
-  void calculatePrediction();
+  int predictedDiscipline();
+  void calculatePrediction(float runTimeMs);
   void saveReferenceRun();
   void loadReferenceRun();
 
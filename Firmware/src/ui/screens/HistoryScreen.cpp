@@ -9,6 +9,7 @@ void HistoryScreen::onShow() {
   _scrollOffset = 0;
   _currentMode = MODE_MENU; // Start at Menu
   _selectedIdx = -1;
+  _cmpFailed = "";
   scanHistory();
 
   // Reset Variables
@@ -49,6 +50,8 @@ void HistoryScreen::update() {
   // Status Bar Update - Handled by UIManager globally
   // if (millis() - lastStatusUpdate > 1000) { ... }
 
+  pollJob();
+
   UIManager::TouchPoint p = _ui->getTouchPoint();
   bool isTouching = (p.x != -1);
 
@@ -284,12 +287,21 @@ void HistoryScreen::update() {
         int startY = 60;
         int h = 50;
         int idx = (ty - startY) / h;
-        if (idx >= 0 && idx < 3) {
+        bool busy = _lastTapIdx >= 0 && _lastTapIdx < _historyList.size() &&
+                    sessionManager.getJobState() ==
+                        SessionManager::JOB_RUNNING &&
+                    sessionManager.getJobFile() ==
+                        _historyList[_lastTapIdx].filename;
+        if (idx >= 0 && idx < 4 && idx != 1 && busy) {
+          _ui->showToast("BUSY, TRY AGAIN", 1500); // Log being rewritten
+        } else if (idx >= 0 && idx < 4) {
           _selectedIdx = idx;
           drawOptions();
           if (idx == 0) { // View Data
             _currentMode = MODE_VIEW_DATA;
             _viewPage = 0;
+            _compareIdx = -1;
+            _cornerLapIdx = -1;
             _ui->getTft()->fillRect(0, STATUS_BAR_HEIGHT, SCREEN_WIDTH,
                                     SCREEN_HEIGHT - STATUS_BAR_HEIGHT,
                                     TFT_BLACK);
@@ -303,14 +315,33 @@ void HistoryScreen::update() {
                                     SCREEN_HEIGHT - STATUS_BAR_HEIGHT,
                                     TFT_BLACK);
             drawConfirmDelete();
+          } else if (idx == 3) { // Re-time Laps
+            if (_lastTapIdx >= 0 && _lastTapIdx < _historyList.size()) {
+              HistoryItem &item = _historyList[_lastTapIdx];
+              if (item.type != "TRACK") {
+                _ui->showToast("TRACK SESSIONS ONLY", 1500);
+              } else if (sessionManager.startJob(SessionManager::JOB_RETIME,
+                                                 item.filename)) {
+                _ui->showToast("RE-TIMING...", 1500); // See pollJob()
+              } else {
+                _ui->showToast("BUSY, TRY AGAIN", 1500);
+              }
+              drawOptions();
+            }
           }
         }
 
       } else if (_currentMode == MODE_VIEW_DATA) {
         // Tap anywhere (except back which is handled)
-        _viewPage++;
-        if (_viewPage > 4) // Cycle through 5 pages (0-4)
-          _viewPage = 0;
+        if (_viewPage == 4 && ty > 55 && ty < 265) {
+          _compareIdx++; // Tap on the graphs: next lap
+        } else if (_viewPage == 7 && ty > 55 && ty < 265) {
+          _cornerLapIdx++; // Tap on the table: next lap
+        } else {
+          _viewPage++;
+          if (_viewPage > 8) // Cycle through 9 pages (0-8)
+            _viewPage = 0;
+        }
         drawViewData();
 
       } else if (_currentMode == MODE_CONFIRM_DELETE) {
@@ -359,6 +390,30 @@ void HistoryScreen::update() {
   }
 }
 
+void HistoryScreen::pollJob() {
+  SessionManager::JobState st = sessionManager.getJobState();
+  if (st != SessionManager::JOB_DONE && st != SessionManager::JOB_FAILED)
+    return;
+  bool ok = (st == SessionManager::JOB_DONE);
+  sessionManager.clearJob();
+
+  if (sessionManager.getJobType() == SessionManager::JOB_RETIME) {
+    if (ok) {
+      scanHistory();
+      scanGroups();
+      _cmpFailed = ""; // Laps changed, worth another try
+    }
+    _ui->showToast(ok ? "LAPS RE-TIMED" : "RE-TIME FAILED", 1500);
+    if (_currentMode == MODE_OPTIONS)
+      drawOptions();
+  } else if (!ok) {
+    _cmpFailed = sessionManager.getJobFile();
+  }
+  // The line page waits on any job (a re-time holds off its build)
+  if (_currentMode == MODE_VIEW_DATA && _viewPage == 4)
+    drawViewData();
+}
+
 void HistoryScreen::scanHistory() {
   _historyList.clear();
   String content = sessionManager.loadHistoryIndex();
@@ -379,6 +434,7 @@ void HistoryScreen::scanHistory() {
       int c2 = line.indexOf(',', c1 + 1);
       int c3 = line.indexOf(',', c2 + 1);
       int c4 = line.indexOf(',', c3 + 1); // Type separator
+      int c5 = (c4 > 0) ? line.indexOf(',', c4 + 1) : -1; // Synced flag
 
       if (c1 > 0 && c2 > 0 && c3 > 0) {
         HistoryItem item;
@@ -389,7 +445,7 @@ void HistoryScreen::scanHistory() {
             line.substring(c3 + 1, (c4 > 0) ? c4 : line.length()).toInt();
 
         if (c4 > 0) {
-          item.type = line.substring(c4 + 1);
+          item.type = line.substring(c4 + 1, (c5 > 0) ? c5 : line.length());
           item.type.trim();
         } else {
           item.type = "TRACK"; // Default backward compatibility
@@ -680,11 +736,11 @@ void HistoryScreen::drawOptions() {
 
   // Options
   const char *options[] = {"1. View Data", "2. Synchronize",
-                           "3. Delete Session"};
+                           "3. Delete Session", "4. Re-time Laps"};
   int startY = 60;
   int h = 40;
 
-  for (int i = 0; i < 3; i++) {
+  for (int i = 0; i < 4; i++) {
     int y = startY + (i * 50);
     bool sel = (i == _selectedIdx);
 
@@ -740,7 +796,19 @@ void HistoryScreen::drawViewData() {
       title = "LAP REPLAY";
       break;
     case 4:
-      title = "RPM & TEMP";
+      title = "LINE vs BEST LAP";
+      break;
+    case 5:
+      title = "TIME IN GEAR";
+      break;
+    case 6:
+      title = "G-G DIAGRAM";
+      break;
+    case 7:
+      title = "CORNERS";
+      break;
+    case 8:
+      title = "MATH CHANNELS";
       break;
     }
   }
@@ -990,8 +1058,26 @@ void HistoryScreen::drawViewData() {
       y += 20;
     }
 
-    // Theo Best
-    if (bestS1 > 0 && bestS2 > 0 && bestS3 > 0) {
+    // Optimal lap from mini-sectors, else Theo Best from S1-S3
+    if (analysis.optimalLap > 0) {
+      unsigned long opt = analysis.optimalLap;
+      char buf[48];
+      sprintf(buf, "OPTIMAL: %d:%02d.%02d", (int)(opt / 60000),
+              (int)((opt / 1000) % 60), (int)((opt % 1000) / 10));
+      tft->setTextColor(TFT_GOLD, TFT_BLACK);
+      tft->setTextDatum(BC_DATUM);
+      tft->drawString(buf, SCREEN_WIDTH / 2, 195, 2);
+
+      // Where the best lap lost time
+      int ly = 215;
+      tft->setTextColor(TFT_ORANGE, TFT_BLACK);
+      for (const auto &z : analysis.lossZones) {
+        sprintf(buf, "%dm-%dm  +%d.%02ds", (int)z.startM, (int)z.endM,
+                (int)(z.lossMs / 1000), (int)((z.lossMs % 1000) / 10));
+        tft->drawString(buf, SCREEN_WIDTH / 2, ly, 2);
+        ly += 18;
+      }
+    } else if (bestS1 > 0 && bestS2 > 0 && bestS3 > 0) {
       unsigned long theo = bestS1 + bestS2 + bestS3;
       char buf[32];
       sprintf(buf, "THEO BEST: %d:%02d.%d", (int)(theo / 60000),
@@ -1001,16 +1087,31 @@ void HistoryScreen::drawViewData() {
       tft->drawString(buf, SCREEN_WIDTH / 2, 210, 2);
     }
   } else if (_viewPage == 3) {
-    // MAP PLACEHOLDER
-    tft->setTextDatum(MC_DATUM);
-    tft->setTextColor(TFT_SILVER, TFT_BLACK);
-    tft->drawString("MAP VIEW", SCREEN_WIDTH / 2, 120, 4);
-    tft->drawString("(Not Available)", SCREEN_WIDTH / 2, 150, 2);
+    // MAP (cached outline of the session log)
+    int mapW = 300;
+    int mapH = 160;
+    int mapX = (SCREEN_WIDTH - mapW) / 2;
+    int mapY = 45;
+    tft->fillRoundRect(mapX - 5, mapY - 5, mapW + 10, mapH + 10, 8, 0x10A2);
+
+    TrackMapRenderer map;
+    if (map.load(currentFile, mapW, mapH)) {
+      map.render(tft, mapX, mapY, 0x10A2, TFT_WHITE);
+    } else {
+      tft->setTextDatum(MC_DATUM);
+      tft->setTextColor(TFT_SILVER, 0x10A2);
+      tft->drawString("NO MAP", SCREEN_WIDTH / 2, mapY + mapH / 2, 2);
+    }
   } else if (_viewPage == 4) {
-    // RPM/TEMP placeholder
-    tft->setTextDatum(MC_DATUM);
-    tft->setTextColor(TFT_DARKGREY, TFT_BLACK);
-    tft->drawString("No RPM/Temp Logs", SCREEN_WIDTH / 2, 120, 2);
+    drawLineCompare(currentFile);
+  } else if (_viewPage == 5) {
+    drawGearTime(analysis);
+  } else if (_viewPage == 6) {
+    drawGGDiagram(analysis);
+  } else if (_viewPage == 7) {
+    drawCornerTable(analysis);
+  } else if (_viewPage == 8) {
+    drawMathChannels(analysis);
   }
 
   // Back Triangle
@@ -1054,3 +1155,320 @@ void HistoryScreen::drawConfirmDelete() {
   tft->setTextColor(TFT_BLACK, selNo ? TFT_GREEN : TFT_DARKGREY);
   tft->drawString("NO", startX + btnW + gap + btnW / 2, y + btnH / 2);
 }
+
+// Logged LonG/LatG as a density plot (accelerating up, right turns
+// right), with the session's peaks beside it
+void HistoryScreen::drawGGDiagram(
+    const SessionManager::SessionAnalysis &analysis) {
+  TFT_eSPI *tft = _ui->getTft();
+  const int n = SessionManager::SessionAnalysis::GG_BINS;
+  const int cell = 8;
+  const int size = n * cell;
+  const int gx = 30, gy = 45;
+
+  uint16_t maxCount = 0;
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++)
+      if (analysis.gg[i][j] > maxCount)
+        maxCount = analysis.gg[i][j];
+  if (maxCount == 0) {
+    tft->setTextDatum(MC_DATUM);
+    tft->setTextColor(TFT_DARKGREY, TFT_BLACK);
+    tft->drawString("No G Data In This Log", SCREEN_WIDTH / 2, 120, 2);
+    return;
+  }
+
+  // Log scale: a few seconds at the limit still show against cruising
+  const uint16_t ramp[] = {0x000F, TFT_BLUE, TFT_CYAN, TFT_YELLOW, TFT_RED};
+  float top = logf(1.0f + maxCount);
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < n; j++) {
+      uint16_t c = analysis.gg[i][j];
+      if (c == 0)
+        continue;
+      int level = (int)(logf(1.0f + c) / top * 4.0f + 0.5f);
+      tft->fillRect(gx + j * cell, gy + (n - 1 - i) * cell, cell, cell,
+                    ramp[constrain(level, 0, 4)]);
+    }
+  }
+
+  int cx = gx + size / 2;
+  int cy = gy + size / 2;
+  float pxPerG = cell / SessionManager::SessionAnalysis::GG_STEP;
+  tft->drawCircle(cx, cy, (int)(0.5f * pxPerG), TFT_DARKGREY);
+  tft->drawCircle(cx, cy, (int)(1.0f * pxPerG), TFT_DARKGREY);
+  tft->drawFastHLine(gx, cy, size, 0x3186);
+  tft->drawFastVLine(cx, gy, size, 0x3186);
+  tft->drawRect(gx - 1, gy - 1, size + 2, size + 2, TFT_DARKGREY);
+
+  // Peaks
+  int tx = gx + size + 30;
+  char buf[32];
+  tft->setTextDatum(TL_DATUM);
+  tft->setTextColor(TFT_SILVER, TFT_BLACK);
+  tft->drawString("MAX ACCEL", tx, gy + 10, 2);
+  tft->drawString("MAX BRAKE", tx, gy + 70, 2);
+  tft->drawString("MAX LATERAL", tx, gy + 130, 2);
+  tft->setTextColor(TFT_GREEN, TFT_BLACK);
+  sprintf(buf, "%.2f g", analysis.maxAccelG);
+  tft->drawString(buf, tx, gy + 28, 4);
+  tft->setTextColor(TFT_RED, TFT_BLACK);
+  sprintf(buf, "%.2f g", analysis.maxBrakeG);
+  tft->drawString(buf, tx, gy + 88, 4);
+  tft->setTextColor(TFT_CYAN, TFT_BLACK);
+  sprintf(buf, "%.2f g", analysis.maxLatG);
+  tft->drawString(buf, tx, gy + 148, 4);
+
+  tft->setTextColor(TFT_DARKGREY, TFT_BLACK);
+  tft->drawString("RINGS 0.5 / 1.0 g", tx, gy + size - 10, 1);
+}
+
+// Entry/apex/exit speed and time through every corner of one lap, from
+// the .sum sidecar. Apex speeds that are the session's best are green.
+void HistoryScreen::drawCornerTable(
+    const SessionManager::SessionAnalysis &analysis) {
+  TFT_eSPI *tft = _ui->getTft();
+  const auto &laps = analysis.cornerLaps;
+  int n = analysis.corners.size();
+  if (n == 0 || laps.empty()) {
+    tft->setTextDatum(MC_DATUM);
+    tft->setTextColor(TFT_DARKGREY, TFT_BLACK);
+    tft->drawString("No Corner Data", SCREEN_WIDTH / 2, 120, 2);
+    tft->drawString("Re-time Laps to build it", SCREEN_WIDTH / 2, 145, 2);
+    return;
+  }
+
+  // Best lap first, taps cycle through the others
+  if (_cornerLapIdx < 0 || _cornerLapIdx >= (int)laps.size()) {
+    _cornerLapIdx = 0;
+    for (size_t i = 0; i < laps.size(); i++) {
+      int l = laps[i].lap;
+      if (l >= 1 && l <= (int)analysis.lapTimes.size() &&
+          analysis.lapTimes[l - 1] == analysis.bestLap) {
+        _cornerLapIdx = i;
+        break;
+      }
+    }
+  }
+  const CornerEngine::LapCorners &lap = laps[_cornerLapIdx];
+
+  char buf[48];
+  tft->setTextDatum(TC_DATUM);
+  tft->setTextColor(TFT_WHITE, TFT_BLACK);
+  sprintf(buf, "LAP %d  (%d/%d)", lap.lap, _cornerLapIdx + 1,
+          (int)laps.size());
+  tft->drawString(buf, SCREEN_WIDTH / 2, 40, 2);
+
+  const int cols[] = {40, 80, 160, 240, 320, 400};
+  const char *heads[] = {"T", "TURN", "ENTRY", "APEX", "EXIT", "TIME"};
+  tft->setTextDatum(TR_DATUM);
+  tft->setTextColor(TFT_SILVER, TFT_BLACK);
+  for (int c = 0; c < 6; c++)
+    tft->drawString(heads[c], cols[c] + 30, 60, 2);
+
+  const int rowH = 16;
+  const int maxRows = (SCREEN_HEIGHT - 80) / rowH;
+  int rows = min((int)lap.corners.size(), min(n, maxRows));
+  for (int i = 0; i < rows; i++) {
+    const CornerEngine::Result &r = lap.corners[i];
+    int y = 78 + i * rowH;
+
+    uint16_t bestApex = 0;
+    for (const auto &l : laps)
+      if (i < (int)l.corners.size() && l.corners[i].apex > bestApex)
+        bestApex = l.corners[i].apex;
+
+    tft->setTextColor(TFT_SILVER, TFT_BLACK);
+    sprintf(buf, "%d", i + 1);
+    tft->drawString(buf, cols[0] + 30, y, 2);
+    float deg = analysis.corners[i].turnDeg;
+    sprintf(buf, "%c %d", deg > 0 ? 'R' : 'L', (int)fabsf(deg));
+    tft->drawString(buf, cols[1] + 30, y, 2);
+
+    tft->setTextColor(TFT_WHITE, TFT_BLACK);
+    sprintf(buf, "%.1f", r.entry / 10.0f);
+    tft->drawString(buf, cols[2] + 30, y, 2);
+    tft->setTextColor(r.apex >= bestApex ? TFT_GREEN : TFT_YELLOW, TFT_BLACK);
+    sprintf(buf, "%.1f", r.apex / 10.0f);
+    tft->drawString(buf, cols[3] + 30, y, 2);
+    tft->setTextColor(TFT_WHITE, TFT_BLACK);
+    sprintf(buf, "%.1f", r.exit / 10.0f);
+    tft->drawString(buf, cols[4] + 30, y, 2);
+    sprintf(buf, "%.2f", r.timeMs / 1000.0f);
+    tft->drawString(buf, cols[5] + 30, y, 2);
+  }
+  if (rows < n) {
+    tft->setTextDatum(TC_DATUM);
+    tft->setTextColor(TFT_DARKGREY, TFT_BLACK);
+    sprintf(buf, "+%d more corners", n - rows);
+    tft->drawString(buf, SCREEN_WIDTH / 2, 78 + rows * rowH, 1);
+  }
+}
+
+// Share of the session in each logged gear, N = stopped/clutch/unknown
+void HistoryScreen::drawGearTime(
+    const SessionManager::SessionAnalysis &analysis) {
+  TFT_eSPI *tft = _ui->getTft();
+  uint32_t total = 0;
+  for (int g = 0; g <= analysis.gearCount; g++)
+    total += analysis.gearMs[g];
+  if (analysis.gearCount == 0 || total == 0) {
+    tft->setTextDatum(MC_DATUM);
+    tft->setTextColor(TFT_DARKGREY, TFT_BLACK);
+    tft->drawString("No Gear Data In This Log", SCREEN_WIDTH / 2, 120, 2);
+    tft->drawString("Needs the RPM sensor", SCREEN_WIDTH / 2, 145, 2);
+    return;
+  }
+
+  const int barX = 60, barW = SCREEN_WIDTH - barX - 150;
+  int rowH = min(32, 220 / (analysis.gearCount + 1));
+  char buf[24];
+  for (int g = 0; g <= analysis.gearCount; g++) {
+    int y = 55 + g * rowH;
+    uint32_t ms = analysis.gearMs[g];
+    int w = (int)((uint64_t)ms * barW / total);
+
+    tft->setTextDatum(ML_DATUM);
+    tft->setTextColor(g ? TFT_WHITE : TFT_SILVER, TFT_BLACK);
+    if (g == 0)
+      tft->drawString("N", 30, y + rowH / 2, 2);
+    else
+      tft->drawNumber(g, 30, y + rowH / 2, 2);
+    tft->fillRect(barX, y + 3, w, rowH - 6, g ? TFT_CYAN : TFT_DARKGREY);
+
+    sprintf(buf, "%d:%02d  %d%%", (int)(ms / 60000), (int)(ms / 1000) % 60,
+            (int)((uint64_t)ms * 100 / total));
+    tft->drawString(buf, barX + barW + 10, y + rowH / 2, 2);
+  }
+}
+
+// Min/avg/max of every /channels.txt channel over the session
+void HistoryScreen::drawMathChannels(
+    const SessionManager::SessionAnalysis &analysis) {
+  TFT_eSPI *tft = _ui->getTft();
+  if (analysis.mathCount == 0) {
+    tft->setTextDatum(MC_DATUM);
+    tft->setTextColor(TFT_DARKGREY, TFT_BLACK);
+    tft->drawString("No Math Channels", SCREEN_WIDTH / 2, 120, 2);
+    tft->drawString("Define them in /channels.txt", SCREEN_WIDTH / 2, 145, 2);
+    return;
+  }
+
+  const int cols[] = {200, 300, 400}; // Right edges
+  tft->setTextColor(TFT_SILVER, TFT_BLACK);
+  tft->setTextDatum(TL_DATUM);
+  tft->drawString("CHANNEL", 40, 55, 2);
+  tft->setTextDatum(TR_DATUM);
+  tft->drawString("MIN", cols[0], 55, 2);
+  tft->drawString("AVG", cols[1], 55, 2);
+  tft->drawString("MAX", cols[2], 55, 2);
+
+  for (int i = 0; i < analysis.mathCount; i++) {
+    int y = 80 + i * 24;
+    tft->setTextDatum(TL_DATUM);
+    tft->setTextColor(TFT_CYAN, TFT_BLACK);
+    tft->drawString(sessionManager.mathChannels.getName(i), 40, y, 2);
+    tft->setTextDatum(TR_DATUM);
+    tft->setTextColor(TFT_WHITE, TFT_BLACK);
+    tft->drawString(String(analysis.mathMin[i], 2), cols[0], y, 2);
+    tft->drawString(String(analysis.mathAvg[i], 2), cols[1], y, 2);
+    tft->drawString(String(analysis.mathMax[i], 2), cols[2], y, 2);
+  }
+}
+
+// Lateral offset and speed difference of one lap against the best lap,
+// binned along the best lap's line (.cmp sidecar, built on first view)
+void HistoryScreen::drawLineCompare(const String &file) {
+  TFT_eSPI *tft = _ui->getTft();
+  tft->setTextDatum(MC_DATUM);
+
+  LapTraceHeader hdr;
+  int count = sessionManager.getLapTraceCount(file, hdr);
+  // No sidecar yet: built once in the background, pollJob() redraws
+  if (count == 0 && file != _cmpFailed &&
+      (sessionManager.getJobState() == SessionManager::JOB_RUNNING ||
+       sessionManager.startJob(SessionManager::JOB_COMPARE, file))) {
+    tft->setTextColor(TFT_WHITE, TFT_BLACK);
+    tft->drawString("Building...", SCREEN_WIDTH / 2, 140, 2);
+    return;
+  }
+  if (count < 2) {
+    tft->setTextColor(TFT_DARKGREY, TFT_BLACK);
+    tft->drawString("Need 2+ Timed Laps", SCREEN_WIDTH / 2, 140, 2);
+    return;
+  }
+
+  // Best lap by time, compared lap cycles through the others
+  int bestIdx = 0;
+  uint32_t bestTime = 0;
+  LapTrace tr;
+  for (int i = 0; i < count; i++) {
+    if (sessionManager.loadLapTrace(file, i, tr, true) &&
+        (bestTime == 0 || tr.lapTime < bestTime)) {
+      bestTime = tr.lapTime;
+      bestIdx = i;
+    }
+  }
+  if (_compareIdx < 0 || _compareIdx >= count)
+    _compareIdx = 0;
+  if (_compareIdx == bestIdx)
+    _compareIdx = (_compareIdx + 1) % count;
+
+  LapTrace best, cmp;
+  if (!sessionManager.loadLapTrace(file, bestIdx, best) ||
+      !sessionManager.loadLapTrace(file, _compareIdx, cmp))
+    return;
+
+  char buf[48];
+  sprintf(buf, "LAP %d  vs  BEST LAP %d", cmp.lap, best.lap);
+  tft->setTextColor(TFT_WHITE, TFT_BLACK);
+  tft->drawString(buf, SCREEN_WIDTH / 2, 52, 2);
+
+  const int gx = 20, gw = SCREEN_WIDTH - 40, gh = 90;
+  const int offY = 70, spdY = 170;
+  const float OFF_RANGE = 50;  // 0.1 m units, +-5 m
+  const float SPD_RANGE = 200; // 0.1 km/h units, +-20 km/h
+
+  tft->drawRect(gx, offY, gw, gh, TFT_DARKGREY);
+  tft->drawRect(gx, spdY, gw, gh, TFT_DARKGREY);
+  tft->drawFastHLine(gx, offY + gh / 2, gw, 0x3186);
+  tft->drawFastHLine(gx, spdY + gh / 2, gw, 0x3186);
+
+  tft->setTextDatum(TL_DATUM);
+  tft->setTextColor(TFT_CYAN, TFT_BLACK);
+  tft->drawString("LINE +-5m (LEFT UP)", gx + 4, offY + 2, 1);
+  tft->setTextColor(TFT_SILVER, TFT_BLACK);
+  tft->drawString("SPEED +-20km/h (FASTER UP)", gx + 4, spdY + 2, 1);
+
+  int prevOff = -1, prevSpd = -1;
+  for (int x = 0; x < gw; x++) {
+    int b = x * hdr.bins / gw;
+    if (cmp.offset[b] == LapTrace::NO_OFFSET ||
+        best.offset[b] == LapTrace::NO_OFFSET) {
+      prevOff = -1;
+      prevSpd = -1;
+      continue;
+    }
+
+    float dOff = constrain(cmp.offset[b] - best.offset[b], -OFF_RANGE,
+                           OFF_RANGE);
+    float dSpd = constrain((int)cmp.speed[b] - (int)best.speed[b],
+                           -SPD_RANGE, SPD_RANGE);
+    int yOff = offY + gh / 2 - (int)(dOff / OFF_RANGE * (gh / 2 - 1));
+    int ySpd = spdY + gh / 2 - (int)(dSpd / SPD_RANGE * (gh / 2 - 1));
+
+    if (prevOff >= 0) {
+      tft->drawLine(gx + x - 1, prevOff, gx + x, yOff, TFT_CYAN);
+      tft->drawLine(gx + x - 1, prevSpd, gx + x, ySpd,
+                    (dSpd >= 0) ? TFT_GREEN : TFT_RED);
+    }
+    prevOff = yOff;
+    prevSpd = ySpd;
+  }
+
+  tft->setTextDatum(TC_DATUM);
+  tft->setTextColor(TFT_DARKGREY, TFT_BLACK);
+  sprintf(buf, "0m - %dm   TAP GRAPH: NEXT LAP",
+          (int)(hdr.bins * hdr.binLen));
+  tft->drawString(buf, SCREEN_WIDTH / 2, spdY + gh + 6, 1);
+}
@@ -1,7 +1,9 @@
 #ifndef HISTORY_SCREEN_H
 #define HISTORY_SCREEN_H
 
+#include "../../core/SessionManager.h"
 #include "../UIManager.h"
+#include "../components/TrackMapRenderer.h"
 #include <Arduino.h>
 #include <vector>
 
@@ -43,7 +45,11 @@ private:
   int _selectedIdx;      // Index in filtered list (or group list)
 
   // Data View
-  int _viewPage; // 0=Speed, 1=RPM, 2=Temp, 3=Sector, 4=Replay
+  int _viewPage; // 0=Summary, 1=Laps, 2=Sector, 3=Map, 4=Line, 5=Gears,
+                 // 6=G-G, 7=Corners, 8=Math channels
+  int _compareIdx = -1; // Lap shown on the line comparison page
+  int _cornerLapIdx = -1; // Lap shown in the corner table, -1 = best
+  String _cmpFailed; // Log whose .cmp build failed, not retried on redraw
 
   int _lastTapIdx;
   unsigned long _lastTapTime;
@@ -70,7 +76,13 @@ private:
   // drawList is already declared above
   void drawOptions();
   void drawViewData();
+  void drawLineCompare(const String &file);
+  void drawGGDiagram(const SessionManager::SessionAnalysis &analysis);
+  void drawCornerTable(const SessionManager::SessionAnalysis &analysis);
+  void drawGearTime(const SessionManager::SessionAnalysis &analysis);
+  void drawMathChannels(const SessionManager::SessionAnalysis &analysis);
   void drawConfirmDelete();
+  void pollJob(); // Outcome of a background re-time / .cmp build
 };
 
 #endif
@@ -40,8 +40,7 @@ void LapTimerScreen::onShow() {
 
 void LapTimerScreen::loadTracks() {
   _tracks.clear();
-  double curLat = gpsManager.getLatitude();
-  double curLon = gpsManager.getLongitude();
+  GeoPoint cur = gpsManager.getPosition();
 
   if (SD.exists("/tracks.json")) {
     File file = SD.open("/tracks.json", FILE_READ);
@@ -52,16 +51,14 @@ void LapTimerScreen::loadTracks() {
       if (!error && doc["tracks"].is<JsonArray>()) {
         JsonArray trackArray = doc["tracks"];
         for (JsonVariant t : trackArray) {
-          double tLat = t["lat"].as<double>();
-          double tLon = t["lon"].as<double>();
-          double dist = gpsManager.distanceBetween(curLat, curLon, tLat, tLon);
-          if (dist > 50000)
+          GeoPoint loc = {degToE7(t["lat"].as<double>()),
+                          degToE7(t["lon"].as<double>())};
+          if (geoDistanceM(cur, loc) > 50000)
             continue;
 
           Track newTrack;
           newTrack.name = t["name"].as<String>();
-          newTrack.lat = tLat;
-          newTrack.lon = tLon;
+          SessionManager::layoutFromJson(t, newTrack.layout);
           newTrack.isCustom = true;
 
           JsonArray configs = t["configs"];
@@ -82,8 +79,7 @@ void LapTimerScreen::loadTracks() {
 
   Track factory;
   factory.name = "Test Track (Bordeaux)";
-  factory.lat = 44.8378;
-  factory.lon = -0.5792;
+  factory.layout.centre = {448378000, -5792000}; // 44.8378, -0.5792
   factory.isCustom = false;
   factory.configs.push_back({"Default"});
   factory.pathFile = "";
@@ -101,7 +97,7 @@ void LapTimerScreen::transitionToSummary() {
   data.lapCount = _lapCount;
   data.lapTimes = _lapTimes;
   data.maxRpm = _maxRpmSession;
-  _ui->setLastSession(data);
+  _ui->setLastSession(std::move(data));
   _ui->switchScreen(SCREEN_SESSION_SUMMARY);
 }
 
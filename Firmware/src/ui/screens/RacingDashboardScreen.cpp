@@ -11,22 +11,45 @@ extern SessionManager sessionManager;
 
 void RacingDashboardScreen::onShow() {
   _currentTrack = _ui->getSelectedTrack();
-  _currentLapStart = millis();
+  _timer.begin(_currentTrack.layout);
+  _hasReference = sessionManager.loadTrackReference(_currentTrack.name);
+  // Slices along the reference centreline when there is one
+  _miniSectors.begin(MiniSectorEngine::DEFAULT_COUNT,
+                     _hasReference ? sessionManager.referenceMatcher.getLength()
+                                   : 0);
+  if (!_hasReference || !_corners.build(sessionManager.referenceMatcher))
+    _corners.clear();
+  _deltaValid = false;
+  _lastFixCount = gpsManager.getFixCount();
+  _currentLapStart = gpsManager.getFixTimeMs();
   _lastLapTime = 0;
   _bestLapTime = 0;
   _lapCount = 0;
   _lapTimes.clear();
   _maxRpmSession = 0;
-  _finishLineInside = false;
-  _lastFinishCross = 0;
+  gpsManager.resetGearStats();
 
   _lastSpeed = -1.0;
   _lastSats = -1;
   _lastRpmRender = -1;
   _needsStaticRedraw = true;
-
-  // Start Logging
-  sessionManager.startSession();
+  _map.clear();
+  _markerX = -1;
+  _markerY = -1;
+  _trailHead = 0;
+  _trailCount = 0;
+  _markerMaxUs = 0;
+  _markerTotalUs = 0;
+  _markerFrames = 0;
+  _shiftShownSeq = gpsManager.getShiftSeq();
+  _shiftShownOn = -1;
+  gpsManager.resetShiftLatency();
+
+  // High-rate receiver profile for the session, then start logging
+  gpsManager.setActivityProfile(GPSManager::PROFILE_SESSION);
+  if (!sessionManager.startSession()) {
+    _ui->showToast("SD FULL - NOT LOGGING", 1500);
+  }
 
   _ui->setTitle(_currentTrack.name);
   drawStatic();
@@ -37,20 +60,59 @@ void RacingDashboardScreen::onHide() {
   if (sessionManager.isLogging()) {
     sessionManager.stopSession();
   }
+  gpsManager.setActivityProfile(GPSManager::PROFILE_IDLE);
+
+  if (_markerFrames > 0) {
+    Serial.printf("Map marker: avg %lu us, max %lu us (%lu frames)\n",
+                  _markerTotalUs / _markerFrames, _markerMaxUs, _markerFrames);
+  }
+  Serial.printf("G filter: avg %lu us, max %lu us per epoch\n",
+                gpsManager.getGForceAvgUs(), gpsManager.getGForceMaxUs());
+  const ShiftAlert::Latency &out = gpsManager.getShiftOutputLatency();
+  const ShiftAlert::Latency &scr = gpsManager.getShiftScreenLatency();
+  if (out.count > 0)
+    Serial.printf("Shift light: %lu changes, GPIO avg %lu us max %lu us, "
+                  "screen avg %lu us max %lu us\n",
+                  (unsigned long)out.count,
+                  (unsigned long)(out.totalUs / out.count),
+                  (unsigned long)out.maxUs,
+                  (unsigned long)(scr.count ? scr.totalUs / scr.count : 0),
+                  (unsigned long)scr.maxUs);
+  _gg.end();
+
+  if (_mapSprite != nullptr) {
+    _mapSprite->deleteSprite();
+    delete _mapSprite;
+    _mapSprite = nullptr;
+  }
 }
 
 void RacingDashboardScreen::update() {
+  updateShiftLamp();
+
   UIManager::TouchPoint p = _ui->getTouchPoint();
   if (p.x != -1) {
     // Stop Button
     int cx = SCREEN_WIDTH / 2;
     if (p.x > cx - 100 && p.x < cx + 100 && p.y > STOP_BTN_Y) {
+      String sessionFile = "";
       if (sessionManager.isLogging()) {
+        sessionFile = sessionManager.getCurrentFilename();
         String dateStr =
             gpsManager.getDateString() + " " + gpsManager.getTimeString();
-        sessionManager.appendToHistoryIndex(_currentTrack.name, dateStr,
-                                            _lapCount, _bestLapTime, "TRACK");
+        sessionManager.appendToHistoryIndex(sessionFile, dateStr, _lapCount,
+                                            _bestLapTime, "TRACK");
         sessionManager.stopSession();
+        sessionManager.writeSessionSummary(sessionFile, _timer, &_miniSectors,
+                                           &_corners);
+
+        // New best for this track: becomes the reference lap
+        uint32_t best = _timer.getBestLap();
+        if (best > 0 && (!_hasReference ||
+                         best < sessionManager.getReferenceLapTime())) {
+          sessionManager.saveTrackReference(_currentTrack.name, sessionFile,
+                                            _timer.getBestLapStart(), best);
+        }
       }
 
       // Prepare data for summary
@@ -60,26 +122,43 @@ void RacingDashboardScreen::update() {
       data.bestLapTime = _bestLapTime;
       data.lapCount = _lapCount;
       data.maxRpm = _maxRpmSession;
+      data.sessionFile = sessionFile;
       // data.trackPoints = _currentTrack.trackPoints; // Track struct doesn't
       // have trackPoints yet
 
-      _ui->setLastSession(data);
+      _ui->setLastSession(std::move(data));
       _ui->switchScreen(SCREEN_SESSION_SUMMARY);
       return;
     }
   }
 
-  // Logic: Finish Line
-  checkFinishLine();
-
-  // Logic: Logging
-  if (sessionManager.isLogging() && (millis() - _lastUpdate > 100)) {
-    String data = String(millis()) + "," + String(gpsManager.getLatitude(), 6) +
+  // Logic: Lap/Sector Timing
+  updateTiming();
+
+  // Logic: Logging. One row per GNSS fix (not per UI tick: rows would
+  // repeat a fix); faster channels go in between at their own rate.
+  sessionManager.logChannels();
+  uint32_t fixes = gpsManager.getFixCount();
+  if (sessionManager.isLogging() && fixes != _lastLogFixCount) {
+    _lastLogFixCount = fixes;
+    uint32_t now = gpsManager.getFixTimeMs();
+    String data = String(now) + "," + String(gpsManager.getLatitude(), 6) +
                   "," + String(gpsManager.getLongitude(), 6) + "," +
                   String(gpsManager.getSpeedKmph()) + "," +
                   String(gpsManager.getSatellites()) + "," +
                   String(gpsManager.getAltitude(), 2) + "," +
-                  String(gpsManager.getHeading(), 2);
+                  String(gpsManager.getHeading(), 2) + "," +
+                  String(gpsManager.getLonG(), 2) + "," +
+                  String(gpsManager.getLatG(), 2) + "," +
+                  String(gpsManager.getGear());
+    // Input order: speed, alt, heading, long, latg, rpm, gear
+    float in[MathChannels::IN_COUNT] = {
+        gpsManager.getSpeedKmph(), (float)gpsManager.getAltitude(),
+        (float)gpsManager.getHeading(), gpsManager.getLonG(),
+        gpsManager.getLatG(), (float)gpsManager.getRPM(),
+        (float)gpsManager.getGear()};
+    sessionManager.logMathChannels(now, in);
+    sessionManager.logChannels(true);
     sessionManager.logData(data);
   }
 
@@ -93,6 +172,7 @@ void RacingDashboardScreen::update() {
   if (millis() - _lastUpdate > 100) {
     drawDynamic();
     _lastUpdate = millis();
+    updateShiftLamp(); // drawDynamic can take a while
   }
 }
 
@@ -108,7 +188,8 @@ void RacingDashboardScreen::drawStatic() {
   int midH = 140;
   int mapW = 160;
   int metricsX = 15 + mapW + 10;
-  int metricsW = SCREEN_WIDTH - metricsX - 15;
+  int metricsW = SCREEN_WIDTH - metricsX - 15 - GG_W - 10;
+  int ggX = metricsX + metricsW + 10;
   int speedH = midH / 2 - 5;
   int timeH = midH / 2 - 5;
   int gridY = midY + midH + 10;
@@ -126,6 +207,12 @@ void RacingDashboardScreen::drawStatic() {
   tft->drawRoundRect(metricsX, midY + speedH + 10, metricsW, timeH, 8,
                      TFT_DARKGREY);
 
+  // 3. G-G Box
+  tft->fillRoundRect(ggX, midY, GG_W, midH, 8, 0x18E3);
+  tft->drawRoundRect(ggX, midY, GG_W, midH, 8, TFT_DARKGREY);
+  if (!_gg.isValid())
+    _gg.begin(tft, GG_W - 10, 0x18E3);
+
   // Labels
   tft->setTextColor(TFT_SILVER, 0x18E3);
   tft->setTextFont(2);
@@ -133,7 +220,7 @@ void RacingDashboardScreen::drawStatic() {
   tft->drawString("SPEED", metricsX + 10, midY + 5);
   tft->drawString("TIME", metricsX + 10, midY + speedH + 15);
 
-  // 3. Grid Boxes (Sats, Last, Best)
+  // 4. Grid Boxes (Sats, Last, Best)
   for (int i = 0; i < 3; i++) {
     int x = 10 + i * (cardW + 5);
     tft->fillRoundRect(x, gridY, cardW, gridH, 8, 0x10A2);
@@ -155,11 +242,15 @@ void RacingDashboardScreen::drawStatic() {
   tft->drawString("STOP", cx, STOP_BTN_Y + 30);
 
   drawTrackMap(15, midY + 10, mapW - 10, midH - 20);
+  _shiftShownOn = -1;
+  updateShiftLamp();
 }
 
 void RacingDashboardScreen::drawDynamic() {
   TFT_eSPI *tft = _ui->getTft();
 
+  updateMapMarker();
+
   // RPM
   int rpm = gpsManager.getRPM();
   if (abs(rpm - _lastRpmRender) > 50) {
@@ -170,7 +261,8 @@ void RacingDashboardScreen::drawDynamic() {
   // Layout for values
   int mapW = 160;
   int metricsX = 15 + mapW + 10;
-  int metricsW = SCREEN_WIDTH - metricsX - 15;
+  int metricsW = SCREEN_WIDTH - metricsX - 15 - GG_W - 10;
+  int ggX = metricsX + metricsW + 10;
   int midY = STATUS_BAR_HEIGHT + 40 + 15;
   int speedH = 140 / 2 - 5;
   int gridY = midY + 140 + 10;
@@ -185,7 +277,7 @@ void RacingDashboardScreen::drawDynamic() {
   tft->drawFloat(speed, 1, metricsX + metricsW / 2, midY + speedH / 2 + 8);
 
   // Current Time
-  unsigned long currentLap = millis() - _currentLapStart;
+  unsigned long currentLap = gpsManager.getFixTimeMs() - _currentLapStart;
   char timeBuf[16];
   sprintf(timeBuf, "%02d:%02d", (int)(currentLap / 60000),
           (int)(currentLap / 1000) % 60);
@@ -193,6 +285,37 @@ void RacingDashboardScreen::drawDynamic() {
   tft->drawString(timeBuf, metricsX + metricsW / 2,
                   midY + speedH + 10 + speedH / 2 + 8);
 
+  // Delta to the reference lap
+  char dBuf[16] = "       ";
+  uint16_t dColor = TFT_DARKGREY;
+  if (_deltaValid) {
+    long a = labs(_deltaMs);
+    sprintf(dBuf, "%c%ld.%02ld", (_deltaMs > 0) ? '+' : '-', a / 1000,
+            (a % 1000) / 10);
+    dColor = (_deltaMs > 0) ? TFT_RED : TFT_GREEN;
+  }
+  tft->setTextColor(dColor, 0x18E3);
+  tft->setTextFont(2);
+  tft->setTextDatum(TR_DATUM);
+  tft->setTextPadding(60);
+  tft->drawString(dBuf, metricsX + metricsW - 10, midY + speedH + 15);
+  tft->setTextPadding(0);
+  tft->setTextDatum(MC_DATUM);
+
+  // Friction circle and combined G
+  if (gpsManager.isGForceValid()) {
+    float lon = gpsManager.getLonG();
+    float lat = gpsManager.getLatG();
+    _gg.addPoint(lon, lat);
+    tft->setTextColor(TFT_WHITE, 0x18E3);
+    tft->setTextFont(2);
+    tft->setTextPadding(60);
+    tft->drawString(String(sqrtf(lon * lon + lat * lat), 2) + " g",
+                    ggX + GG_W / 2, midY + 127);
+    tft->setTextPadding(0);
+  }
+  _gg.render(ggX + 5, midY + 5);
+
   // GPS Sats
   int sats = gpsManager.getSatellites();
   bool fix = gpsManager.isFixed();
@@ -228,38 +351,66 @@ void RacingDashboardScreen::drawDynamic() {
   }
 }
 
-void RacingDashboardScreen::checkFinishLine() {
+void RacingDashboardScreen::updateTiming() {
   if (_currentTrack.configs.empty())
     return;
 
-  double lat = gpsManager.getLatitude();
-  double lon = gpsManager.getLongitude();
-  double dist = gpsManager.distanceBetween(lat, lon, _currentTrack.lat,
-                                           _currentTrack.lon);
-
-  if (dist < 15) { // 15m radius
-    if (!_finishLineInside) {
-      _finishLineInside = true;
-      unsigned long now = millis();
-      if (_lastFinishCross > 0) {
-        _lastLapTime = now - _lastFinishCross;
-        _lapTimes.push_back(_lastLapTime);
-        if (_bestLapTime == 0 || _lastLapTime < _bestLapTime) {
-          _bestLapTime = _lastLapTime;
-        }
-        _lapCount++;
-        _currentLapStart = now;
-      }
-      _lastFinishCross = now;
+  // Once per GPS epoch
+  uint32_t fixes = gpsManager.getFixCount();
+  if (fixes == _lastFixCount)
+    return;
+  _lastFixCount = fixes;
+
+  // Receiver time: exact epoch spacing, and the log rows' timebase
+  uint32_t now = gpsManager.getFixTimeMs();
+  GeoPoint pos = gpsManager.getPosition();
+  int n = _timer.addFix(now, pos);
+  for (int i = 0; i < n; i++) {
+    const LapTimingEngine::Event &e = _timer.getEvent(i);
+    char ev[40];
+    if (e.type == LapTimingEngine::EV_LAP) {
+      _lastLapTime = e.time;
+      _lapTimes.push_back(e.time);
+      _bestLapTime = _timer.getBestLap();
+      _lapCount = _timer.getLapCount();
+      snprintf(ev, sizeof(ev), "LAP,%u,%lu", e.lap, (unsigned long)e.time);
+    } else {
+      snprintf(ev, sizeof(ev), "SECTOR,%u,%u,%lu", e.lap, e.sector,
+               (unsigned long)e.time);
+    }
+    if (sessionManager.isLogging())
+      sessionManager.logData(ev);
+  }
+
+  // Every finish crossing (also the very first) moves the lap start
+  uint32_t lapCross = 0;
+  if (_timer.isLapRunning() && _timer.getLapStart() != _currentLapStart) {
+    _currentLapStart = _timer.getLapStart();
+    lapCross = _currentLapStart;
+  }
+  MapMatcher::Match m = {false, 0, 0, 0};
+  if (_hasReference)
+    m = sessionManager.referenceMatcher.match(pos);
+  _miniSectors.addTrackFix(now, pos, m.valid ? m.distance : NAN, lapCross);
+
+  // Live delta against the reference lap, corner speeds along it
+  _deltaValid = false;
+  if (_hasReference) {
+    if (m.valid)
+      _corners.addFix(now, m.distance, gpsManager.getSpeedKmph(),
+                      _timer.getLapCount() + 1);
+    if (m.valid && _timer.isLapRunning()) {
+      _deltaMs = (long)(now - _currentLapStart) -
+                 (long)sessionManager.getReferenceTime(m.distance);
+      _deltaValid = true;
     }
-  } else if (dist > 25) {
-    _finishLineInside = false;
   }
 }
 
 void RacingDashboardScreen::drawRPMBar(int rpm, int maxRpm) {
   TFT_eSPI *tft = _ui->getTft();
-  int x = 10, y = STATUS_BAR_HEIGHT + 5, w = SCREEN_WIDTH - 20, h = 40;
+  int x = 10, y = STATUS_BAR_HEIGHT + 5, h = 40;
+  int w = SCREEN_WIDTH - 20 - LAMP_W - 5;
   int fillW = map(constrain(rpm, 0, maxRpm), 0, maxRpm, 0, w);
   uint16_t color = (rpm > maxRpm * 0.9)   ? TFT_RED
                    : (rpm > maxRpm * 0.7) ? TFT_YELLOW
@@ -269,9 +420,131 @@ void RacingDashboardScreen::drawRPMBar(int rpm, int maxRpm) {
   tft->drawRect(x, y, w, h, TFT_DARKGREY);
 }
 
+// One fill (60x40, about 1 ms of SPI) when the level or the over-rev
+// blink changes; the time from the first edge past the threshold to
+// here is recorded per change
+void RacingDashboardScreen::updateShiftLamp() {
+  uint32_t seq = gpsManager.getShiftSeq();
+  bool on = gpsManager.isShiftLampOn();
+  if (seq == _shiftShownSeq && (int8_t)on == _shiftShownOn)
+    return;
+
+  uint16_t color = 0x18E3; // Off
+  if (on)
+    color = gpsManager.getShiftLevel() == ShiftAlert::LEVEL_OVERREV
+                ? TFT_RED
+                : TFT_BLUE;
+  TFT_eSPI *tft = _ui->getTft();
+  int x = SCREEN_WIDTH - 10 - LAMP_W, y = STATUS_BAR_HEIGHT + 5;
+  tft->fillRect(x, y, LAMP_W, 40, color);
+  tft->drawRect(x, y, LAMP_W, 40, TFT_DARKGREY);
+
+  if (seq != _shiftShownSeq && _shiftShownOn >= 0)
+    gpsManager.noteShiftShown(seq);
+  _shiftShownSeq = seq;
+  _shiftShownOn = on;
+}
+
 void RacingDashboardScreen::drawTrackMap(int x, int y, int w, int h) {
-  // Simple map or mock
-  _ui->getTft()->setTextColor(TFT_DARKGREY, 0x10A2);
-  _ui->getTft()->setTextDatum(MC_DATUM);
-  _ui->getTft()->drawString("MAP", x + w / 2, y + h / 2);
+  TFT_eSPI *tft = _ui->getTft();
+
+  // Outline comes from the SD cache after the first time
+  if (!_map.isValid() && _currentTrack.pathFile.length() > 0) {
+    _map.load(_currentTrack.pathFile, w, h);
+  }
+
+  _mapX = x;
+  _mapY = y;
+
+  if (_map.isValid()) {
+    // Keep the outline in RAM so the marker can restore what it covered
+    if (_mapSprite == nullptr) {
+      _mapSprite = new TFT_eSprite(tft);
+      _mapSprite->setColorDepth(8);
+      if (!_mapSprite->createSprite(w, h)) {
+        delete _mapSprite;
+        _mapSprite = nullptr;
+      } else {
+        _mapSprite->fillSprite(0x10A2);
+        _map.drawInto(*_mapSprite, TFT_WHITE);
+      }
+    }
+
+    if (_mapSprite != nullptr)
+      _mapSprite->pushSprite(x, y);
+    else
+      _map.render(tft, x, y, 0x10A2, TFT_WHITE); // No marker without sprite
+
+    // Whole box was repainted, marker and trail are gone
+    _markerX = -1;
+    _markerY = -1;
+    _trailCount = 0;
+  } else {
+    tft->setTextColor(TFT_DARKGREY, 0x10A2);
+    tft->setTextDatum(MC_DATUM);
+    tft->drawString("MAP", x + w / 2, y + h / 2);
+  }
+}
+
+// Copy a square of the outline sprite back to the panel
+void RacingDashboardScreen::restoreMapRect(int cx, int cy, int r) {
+  int sx = max(0, cx - r);
+  int sy = max(0, cy - r);
+  int ex = min((int)_mapSprite->width() - 1, cx + r);
+  int ey = min((int)_mapSprite->height() - 1, cy + r);
+  if (ex < sx || ey < sy)
+    return;
+  _mapSprite->pushSprite(_mapX + sx, _mapY + sy, sx, sy, ex - sx + 1,
+                         ey - sy + 1);
+}
+
+void RacingDashboardScreen::updateMapMarker() {
+  if (_mapSprite == nullptr || !gpsManager.isFixed())
+    return;
+
+  int16_t px, py;
+  if (!_map.project(gpsManager.getPosition(), px, py))
+    return; // Off the map (pits, car park)
+
+  // Keep the dot inside the sprite so restoring always covers it
+  px = constrain(px, MARKER_R, _mapSprite->width() - 1 - MARKER_R);
+  py = constrain(py, MARKER_R, _mapSprite->height() - 1 - MARKER_R);
+  if (px == _markerX && py == _markerY)
+    return;
+
+  unsigned long t0 = micros();
+  TFT_eSPI *tft = _ui->getTft();
+
+  if (_markerX >= 0) {
+    restoreMapRect(_markerX, _markerY, MARKER_R);
+
+    // Old position becomes the newest trail dot
+    if (_trailCount == TRAIL_LEN) {
+      int oldest = _trailHead; // Slot about to be overwritten
+      restoreMapRect(_trailX[oldest], _trailY[oldest], 1);
+    } else {
+      _trailCount++;
+    }
+    _trailX[_trailHead] = _markerX;
+    _trailY[_trailHead] = _markerY;
+    _trailHead = (_trailHead + 1) % TRAIL_LEN;
+  }
+
+  // Trail dots are 2x2, cheaper to redraw than to track overlaps
+  for (int i = 0; i < _trailCount; i++) {
+    tft->fillRect(_mapX + _trailX[i], _mapY + _trailY[i], 2, 2, TFT_ORANGE);
+  }
+
+  tft->fillCircle(_mapX + px, _mapY + py, MARKER_R, TFT_RED);
+  _markerX = px;
+  _markerY = py;
+
+  unsigned long dt = micros() - t0;
+  _markerTotalUs += dt;
+  _markerFrames++;
+  if (dt > _markerMaxUs) {
+    _markerMaxUs = dt;
+    if (dt > 1000)
+      Serial.printf("Map marker slow: %lu us\n", dt);
+  }
 }
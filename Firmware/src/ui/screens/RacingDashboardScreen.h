@@ -1,7 +1,10 @@
 #ifndef RACING_DASHBOARD_SCREEN_H
 #define RACING_DASHBOARD_SCREEN_H
 
+#include "../../core/CornerEngine.h"
 #include "../UIManager.h"
+#include "../components/GForceWidget.h"
+#include "../components/TrackMapRenderer.h"
 #include "TrackData.h"
 
 class RacingDashboardScreen : public UserScreen {
@@ -23,9 +26,39 @@ private:
   std::vector<unsigned long> _lapTimes;
   unsigned long _maxRpmSession;
 
+  TrackMapRenderer _map;
+
+  // Live Map: outline drawn once into a sprite, only the marker moves
+  TFT_eSprite *_mapSprite = nullptr;
+  int _mapX = 0;
+  int _mapY = 0;
+  int16_t _markerX = -1;
+  int16_t _markerY = -1;
+  static const int MARKER_R = 3;
+  static const int TRAIL_LEN = 8;
+  int16_t _trailX[TRAIL_LEN];
+  int16_t _trailY[TRAIL_LEN];
+  int _trailHead = 0;
+  int _trailCount = 0;
+
+  // Friction circle right of speed/time
+  GForceWidget _gg;
+  static const int GG_W = 120;
+
+  // Marker update cost (micros)
+  unsigned long _markerMaxUs = 0;
+  unsigned long _markerTotalUs = 0;
+  unsigned long _markerFrames = 0;
+
   // Logic
-  bool _finishLineInside;
-  unsigned long _lastFinishCross;
+  LapTimingEngine _timer; // Line crossings, interpolated between fixes
+  MiniSectorEngine _miniSectors;
+  CornerEngine _corners; // Along the reference lap
+  bool _hasReference = false; // Track reference lap loaded
+  long _deltaMs = 0;          // vs. reference, + = slower
+  bool _deltaValid = false;
+  uint32_t _lastFixCount = 0;
+  uint32_t _lastLogFixCount = 0;
 
   // Flicker Reduction
   float _lastSpeed = -1.0;
@@ -34,11 +67,20 @@ private:
   unsigned long _lastUpdate = 0;
   bool _needsStaticRedraw = true;
 
+  // Shift lamp right of the RPM bar: its own small region, checked
+  // every loop rather than with the 100 ms redraw
+  static const int LAMP_W = 60;
+  uint32_t _shiftShownSeq = 0;
+  int8_t _shiftShownOn = -1;
+  void updateShiftLamp();
+
   void drawStatic();
   void drawDynamic();
-  void checkFinishLine();
+  void updateTiming();
   void drawRPMBar(int rpm, int maxRpm);
   void drawTrackMap(int x, int y, int w, int h);
+  void updateMapMarker();
+  void restoreMapRect(int cx, int cy, int r);
 };
 
 #endif
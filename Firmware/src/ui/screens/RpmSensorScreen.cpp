@@ -34,6 +34,20 @@ void RpmSensorScreen::onShow() {
   _graphIndex = 0;
   _lastUpdate = 0;
 
+  // Dyno coefficients from Settings (stored as option indices)
+  Preferences prefs;
+  prefs.begin("laptimer", true);
+  DynoEngine::Config cfg = _dyno.getConfig();
+  cfg.massKg = DynoEngine::massOption(prefs.getInt("dyno_mass", 2));
+  cfg.cdA = DynoEngine::cdAOption(prefs.getInt("dyno_cda", 3));
+  cfg.crr = DynoEngine::crrOption(prefs.getInt("dyno_crr", 1));
+  prefs.end();
+  _dyno.setConfig(cfg);
+  _dyno.cancel();
+  _dynoMode = false;
+  _histMode = false;
+  _lastFixCount = gpsManager.getFixCount();
+
   // Calculate RPM
   // _rpmPulses = 0;
   // _lastRpmCalcTime = millis();
@@ -62,6 +76,7 @@ void RpmSensorScreen::onShow() {
 
 void RpmSensorScreen::onHide() {
   gpsManager.setRpmEnabled(false); // Disable Logic
+  gpsManager.setActivityProfile(GPSManager::PROFILE_IDLE);
   if (_graphSprite != nullptr) {
     _graphSprite->deleteSprite();
     delete _graphSprite;
@@ -81,6 +96,53 @@ void RpmSensorScreen::update() {
     return;
   }
 
+  // DYNO button toggles the mode; tapping the plot starts a new run
+  if (p.x > SCREEN_WIDTH - 90 && p.y > 22 && p.y < 52) {
+    _dynoMode = !_dynoMode;
+    // A pull needs the full fix rate (idle is 1 Hz)
+    if (_dynoMode)
+      _dyno.arm();
+    else
+      _dyno.cancel();
+    gpsManager.setActivityProfile(_dynoMode ? GPSManager::PROFILE_SESSION
+                                            : GPSManager::PROFILE_IDLE);
+    _dynoShownState = -1;
+    if (_dynoMode && _histMode) {
+      _histMode = false;
+      drawHistButton();
+    }
+    drawDynoButton();
+    if (!_dynoMode)
+      drawGraphGrid();
+  } else if (p.x >= 0 && p.x < 90 && p.y > 22 && p.y < 52) {
+    // HIST button: engine usage instead of the graph
+    _histMode = !_histMode;
+    if (_histMode && _dynoMode) {
+      _dynoMode = false;
+      _dyno.cancel();
+      gpsManager.setActivityProfile(GPSManager::PROFILE_IDLE);
+      drawDynoButton();
+    }
+    _lastHistDraw = 0;
+    drawHistButton();
+    drawGraphGrid();
+  } else if (_dynoMode && p.x > 10 && p.y > 125 && p.y < 210 &&
+             _dyno.getState() == DynoEngine::STATE_DONE) {
+    _dyno.arm();
+  } else if (_histMode && p.x > 10 && p.y > 125 && p.y < 210) {
+    _histLifetime = !_histLifetime;
+    _lastHistDraw = 0;
+  }
+
+  // Dyno wants every epoch, not just one per redraw
+  uint32_t fixes = gpsManager.getFixCount();
+  if (fixes != _lastFixCount) {
+    _lastFixCount = fixes;
+    if (_dynoMode)
+      _dyno.addSample(gpsManager.getFixTimeMs(), gpsManager.getSpeedKmph(),
+                      gpsManager.getRPM());
+  }
+
   // 2. Real RPM Calculation (Get from Global)
   unsigned long now = millis();
   if (now - _lastRpmCalcTime > 100) {
@@ -110,7 +172,12 @@ void RpmSensorScreen::update() {
 
     // Redraw Dynamic Parts
     updateValues();
-    drawGraphLine();
+    if (_dynoMode)
+      drawDynoGraph();
+    else if (_histMode)
+      drawEngineHistogram();
+    else
+      drawGraphLine();
   }
 }
 
@@ -130,6 +197,8 @@ void RpmSensorScreen::drawScreen() {
   tft->setFreeFont(&Org_01);
   tft->setTextSize(2);
   tft->drawString("RPM SENSOR", SCREEN_WIDTH / 2, headerY + 8);
+  drawDynoButton();
+  drawHistButton();
 
   // Back Button (Blue Triangle) - Bottom Left (Standardized)
   _ui->drawBackButton();
@@ -226,6 +295,13 @@ void RpmSensorScreen::drawGraphGrid() {
   // Left (RPM) - Inside frame? Or Outside? Sprite covers inside.
   // Sprite is pushed to (11, 96)? -> Now (11, 126)
 
+  if (_dynoMode || _histMode) {
+    // Curves are scaled to their own peaks: no fixed axes
+    tft->fillRect(0, gY - 4, 10, gH + 8, TFT_BLACK);
+    tft->fillRect(SCREEN_WIDTH - 10, gY - 4, 10, gH + 8, TFT_BLACK);
+    return;
+  }
+
   // Left Axis
   tft->setTextDatum(MR_DATUM);
   tft->drawString("12k", 8, gY);
@@ -296,3 +372,200 @@ void RpmSensorScreen::drawGraphLine() {
   // Inner Rect Start = 11, 126.
   _graphSprite->pushSprite(11, 126);
 }
+
+void RpmSensorScreen::drawDynoButton() {
+  TFT_eSPI *tft = _ui->getTft();
+  int x = SCREEN_WIDTH - 80, y = 26, w = 70, h = 22;
+  uint16_t bg = _dynoMode ? TFT_ORANGE : 0x18E3;
+  tft->fillRoundRect(x, y, w, h, 4, bg);
+  tft->setFreeFont(&Org_01);
+  tft->setTextSize(1);
+  tft->setTextDatum(MC_DATUM);
+  tft->setTextColor(_dynoMode ? TFT_BLACK : TFT_SILVER, bg);
+  tft->drawString("DYNO", x + w / 2, y + h / 2);
+}
+
+// Power (red, kW) and torque (cyan, Nm) from the fit, each scaled to its
+// own peak, with the bin means as dots. Before and during the pull:
+// what it is waiting for.
+void RpmSensorScreen::drawDynoGraph() {
+  if (_graphSprite == nullptr)
+    return;
+  int state = _dyno.getState();
+  int points = _dyno.getAccepted();
+  if (state == _dynoShownState && points == _dynoShownPoints)
+    return;
+  if (_dynoShownState < 0)
+    drawGraphGrid();
+  _dynoShownState = state;
+  _dynoShownPoints = points;
+
+  int sW = GRAPH_WIDTH;
+  int sH = GRAPH_HEIGHT;
+  _graphSprite->fillSprite(COLOR_BG);
+  _graphSprite->setTextFont(2);
+  _graphSprite->setTextSize(1);
+  _graphSprite->setTextDatum(MC_DATUM);
+  _graphSprite->setTextColor(TFT_SILVER, COLOR_BG);
+
+  char buf[64];
+  if (state == DynoEngine::STATE_ARMED) {
+    _graphSprite->drawString("FULL THROTTLE IN ONE GEAR", sW / 2, sH / 2);
+  } else if (state == DynoEngine::STATE_RUNNING) {
+    snprintf(buf, sizeof(buf), "PULL... %d POINTS  %.0f RPM", points,
+             _dyno.getMaxRpm());
+    _graphSprite->setTextColor(TFT_ORANGE, COLOR_BG);
+    _graphSprite->drawString(buf, sW / 2, sH / 2);
+  } else if (state == DynoEngine::STATE_DONE && !_dyno.hasFit()) {
+    _graphSprite->drawString("PULL TOO SHORT - TAP TO RETRY", sW / 2, sH / 2);
+  } else if (state == DynoEngine::STATE_DONE) {
+    // RPM axis over the range covered, whole thousands
+    float r0 = floorf(_dyno.getMinRpm() / 1000.0f) * 1000.0f;
+    float r1 = ceilf(_dyno.getMaxRpm() / 1000.0f) * 1000.0f;
+    float pMax = _dyno.getPeakPower() * 1.15f;
+    float tMax = _dyno.getPeakTorque() * 1.15f;
+    int top = 16; // Peak text
+    int plotH = sH - top - 1;
+
+    for (float r = r0 + 1000.0f; r < r1; r += 1000.0f) {
+      int x = (int)((r - r0) / (r1 - r0) * (sW - 1));
+      _graphSprite->drawFastVLine(x, top, plotH, 0x39E7);
+    }
+
+    int prevX = 0, prevP = 0, prevT = 0;
+    for (int x = 0; x < sW; x++) {
+      float rpm = r0 + (r1 - r0) * x / (sW - 1);
+      if (rpm < _dyno.getMinRpm() || rpm > _dyno.getMaxRpm())
+        continue;
+      int yP = sH - 1 - (int)(_dyno.fitPower(rpm) / pMax * plotH);
+      int yT = sH - 1 - (int)(_dyno.fitTorque(rpm) / tMax * plotH);
+      if (prevX > 0) {
+        _graphSprite->drawLine(prevX, prevP, x, yP, TFT_RED);
+        _graphSprite->drawLine(prevX, prevT, x, yT, TFT_CYAN);
+      }
+      prevX = x;
+      prevP = yP;
+      prevT = yT;
+    }
+
+    for (int b = 0; b < DynoEngine::BINS; b++) {
+      const DynoEngine::Bin &bin = _dyno.getBin(b);
+      if (bin.n == 0 || bin.rpm < r0 || bin.rpm > r1)
+        continue;
+      int x = (int)((bin.rpm - r0) / (r1 - r0) * (sW - 1));
+      int y = sH - 1 - (int)(bin.power / 1000.0f / pMax * plotH);
+      _graphSprite->fillCircle(x, y, 1, TFT_ORANGE);
+    }
+
+    _graphSprite->setTextDatum(TL_DATUM);
+    _graphSprite->setTextColor(TFT_RED, COLOR_BG);
+    snprintf(buf, sizeof(buf), "%.1f kW @ %.0f", _dyno.getPeakPower(),
+             _dyno.getPeakPowerRpm());
+    _graphSprite->drawString(buf, 4, 0);
+    _graphSprite->setTextDatum(TR_DATUM);
+    _graphSprite->setTextColor(TFT_CYAN, COLOR_BG);
+    snprintf(buf, sizeof(buf), "%.1f Nm @ %.0f", _dyno.getPeakTorque(),
+             _dyno.getPeakTorqueRpm());
+    _graphSprite->drawString(buf, sW - 4, 0);
+    _graphSprite->setTextDatum(TC_DATUM);
+    _graphSprite->setTextColor(TFT_SILVER, COLOR_BG);
+    snprintf(buf, sizeof(buf), "%.0f-%.0fk", r0 / 1000.0f, r1 / 1000.0f);
+    _graphSprite->drawString(buf, sW / 2, 0);
+  }
+
+  _graphSprite->pushSprite(11, 126);
+}
+
+void RpmSensorScreen::drawHistButton() {
+  TFT_eSPI *tft = _ui->getTft();
+  int x = 10, y = 26, w = 70, h = 22;
+  uint16_t bg = _histMode ? TFT_ORANGE : 0x18E3;
+  tft->fillRoundRect(x, y, w, h, 4, bg);
+  tft->setFreeFont(&Org_01);
+  tft->setTextSize(1);
+  tft->setTextDatum(MC_DATUM);
+  tft->setTextColor(_histMode ? TFT_BLACK : TFT_SILVER, bg);
+  tft->drawString("HIST", x + w / 2, y + h / 2);
+}
+
+// Time per RPM band, stacked by gear (grey: neutral, clutch or not
+// learned), scaled to the busiest band. Once a second: the counts move
+// slowly and the sum over gears is 256 adds.
+void RpmSensorScreen::drawEngineHistogram() {
+  if (_graphSprite == nullptr)
+    return;
+  unsigned long now = millis();
+  if (_lastHistDraw != 0 && now - _lastHistDraw < 1000)
+    return;
+  _lastHistDraw = now;
+
+  static const uint16_t gearColor[EngineStats::GEAR_SLOTS] = {
+      TFT_DARKGREY, TFT_RED,  TFT_ORANGE, TFT_YELLOW,
+      TFT_GREEN,    TFT_CYAN, TFT_BLUE,   TFT_MAGENTA};
+
+  gpsManager.getEngineHistogram(_histLifetime, _hist);
+  const EngineStats::Histogram &h = _hist;
+
+  int sW = GRAPH_WIDTH;
+  int sH = GRAPH_HEIGHT;
+  _graphSprite->fillSprite(COLOR_BG);
+  _graphSprite->setTextFont(2);
+  _graphSprite->setTextSize(1);
+
+  char buf[80];
+  if (h.runTicks == 0) {
+    _graphSprite->setTextDatum(MC_DATUM);
+    _graphSprite->setTextColor(TFT_SILVER, COLOR_BG);
+    _graphSprite->drawString(_histLifetime ? "NO ENGINE TIME YET"
+                                           : "NO ENGINE TIME THIS SESSION",
+                             sW / 2, sH / 2);
+    _graphSprite->pushSprite(11, 126);
+    return;
+  }
+
+  // 0-12k at least, further if used
+  int bins = 24;
+  uint32_t maxTicks = 0;
+  for (int b = 0; b < EngineStats::BINS; b++) {
+    uint32_t t = EngineStats::binTicks(h, b);
+    if (t > 0 && b + 1 > bins)
+      bins = b + 1;
+    if (t > maxTicks)
+      maxTicks = t;
+  }
+
+  int top = 16;
+  int plotH = sH - top - 1;
+  int barW = sW / bins;
+  for (int b = 0; b < bins; b++) {
+    int x = b * barW;
+    int y = sH - 1;
+    for (int g = 0; g < EngineStats::GEAR_SLOTS; g++) {
+      uint32_t t = h.ticks[g][b];
+      if (t == 0)
+        continue;
+      int bh = (int)((uint64_t)t * plotH / maxTicks);
+      if (bh < 1)
+        bh = 1;
+      _graphSprite->fillRect(x, y - bh + 1, barW - 1, bh, gearColor[g]);
+      y -= bh;
+    }
+    if (b % 4 == 0 && b > 0)
+      _graphSprite->drawFastVLine(x, top, plotH, 0x39E7);
+  }
+
+  _graphSprite->setTextDatum(TL_DATUM);
+  _graphSprite->setTextColor(TFT_ORANGE, COLOR_BG);
+  snprintf(buf, sizeof(buf), "%s %.2f h", _histLifetime ? "LIFE" : "SESSION",
+           EngineStats::hours(h.runTicks));
+  _graphSprite->drawString(buf, 4, 0);
+  _graphSprite->setTextDatum(TR_DATUM);
+  _graphSprite->setTextColor(TFT_SILVER, COLOR_BG);
+  snprintf(buf, sizeof(buf), "AVG %lu  P90 %lu  PEAK %lu  0-%dk",
+           (unsigned long)EngineStats::meanRpm(h),
+           (unsigned long)EngineStats::percentileRpm(h, 90),
+           (unsigned long)h.peakRpm, bins * EngineStats::BIN_RPM / 1000);
+  _graphSprite->drawString(buf, sW - 4, 0);
+
+  _graphSprite->pushSprite(11, 126);
+}
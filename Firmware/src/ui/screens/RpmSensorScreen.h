@@ -1,6 +1,8 @@
 #ifndef RPM_SENSOR_SCREEN_H
 #define RPM_SENSOR_SCREEN_H
 
+#include "../../core/DynoEngine.h"
+#include "../../core/EngineStats.h"
 #include "../UIManager.h"
 
 class RpmSensorScreen : public UserScreen {
@@ -18,6 +20,10 @@ private:
   void drawGraphGrid();
   void drawGraphLine();
   void updateValues();
+  void drawDynoButton();
+  void drawDynoGraph();
+  void drawHistButton();
+  void drawEngineHistogram();
 
   // Constants
   static const int GRAPH_WIDTH = 458; // Fits inside 460px frame (480-20)
@@ -41,6 +47,20 @@ private:
 
   unsigned long _lastUpdate;
 
+  // Virtual dyno (replaces the graph while on)
+  DynoEngine _dyno;
+  bool _dynoMode = false;
+  uint32_t _lastFixCount = 0;
+  int _dynoShownState = -1;
+  int _dynoShownPoints = -1;
+
+  // Engine usage histogram (replaces the graph while on); tap the plot
+  // to switch between this session and the engine's lifetime
+  bool _histMode = false;
+  bool _histLifetime = false;
+  EngineStats::Histogram _hist; // Copy being drawn
+  unsigned long _lastHistDraw = 0;
+
   // Interrupt Handling
   static volatile unsigned long _rpmPulses;
   static volatile unsigned long _lastPulseMicros;
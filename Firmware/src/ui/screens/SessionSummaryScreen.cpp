@@ -158,47 +158,26 @@ void SessionSummaryScreen::drawSummary() {
   tft->fillRoundRect(mapX, mapY, rightW, mapH, 8, 0x10A2);
   tft->drawRoundRect(mapX, mapY, rightW, mapH, 8, TFT_DARKGREY);
 
-  drawTrackMap(mapX + 5, mapY + 5, rightW - 10, mapH - 10, data.trackPoints);
+  drawTrackMap(mapX + 5, mapY + 5, rightW - 10, mapH - 10, data);
 }
 
 void SessionSummaryScreen::drawTrackMap(int x, int y, int w, int h,
-                                        const std::vector<GPSPoint> &points) {
+                                        const ActiveSessionData &data) {
   TFT_eSPI *tft = _ui->getTft();
-  if (points.empty()) {
+
+  // Prefer the session log (cached on SD), fall back to points in RAM
+  bool ok = false;
+  if (data.sessionFile.length() > 0)
+    ok = _map.load(data.sessionFile, w, h);
+  if (!ok)
+    ok = _map.setPoints(data.trackPoints, w, h);
+
+  if (!ok) {
     tft->setTextColor(TFT_DARKGREY, 0x10A2);
     tft->setTextDatum(MC_DATUM);
     tft->drawString("NO MAP", x + w / 2, y + h / 2);
     return;
   }
 
-  double minLat = 90.0, maxLat = -90.0, minLon = 180.0, maxLon = -180.0;
-  for (const auto &p : points) {
-    if (p.lat < minLat)
-      minLat = p.lat;
-    if (p.lat > maxLat)
-      maxLat = p.lat;
-    if (p.lon < minLon)
-      minLon = p.lon;
-    if (p.lon > maxLon)
-      maxLon = p.lon;
-  }
-
-  double dLat = maxLat - minLat;
-  double dLon = maxLon - minLon;
-  if (dLat == 0)
-    dLat = 0.0001;
-  if (dLon == 0)
-    dLon = 0.0001;
-
-  double scale = min(w / dLon, h / dLat) * 0.9;
-  int offsetX = x + (w - dLon * scale) / 2;
-  int offsetY = y + (h - dLat * scale) / 2;
-
-  for (size_t i = 1; i < points.size(); i++) {
-    int x1 = offsetX + (points[i - 1].lon - minLon) * scale;
-    int y1 = offsetY + (maxLat - points[i - 1].lat) * scale;
-    int x2 = offsetX + (points[i].lon - minLon) * scale;
-    int y2 = offsetY + (maxLat - points[i].lat) * scale;
-    tft->drawLine(x1, y1, x2, y2, TFT_WHITE);
-  }
+  _map.render(tft, x, y, 0x10A2, TFT_WHITE);
 }
@@ -2,6 +2,7 @@
 #define SESSION_SUMMARY_SCREEN_H
 
 #include "../UIManager.h"
+#include "../components/TrackMapRenderer.h"
 #include "TrackData.h"
 
 class SessionSummaryScreen : public UserScreen {
@@ -15,8 +16,9 @@ private:
   UIManager *_ui;
 
   void drawSummary();
-  void drawTrackMap(int x, int y, int w, int h,
-                    const std::vector<GPSPoint> &points);
+  TrackMapRenderer _map;
+
+  void drawTrackMap(int x, int y, int w, int h, const ActiveSessionData &data);
 };
 
 #endif
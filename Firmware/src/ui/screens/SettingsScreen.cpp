@@ -1,7 +1,10 @@
 #include "SettingsScreen.h"
 #include "../../config.h"
+#include "../../core/DynoEngine.h"
 #include "../../core/GPSManager.h"
+#include "../../core/QuotaManager.h"
 #include "../../core/SessionManager.h"
+#include "../../core/ShiftAlert.h"
 #include "../../core/SyncManager.h"
 #include "../../core/WiFiManager.h"
 #include "../fonts/Org_01.h"
@@ -9,6 +12,7 @@
 #include "TimeSettingScreen.h"
 
 extern SessionManager sessionManager;
+extern QuotaManager quotaManager;
 extern WiFiManager wifiManager;
 extern SyncManager syncManager;
 
@@ -139,6 +143,11 @@ void SettingsScreen::loadSettings() {
     engineHours.currentOptionIdx = 0;
     _settings.push_back(engineHours);
 
+    // Learned gear ratios (new vehicle / gearing: start over)
+    _settings.push_back({"RESET GEARS", TYPE_ACTION});
+    // RPM histograms (new engine); TOTAL HOURS is kept
+    _settings.push_back({"RESET RPM STATS", TYPE_ACTION});
+
     _prefs.end();
   } else if (_currentMode == MODE_RPM) {
     _prefs.begin("laptimer", false);
@@ -160,6 +169,31 @@ void SettingsScreen::loadSettings() {
     rpmOnOff.checkState = gpsManager.isRpmEnabled();
     _settings.push_back(rpmOnOff);
 
+    // Shift light: a default point, per-gear overrides and over-rev
+    SettingItem shift = {"SHIFT RPM", TYPE_VALUE, "shift_rpm"};
+    shift.options.push_back("OFF");
+    for (int i = 0; i < ShiftAlert::RPM_OPTIONS; i++)
+      shift.options.push_back(String(ShiftAlert::rpmOption(i)));
+    shift.currentOptionIdx = _prefs.getInt("shift_rpm", 0);
+    _settings.push_back(shift);
+
+    for (int g = 1; g <= ShiftAlert::MAX_GEARS; g++) {
+      String key = String("shift_g") + g;
+      SettingItem gear = {String("SHIFT GEAR ") + g, TYPE_VALUE, key};
+      gear.options.push_back("SAME");
+      for (int i = 0; i < ShiftAlert::RPM_OPTIONS; i++)
+        gear.options.push_back(String(ShiftAlert::rpmOption(i)));
+      gear.currentOptionIdx = _prefs.getInt(key.c_str(), 0);
+      _settings.push_back(gear);
+    }
+
+    SettingItem overRev = {"OVER-REV", TYPE_VALUE, "overrev_rpm"};
+    overRev.options.push_back("OFF");
+    for (int i = 0; i < ShiftAlert::RPM_OPTIONS; i++)
+      overRev.options.push_back(String(ShiftAlert::rpmOption(i)));
+    overRev.currentOptionIdx = _prefs.getInt("overrev_rpm", 0);
+    _settings.push_back(overRev);
+
     // Engine Hours (Moved here)
     _settings.push_back({"ENGINE HOURS", TYPE_ACTION});
 
@@ -169,6 +203,25 @@ void SettingsScreen::loadSettings() {
     units.currentOptionIdx = _prefs.getInt("units", 0); // Default Metric
     _settings.push_back(units);
 
+    // Virtual dyno: vehicle + rider mass and drag for the RPM screen
+    SettingItem mass = {"DYNO MASS", TYPE_VALUE, "dyno_mass"};
+    for (int i = 0; i < DynoEngine::MASS_OPTIONS; i++)
+      mass.options.push_back(String((int)DynoEngine::massOption(i)) + " kg");
+    mass.currentOptionIdx = _prefs.getInt("dyno_mass", 2); // 200 kg
+    _settings.push_back(mass);
+
+    SettingItem cda = {"DYNO CdA", TYPE_VALUE, "dyno_cda"};
+    for (int i = 0; i < DynoEngine::CDA_OPTIONS; i++)
+      cda.options.push_back(String(DynoEngine::cdAOption(i), 1) + " m2");
+    cda.currentOptionIdx = _prefs.getInt("dyno_cda", 3); // 0.6
+    _settings.push_back(cda);
+
+    SettingItem crr = {"DYNO Crr", TYPE_VALUE, "dyno_crr"};
+    for (int i = 0; i < DynoEngine::CRR_OPTIONS; i++)
+      crr.options.push_back(String(DynoEngine::crrOption(i), 3));
+    crr.currentOptionIdx = _prefs.getInt("dyno_crr", 1); // 0.015
+    _settings.push_back(crr);
+
     _prefs.end();
   } else if (_currentMode == MODE_CLOCK) {
     _prefs.begin("laptimer", false);
@@ -220,11 +273,11 @@ void SettingsScreen::loadSettings() {
     proj.currentOptionIdx = projState ? 1 : 0;
     _settings.push_back(proj);
 
-    // 3. Frequency Limit
+    // 3. Frequency Limit (cap of the session profile rate)
     SettingItem freq = {"FREQUENCY LIMIT", TYPE_VALUE, "gnss_freq_limit"};
-    freq.options = {"1 Hz", "2 Hz", "5 Hz", "10 Hz", "18 Hz"};
+    freq.options = {"1 Hz", "2 Hz", "5 Hz", "10 Hz", "18 Hz", "25 Hz"};
     freq.currentOptionIdx =
-        _prefs.getInt("gnss_freq_limit", 2); // Default 5Hz (Index 2)
+        _prefs.getInt("gnss_freq_limit", 5); // Default 25Hz (Index 5)
     _settings.push_back(freq);
 
     // 4. Dynamic Model
@@ -321,6 +374,15 @@ void SettingsScreen::loadSettings() {
     // TFT Benchmark (Standard)
     _settings.push_back({"TFT BENCHMARK", TYPE_ACTION});
 
+    // Free space to keep before a session starts (rotates synced sessions)
+    SettingItem quota = {"LOG HEADROOM", TYPE_VALUE, "quota_hours"};
+    quota.options = {"30 min", "1 hr", "2 hr", "4 hr", "8 hr"};
+    quota.currentOptionIdx = _prefs.getInt("quota_hours", 2); // Default 2 hr
+    if (quota.currentOptionIdx < 0 ||
+        quota.currentOptionIdx >= quota.options.size())
+      quota.currentOptionIdx = 2;
+    _settings.push_back(quota);
+
     _prefs.end();
   }
 }
@@ -364,11 +426,20 @@ void SettingsScreen::saveSetting(int idx) {
       _ui->setAutoOff(ms);
     }
 
+    if (item.key == "quota_hours") {
+      quotaManager.setHeadroomIndex(item.currentOptionIdx);
+    }
+
     if (item.key == "rpm_ppr") {
       extern GPSManager gpsManager;
       gpsManager.setPPRIndex(item.currentOptionIdx);
     }
 
+    if (item.key.startsWith("shift_") || item.key == "overrev_rpm") {
+      extern GPSManager gpsManager;
+      gpsManager.loadShiftConfig();
+    }
+
     // GPS Config Handlers
     extern GPSManager gpsManager;
 
@@ -408,6 +479,9 @@ void SettingsScreen::saveSetting(int idx) {
       case 4:
         freq = 18;
         break;
+      case 5:
+        freq = 25;
+        break;
       }
       gpsManager.setFrequencyLimit(freq);
     }
@@ -805,6 +879,15 @@ void SettingsScreen::handleTouch(int idx) {
       drawList(0, true);
       _ui->drawStatusBar(true);
       drawList(0, true);
+    } else if (item.name == "RESET GEARS") {
+      extern GPSManager gpsManager;
+      int gears = gpsManager.getGears().getGearCount();
+      gpsManager.resetGearModel();
+      _ui->showToast(String(gears) + " GEARS CLEARED", 1500);
+    } else if (item.name == "RESET RPM STATS") {
+      extern GPSManager gpsManager;
+      gpsManager.resetEngineStats();
+      _ui->showToast("RPM STATS CLEARED", 1500);
     } else if (item.name == "WIFI / CLOUD") {
       _currentMode = MODE_WIFI_MENU;
       loadSettings();
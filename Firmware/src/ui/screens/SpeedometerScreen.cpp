@@ -51,8 +51,10 @@ void SpeedometerScreen::update() {
     bool rpmChanged = (abs(currentRPM - _lastRPM) > 50);
     bool satsChanged = (sats != _lastSats);
     bool tripChanged = (abs(trip - _lastTrip) > 0.1);
+    bool gearChanged = (gpsManager.getGear() != _lastGear);
 
-    if (speedChanged || rpmChanged || satsChanged || tripChanged) {
+    if (speedChanged || rpmChanged || satsChanged || tripChanged ||
+        gearChanged) {
       if (speed > _maxSpeed)
         _maxSpeed = speed;
       if (currentRPM > _maxRPM)
@@ -157,10 +159,10 @@ void SpeedometerScreen::drawDashboard(bool force) {
   }
 
   // --- 3. CENTER STAGE ---
-  // Gear 'Badge'
-  int gear = (_lastSpeed < 2) ? 0 : (_lastSpeed / 20) + 1;
-  if (gear > 6)
-    gear = 6;
+  // Gear 'Badge': learned from the RPM/speed ratio, '-' while moving
+  // without a known gear (clutch, shifting, not learned yet)
+  int gear = gpsManager.getGear();
+  _lastGear = gear;
 
   if (force) {
     // Gear box background look
@@ -169,10 +171,12 @@ void SpeedometerScreen::drawDashboard(bool force) {
   tft->setTextFont(4);
   tft->setTextColor(TFT_YELLOW, COL_BG);
   tft->setTextDatum(MC_DATUM);
+  tft->setTextPadding(36);
   if (gear == 0)
-    tft->drawString("N", cx, cy - 70);
+    tft->drawString(_lastSpeed < 2 ? "N" : "-", cx, cy - 70);
   else
     tft->drawNumber(gear, cx, cy - 70);
+  tft->setTextPadding(0);
 
   // Main Speed
   tft->setTextColor(COL_MAIN, COL_BG);
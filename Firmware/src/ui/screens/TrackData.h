@@ -1,14 +1,17 @@
 #ifndef TRACK_DATA_H
 #define TRACK_DATA_H
 
+#include "../../core/GeoTypes.h"
+#include "../../core/LapTimingEngine.h"
+#include "../../core/MiniSectorEngine.h"
 #include <Arduino.h>
 #include <vector>
 
-// GPS Point for track recording
+// GPS Point for track recording (12 bytes)
 struct GPSPoint {
-  double lat;
-  double lon;
-  unsigned long timestamp;
+  int32_t latE7;
+  int32_t lonE7;
+  uint32_t timestamp;
 };
 
 struct TrackConfig {
@@ -19,8 +22,7 @@ struct TrackConfig {
 struct Track {
   String name;
   std::vector<TrackConfig> configs;
-  double lat;
-  double lon;
+  TrackLayout layout; // Start/finish point, optional timing lines
   bool isCustom = true;
   String pathFile; // Path to CSV file containing track points
   unsigned long bestLap = 0;
@@ -32,6 +34,7 @@ struct ActiveSessionData {
   unsigned long bestLapTime;
   int lapCount;
   int maxRpm;
+  String sessionFile; // Log on SD, used for the map
   std::vector<GPSPoint> trackPoints;
 };
 
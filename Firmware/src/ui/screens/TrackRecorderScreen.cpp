@@ -12,7 +12,9 @@ void TrackRecorderScreen::onShow() {
   _state = REC_IDLE;
   _recordedPoints.clear();
   _recordingStartTime = 0;
-  _lastPointTime = 0;
+  _rawCount = 0;
+  _pathDist = 0;
+  _gateReady = false;
   _lastTouchTime = millis();
 
   _lastStateRender = (RecorderState)-1;
@@ -24,11 +26,8 @@ void TrackRecorderScreen::onShow() {
 }
 
 void TrackRecorderScreen::onHide() {
-  // Stop any active recording if screen is switched?
-  // Maybe better to alert or just stop.
-  if (_state == REC_ACTIVE) {
-    sessionManager.stopSession();
-  }
+  // Leave the raw stream on SD, it is still a usable lat,lon path
+  closeRaw();
 }
 
 void TrackRecorderScreen::update() {
@@ -56,19 +55,7 @@ void TrackRecorderScreen::update() {
       if (p.x > btnX && p.x < btnX + btnW && p.y > btnY - 20) {
         // GPS Check (Optional bypass for testing)
         if (true || gpsManager.isFixed()) {
-          _state = REC_ACTIVE;
-          _recordStartLat = gpsManager.getLatitude();
-          _recordStartLon = gpsManager.getLongitude();
-          _recordingStartTime = millis();
-          _lastPointTime = millis();
-          _recordedPoints.clear();
-
-          GPSPoint first;
-          first.lat = _recordStartLat;
-          first.lon = _recordStartLon;
-          first.timestamp = millis();
-          _recordedPoints.push_back(first);
-
+          startRecording();
           _lastStateRender = (RecorderState)-1; // Force Redraw
         }
       }
@@ -77,6 +64,7 @@ void TrackRecorderScreen::update() {
       int stopW = 140;
       int stopX = (SCREEN_WIDTH - stopW) / 2;
       if (p.x > stopX && p.x < stopX + stopW && p.y > btnY - 20) {
+        closeRaw();
         _state = REC_COMPLETE;
         _lastStateRender = (RecorderState)-1;
       }
@@ -88,7 +76,8 @@ void TrackRecorderScreen::update() {
 
       // KEEP (Left)
       if (p.x > startX && p.x < startX + keepW && p.y > btnY - 10) {
-        String filename = "/tracks/track_" + String(millis()) + ".gpx";
+        String filename = _rawPath;
+        filename.replace(".csv", ".gpx");
         saveTrackToGPX(filename);
         _ui->showToast("Saved to SD Card!", 2000);
 
@@ -100,41 +89,18 @@ void TrackRecorderScreen::update() {
                p.x < startX + keepW + gap + keepW && p.y > btnY - 10) {
         _state = REC_IDLE;
         _recordedPoints.clear();
+        if (_rawPath.length() > 0)
+          SD.remove(_rawPath);
         _lastStateRender = (RecorderState)-1;
       }
     }
   }
 
-  // Recording Logic
-  if (_state == REC_ACTIVE) {
-    unsigned long now = millis();
-    if (now - _lastPointTime > 2000) {
-      if (gpsManager.isFixed()) {
-        double currentLat = gpsManager.getLatitude();
-        double currentLon = gpsManager.getLongitude();
-
-        if (_recordedPoints.size() > 0) {
-          GPSPoint &last = _recordedPoints.back();
-          double dist = gpsManager.distanceBetween(last.lat, last.lon,
-                                                   currentLat, currentLon);
-          if (dist > 5) {
-            GPSPoint p;
-            p.lat = currentLat;
-            p.lon = currentLon;
-            p.timestamp = now;
-            _recordedPoints.push_back(p);
-
-            // Check if returned to start (Loop closure)
-            double distToStart = gpsManager.distanceBetween(
-                _recordStartLat, _recordStartLon, currentLat, currentLon);
-            if (distToStart < 15 && _recordedPoints.size() > 20) {
-              _state = REC_COMPLETE;
-            }
-          }
-        }
-      }
-      _lastPointTime = now;
-    }
+  // Recording Logic: every new epoch
+  if (_state == REC_ACTIVE && gpsManager.getFixCount() != _lastFixCount) {
+    _lastFixCount = gpsManager.getFixCount();
+    if (gpsManager.isFixed())
+      onEpoch();
   }
 
   drawDynamic();
@@ -239,13 +205,10 @@ void TrackRecorderScreen::drawDynamic() {
     tft->setTextColor(TFT_SKYBLUE, 0x10A2);
     tft->setTextFont(4);
     tft->setTextDatum(MC_DATUM);
-    tft->drawNumber(_recordedPoints.size(), 10 + subW / 2, subY + 28);
+    tft->drawNumber(_rawCount, 10 + subW / 2, subY + 28);
 
-    double dist = gpsManager.distanceBetween(_recordStartLat, _recordStartLon,
-                                             gpsManager.getLatitude(),
-                                             gpsManager.getLongitude());
     tft->setTextColor(TFT_ORANGE, 0x10A2);
-    tft->drawNumber((int)dist, 15 + subW + subW / 2, subY + 28);
+    tft->drawNumber((int)_pathDist, 15 + subW + subW / 2, subY + 28);
 
   } else if (_state == REC_COMPLETE) {
     if (stateChanged) {
@@ -255,7 +218,8 @@ void TrackRecorderScreen::drawDynamic() {
       tft->setTextDatum(MC_DATUM);
       tft->drawString("TRACK RECORDED!", SCREEN_WIDTH / 2, contentY + 20);
 
-      String stats = String(_recordedPoints.size()) + " Pts | " +
+      String stats = String(_rawCount) + " Pts | " +
+                     String((int)_pathDist) + "m | " +
                      String((millis() - _recordingStartTime) / 1000) + "s";
       tft->setTextColor(TFT_WHITE, TFT_BLACK);
       tft->setTextFont(2);
@@ -274,22 +238,162 @@ void TrackRecorderScreen::drawDynamic() {
   _lastStateRender = _state;
 }
 
-void TrackRecorderScreen::saveTrackToGPX(String filename) {
-  if (_recordedPoints.empty())
-    return;
+void TrackRecorderScreen::startRecording() {
+  _state = REC_ACTIVE;
+  _frame.setOrigin(gpsManager.getPosition());
+  _recordingStartTime = millis();
+  _recordedPoints.clear();
+  _recordedPoints.reserve(MAX_POINTS);
+  _rawCount = 0;
+  _pathDist = 0;
+  _prevX = 0;
+  _prevY = 0;
+  _gateReady = false;
+  _lastFixCount = gpsManager.getFixCount();
+
   if (!SD.exists("/tracks"))
     SD.mkdir("/tracks");
+  _rawPath = "/tracks/track_" + String(millis()) + ".csv";
+  _rawFile = SD.open(_rawPath, FILE_WRITE);
+  _lastFlush = millis();
+
+  GPSPoint first;
+  first.latE7 = _frame.origin.latE7;
+  first.lonE7 = _frame.origin.lonE7;
+  first.timestamp = millis();
+  _recordedPoints.push_back(first);
+  writeRaw(first.latE7, first.lonE7, first.timestamp);
+}
+
+void TrackRecorderScreen::onEpoch() {
+  GeoPoint pos = gpsManager.getPosition();
+  unsigned long now = millis();
+
+  float x = _frame.xM(pos.lonE7);
+  float y = _frame.yM(pos.latE7);
+  float dx = x - _prevX;
+  float dy = y - _prevY;
+  float step = sqrt(dx * dx + dy * dy);
+  if (step < 0.5)
+    return; // Standing still, don't fill the card with jitter
+
+  writeRaw(pos.latE7, pos.lonE7, now);
+
+  GPSPoint p;
+  p.latE7 = pos.latE7;
+  p.lonE7 = pos.lonE7;
+  p.timestamp = now;
+  addOutlinePoint(p);
+
+  // Start line = perpendicular to the first 15 m of travel
+  if (!_gateReady) {
+    float d = sqrt(x * x + y * y);
+    if (d > 15.0) {
+      _dirX = x / d;
+      _dirY = y / d;
+      _gateReady = true;
+    }
+  } else if (_pathDist > MIN_LOOP_M) {
+    // Signed distance ahead of the line for previous and current epoch
+    float sPrev = _prevX * _dirX + _prevY * _dirY;
+    float sCur = x * _dirX + y * _dirY;
+    if (sPrev < 0 && sCur >= 0) {
+      float t = -sPrev / (sCur - sPrev);
+      float cx = _prevX + t * dx;
+      float cy = _prevY + t * dy;
+      float lateral = fabs(cx * -_dirY + cy * _dirX);
+      if (lateral <= GATE_HALF_W) {
+        // Close exactly on the line crossing
+        GeoPoint g = _frame.toGeo(cx, cy);
+        GPSPoint c = {g.latE7, g.lonE7, (uint32_t)now};
+        writeRaw(c.latE7, c.lonE7, now);
+        _recordedPoints.push_back(c);
+        closeRaw();
+        _state = REC_COMPLETE;
+      }
+    }
+  }
+
+  _pathDist += step;
+  _prevX = x;
+  _prevY = y;
+
+  // Bound data loss on power cut to ~2 s
+  if (_rawFile && now - _lastFlush > 2000) {
+    _rawFile.flush();
+    _lastFlush = now;
+  }
+}
+
+// Online Visvalingam: when full, drop the interior point that spans the
+// smallest triangle with its neighbours (least visible detail)
+void TrackRecorderScreen::addOutlinePoint(const GPSPoint &p) {
+  if (_recordedPoints.size() >= MAX_POINTS) {
+    size_t minIdx = 1;
+    float minArea = 1e30;
+    for (size_t i = 1; i + 1 < _recordedPoints.size(); i++) {
+      const GPSPoint &a = _recordedPoints[i - 1];
+      const GPSPoint &b = _recordedPoints[i];
+      const GPSPoint &c = _recordedPoints[i + 1];
+      float ax = _frame.xM(a.lonE7), ay = _frame.yM(a.latE7);
+      float bx = _frame.xM(b.lonE7), by = _frame.yM(b.latE7);
+      float cx = _frame.xM(c.lonE7), cy = _frame.yM(c.latE7);
+      float area = fabs((bx - ax) * (cy - ay) - (cx - ax) * (by - ay));
+      if (area < minArea) {
+        minArea = area;
+        minIdx = i;
+      }
+    }
+    _recordedPoints.erase(_recordedPoints.begin() + minIdx);
+  }
+  _recordedPoints.push_back(p);
+}
+
+void TrackRecorderScreen::writeRaw(int32_t latE7, int32_t lonE7,
+                                   unsigned long t) {
+  if (!_rawFile)
+    return;
+  // lat,lon,time - readable as a track path by the map renderer
+  char lat[16], lon[16];
+  formatE7(lat, latE7);
+  formatE7(lon, lonE7);
+  _rawFile.printf("%s,%s,%lu\n", lat, lon, t);
+  _rawCount++;
+}
+
+void TrackRecorderScreen::closeRaw() {
+  if (_rawFile) {
+    _rawFile.close();
+  }
+}
+
+void TrackRecorderScreen::saveTrackToGPX(String filename) {
+  File in = SD.open(_rawPath, FILE_READ);
+  if (!in)
+    return;
   File file = SD.open(filename, FILE_WRITE);
-  if (!file)
+  if (!file) {
+    in.close();
     return;
+  }
 
   file.println("<?xml version=\"1.0\" encoding=\"UTF-8\"?>");
   file.println("<gpx version=\"1.1\" creator=\"MuchRacing\" "
                "xmlns=\"http://www.topografix.com/GPX/1/"
                "1\"><trk><name>Recorded Track</name><trkseg>");
-  for (const auto &p : _recordedPoints) {
-    file.printf("<trkpt lat=\"%.7f\" lon=\"%.7f\"></trkpt>\n", p.lat, p.lon);
+  // Full resolution from the raw stream, not the RAM outline
+  while (in.available()) {
+    String line = in.readStringUntil('\n');
+    int c1 = line.indexOf(',');
+    int c2 = line.indexOf(',', c1 + 1);
+    if (c1 <= 0 || c2 <= c1)
+      continue;
+    file.print("<trkpt lat=\"" + line.substring(0, c1) + "\" lon=\"" +
+               line.substring(c1 + 1, c2) + "\"></trkpt>\n");
   }
   file.println("</trkseg></trk></gpx>");
   file.close();
+  in.close();
+
+  SD.remove(_rawPath);
 }
@@ -3,6 +3,7 @@
 
 #include "../UIManager.h"
 #include "TrackData.h"
+#include <FS.h>
 #include <vector>
 
 enum RecorderState { REC_IDLE, REC_ACTIVE, REC_COMPLETE };
@@ -17,12 +18,29 @@ public:
 private:
   UIManager *_ui;
   RecorderState _state;
-  std::vector<GPSPoint> _recordedPoints;
-  double _recordStartLat, _recordStartLon;
+  std::vector<GPSPoint> _recordedPoints; // Simplified outline (capped)
   unsigned long _recordingStartTime;
-  unsigned long _lastPointTime;
   unsigned long _lastTouchTime = 0;
 
+  // Raw Stream (every epoch goes to SD, survives a crash)
+  static const int MAX_POINTS = 256;  // RAM outline cap
+  static const int MIN_LOOP_M = 200;  // Path length before closure counts
+  static const int GATE_HALF_W = 15;  // Start line half width (m)
+  File _rawFile;
+  String _rawPath;
+  uint32_t _lastFixCount = 0;
+  uint32_t _rawCount = 0;
+  unsigned long _lastFlush = 0;
+
+  // Local Frame (metres from start)
+  LocalFrame _frame;
+  float _prevX = 0, _prevY = 0;
+  float _pathDist = 0;
+
+  // Start Line (perpendicular to initial direction through start point)
+  bool _gateReady = false;
+  float _dirX = 0, _dirY = 0;
+
   // Flicker Reduction
   RecorderState _lastStateRender = (RecorderState)-1;
   bool _lastGpsFixed = false;
@@ -30,6 +48,11 @@ private:
 
   void drawStatic();
   void drawDynamic();
+  void startRecording();
+  void onEpoch();
+  void addOutlinePoint(const GPSPoint &p);
+  void writeRaw(int32_t latE7, int32_t lonE7, unsigned long t);
+  void closeRaw();
   void saveTrackToGPX(String filename);
 };
 